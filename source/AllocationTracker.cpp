@@ -0,0 +1,239 @@
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+using namespace dae;
+using namespace dae::AllocationTracker;
+
+namespace
+{
+	constexpr size_t g_NumPhases{ static_cast<size_t>(Phase::Count) };
+	constexpr const char* g_PhaseNames[g_NumPhases]{ "Other", "Update", "Render", "Present" };
+
+	//Everything operator new touches is constant initialized, so counting works before main and after it
+	struct AtomicCounters
+	{
+		std::atomic<uint64_t> allocations{};
+		std::atomic<uint64_t> bytes{};
+	};
+
+	AtomicCounters g_TotalCounters[g_NumPhases]{};
+	AtomicCounters g_FrameCounters[g_NumPhases]{};
+	std::atomic<uint64_t> g_NumViolations{};
+	std::atomic<bool> g_HasReportedViolation{};
+
+	thread_local ThreadState t_ThreadState{};
+
+	//Only touched by the thread that calls BeginFrame and EndFrame
+	struct FrameStatistics
+	{
+		Counters firstFrame{};
+		Counters laterFrames{};
+		Counters worstFrame{};
+	};
+
+	FrameStatistics g_FrameStatistics[g_NumPhases]{};
+	uint64_t g_NumFrames{};
+
+	void CountAllocation(size_t size)
+	{
+		const size_t phase{ static_cast<size_t>(t_ThreadState.phase) };
+		g_TotalCounters[phase].allocations.fetch_add(1, std::memory_order_relaxed);
+		g_TotalCounters[phase].bytes.fetch_add(size, std::memory_order_relaxed);
+		g_FrameCounters[phase].allocations.fetch_add(1, std::memory_order_relaxed);
+		g_FrameCounters[phase].bytes.fetch_add(size, std::memory_order_relaxed);
+
+		if (t_ThreadState.pNoAllocationScope)
+			g_NumViolations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void* Allocate(size_t size)
+	{
+		CountAllocation(size);
+		if (void* pMemory{ std::malloc(size == 0 ? 1 : size) })
+			return pMemory;
+		throw std::bad_alloc{};
+	}
+
+	void* AllocateAligned(size_t size, std::align_val_t alignment)
+	{
+		CountAllocation(size);
+		const size_t alignmentBytes{ static_cast<size_t>(alignment) };
+#if defined(_MSC_VER)
+		void* pMemory{ _aligned_malloc(size == 0 ? 1 : size, alignmentBytes) };
+#else
+		//aligned_alloc wants a multiple of the alignment
+		void* pMemory{ std::aligned_alloc(alignmentBytes, (std::max<size_t>(size, 1) + alignmentBytes - 1) / alignmentBytes * alignmentBytes) };
+#endif
+		if (pMemory)
+			return pMemory;
+		throw std::bad_alloc{};
+	}
+
+	void FreeAligned(void* pMemory)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(pMemory);
+#else
+		std::free(pMemory);
+#endif
+	}
+
+	void PrintCounters(const char* pLabel, const Counters& counters)
+	{
+		std::cout << pLabel << counters.allocations << " allocations, " << counters.bytes << " bytes";
+	}
+}
+
+ThreadState AllocationTracker::GetThreadState()
+{
+	return t_ThreadState;
+}
+
+ThreadStateScope::ThreadStateScope(const ThreadState& state) :
+	m_PreviousState(t_ThreadState)
+{
+	t_ThreadState = state;
+}
+
+ThreadStateScope::~ThreadStateScope()
+{
+	t_ThreadState = m_PreviousState;
+}
+
+PhaseScope::PhaseScope(Phase phase) :
+	m_PreviousPhase(t_ThreadState.phase)
+{
+	t_ThreadState.phase = phase;
+}
+
+PhaseScope::~PhaseScope()
+{
+	t_ThreadState.phase = m_PreviousPhase;
+}
+
+NoAllocationScope::NoAllocationScope(const char* pName) :
+	m_pPreviousName(t_ThreadState.pNoAllocationScope),
+	m_ViolationsAtStart(g_NumViolations.load())
+{
+	t_ThreadState.pNoAllocationScope = pName;
+}
+
+NoAllocationScope::~NoAllocationScope()
+{
+	const char* pName{ t_ThreadState.pNoAllocationScope };
+	t_ThreadState.pNoAllocationScope = m_pPreviousName;
+
+	//Other threads in a scope of their own can add to the count as well, good enough to know something allocated
+	const uint64_t numViolations{ g_NumViolations.load() - m_ViolationsAtStart };
+	if (numViolations > 0 && !g_HasReportedViolation.exchange(true))
+		std::cout << "Allocated " << numViolations << " times in no-allocation scope " << pName << ", later violations are only counted" << std::endl;
+}
+
+void AllocationTracker::BeginFrame()
+{
+	for (AtomicCounters& counters : g_FrameCounters)
+	{
+		counters.allocations.store(0);
+		counters.bytes.store(0);
+	}
+}
+
+void AllocationTracker::EndFrame()
+{
+	for (size_t phase{}; phase < g_NumPhases; ++phase)
+	{
+		const Counters frame{ g_FrameCounters[phase].allocations.exchange(0), g_FrameCounters[phase].bytes.exchange(0) };
+		FrameStatistics& statistics{ g_FrameStatistics[phase] };
+		if (g_NumFrames == 0)
+		{
+			statistics.firstFrame = frame;
+			continue;
+		}
+
+		statistics.laterFrames.allocations += frame.allocations;
+		statistics.laterFrames.bytes += frame.bytes;
+		statistics.worstFrame.allocations = std::max(statistics.worstFrame.allocations, frame.allocations);
+		statistics.worstFrame.bytes = std::max(statistics.worstFrame.bytes, frame.bytes);
+	}
+	++g_NumFrames;
+}
+
+Counters AllocationTracker::GetTotalCounters(Phase phase)
+{
+	const AtomicCounters& counters{ g_TotalCounters[static_cast<size_t>(phase)] };
+	return { counters.allocations.load(), counters.bytes.load() };
+}
+
+uint64_t AllocationTracker::GetNumViolations()
+{
+	return g_NumViolations.load();
+}
+
+void AllocationTracker::PrintReport()
+{
+	std::cout << "Heap allocations over " << g_NumFrames << " frames\n";
+	for (size_t phase{}; phase < g_NumPhases; ++phase)
+	{
+		const FrameStatistics& statistics{ g_FrameStatistics[phase] };
+		std::cout << "  " << g_PhaseNames[phase] << "\n";
+		PrintCounters("    First frame:          ", statistics.firstFrame);
+		if (g_NumFrames > 1)
+		{
+			const uint64_t numLaterFrames{ g_NumFrames - 1 };
+			PrintCounters("\n    Later frames average: ", { statistics.laterFrames.allocations / numLaterFrames, statistics.laterFrames.bytes / numLaterFrames });
+			PrintCounters("\n    Later frames worst:   ", statistics.worstFrame);
+		}
+		PrintCounters("\n    Total:                ", GetTotalCounters(static_cast<Phase>(phase)));
+		std::cout << "\n";
+	}
+	std::cout << "  No-allocation scope violations: " << g_NumViolations.load() << std::endl;
+}
+
+//Replacements of the global allocation functions, the nothrow versions are replaced as well because some standard
+//libraries implement them without calling the throwing ones
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AllocateAligned(size, alignment); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try { return Allocate(size); }
+	catch (const std::bad_alloc&) { return nullptr; }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	try { return Allocate(size); }
+	catch (const std::bad_alloc&) { return nullptr; }
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return AllocateAligned(size, alignment); }
+	catch (const std::bad_alloc&) { return nullptr; }
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return AllocateAligned(size, alignment); }
+	catch (const std::bad_alloc&) { return nullptr; }
+}
+
+void operator delete(void* pMemory) noexcept { std::free(pMemory); }
+void operator delete[](void* pMemory) noexcept { std::free(pMemory); }
+void operator delete(void* pMemory, size_t) noexcept { std::free(pMemory); }
+void operator delete[](void* pMemory, size_t) noexcept { std::free(pMemory); }
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept { std::free(pMemory); }
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept { std::free(pMemory); }
+void operator delete(void* pMemory, std::align_val_t) noexcept { FreeAligned(pMemory); }
+void operator delete[](void* pMemory, std::align_val_t) noexcept { FreeAligned(pMemory); }
+void operator delete(void* pMemory, size_t, std::align_val_t) noexcept { FreeAligned(pMemory); }
+void operator delete[](void* pMemory, size_t, std::align_val_t) noexcept { FreeAligned(pMemory); }
+void operator delete(void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(pMemory); }
+void operator delete[](void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(pMemory); }
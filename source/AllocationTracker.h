@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	//Counts every heap allocation the program makes, through replacements of the global operator new and delete
+	//Allocations are booked on the phase of the thread that makes them; ParallelFor hands the phase of its caller to
+	//the threads it runs on. Works on every platform, unlike vld which only reports leaks at exit on Windows.
+	namespace AllocationTracker
+	{
+		enum class Phase
+		{
+			Other,
+			Update,
+			Render,
+			Present,
+			//Number of phases
+			Count
+		};
+
+		struct Counters
+		{
+			uint64_t allocations{};
+			uint64_t bytes{};
+		};
+
+		//What the calling thread is doing, copied to the worker threads of a ParallelFor
+		struct ThreadState
+		{
+			Phase phase{ Phase::Other };
+			//Name of the innermost NoAllocationScope, nullptr outside of one
+			const char* pNoAllocationScope{};
+		};
+
+		ThreadState GetThreadState();
+
+		//Gives the calling thread another state until the scope ends
+		class ThreadStateScope final
+		{
+		public:
+			explicit ThreadStateScope(const ThreadState& state);
+			~ThreadStateScope();
+
+			ThreadStateScope(const ThreadStateScope&) = delete;
+			ThreadStateScope(ThreadStateScope&&) noexcept = delete;
+			ThreadStateScope& operator=(const ThreadStateScope&) = delete;
+			ThreadStateScope& operator=(ThreadStateScope&&) noexcept = delete;
+
+		private:
+			ThreadState m_PreviousState{};
+		};
+
+		//Books allocations of the calling thread on phase until the scope ends
+		class PhaseScope final
+		{
+		public:
+			explicit PhaseScope(Phase phase);
+			~PhaseScope();
+
+			PhaseScope(const PhaseScope&) = delete;
+			PhaseScope(PhaseScope&&) noexcept = delete;
+			PhaseScope& operator=(const PhaseScope&) = delete;
+			PhaseScope& operator=(PhaseScope&&) noexcept = delete;
+
+		private:
+			Phase m_PreviousPhase{};
+		};
+
+		//Code that must not allocate, such as tracing a frame. Allocations inside, also by the threads of a ParallelFor
+		//started inside, count as violations; the first scope that has one prints a message when it ends
+		class NoAllocationScope final
+		{
+		public:
+			//pName is kept, pass a string literal
+			explicit NoAllocationScope(const char* pName);
+			~NoAllocationScope();
+
+			NoAllocationScope(const NoAllocationScope&) = delete;
+			NoAllocationScope(NoAllocationScope&&) noexcept = delete;
+			NoAllocationScope& operator=(const NoAllocationScope&) = delete;
+			NoAllocationScope& operator=(NoAllocationScope&&) noexcept = delete;
+
+		private:
+			const char* m_pPreviousName{};
+			uint64_t m_ViolationsAtStart{};
+		};
+
+		//Frames are counted from BeginFrame to EndFrame, allocations outside of a frame only go in the totals
+		void BeginFrame();
+		void EndFrame();
+
+		Counters GetTotalCounters(Phase phase);
+		uint64_t GetNumViolations();
+
+		//Per phase: the first frame, the average and worst frame after it, and the totals; then the violations
+		void PrintReport();
+	}
+}
@@ -0,0 +1,528 @@
+#include "BatchRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AllocationTracker.h"
+#include "CameraPath.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "TileCoordinator.h"
+#include "Timer.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr int g_NumValidationWorkers{ 3 };
+		//A hanging worker is only noticed at the timeout, so --validate-workers caps it
+		constexpr int g_ValidationTimeoutSeconds{ 10 };
+
+		void PrintBatchRenderUsage()
+		{
+			std::cout << "Usage: RayTracer --batch [options]\n"
+				<< "  --scene <name>          W1, W2, W3, W4_TestScene, W4_ReferenceScene or a .scene/.sceneb file (default W4_ReferenceScene)\n"
+				<< "  --camera <file>         camera path, one keyframe per line: time x y z pitch yaw fov\n"
+				<< "  --resolution <w>x<h>    output size (default 640x480)\n"
+				<< "  --frames <first>-<last> inclusive frame range (default 0-0)\n"
+				<< "  --fps <n>               fixed animation timestep (default 30)\n"
+				<< "  --output <directory>    where frames are written (default frames)\n"
+				<< "  --format <format>       png, ppm, bmp or pfm (HDR) (default png)\n"
+				<< "  --video <file>          stream all frames into one file, - for stdout\n"
+				<< "  --video-format <format> y4m or rgb (raw rgb24) (default y4m)\n"
+				<< "  --workers <n>           split every frame over n local worker processes (default 0)\n"
+				<< "  --worker-timeout <s>    kill a worker that takes longer to answer and reassign its tiles (default 60)\n"
+				<< "  --worker-fault <fault>  none, exit or hang: worker 0 fails on its first tile range, for testing (default none)\n"
+				<< "  --soft-shadows <n>      shadow rays per light for soft shadows, 0 for hard shadows (default 0)\n"
+				<< "  --denoise <0|1>         run the denoiser before saving, single process only (default 0)\n"
+				<< "  --compress-meshes <0|1> trace triangle meshes from compressed vertex data (default 0)\n"
+				<< "  --allocation-report <0|1> heap allocations per frame and phase, fails if rendering allocates (default 0)\n";
+		}
+
+		bool ParseWorkerFault(const std::string& value, WorkerFault& fault)
+		{
+			if (value == "none")
+				fault = WorkerFault::None;
+			else if (value == "exit")
+				fault = WorkerFault::Exit;
+			else if (value == "hang")
+				fault = WorkerFault::Hang;
+			else
+				return false;
+			return true;
+		}
+
+		const char* GetWorkerFaultName(WorkerFault fault)
+		{
+			switch (fault)
+			{
+			case WorkerFault::Exit:
+				return "exit";
+			case WorkerFault::Hang:
+				return "hang";
+			default:
+				return "none";
+			}
+		}
+
+		//"<a><separator><b>", e.g. "640x480" or "0-99"
+		bool ParsePair(const std::string& value, char separator, int& first, int& second)
+		{
+			std::istringstream stream{ value };
+			char readSeparator{};
+			return (stream >> first >> readSeparator >> second) && readSeparator == separator && stream.eof();
+		}
+
+		//Scene, camera path and clock of a batch run, advanced one fixed step per frame
+		class BatchScene final
+		{
+		public:
+			BatchScene() = default;
+			~BatchScene() { delete m_pScene; }
+
+			BatchScene(const BatchScene&) = delete;
+			BatchScene(BatchScene&&) noexcept = delete;
+			BatchScene& operator=(const BatchScene&) = delete;
+			BatchScene& operator=(BatchScene&&) noexcept = delete;
+
+			bool Initialize(const BatchRenderSettings& settings)
+			{
+				m_pScene = CreateScene(settings.sceneName);
+				if (!m_pScene)
+				{
+					std::cout << "Could not create scene: " << settings.sceneName << std::endl;
+					return false;
+				}
+				m_pScene->Initialize();
+				if (settings.areMeshesCompressed)
+					m_pScene->CompressTriangleMeshes();
+
+				if (!settings.cameraPathFile.empty() && !m_CameraPath.LoadFromFile(settings.cameraPathFile))
+				{
+					std::cout << "Could not load camera path: " << settings.cameraPathFile << std::endl;
+					return false;
+				}
+
+				m_TimeStep = 1.f / settings.framesPerSecond;
+				return true;
+			}
+
+			//Frames in between are still simulated so animation state matches an uninterrupted run
+			//Only the first update may allocate, it sizes the buffers every later one writes into
+			void AdvanceTo(int frame)
+			{
+				const AllocationTracker::PhaseScope phaseScope{ AllocationTracker::Phase::Update };
+				if (m_Frame < 0 && frame >= 0)
+					Step();
+
+				const AllocationTracker::NoAllocationScope noAllocationScope{ "BatchScene::AdvanceTo" };
+				while (m_Frame < frame)
+				{
+					Step();
+				}
+			}
+
+			//Hands the frame AdvanceTo got to the renderer, never while a render is running
+			void Publish()
+			{
+				if (m_PublishedFrame == m_Frame)
+					return;
+
+				const AllocationTracker::PhaseScope phaseScope{ AllocationTracker::Phase::Update };
+				if (m_PublishedFrame < 0)
+				{
+					m_pScene->PublishFrame();
+				}
+				else
+				{
+					const AllocationTracker::NoAllocationScope noAllocationScope{ "BatchScene::Publish" };
+					m_pScene->PublishFrame();
+				}
+				m_PublishedFrame = m_Frame;
+			}
+
+			Scene* GetScene() const { return m_pScene; }
+
+		private:
+			void Step()
+			{
+				++m_Frame;
+				m_Timer.Step(m_Frame == 0 ? 0.f : m_TimeStep);
+				//Camera first, so Update selects mesh LODs for where the camera is this frame
+				m_CameraPath.Apply(m_Timer.GetTotal(), m_pScene->GetCamera());
+				m_pScene->Update(&m_Timer);
+			}
+
+			Scene* m_pScene{};
+			CameraPath m_CameraPath{};
+			Timer m_Timer{};
+			float m_TimeStep{};
+			int m_Frame{ -1 };
+			int m_PublishedFrame{ -1 };
+		};
+
+		int GetWorkerTimeoutMilliseconds(const BatchRenderSettings& settings)
+		{
+			return settings.workerTimeoutSeconds * 1000;
+		}
+
+		//The settings a worker needs to rebuild the exact same scene
+		std::vector<std::string> GetWorkerArguments(const BatchRenderSettings& settings)
+		{
+			std::vector<std::string> arguments{ "--worker",
+				"--scene", settings.sceneName,
+				"--resolution", std::to_string(settings.width) + "x" + std::to_string(settings.height),
+				"--fps", std::to_string(settings.framesPerSecond),
+				"--soft-shadows", std::to_string(settings.softShadowSamples),
+				"--compress-meshes", settings.areMeshesCompressed ? "1" : "0",
+				"--worker-fault", GetWorkerFaultName(settings.workerFault) };
+
+			if (!settings.cameraPathFile.empty())
+			{
+				arguments.push_back("--camera");
+				arguments.push_back(std::filesystem::absolute(settings.cameraPathFile).string());
+			}
+			return arguments;
+		}
+
+		//Renders the frames of settings one after the other, without saving them, and appends the HDR colors of each;
+		//numRunningWorkers is what is left of the coordinator's workers afterwards
+		bool RenderFrameColors(const BatchRenderSettings& settings, std::vector<ColorRGB>& colors, int& numRunningWorkers)
+		{
+			BatchScene batchScene{};
+			if (!batchScene.Initialize(settings))
+				return false;
+
+			Renderer renderer{ settings.width, settings.height };
+			renderer.SetSoftShadowSamples(settings.softShadowSamples);
+
+			std::unique_ptr<TileCoordinator> pCoordinator{};
+			if (settings.numWorkers > 0)
+				pCoordinator = std::make_unique<TileCoordinator>(settings.numWorkers, GetWorkerArguments(settings), GetWorkerTimeoutMilliseconds(settings));
+
+			for (int frame{ settings.firstFrame }; frame <= settings.lastFrame; ++frame)
+			{
+				batchScene.AdvanceTo(frame);
+				batchScene.Publish();
+				renderer.SetFrameIndex(static_cast<uint32_t>(frame));
+				if (pCoordinator)
+					pCoordinator->RenderFrame(batchScene.GetScene(), renderer, frame);
+				else
+					renderer.Render(batchScene.GetScene());
+
+				for (uint32_t tileIndex{}; tileIndex < renderer.GetNumTiles(); ++tileIndex)
+				{
+					const size_t offset{ colors.size() };
+					colors.resize(offset + renderer.GetTilePixelCount(tileIndex));
+					renderer.ReadTile(tileIndex, colors.data() + offset);
+				}
+			}
+
+			numRunningWorkers = pCoordinator ? pCoordinator->GetNumRunningWorkers() : 0;
+			return true;
+		}
+	}
+
+	bool ParseBatchRenderArguments(int argc, char* args[], BatchRenderSettings& settings)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const std::string argument{ args[i] };
+			if (argument == "--batch" || argument == "--worker" || argument == "--validate-workers")
+				continue;
+
+			if (i + 1 >= argc)
+			{
+				std::cout << "Missing value for " << argument << std::endl;
+				PrintBatchRenderUsage();
+				return false;
+			}
+
+			const std::string value{ args[++i] };
+			bool isValid{ true };
+
+			if (argument == "--scene")
+				settings.sceneName = value;
+			else if (argument == "--camera")
+				settings.cameraPathFile = value;
+			else if (argument == "--output")
+				settings.outputDirectory = value;
+			else if (argument == "--format")
+				isValid = ImageWriter::ParseFormat(value, settings.outputFormat);
+			else if (argument == "--video")
+				settings.videoFile = value;
+			else if (argument == "--video-format")
+				isValid = VideoWriter::ParseFormat(value, settings.videoFormat);
+			else if (argument == "--resolution")
+				isValid = ParsePair(value, 'x', settings.width, settings.height) && settings.width > 0 && settings.height > 0;
+			else if (argument == "--frames")
+				isValid = ParsePair(value, '-', settings.firstFrame, settings.lastFrame) && settings.firstFrame >= 0 && settings.lastFrame >= settings.firstFrame;
+			else if (argument == "--fps")
+				isValid = (std::istringstream{ value } >> settings.framesPerSecond) && settings.framesPerSecond > 0.f;
+			else if (argument == "--workers")
+				isValid = (std::istringstream{ value } >> settings.numWorkers) && settings.numWorkers >= 0;
+			else if (argument == "--worker-timeout")
+				isValid = (std::istringstream{ value } >> settings.workerTimeoutSeconds) && settings.workerTimeoutSeconds > 0;
+			else if (argument == "--worker-index")
+				isValid = (std::istringstream{ value } >> settings.workerIndex) && settings.workerIndex >= 0;
+			else if (argument == "--worker-fault")
+				isValid = ParseWorkerFault(value, settings.workerFault);
+			else if (argument == "--soft-shadows")
+				isValid = (std::istringstream{ value } >> settings.softShadowSamples) && settings.softShadowSamples >= 0;
+			else if (argument == "--denoise")
+			{
+				settings.isDenoiserEnabled = value == "1";
+				isValid = value == "0" || value == "1";
+			}
+			else if (argument == "--compress-meshes")
+			{
+				settings.areMeshesCompressed = value == "1";
+				isValid = value == "0" || value == "1";
+			}
+			else if (argument == "--allocation-report")
+			{
+				settings.isAllocationReportEnabled = value == "1";
+				isValid = value == "0" || value == "1";
+			}
+			else
+				isValid = false;
+
+			if (!isValid)
+			{
+				std::cout << "Invalid argument: " << argument << " " << value << std::endl;
+				PrintBatchRenderUsage();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	int RunBatchRender(const BatchRenderSettings& settings)
+	{
+		//Opened first: streaming to stdout moves every later print over to stderr
+		std::unique_ptr<VideoWriter> pVideoWriter{};
+		if (!settings.videoFile.empty())
+		{
+			pVideoWriter = std::make_unique<VideoWriter>(settings.videoFile, settings.videoFormat, settings.width, settings.height, settings.framesPerSecond);
+			if (!pVideoWriter->IsOpen())
+			{
+				std::cout << "Could not open video output: " << settings.videoFile << std::endl;
+				return 1;
+			}
+		}
+
+		BatchScene batchScene{};
+		if (!batchScene.Initialize(settings))
+			return 1;
+
+		std::error_code error{};
+		if (!pVideoWriter)
+			std::filesystem::create_directories(settings.outputDirectory, error);
+
+		Renderer renderer{ settings.width, settings.height };
+		renderer.SetSoftShadowSamples(settings.softShadowSamples);
+
+		//Workers only send colors back, the guide buffers the denoiser needs stay with them
+		if (settings.isDenoiserEnabled && settings.numWorkers > 0)
+			std::cout << "The denoiser is not available with --workers, frames are saved unfiltered" << std::endl;
+		renderer.SetDenoiserEnabled(settings.isDenoiserEnabled && settings.numWorkers == 0);
+
+		std::unique_ptr<TileCoordinator> pCoordinator{};
+		if (settings.numWorkers > 0)
+		{
+			pCoordinator = std::make_unique<TileCoordinator>(settings.numWorkers, GetWorkerArguments(settings), GetWorkerTimeoutMilliseconds(settings));
+			std::cout << "Distributing tiles over " << pCoordinator->GetNumRunningWorkers() << " workers" << std::endl;
+		}
+
+		float renderSeconds{};
+		const auto batchStart{ std::chrono::steady_clock::now() };
+
+		batchScene.AdvanceTo(settings.firstFrame);
+		batchScene.Publish();
+		for (int frame{ settings.firstFrame }; frame <= settings.lastFrame; ++frame)
+		{
+			AllocationTracker::BeginFrame();
+
+			//The next frame is simulated while this one renders from the published snapshot
+			std::future<void> nextFrame{};
+			if (frame < settings.lastFrame)
+				nextFrame = std::async(std::launch::async, [&batchScene, frame]() { batchScene.AdvanceTo(frame + 1); });
+
+			const auto frameStart{ std::chrono::steady_clock::now() };
+			renderer.SetFrameIndex(static_cast<uint32_t>(frame));
+			if (pCoordinator)
+				pCoordinator->RenderFrame(batchScene.GetScene(), renderer, frame);
+			else
+				renderer.Render(batchScene.GetScene());
+			renderSeconds += std::chrono::duration<float>(std::chrono::steady_clock::now() - frameStart).count();
+
+			if (nextFrame.valid())
+			{
+				nextFrame.get();
+				batchScene.Publish();
+			}
+
+			//Both only copy the frame, the next one is rendered while this one is encoded
+			if (pVideoWriter)
+			{
+				renderer.SaveBufferToVideo(*pVideoWriter);
+			}
+			else
+			{
+				char filename[32]{};
+				snprintf(filename, sizeof(filename), "frame_%05d.%s", frame, ImageWriter::GetExtension(settings.outputFormat));
+				renderer.SaveBufferToImage((std::filesystem::path(settings.outputDirectory) / filename).string(), settings.outputFormat);
+			}
+
+			AllocationTracker::EndFrame();
+		}
+		renderer.FlushImages();
+		pVideoWriter.reset();
+
+		const float totalSeconds{ std::chrono::duration<float>(std::chrono::steady_clock::now() - batchStart).count() };
+		const int numFrames{ settings.lastFrame - settings.firstFrame + 1 };
+
+		//Rays traced by the workers plus whatever the coordinator had to trace itself
+		RenderStatistics statistics{ renderer.GetStatistics() };
+		if (pCoordinator)
+		{
+			statistics.primaryRays += pCoordinator->GetStatistics().primaryRays;
+			statistics.shadowRays += pCoordinator->GetStatistics().shadowRays;
+		}
+		const double numRays{ static_cast<double>(statistics.primaryRays + statistics.shadowRays) };
+
+		std::cout << "Rendered " << numFrames << " frames of " << settings.sceneName
+			<< " at " << settings.width << "x" << settings.height << " in " << totalSeconds << " s\n"
+			<< "  Frames/s: " << numFrames / totalSeconds << " (render only: " << numFrames / renderSeconds << ")\n"
+			<< "  Mrays/s:  " << numRays / renderSeconds / 1'000'000.0
+			<< " (" << statistics.primaryRays << " primary, " << statistics.shadowRays << " shadow)\n"
+			<< "  Mesh memory: " << batchScene.GetScene()->GetTriangleMeshFootprint() / (1024.0 * 1024.0) << " MB"
+			<< (settings.areMeshesCompressed ? " (compressed)" : " (uncompressed)") << std::endl;
+
+		const std::vector<StreamedMesh*>& streamedMeshes{ batchScene.GetScene()->GetStreamedMeshes() };
+		if (!streamedMeshes.empty())
+		{
+			StreamedMesh::Statistics streaming{};
+			for (const StreamedMesh* pStreamedMesh : streamedMeshes)
+			{
+				streaming.Add(pStreamedMesh->GetTotalStatistics());
+			}
+			std::cout << "  Streamed geometry: " << streaming.pageIns << " chunk page-ins (" << streaming.bytesPagedIn / (1024.0 * 1024.0)
+				<< " MB), " << streaming.evictions << " evictions, peak resident " << streaming.residentBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+		}
+
+		if (settings.isAllocationReportEnabled)
+		{
+			AllocationTracker::PrintReport();
+			if (AllocationTracker::GetNumViolations() > 0)
+				return 1;
+		}
+
+		return 0;
+	}
+
+	int RunRenderWorker(const BatchRenderSettings& settings)
+	{
+		//Takes over stdin/stdout before anything else can print
+		WorkerChannel channel{};
+
+		BatchScene batchScene{};
+		if (!batchScene.Initialize(settings))
+			return 1;
+
+		Renderer renderer{ settings.width, settings.height };
+		renderer.SetSoftShadowSamples(settings.softShadowSamples);
+		std::vector<ColorRGB> colors{};
+
+		TileRequest request{};
+		bool isFirstRequest{ true };
+		while (channel.Read(&request, sizeof(request)) && request.command == WorkerCommand::RenderTiles)
+		{
+			//--worker-fault, see ValidateWorkers
+			if (settings.workerIndex == 0 && isFirstRequest)
+			{
+				if (settings.workerFault == WorkerFault::Exit)
+					return 1;
+				while (settings.workerFault == WorkerFault::Hang)
+				{
+					std::this_thread::sleep_for(std::chrono::hours(1));
+				}
+			}
+			isFirstRequest = false;
+
+			batchScene.AdvanceTo(static_cast<int>(request.frame));
+			batchScene.Publish();
+
+			renderer.ResetStatistics();
+			renderer.SetFrameIndex(request.frame);
+			renderer.RenderTileRange(batchScene.GetScene(), request.firstTile, request.endTile);
+
+			//The answer names the clamped range, so a coordinator that asked past the last tile rejects it
+			const uint32_t endTile{ std::min(request.endTile, renderer.GetNumTiles()) };
+			colors.clear();
+			for (uint32_t tileIndex{ request.firstTile }; tileIndex < endTile; ++tileIndex)
+			{
+				const size_t offset{ colors.size() };
+				colors.resize(offset + renderer.GetTilePixelCount(tileIndex));
+				renderer.ReadTile(tileIndex, colors.data() + offset);
+			}
+
+			const RenderStatistics statistics{ renderer.GetStatistics() };
+			const TileResponse response{ request.firstTile, endTile, statistics.primaryRays, statistics.shadowRays };
+			if (!channel.Write(&response, sizeof(response)) || !channel.Write(colors.data(), colors.size() * sizeof(ColorRGB)))
+				return 1;
+		}
+
+		return 0;
+	}
+
+	bool ValidateWorkers(const BatchRenderSettings& settings)
+	{
+		BatchRenderSettings singleProcess{ settings };
+		singleProcess.numWorkers = 0;
+
+		std::vector<ColorRGB> expectedColors{};
+		int numRunningWorkers{};
+		if (!RenderFrameColors(singleProcess, expectedColors, numRunningWorkers))
+			return false;
+
+		const int numWorkers{ settings.numWorkers > 0 ? settings.numWorkers : g_NumValidationWorkers };
+		std::cout << "Comparing frames " << settings.firstFrame << "-" << settings.lastFrame << " of " << settings.sceneName
+			<< " rendered in one process against " << numWorkers << " workers" << std::endl;
+
+		bool isValid{ true };
+		for (const WorkerFault fault : { WorkerFault::None, WorkerFault::Exit, WorkerFault::Hang })
+		{
+			BatchRenderSettings distributed{ settings };
+			distributed.numWorkers = numWorkers;
+			distributed.workerFault = fault;
+			distributed.workerTimeoutSeconds = std::min(settings.workerTimeoutSeconds, g_ValidationTimeoutSeconds);
+
+			std::vector<ColorRGB> colors{};
+			if (!RenderFrameColors(distributed, colors, numRunningWorkers))
+				return false;
+
+			const bool isIdentical{ colors.size() == expectedColors.size()
+				&& std::memcmp(colors.data(), expectedColors.data(), colors.size() * sizeof(ColorRGB)) == 0 };
+			const int expectedRunningWorkers{ fault == WorkerFault::None ? numWorkers : numWorkers - 1 };
+			const bool isRecovered{ numRunningWorkers == expectedRunningWorkers };
+
+			std::cout << "  Worker fault " << GetWorkerFaultName(fault) << ": " << (isIdentical ? "identical" : "DIFFERENT")
+				<< ", " << numRunningWorkers << " of " << numWorkers << " workers left" << (isRecovered ? "" : ", EXPECTED ")
+				<< (isRecovered ? "" : std::to_string(expectedRunningWorkers)) << std::endl;
+			isValid = isValid && isIdentical && isRecovered;
+		}
+		return isValid;
+	}
+}
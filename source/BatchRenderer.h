@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+
+#include "ImageWriter.h"
+#include "VideoWriter.h"
+
+namespace dae
+{
+	//Failure worker 0 fakes on its first tile range, to check the coordinator recovers from it
+	enum class WorkerFault
+	{
+		None,
+		//Exits without answering
+		Exit,
+		//Never answers
+		Hang
+	};
+
+	//Command-line driven offline rendering, no window is created
+	struct BatchRenderSettings
+	{
+		std::string sceneName{ "W4_ReferenceScene" };
+		std::string cameraPathFile{};
+		std::string outputDirectory{ "frames" };
+		ImageFormat outputFormat{ ImageFormat::PNG };
+
+		//When set, frames are streamed into this file ("-" for stdout) instead of written as images
+		std::string videoFile{};
+		VideoFormat videoFormat{ VideoFormat::Y4M };
+
+		int width{ 640 };
+		int height{ 480 };
+
+		int firstFrame{ 0 };
+		int lastFrame{ 0 };
+		float framesPerSecond{ 30.f };
+
+		//Above zero, frames are split over this many local worker processes
+		int numWorkers{ 0 };
+		//A worker that takes longer to answer a tile range is killed and its tiles go to the others
+		int workerTimeoutSeconds{ 60 };
+		//Set by the coordinator for the processes it starts, -1 otherwise
+		int workerIndex{ -1 };
+		WorkerFault workerFault{ WorkerFault::None };
+
+		int softShadowSamples{ 0 };
+		bool isDenoiserEnabled{ false };
+		//Quantized positions, octahedral normals and delta indices, see CompressedMeshData
+		bool areMeshesCompressed{ false };
+		//Prints heap allocations per frame and phase at the end, the batch fails when rendering allocated
+		bool isAllocationReportEnabled{ false };
+	};
+
+	//Parses everything after "--batch", prints the usage and returns false on bad input
+	bool ParseBatchRenderArguments(int argc, char* args[], BatchRenderSettings& settings);
+	int RunBatchRender(const BatchRenderSettings& settings);
+
+	//Entry point of a process started by the tile coordinator, talks to it over stdin/stdout
+	int RunRenderWorker(const BatchRenderSettings& settings);
+
+	//RayTracer --validate-workers [batch options]: renders the frames of settings in one process, then split over
+	//numWorkers workers (3 when 0) with all of them healthy, with worker 0 exiting and with worker 0 hanging.
+	//Returns false unless every run gives bit-identical HDR colors and the faulty worker was dropped.
+	bool ValidateWorkers(const BatchRenderSettings& settings);
+}
@@ -0,0 +1,87 @@
+#include "CacheMissCounter.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+using namespace dae;
+
+#if defined(__linux__)
+namespace
+{
+	int OpenCounter(uint64_t config)
+	{
+		perf_event_attr attributes{};
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.size = sizeof(attributes);
+		attributes.config = config;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+
+		//pid 0, cpu -1: this thread on any cpu
+		return static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+	}
+
+	uint64_t ReadCounter(int handle)
+	{
+		uint64_t value{};
+		if (read(handle, &value, sizeof(value)) != sizeof(value))
+			return 0;
+		return value;
+	}
+}
+
+CacheMissCounter::CacheMissCounter() :
+	m_MissesHandle(OpenCounter(PERF_COUNT_HW_CACHE_MISSES)),
+	m_ReferencesHandle(OpenCounter(PERF_COUNT_HW_CACHE_REFERENCES))
+{
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+	if (m_MissesHandle >= 0)
+		close(m_MissesHandle);
+	if (m_ReferencesHandle >= 0)
+		close(m_ReferencesHandle);
+}
+
+void CacheMissCounter::Start()
+{
+	if (!IsAvailable())
+		return;
+
+	ioctl(m_MissesHandle, PERF_EVENT_IOC_RESET, 0);
+	ioctl(m_ReferencesHandle, PERF_EVENT_IOC_RESET, 0);
+	ioctl(m_MissesHandle, PERF_EVENT_IOC_ENABLE, 0);
+	ioctl(m_ReferencesHandle, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void CacheMissCounter::Stop()
+{
+	if (!IsAvailable())
+		return;
+
+	ioctl(m_MissesHandle, PERF_EVENT_IOC_DISABLE, 0);
+	ioctl(m_ReferencesHandle, PERF_EVENT_IOC_DISABLE, 0);
+
+	m_CacheMisses = ReadCounter(m_MissesHandle);
+	m_CacheReferences = ReadCounter(m_ReferencesHandle);
+}
+#else
+CacheMissCounter::CacheMissCounter() = default;
+CacheMissCounter::~CacheMissCounter() = default;
+
+void CacheMissCounter::Start()
+{
+}
+
+void CacheMissCounter::Stop()
+{
+}
+#endif
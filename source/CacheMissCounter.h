@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	//Hardware cache-miss/-reference counters for the calling thread (perf_event_open on Linux)
+	//On other platforms IsAvailable() returns false and all counts stay zero
+	class CacheMissCounter final
+	{
+	public:
+		CacheMissCounter();
+		~CacheMissCounter();
+
+		CacheMissCounter(const CacheMissCounter&) = delete;
+		CacheMissCounter(CacheMissCounter&&) noexcept = delete;
+		CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+		CacheMissCounter& operator=(CacheMissCounter&&) noexcept = delete;
+
+		bool IsAvailable() const { return m_MissesHandle >= 0 && m_ReferencesHandle >= 0; }
+
+		void Start();
+		void Stop();
+
+		uint64_t GetCacheMisses() const { return m_CacheMisses; }
+		uint64_t GetCacheReferences() const { return m_CacheReferences; }
+
+	private:
+		int m_MissesHandle{ -1 };
+		int m_ReferencesHandle{ -1 };
+
+		uint64_t m_CacheMisses{};
+		uint64_t m_CacheReferences{};
+	};
+}
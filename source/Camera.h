@@ -1,5 +1,7 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <SDL_keyboard.h>
 #include <SDL_mouse.h>
@@ -9,6 +11,25 @@
 
 namespace dae
 {
+	//Keyboard and mouse state for one camera Update, sampled where SDL pumps its events so Update can run on any thread
+	struct CameraInput
+	{
+		uint8_t keyboardState[SDL_NUM_SCANCODES]{};
+		uint32_t mouseState{};
+		int mouseX{};
+		int mouseY{};
+
+		//Call on the main thread, once per frame: the relative mouse motion is reset by every call
+		void Sample()
+		{
+			int numKeys{};
+			const uint8_t* pKeyboardState{ SDL_GetKeyboardState(&numKeys) };
+			std::copy_n(pKeyboardState, std::min(numKeys, static_cast<int>(SDL_NUM_SCANCODES)), keyboardState);
+
+			mouseState = SDL_GetRelativeMouseState(&mouseX, &mouseY);
+		}
+	};
+
 	struct Camera
 	{
 		Camera() = default;
@@ -47,21 +68,49 @@ namespace dae
 			return ONB;
 		}
 
-		void Update(Timer* pTimer)
+		//Inverse of the primary ray setup in Renderer::RenderPixel (fov = tan(fovAngle / 2))
+		//Returns false when the point lies behind the camera
+		//Distance along the view axis, negative behind the camera
+		float GetViewDepth(const Vector3& point) const
+		{
+			const Vector3 right{ cameraToWorld.GetAxisX() };
+			const Vector3 up{ cameraToWorld.GetAxisY() };
+			const Vector3 look{ cameraToWorld.GetAxisZ() };
+
+			const float determinant{ Vector3::Dot(right, Vector3::Cross(up, look)) };
+			return Vector3::Dot(point - cameraToWorld.GetTranslation(), Vector3::Cross(right, up)) / determinant;
+		}
+
+		bool WorldToScreen(const Vector3& point, float fov, float aspectRatio, int width, int height, float& screenX, float& screenY) const
+		{
+			const Vector3 right{ cameraToWorld.GetAxisX() };
+			const Vector3 up{ cameraToWorld.GetAxisY() };
+			const Vector3 look{ cameraToWorld.GetAxisZ() };
+			const Vector3 toPoint{ point - cameraToWorld.GetTranslation() };
+
+			const float determinant{ Vector3::Dot(right, Vector3::Cross(up, look)) };
+			const float depth{ GetViewDepth(point) };
+			if (depth <= 0.f)
+				return false;
+
+			const float cx{ Vector3::Dot(toPoint, Vector3::Cross(up, look)) / determinant / depth };
+			const float cy{ Vector3::Dot(toPoint, Vector3::Cross(look, right)) / determinant / depth };
+
+			screenX = (cx / (aspectRatio * fov) + 1.f) * 0.5f * static_cast<float>(width);
+			screenY = (1.f - cy / fov) * 0.5f * static_cast<float>(height);
+			return true;
+		}
+
+		void Update(Timer* pTimer, const CameraInput& input)
 		{
 			const float speed{ 10.f };
 			const float deltaTime = pTimer->GetElapsed();
 
 			//Keyboard Input
-			const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
-
-			HandleKeyMovement(pKeyboardState, speed, deltaTime);
+			HandleKeyMovement(input.keyboardState, speed, deltaTime);
 
 			//Mouse Input
-			int mouseX{}, mouseY{};
-			const uint32_t mouseState = SDL_GetRelativeMouseState(&mouseX, &mouseY);
-
-			HandleMouseRotation(mouseState, mouseX, mouseY, speed, deltaTime);
+			HandleMouseRotation(input.mouseState, input.mouseX, input.mouseY, speed, deltaTime);
 
 		}
 
@@ -86,6 +135,11 @@ namespace dae
 				}
 			}
 
+			UpdateOrientation();
+		}
+
+		void UpdateOrientation()
+		{
 			Matrix Mc{ Matrix::CreateRotation(Vector3(-totalPitch,totalYaw,0.f))};
 
 			forward = Mc.TransformVector(Vector3::UnitZ);
@@ -93,6 +147,16 @@ namespace dae
 			cameraToWorld = CalculateCameraToWorld();
 		}
 
+		//Places the camera directly, bypassing input (scripted camera paths)
+		void SetPose(const Vector3& _origin, float pitch, float yaw, float _fovAngle)
+		{
+			origin = _origin;
+			totalPitch = pitch;
+			totalYaw = yaw;
+			fovAngle = _fovAngle;
+			UpdateOrientation();
+		}
+
 
 		void HandleKeyMovement(const uint8_t* pKeyboardState, const float speed, const float deltaTime)
 		{
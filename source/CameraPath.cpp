@@ -0,0 +1,72 @@
+#include "CameraPath.h"
+#include "Camera.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace dae;
+
+bool CameraPath::LoadFromFile(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+		return false;
+
+	m_Keyframes.clear();
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream lineStream{ line };
+		Keyframe keyframe{};
+		if (lineStream >> keyframe.time >> keyframe.origin.x >> keyframe.origin.y >> keyframe.origin.z >> keyframe.pitch >> keyframe.yaw >> keyframe.fovAngle)
+			AddKeyframe(keyframe);
+	}
+
+	return !m_Keyframes.empty();
+}
+
+void CameraPath::AddKeyframe(const Keyframe& keyframe)
+{
+	//Keep keyframes sorted on time
+	const auto it{ std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), keyframe.time,
+		[](float time, const Keyframe& other) { return time < other.time; }) };
+	m_Keyframes.insert(it, keyframe);
+}
+
+void CameraPath::Apply(float time, Camera& camera) const
+{
+	if (m_Keyframes.empty())
+		return;
+
+	if (time <= m_Keyframes.front().time || m_Keyframes.size() == 1)
+	{
+		const Keyframe& first{ m_Keyframes.front() };
+		camera.SetPose(first.origin, first.pitch, first.yaw, first.fovAngle);
+		return;
+	}
+
+	if (time >= m_Keyframes.back().time)
+	{
+		const Keyframe& last{ m_Keyframes.back() };
+		camera.SetPose(last.origin, last.pitch, last.yaw, last.fovAngle);
+		return;
+	}
+
+	const auto next{ std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), time,
+		[](float t, const Keyframe& other) { return t < other.time; }) };
+	const Keyframe& to{ *next };
+	const Keyframe& from{ *(next - 1) };
+
+	const float factor{ (time - from.time) / (to.time - from.time) };
+	const Vector3 origin{
+		Lerpf(from.origin.x, to.origin.x, factor),
+		Lerpf(from.origin.y, to.origin.y, factor),
+		Lerpf(from.origin.z, to.origin.z, factor) };
+
+	camera.SetPose(origin, Lerpf(from.pitch, to.pitch, factor), Lerpf(from.yaw, to.yaw, factor), Lerpf(from.fovAngle, to.fovAngle, factor));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct Camera;
+
+	//Scripted camera motion: keyframes are linearly interpolated over time
+	//File format, one keyframe per line: time originX originY originZ pitch yaw fovAngle ('#' starts a comment)
+	//pitch and yaw are in radians, fovAngle in degrees
+	class CameraPath final
+	{
+	public:
+		struct Keyframe
+		{
+			float time{};
+			Vector3 origin{};
+			float pitch{};
+			float yaw{};
+			float fovAngle{ 45.f };
+		};
+
+		CameraPath() = default;
+		~CameraPath() = default;
+
+		CameraPath(const CameraPath&) = default;
+		CameraPath(CameraPath&&) noexcept = default;
+		CameraPath& operator=(const CameraPath&) = default;
+		CameraPath& operator=(CameraPath&&) noexcept = default;
+
+		bool LoadFromFile(const std::string& filename);
+		void AddKeyframe(const Keyframe& keyframe);
+
+		bool IsEmpty() const { return m_Keyframes.empty(); }
+		float GetDuration() const { return m_Keyframes.empty() ? 0.f : m_Keyframes.back().time; }
+
+		//Leaves the camera untouched when the path has no keyframes
+		void Apply(float time, Camera& camera) const;
+
+	private:
+		std::vector<Keyframe> m_Keyframes{};
+	};
+}
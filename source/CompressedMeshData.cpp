@@ -0,0 +1,111 @@
+#include "CompressedMeshData.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace dae;
+
+namespace
+{
+	constexpr float g_MaxQuantized{ 65535.f };
+
+	int16_t ToSignedNormalized(float value)
+	{
+		return static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * 32767.f));
+	}
+}
+
+void CompressedMeshData::Encode(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices)
+{
+	Vector3 minBounds{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Vector3 maxBounds{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const Vector3& position : positions)
+	{
+		minBounds = { std::min(minBounds.x, position.x), std::min(minBounds.y, position.y), std::min(minBounds.z, position.z) };
+		maxBounds = { std::max(maxBounds.x, position.x), std::max(maxBounds.y, position.y), std::max(maxBounds.z, position.z) };
+	}
+	if (positions.empty())
+	{
+		minBounds = {};
+		maxBounds = {};
+	}
+
+	m_MinBounds = minBounds;
+	m_Scale = (maxBounds - minBounds) / g_MaxQuantized;
+
+	m_Positions.resize(positions.size() * 3);
+	for (size_t i{}; i < positions.size(); ++i)
+	{
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float extent{ maxBounds[axis] - minBounds[axis] };
+			const float normalized{ extent > 0.f ? (positions[i][axis] - minBounds[axis]) / extent : 0.f };
+			m_Positions[i * 3 + axis] = static_cast<uint16_t>(std::lround(std::clamp(normalized, 0.f, 1.f) * g_MaxQuantized));
+		}
+	}
+
+	m_Normals.resize(normals.size());
+	for (size_t i{}; i < normals.size(); ++i)
+	{
+		const Vector3& normal{ normals[i] };
+		const float length{ std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z) };
+		if (length <= 0.f)
+		{
+			m_Normals[i] = {};
+			continue;
+		}
+
+		//Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half up
+		float x{ normal.x / length };
+		float y{ normal.y / length };
+		if (normal.z < 0.f)
+		{
+			const float foldedX{ (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f) };
+			y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+			x = foldedX;
+		}
+		m_Normals[i] = { ToSignedNormalized(x), ToSignedNormalized(y) };
+	}
+
+	const size_t numTriangles{ indices.size() / 3 };
+	m_DeltaTriangles.resize(numTriangles);
+	m_Indices.clear();
+	for (size_t i{}; i < numTriangles; ++i)
+	{
+		const int first{ indices[i * 3] };
+		const int secondDelta{ indices[i * 3 + 1] - first };
+		const int thirdDelta{ indices[i * 3 + 2] - first };
+		if (secondDelta < INT16_MIN || secondDelta > INT16_MAX || thirdDelta < INT16_MIN || thirdDelta > INT16_MAX)
+		{
+			m_DeltaTriangles.clear();
+			m_Indices = indices;
+			break;
+		}
+		m_DeltaTriangles[i] = { static_cast<uint32_t>(first), static_cast<int16_t>(secondDelta), static_cast<int16_t>(thirdDelta) };
+	}
+
+	m_Positions.shrink_to_fit();
+	m_Normals.shrink_to_fit();
+	m_DeltaTriangles.shrink_to_fit();
+	m_Indices.shrink_to_fit();
+	m_IsEncoded = true;
+}
+
+std::vector<Vector3> CompressedMeshData::DecodePositions() const
+{
+	std::vector<Vector3> positions(m_Positions.size() / 3);
+	for (size_t i{}; i < positions.size(); ++i)
+	{
+		positions[i] = DecodePosition(static_cast<int>(i));
+	}
+	return positions;
+}
+
+size_t CompressedMeshData::GetMemoryFootprint() const
+{
+	return m_Positions.capacity() * sizeof(uint16_t)
+		+ m_Normals.capacity() * sizeof(OctahedralNormal)
+		+ m_DeltaTriangles.capacity() * sizeof(DeltaTriangle)
+		+ m_Indices.capacity() * sizeof(int);
+}
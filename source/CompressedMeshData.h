@@ -0,0 +1,111 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Compact storage for the triangles of one mesh, decoded on the fly by the intersection code
+	//Positions: 3 x 16 bits on a grid over the object space bounds (6 bytes instead of 12).
+	//Normals: octahedral, 2 x 16 bits (4 bytes instead of 12).
+	//Indices: the first index of a triangle plus two 16-bit deltas for the others (8 bytes instead of 12); meshes with a
+	//triangle whose corners lie further apart in the vertex buffer keep plain 32-bit indices.
+	class CompressedMeshData final
+	{
+	public:
+		CompressedMeshData() = default;
+		~CompressedMeshData() = default;
+
+		CompressedMeshData(const CompressedMeshData&) = default;
+		CompressedMeshData(CompressedMeshData&&) noexcept = default;
+		CompressedMeshData& operator=(const CompressedMeshData&) = default;
+		CompressedMeshData& operator=(CompressedMeshData&&) noexcept = default;
+
+		//Normals are one per triangle, indices three per triangle
+		void Encode(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices);
+		//All positions as the intersection code sees them, for fitting bounds around the quantized geometry
+		std::vector<Vector3> DecodePositions() const;
+
+		bool IsEncoded() const { return m_IsEncoded; }
+		bool HasDeltaIndices() const { return !m_DeltaTriangles.empty(); }
+		size_t GetNumTriangles() const { return m_Normals.size(); }
+		size_t GetMemoryFootprint() const;
+
+		const Vector3& GetMinBounds() const { return m_MinBounds; }
+		Vector3 GetMaxBounds() const { return m_MinBounds + m_Scale * 65535.f; }
+
+		void DecodeTriangle(uint32_t triangle, Vector3& v0, Vector3& v1, Vector3& v2) const
+		{
+			int first{};
+			int second{};
+			int third{};
+			if (HasDeltaIndices())
+			{
+				const DeltaTriangle& deltaTriangle{ m_DeltaTriangles[triangle] };
+				first = static_cast<int>(deltaTriangle.first);
+				second = first + deltaTriangle.secondDelta;
+				third = first + deltaTriangle.thirdDelta;
+			}
+			else
+			{
+				first = m_Indices[triangle * 3];
+				second = m_Indices[triangle * 3 + 1];
+				third = m_Indices[triangle * 3 + 2];
+			}
+			v0 = DecodePosition(first);
+			v1 = DecodePosition(second);
+			v2 = DecodePosition(third);
+		}
+
+		Vector3 DecodeNormal(uint32_t triangle) const
+		{
+			const OctahedralNormal& encoded{ m_Normals[triangle] };
+			float x{ encoded.x / 32767.f };
+			float y{ encoded.y / 32767.f };
+			const float z{ 1.f - std::abs(x) - std::abs(y) };
+			//The lower hemisphere is folded over the diagonals of the octahedron
+			if (z < 0.f)
+			{
+				const float foldedX{ (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f) };
+				y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+				x = foldedX;
+			}
+			return Vector3{ x, y, z }.Normalized();
+		}
+
+	private:
+		struct DeltaTriangle
+		{
+			uint32_t first{};
+			int16_t secondDelta{};
+			int16_t thirdDelta{};
+		};
+
+		struct OctahedralNormal
+		{
+			int16_t x{};
+			int16_t y{};
+		};
+
+		Vector3 m_MinBounds{};
+		//Size of one quantization step on each axis
+		Vector3 m_Scale{};
+		std::vector<uint16_t> m_Positions{};
+		std::vector<OctahedralNormal> m_Normals{};
+		std::vector<DeltaTriangle> m_DeltaTriangles{};
+		//Only used when the deltas do not fit in 16 bits
+		std::vector<int> m_Indices{};
+		bool m_IsEncoded{};
+
+		Vector3 DecodePosition(int index) const
+		{
+			const uint16_t* pQuantized{ &m_Positions[static_cast<size_t>(index) * 3] };
+			return Vector3{
+				m_MinBounds.x + pQuantized[0] * m_Scale.x,
+				m_MinBounds.y + pQuantized[1] * m_Scale.y,
+				m_MinBounds.z + pQuantized[2] * m_Scale.z };
+		}
+	};
+}
@@ -2,6 +2,10 @@
 #include <cassert>
 
 #include "Math.h"
+#include "CompressedMeshData.h"
+#include "MeshBVH.h"
+#include "MeshSimplifier.h"
+#include "VertexTransform.h"
 #include "vector"
 
 namespace dae
@@ -56,6 +60,13 @@ namespace dae
 
 	struct TriangleMesh
 	{
+		//Each level of detail has about a quarter of the triangles of the one before, the chain ends below this many
+		static constexpr size_t m_MinLodTriangles{ 64 };
+		//Fraction of the screen height the bounding sphere must cover for level 0, every next level takes half of that
+		static constexpr float m_LodScreenSize{ .5f };
+		//How far past a threshold the screen size has to go before the level changes
+		static constexpr float m_LodHysteresis{ .2f };
+
 		TriangleMesh() = default;
 		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode) :
 			positions(_positions), indices(_indices), cullMode(_cullMode)
@@ -80,6 +91,8 @@ namespace dae
 
 		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
 
+		//Placement that came with the mesh (a glTF node hierarchy), applied before scale, rotation and translation
+		Matrix baseTransform{};
 		Matrix rotationTransform{};
 		Matrix translationTransform{};
 		Matrix scaleTransform{};
@@ -87,6 +100,29 @@ namespace dae
 		std::vector<Vector3> transformedPositions{};
 		std::vector<Vector3> transformedNormals{};
 
+		//Built on first UpdateTransforms, refit to world space on every one after that
+		MeshBVH bvh{};
+
+		//Only filled after Compress, which empties the float buffers above; the mesh is then traced in object space
+		//by moving the ray instead of the vertices, so UpdateTransforms only has to update these matrices
+		CompressedMeshData compressed{};
+		Matrix inverseTransform{};
+		//Inverse transpose, takes object space normals to world space (also for transformedNormals)
+		Matrix normalTransform{};
+
+		//Simplified copies of this mesh, coarsest last; they follow its transform, cull mode and material
+		std::vector<TriangleMesh> lods{};
+		//0 is this mesh itself, n is lods[n - 1]
+		int selectedLod{};
+
+		//World space bounds of transformedPositions, and the bounds at the start of the frame
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+		Vector3 previousMinAABB{};
+		Vector3 previousMaxAABB{};
+		Matrix previousTransform{};
+		bool hasTransformChanged{ true };
+
 		void Translate(const Vector3& translation)
 		{
 			translationTransform = Matrix::CreateTranslation(translation);
@@ -104,6 +140,7 @@ namespace dae
 
 		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
 		{
+			assert(!compressed.IsEncoded() && "Compressed meshes can not grow");
 			int startIndex = static_cast<int>(positions.size());
 
 			positions.push_back(triangle.v0);
@@ -125,10 +162,10 @@ namespace dae
 		{
 			int triangleSides{ 3 };
 			int currentCheckedSides{};
+			normals.reserve(normals.size() + indices.size() / 3);
 			while (currentCheckedSides < indices.size())
 			{
-				std::vector<int> range{ indices[currentCheckedSides],indices[currentCheckedSides + 1],indices[currentCheckedSides + 2] };
-				Triangle triangle{ positions[range[0]],positions[range[1]],positions[range[2]] };
+				Triangle triangle{ positions[indices[currentCheckedSides]],positions[indices[currentCheckedSides + 1]],positions[indices[currentCheckedSides + 2]] };
 				Vector3 a{ triangle.v1 - triangle.v0 };
 				Vector3 b{ triangle.v2 - triangle.v0 };
 				triangle.normal = Vector3::Cross(a, b);
@@ -137,30 +174,216 @@ namespace dae
 			}
 		}
 
+		//Replaces the LOD chain with one simplified from the current triangles
+		void GenerateLods()
+		{
+			lods.clear();
+			selectedLod = 0;
+
+			const std::vector<Vector3>* pPositions{ &positions };
+			const std::vector<int>* pIndices{ &indices };
+			while (pIndices->size() / 3 / 4 >= m_MinLodTriangles)
+			{
+				const size_t numTriangles{ pIndices->size() / 3 };
+				TriangleMesh lod{};
+				MeshSimplifier::Simplify(*pPositions, *pIndices, numTriangles / 4, lod.positions, lod.indices);
+				//Stuck on a mesh that will not simplify any further
+				if (lod.indices.size() / 3 > numTriangles * 3 / 4)
+					break;
+
+				lod.CalculateNormals();
+				lods.push_back(std::move(lod));
+				pPositions = &lods.back().positions;
+				pIndices = &lods.back().indices;
+			}
+			UpdateTransforms();
+		}
+
+		const TriangleMesh& GetSelectedLod() const
+		{
+			return selectedLod == 0 ? *this : lods[selectedLod - 1];
+		}
+
+		//Picks the level from the size of the world bounds on screen, fov being tan(fovAngle / 2)
+		//Level n takes over below m_LodScreenSize / 2^n; the hysteresis band keeps a mesh that sits right at a threshold
+		//from popping back and forth
+		void SelectLod(const Vector3& cameraOrigin, float fov)
+		{
+			if (lods.empty())
+				return;
+
+			const Vector3 center{ (minAABB + maxAABB) * .5f };
+			const float radius{ (maxAABB - minAABB).Magnitude() * .5f };
+			const float distance{ std::max((center - cameraOrigin).Magnitude() - radius, FLT_EPSILON) };
+			const float screenSize{ radius / (distance * fov) };
+
+			const int numLevels{ static_cast<int>(lods.size()) };
+			int level{ selectedLod };
+			//Threshold between level n and n + 1
+			const auto getThreshold{ [](int n) { return m_LodScreenSize / static_cast<float>(1 << n); } };
+			while (level > 0 && screenSize > getThreshold(level - 1) * (1.f + m_LodHysteresis))
+				--level;
+			while (level < numLevels && screenSize < getThreshold(level) * (1.f - m_LodHysteresis))
+				++level;
+
+			if (level != selectedLod)
+			{
+				selectedLod = level;
+				//Different triangles on screen, the renderer has to redraw the mesh's tiles
+				hasTransformChanged = true;
+			}
+		}
+
+		//Called once per frame before any transform updates, so the renderer can see what moved
+		void BeginFrame()
+		{
+			previousMinAABB = minAABB;
+			previousMaxAABB = maxAABB;
+			hasTransformChanged = false;
+
+			for (TriangleMesh& lod : lods)
+			{
+				lod.BeginFrame();
+			}
+		}
+
+		//Takes over what the intersection code and the renderer read from source, so this mesh can be traced while
+		//source is being updated; the object space buffers only UpdateTransforms needs are left out
+		//Indices, the BVH and compressed data only change when a mesh is (re)built, isFullCopy copies those as well;
+		//otherwise world space buffers are only copied when the transform changed, into the capacity already there
+		void CopyRenderState(const TriangleMesh& source, bool isFullCopy)
+		{
+			if (isFullCopy)
+			{
+				indices = source.indices;
+				bvh = source.bvh;
+				compressed = source.compressed;
+				lods.resize(source.lods.size());
+			}
+			else if (source.hasTransformChanged)
+				bvh.CopyWorldNodes(source.bvh);
+
+			if (isFullCopy || source.hasTransformChanged)
+			{
+				transformedPositions = source.transformedPositions;
+				transformedNormals = source.transformedNormals;
+			}
+
+			cullMode = source.cullMode;
+			materialIndex = source.materialIndex;
+			inverseTransform = source.inverseTransform;
+			normalTransform = source.normalTransform;
+			selectedLod = source.selectedLod;
+			minAABB = source.minAABB;
+			maxAABB = source.maxAABB;
+			previousMinAABB = source.previousMinAABB;
+			previousMaxAABB = source.previousMaxAABB;
+			hasTransformChanged = source.hasTransformChanged;
+
+			for (size_t i{}; i < lods.size(); ++i)
+			{
+				lods[i].CopyRenderState(source.lods[i], isFullCopy);
+			}
+		}
+
+		//Switches to compressed storage for good, see CompressedMeshData; no triangles can be appended afterwards
+		void Compress()
+		{
+			if (compressed.IsEncoded())
+				return;
+
+			if (!bvh.IsBuiltFor(indices.size() / 3))
+				bvh.Build(positions, indices, normals);
+
+			compressed.Encode(positions, normals, indices);
+			//Quantized positions move by up to half a step, the nodes have to bound where they ended up
+			bvh.RefitInPlace(compressed.DecodePositions(), indices);
+
+			positions = std::vector<Vector3>{};
+			normals = std::vector<Vector3>{};
+			indices = std::vector<int>{};
+			transformedPositions = std::vector<Vector3>{};
+			transformedNormals = std::vector<Vector3>{};
+
+			for (TriangleMesh& lod : lods)
+			{
+				lod.Compress();
+			}
+
+			hasTransformChanged = true;
+			UpdateTransforms();
+		}
+
+		//Bytes held by the vertex, normal, index and BVH buffers, LODs included
+		size_t GetMemoryFootprint() const
+		{
+			size_t footprint{ (positions.capacity() + normals.capacity() + transformedPositions.capacity() + transformedNormals.capacity()) * sizeof(Vector3)
+				+ indices.capacity() * sizeof(int) + compressed.GetMemoryFootprint() + bvh.GetMemoryFootprint() };
+			for (const TriangleMesh& lod : lods)
+			{
+				footprint += lod.GetMemoryFootprint();
+			}
+			return footprint;
+		}
+
 		void UpdateTransforms()
 		{
+			//(Re)build when triangles were added since the last build, this also puts them in leaf order
+			if (!compressed.IsEncoded() && !bvh.IsBuiltFor(indices.size() / 3))
+				bvh.Build(positions, indices, normals);
+
 			//Calculate Final Transform 
-			Matrix finalTransform{ scaleTransform * rotationTransform* translationTransform };
+			Matrix finalTransform{ baseTransform * scaleTransform * rotationTransform* translationTransform };
 			//const auto finalTransform = ...
 
-			//Transform Positions (positions > transformedPositions)
-			transformedPositions.clear();
-			for (int i{}; i < positions.size(); ++i)
+			for (int r{}; r < 4; ++r)
+			{
+				for (int c{}; c < 4; ++c)
+				{
+					if (finalTransform[r][c] != previousTransform[r][c])
+						hasTransformChanged = true;
+				}
+			}
+			previousTransform = finalTransform;
+
+			for (TriangleMesh& lod : lods)
 			{
-				std::vector<Vector3>::iterator it{ transformedPositions.begin() };
-				std::advance(it, i);
-				transformedPositions.emplace(it,finalTransform.TransformPoint(positions[i]));
+				lod.baseTransform = baseTransform;
+				lod.scaleTransform = scaleTransform;
+				lod.rotationTransform = rotationTransform;
+				lod.translationTransform = translationTransform;
+				lod.cullMode = cullMode;
+				lod.materialIndex = materialIndex;
+				lod.UpdateTransforms();
 			}
 
-			////Transform Normals (normals > transformedNormals)
-			////...
-			transformedNormals.clear();
-			for (int i{}; i < normals.size(); ++i)
+			inverseTransform = Matrix::Inverse(finalTransform);
+			normalTransform = Matrix::Transpose(inverseTransform);
+
+			if (compressed.IsEncoded())
 			{
-				std::vector<Vector3>::iterator it{ transformedNormals.begin() };
-				std::advance(it, i);
-				transformedNormals.emplace(it,finalTransform.TransformPoint(normals[i]));
+				//World bounds of the transformed object bounds, looser than bounding every vertex but free
+				const Vector3 objectMin{ compressed.GetMinBounds() };
+				const Vector3 objectMax{ compressed.GetMaxBounds() };
+				for (int corner{}; corner < 8; ++corner)
+				{
+					const Vector3 position{ finalTransform.TransformPoint(
+						corner & 1 ? objectMax.x : objectMin.x, corner & 2 ? objectMax.y : objectMin.y, corner & 4 ? objectMax.z : objectMin.z) };
+					minAABB = corner == 0 ? position : Vector3{ std::min(minAABB.x, position.x), std::min(minAABB.y, position.y), std::min(minAABB.z, position.z) };
+					maxAABB = corner == 0 ? position : Vector3{ std::max(maxAABB.x, position.x), std::max(maxAABB.y, position.y), std::max(maxAABB.z, position.z) };
+				}
+				return;
 			}
+
+			//Transform Positions (positions > transformedPositions), sized once and then overwritten in place
+			transformedPositions.resize(positions.size());
+			VertexTransform::TransformPoints(finalTransform, positions.data(), transformedPositions.data(), positions.size(), minAABB, maxAABB);
+
+			//Transform Normals (normals > transformedNormals)
+			transformedNormals.resize(normals.size());
+			VertexTransform::TransformNormals(normalTransform, normals.data(), transformedNormals.data(), normals.size());
+
+			bvh.Refit(transformedPositions, indices);
 		}
 	};
 #pragma endregion
@@ -177,6 +400,8 @@ namespace dae
 		Vector3 direction{};
 		ColorRGB color{};
 		float intensity{};
+		//Point lights only, sampled as a disk of this size when soft shadows are on
+		float radius{};
 
 		LightType type{};
 	};
@@ -0,0 +1,245 @@
+#include "Denoiser.h"
+
+#include <algorithm>
+#include <immintrin.h>
+
+#include "Parallel.h"
+
+using namespace dae;
+
+namespace
+{
+	//B3 spline, the standard a-trous kernel
+	constexpr float g_KernelWeights[5]{ 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+	//Allowed distance off the center pixel's tangent plane, relative to its depth
+	constexpr float g_PlaneTolerance{ 0.01f };
+	//Squared albedo difference that costs a factor e in weight
+	constexpr float g_AlbedoTolerance{ 0.01f };
+	//Relative luminance difference that costs a factor e in weight
+	constexpr float g_LuminanceTolerance{ 0.25f };
+	//Albedo is clamped to this before dividing it out
+	constexpr float g_MinAlbedo{ 0.01f };
+
+	//e^-x for x >= 0: 2^(integer part) from the exponent bits, 2^(fraction) from a polynomial (about 1e-4 relative error)
+	inline __m128 ExpNegative(__m128 x)
+	{
+		const __m128 exponent{ _mm_mul_ps(_mm_min_ps(x, _mm_set1_ps(80.f)), _mm_set1_ps(-1.44269504f)) };
+		const __m128i integerPart{ _mm_cvttps_epi32(exponent) };
+		const __m128 fraction{ _mm_sub_ps(exponent, _mm_cvtepi32_ps(integerPart)) };
+
+		__m128 result{ _mm_set1_ps(0.0096181f) };
+		result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(0.0555041f));
+		result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(0.2402265f));
+		result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(0.6931472f));
+		result = _mm_add_ps(_mm_mul_ps(result, fraction), _mm_set1_ps(1.f));
+
+		const __m128 scale{ _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(integerPart, _mm_set1_epi32(127)), 23)) };
+		return _mm_mul_ps(result, scale);
+	}
+
+	inline __m128 Luminance(__m128 r, __m128 g, __m128 b)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(0.2126f)), _mm_mul_ps(g, _mm_set1_ps(0.7152f))), _mm_mul_ps(b, _mm_set1_ps(0.0722f)));
+	}
+
+	inline __m128 Abs(__m128 value)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.f), value);
+	}
+}
+
+void Denoiser::Resize(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_Stride = (width + 3) & ~3;
+
+	const size_t planeSize{ static_cast<size_t>(m_Stride) * height };
+	for (std::vector<float>& plane : m_GuidePlanes)
+	{
+		plane.assign(planeSize, 0.f);
+	}
+	for (auto& planes : m_Irradiance)
+	{
+		for (std::vector<float>& plane : planes)
+		{
+			plane.assign(planeSize, 0.f);
+		}
+	}
+}
+
+void Denoiser::Apply(const ColorRGB* pColors, const ColorRGB* pAlbedos, const Vector3* pNormals, const Vector3* pPositions, const float* pDepths, ColorRGB* pOutput)
+{
+	ParallelFor(0, m_Height, [&](int py)
+		{
+			LoadRow(py, pColors, pAlbedos, pNormals, pPositions, pDepths);
+		});
+
+	int sourceIndex{};
+	for (int iteration{}; iteration < m_NumIterations; ++iteration)
+	{
+		ParallelFor(0, m_Height, [&](int py)
+			{
+				FilterRow(py, 1 << iteration, sourceIndex);
+			});
+		sourceIndex = 1 - sourceIndex;
+	}
+
+	ParallelFor(0, m_Height, [&](int py)
+		{
+			StoreRow(py, sourceIndex, pOutput);
+		});
+}
+
+void Denoiser::LoadRow(int py, const ColorRGB* pColors, const ColorRGB* pAlbedos, const Vector3* pNormals, const Vector3* pPositions, const float* pDepths)
+{
+	for (int px{}; px < m_Width; ++px)
+	{
+		const size_t source{ static_cast<size_t>(px) + static_cast<size_t>(py) * m_Width };
+		const size_t destination{ static_cast<size_t>(px) + static_cast<size_t>(py) * m_Stride };
+
+		const Vector3& normal{ pNormals[source] };
+		const bool isMiss{ normal.SqrMagnitude() < 0.5f };
+
+		const ColorRGB albedo{ isMiss ? ColorRGB{ 1.f, 1.f, 1.f } : ColorRGB{
+			std::max(pAlbedos[source].r, g_MinAlbedo),
+			std::max(pAlbedos[source].g, g_MinAlbedo),
+			std::max(pAlbedos[source].b, g_MinAlbedo) } };
+
+		m_GuidePlanes[NormalX][destination] = isMiss ? 0.f : normal.x;
+		m_GuidePlanes[NormalY][destination] = isMiss ? 0.f : normal.y;
+		m_GuidePlanes[NormalZ][destination] = isMiss ? 0.f : normal.z;
+		m_GuidePlanes[Miss][destination] = isMiss ? 1.f : 0.f;
+		m_GuidePlanes[PositionX][destination] = isMiss ? 0.f : pPositions[source].x;
+		m_GuidePlanes[PositionY][destination] = isMiss ? 0.f : pPositions[source].y;
+		m_GuidePlanes[PositionZ][destination] = isMiss ? 0.f : pPositions[source].z;
+		m_GuidePlanes[InversePlaneTolerance][destination] = isMiss ? 0.f : 1.f / (g_PlaneTolerance * std::max(pDepths[source], 0.001f));
+		m_GuidePlanes[AlbedoR][destination] = albedo.r;
+		m_GuidePlanes[AlbedoG][destination] = albedo.g;
+		m_GuidePlanes[AlbedoB][destination] = albedo.b;
+
+		m_Irradiance[0][0][destination] = pColors[source].r / albedo.r;
+		m_Irradiance[0][1][destination] = pColors[source].g / albedo.g;
+		m_Irradiance[0][2][destination] = pColors[source].b / albedo.b;
+	}
+}
+
+void Denoiser::FilterRow(int py, int step, int sourceIndex)
+{
+	const std::vector<float>* pGuides{ m_GuidePlanes };
+	const std::vector<float>* pSource{ m_Irradiance[sourceIndex] };
+	std::vector<float>* pDestination{ m_Irradiance[1 - sourceIndex] };
+
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 one{ _mm_set1_ps(1.f) };
+	const __m128 inverseStep{ _mm_set1_ps(1.f / static_cast<float>(step)) };
+	const __m128 inverseAlbedoTolerance{ _mm_set1_ps(1.f / g_AlbedoTolerance) };
+	const __m128 inverseLuminanceTolerance{ _mm_set1_ps(1.f / g_LuminanceTolerance) };
+	const __m128 luminanceEpsilon{ _mm_set1_ps(0.01f) };
+
+	for (int blockX{}; blockX < m_Width; blockX += 4)
+	{
+		const size_t center{ static_cast<size_t>(blockX) + static_cast<size_t>(py) * m_Stride };
+		const auto loadCenter = [center](const std::vector<float>& plane) { return _mm_loadu_ps(plane.data() + center); };
+
+		const __m128 normalX{ loadCenter(pGuides[NormalX]) };
+		const __m128 normalY{ loadCenter(pGuides[NormalY]) };
+		const __m128 normalZ{ loadCenter(pGuides[NormalZ]) };
+		const __m128 miss{ loadCenter(pGuides[Miss]) };
+		const __m128 positionX{ loadCenter(pGuides[PositionX]) };
+		const __m128 positionY{ loadCenter(pGuides[PositionY]) };
+		const __m128 positionZ{ loadCenter(pGuides[PositionZ]) };
+		const __m128 inversePlaneTolerance{ _mm_mul_ps(loadCenter(pGuides[InversePlaneTolerance]), inverseStep) };
+		const __m128 albedoR{ loadCenter(pGuides[AlbedoR]) };
+		const __m128 albedoG{ loadCenter(pGuides[AlbedoG]) };
+		const __m128 albedoB{ loadCenter(pGuides[AlbedoB]) };
+		const __m128 luminance{ Luminance(loadCenter(pSource[0]), loadCenter(pSource[1]), loadCenter(pSource[2])) };
+
+		__m128 sumR{ zero }, sumG{ zero }, sumB{ zero }, sumWeights{ zero };
+
+		for (int tapY{}; tapY < 5; ++tapY)
+		{
+			const int sampleY{ std::clamp(py + (tapY - 2) * step, 0, m_Height - 1) };
+			const size_t rowOffset{ static_cast<size_t>(sampleY) * m_Stride };
+
+			for (int tapX{}; tapX < 5; ++tapX)
+			{
+				const int sampleX{ blockX + (tapX - 2) * step };
+				const bool isInside{ sampleX >= 0 && sampleX + 3 < m_Width };
+
+				//Taps past the image edge repeat the edge pixel
+				const auto loadTap = [&](const std::vector<float>& plane)
+				{
+					if (isInside)
+						return _mm_loadu_ps(plane.data() + rowOffset + sampleX);
+
+					const float* pRow{ plane.data() + rowOffset };
+					return _mm_setr_ps(
+						pRow[std::clamp(sampleX, 0, m_Width - 1)],
+						pRow[std::clamp(sampleX + 1, 0, m_Width - 1)],
+						pRow[std::clamp(sampleX + 2, 0, m_Width - 1)],
+						pRow[std::clamp(sampleX + 3, 0, m_Width - 1)]);
+				};
+
+				//Normals: cos^128, two misses count as facing the same way, a hit and a miss never mix
+				__m128 normalWeight{ _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(normalX, loadTap(pGuides[NormalX])), _mm_mul_ps(normalY, loadTap(pGuides[NormalY]))),
+					_mm_add_ps(_mm_mul_ps(normalZ, loadTap(pGuides[NormalZ])), _mm_mul_ps(miss, loadTap(pGuides[Miss])))) };
+				normalWeight = _mm_max_ps(normalWeight, zero);
+				for (int squaring{}; squaring < 7; ++squaring)
+				{
+					normalWeight = _mm_mul_ps(normalWeight, normalWeight);
+				}
+
+				//Distance of the tap from the center's tangent plane
+				const __m128 planeDistance{ Abs(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(normalX, _mm_sub_ps(loadTap(pGuides[PositionX]), positionX)),
+					_mm_mul_ps(normalY, _mm_sub_ps(loadTap(pGuides[PositionY]), positionY))),
+					_mm_mul_ps(normalZ, _mm_sub_ps(loadTap(pGuides[PositionZ]), positionZ)))) };
+
+				const __m128 albedoDeltaR{ _mm_sub_ps(loadTap(pGuides[AlbedoR]), albedoR) };
+				const __m128 albedoDeltaG{ _mm_sub_ps(loadTap(pGuides[AlbedoG]), albedoG) };
+				const __m128 albedoDeltaB{ _mm_sub_ps(loadTap(pGuides[AlbedoB]), albedoB) };
+				const __m128 albedoDistance{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(albedoDeltaR, albedoDeltaR), _mm_mul_ps(albedoDeltaG, albedoDeltaG)), _mm_mul_ps(albedoDeltaB, albedoDeltaB)) };
+
+				const __m128 tapR{ loadTap(pSource[0]) };
+				const __m128 tapG{ loadTap(pSource[1]) };
+				const __m128 tapB{ loadTap(pSource[2]) };
+				const __m128 tapLuminance{ Luminance(tapR, tapG, tapB) };
+				const __m128 luminanceDistance{ _mm_div_ps(Abs(_mm_sub_ps(tapLuminance, luminance)),
+					_mm_add_ps(_mm_max_ps(tapLuminance, luminance), luminanceEpsilon)) };
+
+				const __m128 edgeDistance{ _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(planeDistance, inversePlaneTolerance),
+					_mm_mul_ps(albedoDistance, inverseAlbedoTolerance)),
+					_mm_mul_ps(luminanceDistance, inverseLuminanceTolerance)) };
+
+				const __m128 weight{ _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(g_KernelWeights[tapX] * g_KernelWeights[tapY]), normalWeight), ExpNegative(edgeDistance)) };
+
+				sumR = _mm_add_ps(sumR, _mm_mul_ps(weight, tapR));
+				sumG = _mm_add_ps(sumG, _mm_mul_ps(weight, tapG));
+				sumB = _mm_add_ps(sumB, _mm_mul_ps(weight, tapB));
+				sumWeights = _mm_add_ps(sumWeights, weight);
+			}
+		}
+
+		//The center tap always has a weight of at least 9/64, the max only guards the padding lanes
+		const __m128 inverseWeight{ _mm_div_ps(one, _mm_max_ps(sumWeights, _mm_set1_ps(1e-6f))) };
+		_mm_storeu_ps(pDestination[0].data() + center, _mm_mul_ps(sumR, inverseWeight));
+		_mm_storeu_ps(pDestination[1].data() + center, _mm_mul_ps(sumG, inverseWeight));
+		_mm_storeu_ps(pDestination[2].data() + center, _mm_mul_ps(sumB, inverseWeight));
+	}
+}
+
+void Denoiser::StoreRow(int py, int sourceIndex, ColorRGB* pOutput) const
+{
+	for (int px{}; px < m_Width; ++px)
+	{
+		const size_t source{ static_cast<size_t>(px) + static_cast<size_t>(py) * m_Stride };
+		pOutput[px + py * m_Width] = ColorRGB{
+			m_Irradiance[sourceIndex][0][source] * m_GuidePlanes[AlbedoR][source],
+			m_Irradiance[sourceIndex][1][source] * m_GuidePlanes[AlbedoG][source],
+			m_Irradiance[sourceIndex][2][source] * m_GuidePlanes[AlbedoB][source] };
+	}
+}
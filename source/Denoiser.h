@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Edge-aware a-trous wavelet filter for low sample counts
+	//Albedo is divided out before filtering and multiplied back after, so only lighting gets smoothed.
+	//Normals, world positions, albedo and luminance stop the filter at geometric and shading edges.
+	//Works on planar float buffers four pixels at a time, rows are spread over all cores.
+	class Denoiser final
+	{
+	public:
+		Denoiser() = default;
+		~Denoiser() = default;
+
+		Denoiser(const Denoiser&) = delete;
+		Denoiser(Denoiser&&) noexcept = delete;
+		Denoiser& operator=(const Denoiser&) = delete;
+		Denoiser& operator=(Denoiser&&) noexcept = delete;
+
+		void Resize(int width, int height);
+
+		//Pixels with a zero normal are treated as misses and only blend with other misses
+		void Apply(const ColorRGB* pColors, const ColorRGB* pAlbedos, const Vector3* pNormals, const Vector3* pPositions, const float* pDepths, ColorRGB* pOutput);
+
+		//Each iteration doubles the tap spacing: 1, 2, 4, ...
+		void SetNumIterations(int numIterations) { m_NumIterations = numIterations > 0 ? numIterations : 1; }
+
+	private:
+		void LoadRow(int py, const ColorRGB* pColors, const ColorRGB* pAlbedos, const Vector3* pNormals, const Vector3* pPositions, const float* pDepths);
+		void FilterRow(int py, int step, int sourceIndex);
+		void StoreRow(int py, int sourceIndex, ColorRGB* pOutput) const;
+
+		enum Plane
+		{
+			NormalX, NormalY, NormalZ,
+			//1 for misses, 0 for hits
+			Miss,
+			PositionX, PositionY, PositionZ,
+			//1 / (plane distance tolerance), grows with distance to the camera
+			InversePlaneTolerance,
+			AlbedoR, AlbedoG, AlbedoB,
+			NumGuidePlanes
+		};
+
+		int m_Width{};
+		int m_Height{};
+		//Rows are padded to a multiple of four so every block load stays inside the row
+		int m_Stride{};
+
+		int m_NumIterations{ 2 };
+
+		std::vector<float> m_GuidePlanes[NumGuidePlanes]{};
+		//Demodulated lighting, ping-ponged between iterations
+		std::vector<float> m_Irradiance[2][3]{};
+	};
+}
@@ -0,0 +1,654 @@
+#include "GltfLoader.h"
+#include "DataTypes.h"
+#include "MappedFile.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+using namespace dae;
+
+namespace
+{
+	constexpr uint32_t g_GlbMagic{ 0x46546C67 }; //"glTF"
+	constexpr uint32_t g_JsonChunkType{ 0x4E4F534A }; //"JSON"
+	constexpr uint32_t g_BinaryChunkType{ 0x004E4942 }; //"BIN\0"
+
+	constexpr int g_ComponentUnsignedByte{ 5121 };
+	constexpr int g_ComponentUnsignedShort{ 5123 };
+	constexpr int g_ComponentUnsignedInt{ 5125 };
+	constexpr int g_ComponentFloat{ 5126 };
+	constexpr int g_ModeTriangles{ 4 };
+
+	//Just enough JSON for the glTF header chunk: the whole document becomes one tree of values
+	struct JsonValue
+	{
+		enum class Type
+		{
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		Type type{ Type::Null };
+		bool boolean{};
+		double number{};
+		std::string string{};
+		std::vector<JsonValue> elements{};
+		std::vector<std::pair<std::string, JsonValue>> members{};
+
+		const JsonValue* Find(const char* key) const
+		{
+			for (const auto& member : members)
+			{
+				if (member.first == key)
+					return &member.second;
+			}
+			return nullptr;
+		}
+
+		const JsonValue* GetElement(size_t index) const
+		{
+			return type == Type::Array && index < elements.size() ? &elements[index] : nullptr;
+		}
+
+		size_t GetNumElements(const char* key) const
+		{
+			const JsonValue* pValue{ Find(key) };
+			return pValue && pValue->type == Type::Array ? pValue->elements.size() : 0;
+		}
+
+		double GetNumber(const char* key, double defaultValue) const
+		{
+			const JsonValue* pValue{ Find(key) };
+			return pValue && pValue->type == Type::Number ? pValue->number : defaultValue;
+		}
+
+		int GetInt(const char* key, int defaultValue) const
+		{
+			return static_cast<int>(GetNumber(key, defaultValue));
+		}
+	};
+
+	class JsonParser final
+	{
+	public:
+		JsonParser(const char* pBegin, const char* pEnd) :
+			m_pCurrent{ pBegin },
+			m_pEnd{ pEnd }
+		{
+		}
+
+		bool ParseDocument(JsonValue& value)
+		{
+			if (!ParseValue(value, 0))
+				return false;
+			SkipWhitespace();
+			//The chunk is padded with spaces, anything else after the document is an error
+			return m_pCurrent == m_pEnd;
+		}
+
+	private:
+		//Deeper nesting than this only shows up in malicious files
+		static constexpr int m_MaxDepth{ 64 };
+
+		void SkipWhitespace()
+		{
+			while (m_pCurrent < m_pEnd && (*m_pCurrent == ' ' || *m_pCurrent == '\t' || *m_pCurrent == '\n' || *m_pCurrent == '\r'))
+				++m_pCurrent;
+		}
+
+		bool Consume(char c)
+		{
+			SkipWhitespace();
+			if (m_pCurrent == m_pEnd || *m_pCurrent != c)
+				return false;
+			++m_pCurrent;
+			return true;
+		}
+
+		bool ConsumeWord(const char* word)
+		{
+			const size_t length{ std::strlen(word) };
+			if (static_cast<size_t>(m_pEnd - m_pCurrent) < length || std::memcmp(m_pCurrent, word, length) != 0)
+				return false;
+			m_pCurrent += length;
+			return true;
+		}
+
+		bool ParseValue(JsonValue& value, int depth)
+		{
+			SkipWhitespace();
+			if (m_pCurrent == m_pEnd || depth > m_MaxDepth)
+				return false;
+
+			switch (*m_pCurrent)
+			{
+			case '{':
+				value.type = JsonValue::Type::Object;
+				return ParseObject(value, depth);
+			case '[':
+				value.type = JsonValue::Type::Array;
+				return ParseArray(value, depth);
+			case '"':
+				value.type = JsonValue::Type::String;
+				return ParseString(value.string);
+			case 't':
+				value.type = JsonValue::Type::Bool;
+				value.boolean = true;
+				return ConsumeWord("true");
+			case 'f':
+				value.type = JsonValue::Type::Bool;
+				return ConsumeWord("false");
+			case 'n':
+				return ConsumeWord("null");
+			default:
+			{
+				value.type = JsonValue::Type::Number;
+				const auto [pNext, error] { std::from_chars(m_pCurrent, m_pEnd, value.number) };
+				if (error != std::errc{})
+					return false;
+				m_pCurrent = pNext;
+				return true;
+			}
+			}
+		}
+
+		bool ParseObject(JsonValue& value, int depth)
+		{
+			++m_pCurrent;
+			if (Consume('}'))
+				return true;
+
+			do
+			{
+				SkipWhitespace();
+				std::pair<std::string, JsonValue> member{};
+				if (!ParseString(member.first) || !Consume(':') || !ParseValue(member.second, depth + 1))
+					return false;
+				value.members.push_back(std::move(member));
+			} while (Consume(','));
+
+			return Consume('}');
+		}
+
+		bool ParseArray(JsonValue& value, int depth)
+		{
+			++m_pCurrent;
+			if (Consume(']'))
+				return true;
+
+			do
+			{
+				value.elements.emplace_back();
+				if (!ParseValue(value.elements.back(), depth + 1))
+					return false;
+			} while (Consume(','));
+
+			return Consume(']');
+		}
+
+		//Escapes are resolved, \u sequences outside ASCII become '?' since names and keys are all glTF needs
+		bool ParseString(std::string& string)
+		{
+			if (m_pCurrent == m_pEnd || *m_pCurrent != '"')
+				return false;
+			++m_pCurrent;
+
+			while (m_pCurrent < m_pEnd && *m_pCurrent != '"')
+			{
+				if (*m_pCurrent != '\\')
+				{
+					string += *m_pCurrent++;
+					continue;
+				}
+
+				if (++m_pCurrent == m_pEnd)
+					return false;
+				switch (*m_pCurrent++)
+				{
+				case 'b': string += '\b'; break;
+				case 'f': string += '\f'; break;
+				case 'n': string += '\n'; break;
+				case 'r': string += '\r'; break;
+				case 't': string += '\t'; break;
+				case 'u':
+				{
+					unsigned int codePoint{};
+					if (m_pEnd - m_pCurrent < 4 || std::from_chars(m_pCurrent, m_pCurrent + 4, codePoint, 16).ptr != m_pCurrent + 4)
+						return false;
+					m_pCurrent += 4;
+					string += codePoint < 0x80 ? static_cast<char>(codePoint) : '?';
+					break;
+				}
+				default: string += m_pCurrent[-1]; break;
+				}
+			}
+
+			if (m_pCurrent == m_pEnd)
+				return false;
+			++m_pCurrent;
+			return true;
+		}
+
+		const char* m_pCurrent{};
+		const char* m_pEnd{};
+	};
+
+	//Where an accessor's elements live inside the binary chunk
+	struct AccessorView
+	{
+		const uint8_t* pData{};
+		size_t count{};
+		size_t stride{};
+		size_t elementSize{};
+		int componentType{};
+	};
+
+	size_t GetComponentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case g_ComponentUnsignedByte: return 1;
+		case g_ComponentUnsignedShort: return 2;
+		case g_ComponentUnsignedInt:
+		case g_ComponentFloat: return 4;
+		default: return 0;
+		}
+	}
+
+	size_t GetNumComponents(const std::string& type)
+	{
+		if (type == "SCALAR")
+			return 1;
+		if (type == "VEC2")
+			return 2;
+		if (type == "VEC3")
+			return 3;
+		if (type == "VEC4")
+			return 4;
+		return 0;
+	}
+
+	//Resolves accessor -> bufferView -> binary chunk and checks every element stays inside the chunk
+	bool GetAccessorView(const JsonValue& document, int accessorIndex, const uint8_t* pBinary, size_t binarySize, AccessorView& view)
+	{
+		const JsonValue* pAccessors{ document.Find("accessors") };
+		const JsonValue* pAccessor{ pAccessors ? pAccessors->GetElement(accessorIndex) : nullptr };
+		if (!pAccessor || pAccessor->Find("sparse"))
+			return false;
+
+		const JsonValue* pType{ pAccessor->Find("type") };
+		const size_t numComponents{ pType ? GetNumComponents(pType->string) : 0 };
+		view.componentType = pAccessor->GetInt("componentType", 0);
+		const size_t elementSize{ GetComponentSize(view.componentType) * numComponents };
+		if (elementSize == 0)
+			return false;
+
+		const JsonValue* pBufferViews{ document.Find("bufferViews") };
+		const JsonValue* pBufferView{ pBufferViews ? pBufferViews->GetElement(pAccessor->GetInt("bufferView", -1)) : nullptr };
+		//Only the buffer embedded in the .glb itself
+		if (!pBufferView || pBufferView->GetInt("buffer", 0) != 0)
+			return false;
+
+		const double count{ pAccessor->GetNumber("count", 0) };
+		const double accessorOffset{ pAccessor->GetNumber("byteOffset", 0) };
+		const double viewOffset{ pBufferView->GetNumber("byteOffset", 0) };
+		const double viewLength{ pBufferView->GetNumber("byteLength", 0) };
+		const double stride{ pBufferView->GetNumber("byteStride", static_cast<double>(elementSize)) };
+		if (count < 0 || accessorOffset < 0 || viewOffset < 0 || stride < elementSize
+			|| viewOffset + viewLength > binarySize
+			|| (count > 0 && accessorOffset + stride * (count - 1) + elementSize > viewLength))
+			return false;
+
+		view.pData = pBinary + static_cast<size_t>(viewOffset + accessorOffset);
+		view.elementSize = elementSize;
+		view.count = static_cast<size_t>(count);
+		view.stride = static_cast<size_t>(stride);
+		return true;
+	}
+
+	uint32_t ReadIndex(const AccessorView& view, size_t i)
+	{
+		const uint8_t* pElement{ view.pData + i * view.stride };
+		switch (view.componentType)
+		{
+		case g_ComponentUnsignedByte:
+			return *pElement;
+		case g_ComponentUnsignedShort:
+		{
+			uint16_t index{};
+			std::memcpy(&index, pElement, sizeof(index));
+			return index;
+		}
+		default:
+		{
+			uint32_t index{};
+			std::memcpy(&index, pElement, sizeof(index));
+			return index;
+		}
+		}
+	}
+
+	//Appends one triangle primitive to the merged mesh
+	bool AppendPrimitive(const JsonValue& document, const JsonValue& primitive, const uint8_t* pBinary, size_t binarySize, TriangleMesh& mesh)
+	{
+		const JsonValue* pAttributes{ primitive.Find("attributes") };
+		const JsonValue* pPosition{ pAttributes ? pAttributes->Find("POSITION") : nullptr };
+		AccessorView positions{};
+		if (!pPosition || !GetAccessorView(document, static_cast<int>(pPosition->number), pBinary, binarySize, positions)
+			|| positions.componentType != g_ComponentFloat || positions.elementSize != sizeof(Vector3))
+			return false;
+
+		const size_t firstVertex{ mesh.positions.size() };
+		if (firstVertex + positions.count > INT32_MAX)
+			return false;
+
+		//Tightly packed and aligned data is taken over as a block, interleaved vertices one at a time
+		if (positions.stride == sizeof(Vector3) && reinterpret_cast<uintptr_t>(positions.pData) % alignof(Vector3) == 0)
+		{
+			const Vector3* pFirst{ reinterpret_cast<const Vector3*>(positions.pData) };
+			mesh.positions.insert(mesh.positions.end(), pFirst, pFirst + positions.count);
+		}
+		else
+		{
+			mesh.positions.resize(firstVertex + positions.count);
+			for (size_t i{}; i < positions.count; ++i)
+			{
+				std::memcpy(&mesh.positions[firstVertex + i], positions.pData + i * positions.stride, sizeof(Vector3));
+			}
+		}
+
+		const JsonValue* pIndices{ primitive.Find("indices") };
+		if (!pIndices)
+		{
+			const size_t numIndices{ positions.count / 3 * 3 };
+			mesh.indices.reserve(mesh.indices.size() + numIndices);
+			for (size_t i{}; i < numIndices; ++i)
+			{
+				mesh.indices.push_back(static_cast<int>(firstVertex + i));
+			}
+			return true;
+		}
+
+		AccessorView indices{};
+		if (!GetAccessorView(document, static_cast<int>(pIndices->number), pBinary, binarySize, indices)
+			|| indices.componentType == g_ComponentFloat || indices.elementSize != GetComponentSize(indices.componentType))
+			return false;
+
+		const size_t firstIndex{ mesh.indices.size() };
+		const size_t numIndices{ indices.count / 3 * 3 };
+		mesh.indices.resize(firstIndex + numIndices);
+		for (size_t i{}; i < numIndices; ++i)
+		{
+			const uint32_t index{ ReadIndex(indices, i) };
+			if (index >= positions.count)
+				return false;
+			mesh.indices[firstIndex + i] = static_cast<int>(firstVertex + index);
+		}
+		return true;
+	}
+
+	bool LoadMesh(const JsonValue& document, const JsonValue& gltfMesh, const uint8_t* pBinary, size_t binarySize, TriangleMesh& mesh)
+	{
+		const JsonValue* pPrimitives{ gltfMesh.Find("primitives") };
+		if (!pPrimitives)
+			return false;
+
+		for (const JsonValue& primitive : pPrimitives->elements)
+		{
+			//Points and lines have nothing to intersect, strips and fans are rare enough to skip
+			if (primitive.GetInt("mode", g_ModeTriangles) != g_ModeTriangles)
+				continue;
+			if (!AppendPrimitive(document, primitive, pBinary, binarySize, mesh))
+				return false;
+		}
+
+		//Precompute normals
+		const size_t numTriangles{ mesh.indices.size() / 3 };
+		mesh.normals.resize(numTriangles);
+		for (size_t triangle{}; triangle < numTriangles; ++triangle)
+		{
+			const Vector3& v0{ mesh.positions[mesh.indices[triangle * 3]] };
+			const Vector3 edgeV0V1{ mesh.positions[mesh.indices[triangle * 3 + 1]] - v0 };
+			const Vector3 edgeV0V2{ mesh.positions[mesh.indices[triangle * 3 + 2]] - v0 };
+			mesh.normals[triangle] = Vector3::Cross(edgeV0V1, edgeV0V2).Normalized();
+		}
+		return true;
+	}
+
+	//glTF matrices are column-major for column vectors, which is exactly the row layout Matrix uses for row vectors
+	Matrix GetLocalTransform(const JsonValue& node)
+	{
+		const JsonValue* pMatrix{ node.Find("matrix") };
+		if (pMatrix && pMatrix->elements.size() == 16)
+		{
+			float m[16]{};
+			for (int i{}; i < 16; ++i)
+			{
+				m[i] = static_cast<float>(pMatrix->elements[i].number);
+			}
+			return Matrix{ { m[0], m[1], m[2], m[3] }, { m[4], m[5], m[6], m[7] }, { m[8], m[9], m[10], m[11] }, { m[12], m[13], m[14], m[15] } };
+		}
+
+		const auto getVector = [&node](const char* key, const float defaultValue[4], float result[4])
+		{
+			const JsonValue* pValue{ node.Find(key) };
+			for (size_t i{}; i < 4; ++i)
+			{
+				const JsonValue* pElement{ pValue ? pValue->GetElement(i) : nullptr };
+				result[i] = pElement ? static_cast<float>(pElement->number) : defaultValue[i];
+			}
+		};
+
+		constexpr float zero[4]{ 0.f, 0.f, 0.f, 0.f };
+		constexpr float one[4]{ 1.f, 1.f, 1.f, 1.f };
+		constexpr float identityRotation[4]{ 0.f, 0.f, 0.f, 1.f };
+		float t[4]{};
+		float r[4]{};
+		float s[4]{};
+		getVector("translation", zero, t);
+		getVector("rotation", identityRotation, r);
+		getVector("scale", one, s);
+
+		//Unit quaternion (x, y, z, w) to rotation rows
+		const float x{ r[0] };
+		const float y{ r[1] };
+		const float z{ r[2] };
+		const float w{ r[3] };
+		const Matrix rotation{
+			{ 1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z), 2.f * (x * z - w * y) },
+			{ 2.f * (x * y - w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + w * x) },
+			{ 2.f * (x * z + w * y), 2.f * (y * z - w * x), 1.f - 2.f * (x * x + y * y) },
+			Vector3::Zero };
+
+		//T * R * S in glTF's column-vector order
+		return Matrix::CreateScale(s[0], s[1], s[2]) * rotation * Matrix::CreateTranslation(t[0], t[1], t[2]);
+	}
+
+	struct SceneBuilder
+	{
+		const JsonValue& document;
+		const uint8_t* pBinary{};
+		size_t binarySize{};
+
+		//Filled on first use, one entry per glTF mesh
+		std::vector<TriangleMesh> meshes{};
+		std::vector<int> meshStates{};
+		std::vector<TriangleMesh> instances{};
+		//BVH and LOD chain
+		float buildSeconds{};
+
+		bool AddNode(int nodeIndex, const Matrix& parentTransform, int depth)
+		{
+			const JsonValue* pNodes{ document.Find("nodes") };
+			const JsonValue* pNode{ pNodes ? pNodes->GetElement(nodeIndex) : nullptr };
+			//A node graph deeper than its node count has a cycle
+			if (!pNode || depth > static_cast<int>(pNodes->elements.size()))
+				return false;
+
+			const Matrix worldTransform{ GetLocalTransform(*pNode) * parentTransform };
+
+			if (const JsonValue* pMesh{ pNode->Find("mesh") })
+			{
+				TriangleMesh* pSource{ GetMesh(static_cast<int>(pMesh->number)) };
+				if (!pSource)
+					return false;
+				instances.push_back(*pSource);
+				instances.back().baseTransform = worldTransform;
+			}
+
+			if (const JsonValue* pChildren{ pNode->Find("children") })
+			{
+				for (const JsonValue& child : pChildren->elements)
+				{
+					if (!AddNode(static_cast<int>(child.number), worldTransform, depth + 1))
+						return false;
+				}
+			}
+			return true;
+		}
+
+		TriangleMesh* GetMesh(int meshIndex)
+		{
+			const JsonValue* pMeshes{ document.Find("meshes") };
+			const JsonValue* pMesh{ pMeshes ? pMeshes->GetElement(meshIndex) : nullptr };
+			if (!pMesh)
+				return nullptr;
+
+			if (meshes.empty())
+			{
+				meshes.resize(pMeshes->elements.size());
+				meshStates.resize(pMeshes->elements.size());
+			}
+
+			//0 = not loaded yet, 1 = loaded, -1 = failed
+			int& state{ meshStates[meshIndex] };
+			if (state == 0)
+			{
+				state = LoadMesh(document, *pMesh, pBinary, binarySize, meshes[meshIndex]) ? 1 : -1;
+				if (state > 0)
+				{
+					//Built once here, every instance gets a copy that only needs a refit
+					const auto buildStart{ std::chrono::steady_clock::now() };
+					TriangleMesh& mesh{ meshes[meshIndex] };
+					mesh.bvh.Build(mesh.positions, mesh.indices, mesh.normals);
+					mesh.GenerateLods();
+					buildSeconds += std::chrono::duration<float>(std::chrono::steady_clock::now() - buildStart).count();
+				}
+			}
+			return state > 0 ? &meshes[meshIndex] : nullptr;
+		}
+	};
+
+	uint32_t ReadUInt32(const char* pData)
+	{
+		uint32_t value{};
+		std::memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+}
+
+bool GltfLoader::LoadGLB(const std::string& filename, std::vector<TriangleMesh>& instances)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	MappedFile file{};
+	if (!file.Open(filename))
+	{
+		std::cout << "Could not open " << filename << std::endl;
+		return false;
+	}
+
+	//12 byte header followed by chunks of (length, type, data), the JSON chunk first and the binary chunk second
+	const char* pData{ file.GetData() };
+	const size_t size{ file.GetSize() };
+	if (size < 20 || ReadUInt32(pData) != g_GlbMagic || ReadUInt32(pData + 4) != 2 || ReadUInt32(pData + 8) > size)
+	{
+		std::cout << filename << " is not a glTF 2.0 binary" << std::endl;
+		return false;
+	}
+
+	const size_t jsonLength{ ReadUInt32(pData + 12) };
+	if (ReadUInt32(pData + 16) != g_JsonChunkType || jsonLength > size - 20)
+	{
+		std::cout << filename << " has no JSON chunk" << std::endl;
+		return false;
+	}
+	const char* pJson{ pData + 20 };
+
+	const uint8_t* pBinary{};
+	size_t binarySize{};
+	const size_t binaryHeader{ 20 + jsonLength };
+	if (binaryHeader + 8 <= size && ReadUInt32(pData + binaryHeader + 4) == g_BinaryChunkType)
+	{
+		binarySize = ReadUInt32(pData + binaryHeader);
+		if (binarySize > size - binaryHeader - 8)
+		{
+			std::cout << filename << " has a truncated binary chunk" << std::endl;
+			return false;
+		}
+		pBinary = reinterpret_cast<const uint8_t*>(pData + binaryHeader + 8);
+	}
+
+	JsonValue document{};
+	if (!JsonParser{ pJson, pJson + jsonLength }.ParseDocument(document) || document.type != JsonValue::Type::Object)
+	{
+		std::cout << filename << " has malformed JSON" << std::endl;
+		return false;
+	}
+
+	SceneBuilder builder{ document, pBinary, binarySize };
+
+	bool isValid{ true };
+	const JsonValue* pScenes{ document.Find("scenes") };
+	const JsonValue* pScene{ pScenes ? pScenes->GetElement(document.GetInt("scene", 0)) : nullptr };
+	if (pScene)
+	{
+		if (const JsonValue* pRoots{ pScene->Find("nodes") })
+		{
+			for (size_t i{}; isValid && i < pRoots->elements.size(); ++i)
+			{
+				isValid = builder.AddNode(static_cast<int>(pRoots->elements[i].number), Matrix{}, 0);
+			}
+		}
+	}
+	else
+	{
+		//Without a scene, show every mesh once, untransformed
+		for (size_t i{}; isValid && i < document.GetNumElements("meshes"); ++i)
+		{
+			TriangleMesh* pMesh{ builder.GetMesh(static_cast<int>(i)) };
+			isValid = pMesh != nullptr;
+			if (isValid)
+				builder.instances.push_back(*pMesh);
+		}
+	}
+
+	if (!isValid)
+	{
+		std::cout << filename << " references missing or unsupported data" << std::endl;
+		return false;
+	}
+
+	size_t numTriangles{};
+	for (const TriangleMesh& instance : builder.instances)
+	{
+		numTriangles += instance.indices.size() / 3;
+	}
+
+	//Throughput covers reading the file, BVH and LOD builds are reported on their own
+	const float seconds{ std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() - builder.buildSeconds };
+	std::cout << "Loaded " << filename << ": " << builder.instances.size() << " instances of "
+		<< builder.meshes.size() << " meshes, " << numTriangles << " triangles in " << seconds * 1000.f << " ms ("
+		<< size / (1024.f * 1024.f) / seconds << " MB/s), BVH and LOD builds " << builder.buildSeconds * 1000.f << " ms" << std::endl;
+
+	instances.insert(instances.end(), std::make_move_iterator(builder.instances.begin()), std::make_move_iterator(builder.instances.end()));
+	return true;
+}
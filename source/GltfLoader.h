@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	struct TriangleMesh;
+
+	//Binary glTF 2.0 (.glb) reader
+	//The file is memory mapped and accessor data is copied straight out of the binary chunk, there is no per-vertex parsing.
+	//Every node that references a mesh becomes one TriangleMesh, with the node's world matrix as its baseTransform.
+	//All triangle primitives of a mesh are merged and its BVH and LOD chain are built once, but every node gets a full
+	//copy of the mesh: positions, indices, BVH and LODs. Meshes are traced from their own world space vertices, so
+	//memory grows with the number of instances.
+	//Meshes shade with flat face normals computed from the positions, NORMAL accessors are not needed for that.
+	namespace GltfLoader
+	{
+		//Appends one mesh per node instance; cull mode and material are left for the caller
+		//Returns false, and appends nothing, for anything but a valid .glb with an embedded binary buffer
+		bool LoadGLB(const std::string& filename, std::vector<TriangleMesh>& instances);
+	}
+}
@@ -0,0 +1,553 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace dae;
+
+namespace
+{
+	using ByteBuffer = std::vector<uint8_t>;
+
+	void AppendU16LE(ByteBuffer& buffer, uint32_t value)
+	{
+		buffer.push_back(static_cast<uint8_t>(value));
+		buffer.push_back(static_cast<uint8_t>(value >> 8));
+	}
+
+	void AppendU32LE(ByteBuffer& buffer, uint32_t value)
+	{
+		AppendU16LE(buffer, value & 0xffff);
+		AppendU16LE(buffer, value >> 16);
+	}
+
+	void AppendU32BE(ByteBuffer& buffer, uint32_t value)
+	{
+		buffer.push_back(static_cast<uint8_t>(value >> 24));
+		buffer.push_back(static_cast<uint8_t>(value >> 16));
+		buffer.push_back(static_cast<uint8_t>(value >> 8));
+		buffer.push_back(static_cast<uint8_t>(value));
+	}
+
+	void AppendText(ByteBuffer& buffer, const std::string& text)
+	{
+		buffer.insert(buffer.end(), text.begin(), text.end());
+	}
+
+	//Packed surface pixels >> tightly packed 8 bit RGB rows, top to bottom
+	ByteBuffer UnpackRGB(const std::vector<uint32_t>& pixels, const ToneMappingUtils::SurfaceFormat& format)
+	{
+		ByteBuffer rgb(pixels.size() * 3);
+		for (size_t i{}; i < pixels.size(); ++i)
+		{
+			rgb[i * 3] = static_cast<uint8_t>(pixels[i] >> format.redShift);
+			rgb[i * 3 + 1] = static_cast<uint8_t>(pixels[i] >> format.greenShift);
+			rgb[i * 3 + 2] = static_cast<uint8_t>(pixels[i] >> format.blueShift);
+		}
+		return rgb;
+	}
+
+#pragma region BMP/PPM/PFM
+	ByteBuffer EncodeBMP(const ByteBuffer& rgb, int width, int height)
+	{
+		//24 bit BGR, bottom-up, rows padded to 4 bytes
+		const uint32_t rowSize{ (static_cast<uint32_t>(width) * 3 + 3) & ~3u };
+		const uint32_t pixelDataSize{ rowSize * static_cast<uint32_t>(height) };
+		constexpr uint32_t headerSize{ 14 + 40 };
+
+		ByteBuffer buffer{};
+		buffer.reserve(headerSize + pixelDataSize);
+
+		AppendText(buffer, "BM");
+		AppendU32LE(buffer, headerSize + pixelDataSize);
+		AppendU32LE(buffer, 0);
+		AppendU32LE(buffer, headerSize);
+
+		AppendU32LE(buffer, 40);
+		AppendU32LE(buffer, static_cast<uint32_t>(width));
+		AppendU32LE(buffer, static_cast<uint32_t>(height));
+		AppendU16LE(buffer, 1);
+		AppendU16LE(buffer, 24);
+		AppendU32LE(buffer, 0);
+		AppendU32LE(buffer, pixelDataSize);
+		AppendU32LE(buffer, 2835);
+		AppendU32LE(buffer, 2835);
+		AppendU32LE(buffer, 0);
+		AppendU32LE(buffer, 0);
+
+		for (int py{ height - 1 }; py >= 0; --py)
+		{
+			const uint8_t* pRow{ rgb.data() + static_cast<size_t>(py) * width * 3 };
+			for (int px{}; px < width; ++px)
+			{
+				buffer.push_back(pRow[px * 3 + 2]);
+				buffer.push_back(pRow[px * 3 + 1]);
+				buffer.push_back(pRow[px * 3]);
+			}
+			buffer.resize(buffer.size() + (rowSize - static_cast<uint32_t>(width) * 3));
+		}
+		return buffer;
+	}
+
+	ByteBuffer EncodePPM(const ByteBuffer& rgb, int width, int height)
+	{
+		ByteBuffer buffer{};
+		AppendText(buffer, "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n");
+		buffer.insert(buffer.end(), rgb.begin(), rgb.end());
+		return buffer;
+	}
+
+	ByteBuffer EncodePFM(const std::vector<ColorRGB>& colors, int width, int height)
+	{
+		//Negative scale marks little endian, rows are stored bottom-up
+		ByteBuffer buffer{};
+		AppendText(buffer, "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n");
+
+		const size_t headerSize{ buffer.size() };
+		buffer.resize(headerSize + colors.size() * 3 * sizeof(float));
+		uint8_t* pDestination{ buffer.data() + headerSize };
+
+		for (int py{ height - 1 }; py >= 0; --py)
+		{
+			for (int px{}; px < width; ++px)
+			{
+				const ColorRGB& color{ colors[px + static_cast<size_t>(py) * width] };
+				const float values[3]{ color.r, color.g, color.b };
+				for (const float value : values)
+				{
+					uint32_t bits{};
+					memcpy(&bits, &value, sizeof(bits));
+					for (int byteIndex{}; byteIndex < 4; ++byteIndex)
+					{
+						*pDestination++ = static_cast<uint8_t>(bits >> (byteIndex * 8));
+					}
+				}
+			}
+		}
+		return buffer;
+	}
+#pragma endregion
+
+#pragma region PNG
+	uint32_t UpdateCRC32(uint32_t crc, const uint8_t* pData, size_t size)
+	{
+		static const std::array<uint32_t, 256> table{ []
+			{
+				std::array<uint32_t, 256> result{};
+				for (uint32_t i{}; i < 256; ++i)
+				{
+					uint32_t value{ i };
+					for (int bit{}; bit < 8; ++bit)
+					{
+						value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+					}
+					result[i] = value;
+				}
+				return result;
+			}() };
+
+		crc = ~crc;
+		for (size_t i{}; i < size; ++i)
+		{
+			crc = table[(crc ^ pData[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t Adler32(const ByteBuffer& data)
+	{
+		constexpr uint32_t modulus{ 65521 };
+		uint32_t a{ 1 }, b{ 0 };
+		for (const uint8_t value : data)
+		{
+			a = (a + value) % modulus;
+			b = (b + a) % modulus;
+		}
+		return (b << 16) | a;
+	}
+
+	//LSB-first bit stream as deflate expects it
+	class BitWriter final
+	{
+	public:
+		explicit BitWriter(ByteBuffer& buffer) : m_Buffer{ buffer } {}
+
+		void Write(uint32_t bits, int numBits)
+		{
+			m_BitBuffer |= static_cast<uint64_t>(bits) << m_NumBits;
+			m_NumBits += numBits;
+			while (m_NumBits >= 8)
+			{
+				m_Buffer.push_back(static_cast<uint8_t>(m_BitBuffer));
+				m_BitBuffer >>= 8;
+				m_NumBits -= 8;
+			}
+		}
+
+		//Huffman codes are defined MSB-first
+		void WriteReversed(uint32_t code, int numBits)
+		{
+			uint32_t reversed{};
+			for (int bit{}; bit < numBits; ++bit)
+			{
+				reversed |= ((code >> bit) & 1) << (numBits - 1 - bit);
+			}
+			Write(reversed, numBits);
+		}
+
+		void Finish()
+		{
+			if (m_NumBits > 0)
+				m_Buffer.push_back(static_cast<uint8_t>(m_BitBuffer));
+			m_BitBuffer = 0;
+			m_NumBits = 0;
+		}
+
+	private:
+		ByteBuffer& m_Buffer;
+		uint64_t m_BitBuffer{};
+		int m_NumBits{};
+	};
+
+	void WriteFixedLiteral(BitWriter& writer, uint32_t symbol)
+	{
+		if (symbol < 144)
+			writer.WriteReversed(0x30 + symbol, 8);
+		else if (symbol < 256)
+			writer.WriteReversed(0x190 + symbol - 144, 9);
+		else if (symbol < 280)
+			writer.WriteReversed(symbol - 256, 7);
+		else
+			writer.WriteReversed(0xc0 + symbol - 280, 8);
+	}
+
+	void WriteMatch(BitWriter& writer, int length, int distance)
+	{
+		static constexpr uint16_t lengthBase[29]{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr uint8_t lengthExtraBits[29]{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static constexpr uint16_t distanceBase[30]{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static constexpr uint8_t distanceExtraBits[30]{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		int lengthCode{ 28 };
+		while (lengthBase[lengthCode] > length)
+			--lengthCode;
+		WriteFixedLiteral(writer, 257 + lengthCode);
+		writer.Write(length - lengthBase[lengthCode], lengthExtraBits[lengthCode]);
+
+		int distanceCode{ 29 };
+		while (distanceBase[distanceCode] > distance)
+			--distanceCode;
+		writer.WriteReversed(distanceCode, 5);
+		writer.Write(distance - distanceBase[distanceCode], distanceExtraBits[distanceCode]);
+	}
+
+	//zlib stream with a single fixed-Huffman deflate block, LZ77 matches found through hash chains
+	ByteBuffer Deflate(const ByteBuffer& data)
+	{
+		constexpr int windowSize{ 32768 };
+		constexpr int minMatch{ 3 };
+		constexpr int maxMatch{ 258 };
+		constexpr int maxChainLength{ 32 };
+		constexpr int hashBits{ 15 };
+
+		ByteBuffer buffer{ 0x78, 0x01 };
+		BitWriter writer{ buffer };
+		writer.Write(1, 1);
+		writer.Write(1, 2);
+
+		const int size{ static_cast<int>(data.size()) };
+		std::vector<int> head(1 << hashBits, -1);
+		std::vector<int> previous(windowSize, -1);
+
+		const auto hashAt = [&](int position)
+		{
+			const uint32_t value{ static_cast<uint32_t>(data[position]) | (data[position + 1] << 8) | (data[position + 2] << 16) };
+			return (value * 2654435761u) >> (32 - hashBits);
+		};
+		const auto insert = [&](int position)
+		{
+			if (position + minMatch > size)
+				return;
+			const uint32_t hash{ hashAt(position) };
+			previous[position % windowSize] = head[hash];
+			head[hash] = position;
+		};
+
+		int position{};
+		while (position < size)
+		{
+			int bestLength{}, bestDistance{};
+			if (position + minMatch <= size)
+			{
+				const int maxLength{ std::min(maxMatch, size - position) };
+				int candidate{ head[hashAt(position)] };
+				for (int chain{}; chain < maxChainLength && candidate >= 0 && position - candidate <= windowSize; ++chain)
+				{
+					int length{};
+					while (length < maxLength && data[candidate + length] == data[position + length])
+						++length;
+
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = position - candidate;
+						if (length == maxLength)
+							break;
+					}
+
+					const int next{ previous[candidate % windowSize] };
+					if (next >= candidate)
+						break;
+					candidate = next;
+				}
+			}
+
+			if (bestLength >= minMatch)
+			{
+				WriteMatch(writer, bestLength, bestDistance);
+				for (int i{}; i < bestLength; ++i)
+				{
+					insert(position + i);
+				}
+				position += bestLength;
+			}
+			else
+			{
+				WriteFixedLiteral(writer, data[position]);
+				insert(position);
+				++position;
+			}
+		}
+
+		WriteFixedLiteral(writer, 256);
+		writer.Finish();
+
+		AppendU32BE(buffer, Adler32(data));
+		return buffer;
+	}
+
+	void AppendChunk(ByteBuffer& buffer, const char* type, const ByteBuffer& data)
+	{
+		AppendU32BE(buffer, static_cast<uint32_t>(data.size()));
+		const size_t typeOffset{ buffer.size() };
+		buffer.insert(buffer.end(), type, type + 4);
+		buffer.insert(buffer.end(), data.begin(), data.end());
+		AppendU32BE(buffer, UpdateCRC32(0, buffer.data() + typeOffset, buffer.size() - typeOffset));
+	}
+
+	ByteBuffer EncodePNG(const ByteBuffer& rgb, int width, int height)
+	{
+		const size_t rowSize{ static_cast<size_t>(width) * 3 };
+
+		//Every row is filtered with whichever of None/Sub/Up/Paeth leaves the smallest residuals
+		ByteBuffer filtered{};
+		filtered.reserve((rowSize + 1) * height);
+		ByteBuffer candidate(rowSize);
+		ByteBuffer bestRow(rowSize);
+		const ByteBuffer zeroRow(rowSize);
+
+		for (int py{}; py < height; ++py)
+		{
+			const uint8_t* pRow{ rgb.data() + py * rowSize };
+			const uint8_t* pAbove{ py > 0 ? pRow - rowSize : zeroRow.data() };
+
+			uint8_t bestFilter{};
+			uint64_t bestScore{ UINT64_MAX };
+			for (uint8_t filter : { 0, 1, 2, 4 })
+			{
+				uint64_t score{};
+				for (size_t i{}; i < rowSize; ++i)
+				{
+					const int left{ i >= 3 ? pRow[i - 3] : 0 };
+					const int up{ pAbove[i] };
+					const int upLeft{ i >= 3 ? pAbove[i - 3] : 0 };
+
+					int prediction{};
+					if (filter == 1)
+						prediction = left;
+					else if (filter == 2)
+						prediction = up;
+					else if (filter == 4)
+					{
+						const int estimate{ left + up - upLeft };
+						const int distanceLeft{ abs(estimate - left) };
+						const int distanceUp{ abs(estimate - up) };
+						const int distanceUpLeft{ abs(estimate - upLeft) };
+						prediction = (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) ? left : (distanceUp <= distanceUpLeft ? up : upLeft);
+					}
+
+					candidate[i] = static_cast<uint8_t>(pRow[i] - prediction);
+					score += static_cast<uint64_t>(std::min<int>(candidate[i], 256 - candidate[i]));
+				}
+
+				if (score < bestScore)
+				{
+					bestScore = score;
+					bestFilter = filter;
+					bestRow.swap(candidate);
+				}
+			}
+
+			filtered.push_back(bestFilter);
+			filtered.insert(filtered.end(), bestRow.begin(), bestRow.end());
+		}
+
+		ByteBuffer buffer{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+		ByteBuffer header{};
+		AppendU32BE(header, static_cast<uint32_t>(width));
+		AppendU32BE(header, static_cast<uint32_t>(height));
+		header.insert(header.end(), { 8, 2, 0, 0, 0 });
+
+		AppendChunk(buffer, "IHDR", header);
+		AppendChunk(buffer, "IDAT", Deflate(filtered));
+		AppendChunk(buffer, "IEND", {});
+		return buffer;
+	}
+#pragma endregion
+}
+
+ImageWriter::ImageWriter(size_t maxQueuedImages) :
+	m_MaxQueuedImages{ std::max<size_t>(maxQueuedImages, 1) },
+	m_Thread{ &ImageWriter::Run, this }
+{
+}
+
+ImageWriter::~ImageWriter()
+{
+	{
+		const std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_JobAdded.notify_one();
+	m_Thread.join();
+}
+
+const char* ImageWriter::GetExtension(ImageFormat format)
+{
+	switch (format)
+	{
+	case ImageFormat::BMP:
+		return "bmp";
+	case ImageFormat::PPM:
+		return "ppm";
+	case ImageFormat::PNG:
+		return "png";
+	case ImageFormat::PFM:
+		return "pfm";
+	}
+	return "";
+}
+
+bool ImageWriter::ParseFormat(const std::string& name, ImageFormat& format)
+{
+	for (const ImageFormat candidate : { ImageFormat::BMP, ImageFormat::PPM, ImageFormat::PNG, ImageFormat::PFM })
+	{
+		if (name == GetExtension(candidate))
+		{
+			format = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string ImageWriter::GetNextSequenceFilename(const std::string& baseName, ImageFormat format)
+{
+	char sequence[16]{};
+	snprintf(sequence, sizeof(sequence), "_%04u.", m_NextSequenceNumber++);
+	return baseName + sequence + GetExtension(format);
+}
+
+void ImageWriter::Write(const std::string& filename, ImageFormat format, int width, int height, std::vector<uint32_t>&& pixels, const ToneMappingUtils::SurfaceFormat& surfaceFormat)
+{
+	ImageJob job{ filename, format, width, height };
+	job.pixels = std::move(pixels);
+	job.surfaceFormat = surfaceFormat;
+	Enqueue(std::move(job));
+}
+
+void ImageWriter::Write(const std::string& filename, int width, int height, std::vector<ColorRGB>&& colors)
+{
+	ImageJob job{ filename, ImageFormat::PFM, width, height };
+	job.colors = std::move(colors);
+	Enqueue(std::move(job));
+}
+
+void ImageWriter::Flush()
+{
+	std::unique_lock lock{ m_Mutex };
+	m_JobDone.wait(lock, [this] { return m_Jobs.empty() && !m_IsWriting; });
+}
+
+void ImageWriter::Enqueue(ImageJob&& job)
+{
+	{
+		//Backpressure: a slow disk holds up the caller instead of piling up frame copies
+		std::unique_lock lock{ m_Mutex };
+		m_JobDone.wait(lock, [this] { return m_Jobs.size() < m_MaxQueuedImages; });
+		m_Jobs.push_back(std::move(job));
+	}
+	m_JobAdded.notify_one();
+}
+
+void ImageWriter::Run()
+{
+	std::unique_lock lock{ m_Mutex };
+	while (true)
+	{
+		m_JobAdded.wait(lock, [this] { return !m_Jobs.empty() || m_IsStopping; });
+		if (m_Jobs.empty())
+			return;
+
+		const ImageJob job{ std::move(m_Jobs.front()) };
+		m_Jobs.pop_front();
+		m_IsWriting = true;
+
+		lock.unlock();
+		m_JobDone.notify_all();
+
+		if (!Encode(job))
+			std::cout << "Could not write " << job.filename << std::endl;
+
+		lock.lock();
+		m_IsWriting = false;
+		m_JobDone.notify_all();
+	}
+}
+
+bool ImageWriter::Encode(const ImageJob& job)
+{
+	ByteBuffer encoded{};
+	if (job.format == ImageFormat::PFM)
+	{
+		encoded = EncodePFM(job.colors, job.width, job.height);
+	}
+	else
+	{
+		const ByteBuffer rgb{ UnpackRGB(job.pixels, job.surfaceFormat) };
+		switch (job.format)
+		{
+		case ImageFormat::BMP:
+			encoded = EncodeBMP(rgb, job.width, job.height);
+			break;
+		case ImageFormat::PPM:
+			encoded = EncodePPM(rgb, job.width, job.height);
+			break;
+		case ImageFormat::PNG:
+			encoded = EncodePNG(rgb, job.width, job.height);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	std::ofstream file{ job.filename, std::ios::binary };
+	file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+	return file.good();
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Math.h"
+#include "ToneMapping.h"
+
+namespace dae
+{
+	enum class ImageFormat
+	{
+		BMP,
+		PPM,
+		PNG,
+		//Float RGB, written from the HDR colors before tonemapping
+		PFM
+	};
+
+	//Encodes and writes images on a background thread
+	//Callers hand over a copy of their pixels and only block when more than maxQueuedImages are still waiting
+	class ImageWriter final
+	{
+	public:
+		explicit ImageWriter(size_t maxQueuedImages = 4);
+		~ImageWriter();
+
+		ImageWriter(const ImageWriter&) = delete;
+		ImageWriter(ImageWriter&&) noexcept = delete;
+		ImageWriter& operator=(const ImageWriter&) = delete;
+		ImageWriter& operator=(ImageWriter&&) noexcept = delete;
+
+		static const char* GetExtension(ImageFormat format);
+		static bool ParseFormat(const std::string& name, ImageFormat& format);
+
+		//"<baseName>_<n>.<extension>", n counts up with every call
+		std::string GetNextSequenceFilename(const std::string& baseName, ImageFormat format);
+
+		//Packed 8 bit pixels, used for every format except PFM
+		void Write(const std::string& filename, ImageFormat format, int width, int height, std::vector<uint32_t>&& pixels, const ToneMappingUtils::SurfaceFormat& surfaceFormat);
+		//HDR colors, used for PFM
+		void Write(const std::string& filename, int width, int height, std::vector<ColorRGB>&& colors);
+
+		//Blocks until everything queued so far is on disk
+		void Flush();
+
+	private:
+		struct ImageJob
+		{
+			std::string filename{};
+			ImageFormat format{};
+			int width{};
+			int height{};
+			std::vector<uint32_t> pixels{};
+			std::vector<ColorRGB> colors{};
+			ToneMappingUtils::SurfaceFormat surfaceFormat{};
+		};
+
+		void Enqueue(ImageJob&& job);
+		void Run();
+		static bool Encode(const ImageJob& job);
+
+		const size_t m_MaxQueuedImages{};
+		uint32_t m_NextSequenceNumber{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_JobAdded{};
+		std::condition_variable m_JobDone{};
+		std::deque<ImageJob> m_Jobs{};
+		bool m_IsWriting{ false };
+		bool m_IsStopping{ false };
+
+		std::thread m_Thread{};
+	};
+}
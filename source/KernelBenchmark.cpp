@@ -0,0 +1,367 @@
+#include "KernelBenchmark.h"
+#include "Material.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+	constexpr int g_NumRepeats{ 5 };
+	//Fractions of the rays that are aimed at the primitive, the rest is aimed past it
+	constexpr float g_AimedFractions[]{ 0.f, .5f, 1.f };
+	constexpr TriangleCullMode g_CullModes[]{ TriangleCullMode::BackFaceCulling, TriangleCullMode::FrontFaceCulling, TriangleCullMode::NoCulling };
+	constexpr const char* g_CullModeNames[]{ "back-face culling", "front-face culling", "no culling" };
+	//Primitives sit around here, rays start in a box of size 2 around the origin
+	constexpr Vector3 g_PrimitiveCenter{ 0.f, 0.f, 10.f };
+	//Rings and segments of the sphere the mesh tests use, about a thousand triangles
+	constexpr int g_MeshRings{ 16 };
+	constexpr int g_MeshSegments{ 32 };
+
+	class SampleGenerator final
+	{
+	public:
+		float GetUniform(float min, float max)
+		{
+			return std::uniform_real_distribution<float>{ min, max }(m_Random);
+		}
+
+		bool GetChance(float probability)
+		{
+			return GetUniform(0.f, 1.f) < probability;
+		}
+
+		Vector3 GetInBox()
+		{
+			return { GetUniform(-1.f, 1.f), GetUniform(-1.f, 1.f), GetUniform(-1.f, 1.f) };
+		}
+
+		Vector3 GetInUnitBall()
+		{
+			while (true)
+			{
+				const Vector3 point{ GetInBox() };
+				if (point.SqrMagnitude() <= 1.f)
+					return point;
+			}
+		}
+
+		Vector3 GetUnitVector()
+		{
+			while (true)
+			{
+				const Vector3 point{ GetInBox() };
+				const float squaredMagnitude{ point.SqrMagnitude() };
+				if (squaredMagnitude > 1e-4f && squaredMagnitude <= 1.f)
+					return point.Normalized();
+			}
+		}
+
+		//Unit vector on the side normal points to
+		Vector3 GetInHemisphere(const Vector3& normal)
+		{
+			const Vector3 direction{ GetUnitVector() };
+			return Vector3::Dot(direction, normal) < 0.f ? -direction : direction;
+		}
+
+	private:
+		std::mt19937 m_Random{ 42 };
+	};
+
+	struct Measurement
+	{
+		double nanosecondsPerCall{};
+		double callsPerCycle{};
+	};
+
+	//Best of a few runs over all samples, kernel(i) returns a float that is summed into a volatile so the calls can not
+	//be optimized away
+	template<typename Kernel>
+	Measurement Measure(size_t numSamples, const Kernel& kernel)
+	{
+		float sum{};
+		double bestSeconds{ DBL_MAX };
+		uint64_t bestCycles{ UINT64_MAX };
+		for (int repeat{}; repeat < g_NumRepeats; ++repeat)
+		{
+			const auto start{ std::chrono::steady_clock::now() };
+			const uint64_t startCycles{ __rdtsc() };
+			for (size_t i{}; i < numSamples; ++i)
+			{
+				sum += kernel(i);
+			}
+			const uint64_t cycles{ __rdtsc() - startCycles };
+			bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+			bestCycles = std::min(bestCycles, cycles);
+		}
+		volatile float result{ sum };
+		(void)result;
+		return { bestSeconds * 1e9 / numSamples, static_cast<double>(numSamples) / std::max<uint64_t>(bestCycles, 1) };
+	}
+
+	void PrintMeasurement(const std::string& name, const Measurement& measurement)
+	{
+		std::cout << "  " << std::left << std::setw(64) << name << std::right << std::fixed
+			<< std::setprecision(2) << std::setw(9) << measurement.nanosecondsPerCall << " ns/op"
+			<< std::setprecision(3) << std::setw(9) << measurement.callsPerCycle << " ops/cycle";
+		std::cout.copyfmt(std::ios{ nullptr });
+	}
+
+	//The rays that start on the far side of a primitive, only the triangle tests use them to see both faces
+	Vector3 GetRayOrigin(SampleGenerator& generator, bool isFromBothSides)
+	{
+		const Vector3 origin{ generator.GetInBox() };
+		return isFromBothSides && generator.GetChance(.5f) ? origin + Vector3::UnitZ * 20.f : origin;
+	}
+
+	//getTarget(origin, isAimed) returns the point the ray goes through
+	template<typename GetTarget>
+	std::vector<Ray> CreateRays(SampleGenerator& generator, size_t numRays, float aimedFraction, bool isFromBothSides, const GetTarget& getTarget)
+	{
+		std::vector<Ray> rays(numRays);
+		for (Ray& ray : rays)
+		{
+			ray.origin = GetRayOrigin(generator, isFromBothSides);
+			ray.direction = (getTarget(ray.origin, generator.GetChance(aimedFraction)) - ray.origin).Normalized();
+		}
+		return rays;
+	}
+
+	//A point that is between 1.5 and 3 radii away from the line from origin through center
+	Vector3 GetTargetBeside(SampleGenerator& generator, const Vector3& origin, const Vector3& center, float radius)
+	{
+		const Vector3 toCenter{ (center - origin).Normalized() };
+		while (true)
+		{
+			const Vector3 direction{ generator.GetUnitVector() };
+			const Vector3 side{ direction - toCenter * Vector3::Dot(direction, toCenter) };
+			if (side.SqrMagnitude() > 1e-2f)
+				return center + side.Normalized() * (radius * generator.GetUniform(1.5f, 3.f));
+		}
+	}
+
+	std::string GetAimedName(const std::string& name, float aimedFraction)
+	{
+		return name + ", " + std::to_string(static_cast<int>(aimedFraction * 100.f)) + "% aimed";
+	}
+
+	template<typename Primitive, typename HitTest>
+	void RunHitTest(const std::string& name, const Primitive& primitive, const std::vector<Ray>& rays, const HitTest& hitTest)
+	{
+		size_t numHits{};
+		for (const Ray& ray : rays)
+		{
+			HitRecord hitRecord{};
+			if (hitTest(primitive, ray, hitRecord))
+				++numHits;
+		}
+
+		const Measurement measurement{ Measure(rays.size(), [&](size_t i)
+			{
+				HitRecord hitRecord{};
+				return hitTest(primitive, rays[i], hitRecord) ? hitRecord.t : 0.f;
+			}) };
+		PrintMeasurement(name, measurement);
+		std::cout << std::setw(7) << static_cast<int>(100.f * numHits / rays.size() + .5f) << "% hits" << std::endl;
+	}
+
+	//Sphere around g_PrimitiveCenter with outward facing triangles, the poles without their degenerate halves
+	TriangleMesh CreateSphereMesh(float radius, TriangleCullMode cullMode)
+	{
+		std::vector<Vector3> positions{};
+		for (int ring{}; ring <= g_MeshRings; ++ring)
+		{
+			const float theta{ PI * ring / g_MeshRings };
+			for (int segment{}; segment <= g_MeshSegments; ++segment)
+			{
+				const float phi{ 2.f * PI * segment / g_MeshSegments };
+				positions.push_back(Vector3{ sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) } * radius);
+			}
+		}
+
+		std::vector<int> indices{};
+		const auto getIndex{ [](int ring, int segment) { return ring * (g_MeshSegments + 1) + segment; } };
+		for (int ring{}; ring < g_MeshRings; ++ring)
+		{
+			for (int segment{}; segment < g_MeshSegments; ++segment)
+			{
+				if (ring > 0)
+					indices.insert(indices.end(), { getIndex(ring, segment), getIndex(ring, segment + 1), getIndex(ring + 1, segment) });
+				if (ring < g_MeshRings - 1)
+					indices.insert(indices.end(), { getIndex(ring, segment + 1), getIndex(ring + 1, segment + 1), getIndex(ring + 1, segment) });
+			}
+		}
+
+		TriangleMesh mesh{ positions, indices, cullMode };
+		mesh.Translate(g_PrimitiveCenter);
+		mesh.UpdateTransforms();
+		return mesh;
+	}
+
+	void RunHitTests(size_t numSamples, const auto& isSelected)
+	{
+		SampleGenerator generator{};
+
+		const Sphere sphere{ g_PrimitiveCenter, 1.f };
+		for (const float aimedFraction : g_AimedFractions)
+		{
+			const std::string name{ GetAimedName("HitTest_Sphere", aimedFraction) };
+			if (!isSelected(name))
+				continue;
+
+			const std::vector<Ray> rays{ CreateRays(generator, numSamples, aimedFraction, false, [&](const Vector3& origin, bool isAimed)
+				{
+					return isAimed ? sphere.origin + generator.GetInUnitBall() * (sphere.radius * .9f) : GetTargetBeside(generator, origin, sphere.origin, sphere.radius);
+				}) };
+			RunHitTest(name, sphere, rays, [](const Sphere& sphere, const Ray& ray, HitRecord& hitRecord) { return GeometryUtils::HitTest_Sphere(sphere, ray, hitRecord); });
+		}
+
+		//Tilted towards the rays; a ray that is not aimed at it goes the other way
+		const Plane plane{ g_PrimitiveCenter, Vector3{ .2f, .1f, -1.f }.Normalized() };
+		for (const float aimedFraction : g_AimedFractions)
+		{
+			const std::string name{ GetAimedName("HitTest_Plane", aimedFraction) };
+			if (!isSelected(name))
+				continue;
+
+			const std::vector<Ray> rays{ CreateRays(generator, numSamples, aimedFraction, false, [&](const Vector3& origin, bool isAimed)
+				{
+					const Vector3 offset{ generator.GetInBox() * 5.f };
+					const Vector3 target{ plane.origin + offset - plane.normal * Vector3::Dot(offset, plane.normal) };
+					return isAimed ? target : origin * 2.f - target;
+				}) };
+			RunHitTest(name, plane, rays, [](const Plane& plane, const Ray& ray, HitRecord& hitRecord) { return GeometryUtils::HitTest_Plane(plane, ray, hitRecord); });
+		}
+
+		//Rays come from both sides, so the cull modes see both faces; aimed rays go through the inside of the triangle,
+		//the others through its plane outside of it
+		Triangle triangle{ g_PrimitiveCenter + Vector3{ -1.f, -1.f, .2f }, g_PrimitiveCenter + Vector3{ 1.f, -.8f, -.1f }, g_PrimitiveCenter + Vector3{ .1f, 1.f, 0.f } };
+		const Vector3 edge1{ triangle.v1 - triangle.v0 };
+		const Vector3 edge2{ triangle.v2 - triangle.v0 };
+		for (size_t cullModeIndex{}; cullModeIndex < std::size(g_CullModes); ++cullModeIndex)
+		{
+			triangle.cullMode = g_CullModes[cullModeIndex];
+			for (const float aimedFraction : g_AimedFractions)
+			{
+				const std::string name{ GetAimedName(std::string{ "HitTest_Triangle, " } + g_CullModeNames[cullModeIndex], aimedFraction) };
+				if (!isSelected(name))
+					continue;
+
+				const std::vector<Ray> rays{ CreateRays(generator, numSamples, aimedFraction, true, [&](const Vector3&, bool isAimed)
+					{
+						float u{ generator.GetUniform(0.f, 1.f) };
+						float v{ generator.GetUniform(0.f, 1.f) };
+						if (!isAimed)
+							return triangle.v0 + edge1 * (u + .6f) + edge2 * (v + .6f);
+						if (u + v > 1.f)
+						{
+							u = 1.f - u;
+							v = 1.f - v;
+						}
+						return triangle.v0 + edge1 * u + edge2 * v;
+					}) };
+				RunHitTest(name, triangle, rays, [](const Triangle& triangle, const Ray& ray, HitRecord& hitRecord) { return GeometryUtils::HitTest_Triangle(triangle, ray, hitRecord); });
+			}
+		}
+
+		for (size_t cullModeIndex{}; cullModeIndex < std::size(g_CullModes); ++cullModeIndex)
+		{
+			const TriangleMesh mesh{ CreateSphereMesh(1.f, g_CullModes[cullModeIndex]) };
+			for (const float aimedFraction : g_AimedFractions)
+			{
+				const std::string name{ GetAimedName(std::string{ "HitTest_TriangleMesh, " } + g_CullModeNames[cullModeIndex], aimedFraction) };
+				if (!isSelected(name))
+					continue;
+
+				const std::vector<Ray> rays{ CreateRays(generator, numSamples, aimedFraction, false, [&](const Vector3& origin, bool isAimed)
+					{
+						return isAimed ? g_PrimitiveCenter + generator.GetInUnitBall() * .9f : GetTargetBeside(generator, origin, g_PrimitiveCenter, 1.f);
+					}) };
+				RunHitTest(name, mesh, rays, [](const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord) { return GeometryUtils::HitTest_TriangleMesh(mesh, ray, hitRecord); });
+			}
+		}
+	}
+
+	//Light and view direction in the hemisphere of the normal, as shading sees them
+	struct ShadingSample
+	{
+		HitRecord hitRecord{};
+		Vector3 l{};
+		Vector3 v{};
+		Vector3 h{};
+		float roughness{};
+		float phongExponent{};
+		ColorRGB f0{};
+	};
+
+	void RunShadingKernels(size_t numSamples, const auto& isSelected)
+	{
+		SampleGenerator generator{};
+		std::vector<ShadingSample> samples(numSamples);
+		for (ShadingSample& sample : samples)
+		{
+			sample.hitRecord.normal = generator.GetUnitVector();
+			sample.hitRecord.didHit = true;
+			sample.l = generator.GetInHemisphere(sample.hitRecord.normal);
+			sample.v = generator.GetInHemisphere(sample.hitRecord.normal);
+			sample.h = (sample.l + sample.v).Normalized();
+			sample.roughness = generator.GetUniform(.05f, 1.f);
+			sample.phongExponent = generator.GetUniform(1.f, 100.f);
+			sample.f0 = { generator.GetUniform(.04f, 1.f), generator.GetUniform(.04f, 1.f), generator.GetUniform(.04f, 1.f) };
+		}
+
+		const auto run{ [&](const char* pName, const auto& kernel)
+			{
+				if (!isSelected(pName))
+					return;
+				PrintMeasurement(pName, Measure(numSamples, [&](size_t i) { return kernel(samples[i]); }));
+				std::cout << std::endl;
+			} };
+		const auto sumColor{ [](const ColorRGB& color) { return color.r + color.g + color.b; } };
+
+		run("BRDF::Lambert", [&](const ShadingSample& s) { return sumColor(BRDF::Lambert(s.roughness, s.f0)); });
+		run("BRDF::Phong", [&](const ShadingSample& s) { return sumColor(BRDF::Phong(.5f, s.phongExponent, s.l, s.v, s.hitRecord.normal)); });
+		run("BRDF::FresnelFunction_Schlick", [&](const ShadingSample& s) { return sumColor(BRDF::FresnelFunction_Schlick(s.h, s.v, s.f0)); });
+		run("BRDF::NormalDistribution_GGX", [&](const ShadingSample& s) { return BRDF::NormalDistribution_GGX(s.hitRecord.normal, s.h, s.roughness); });
+		run("BRDF::GeometryFunction_SchlickGGX", [&](const ShadingSample& s) { return BRDF::GeometryFunction_SchlickGGX(s.hitRecord.normal, s.v, s.roughness); });
+		run("BRDF::GeometryFunction_Smith", [&](const ShadingSample& s) { return BRDF::GeometryFunction_Smith(s.hitRecord.normal, s.v, s.l, s.roughness); });
+
+		//Through a Material pointer, the way the renderer calls them
+		Material_SolidColor solidColor{ colors::Red };
+		Material_Lambert lambert{ { .49f, .57f, .57f }, 1.f };
+		Material_LambertPhong lambertPhong{ colors::Blue, .5f, .5f, 60.f };
+		Material_CookTorrence cookTorrence{ { .972f, .960f, .915f }, 1.f, .6f };
+		const std::vector<Material*> materials{ &solidColor, &lambert, &lambertPhong, &cookTorrence };
+		const auto runMaterial{ [&](const char* pName, size_t materialIndex)
+			{
+				Material* pMaterial{ materials[materialIndex] };
+				run(pName, [&](const ShadingSample& s) { return sumColor(pMaterial->Shade(s.hitRecord, s.l, s.v)); });
+			} };
+		runMaterial("Material_SolidColor::Shade", 0);
+		runMaterial("Material_Lambert::Shade", 1);
+		runMaterial("Material_LambertPhong::Shade", 2);
+		runMaterial("Material_CookTorrence::Shade", 3);
+	}
+}
+
+void KernelBenchmark::Run(size_t numSamples, const std::string& filter)
+{
+	const auto isSelected{ [&filter](const std::string& name) { return name.find(filter) != std::string::npos; } };
+
+	std::cout << "Best of " << g_NumRepeats << " runs over " << numSamples << " samples per kernel" << std::endl;
+	RunHitTests(numSamples, isSelected);
+	RunShadingKernels(numSamples, isSelected);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	//Times the hot functions of a render one at a time: RayTracer --benchmark-kernels [numSamples] [filter]
+	//Every kernel runs over numSamples inputs drawn from a seeded generator, so runs on the same machine compare.
+	//The hit tests get rays where none, half or all are aimed at the primitive, triangles and meshes once per cull
+	//mode; the BRDFs and Material::Shade get random unit vectors in the hemisphere of the normal.
+	namespace KernelBenchmark
+	{
+		//Prints ns per call and calls per cycle for every kernel whose name contains filter (all when empty), and for
+		//the hit tests the fraction of calls that hit. Cycles are those of the time-stamp counter, which runs at the
+		//nominal clock rate of the CPU whatever its current one.
+		void Run(size_t numSamples, const std::string& filter);
+	}
+}
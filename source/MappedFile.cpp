@@ -0,0 +1,165 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	const HANDLE file{ CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_File = file;
+	m_Size = static_cast<size_t>(size.QuadPart);
+	if (m_Size == 0)
+		return true;
+
+	m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_Mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_Mapping)
+		CloseHandle(m_Mapping);
+	if (m_File)
+		CloseHandle(m_File);
+
+	m_pData = nullptr;
+	m_Mapping = nullptr;
+	m_File = nullptr;
+	m_Size = 0;
+}
+
+void MappedFile::AdviseWillNeed(size_t offset, size_t size) const
+{
+	if (!m_pData || offset >= m_Size)
+		return;
+
+	WIN32_MEMORY_RANGE_ENTRY range{ const_cast<char*>(m_pData) + offset, std::min(size, m_Size - offset) };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void MappedFile::AdviseDontNeed(size_t offset, size_t size) const
+{
+	if (!m_pData || offset >= m_Size)
+		return;
+
+	//Unlocking pages that are not locked takes them out of the working set, which is what DontNeed means here
+	VirtualUnlock(const_cast<char*>(m_pData) + offset, std::min(size, m_Size - offset));
+}
+#else
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	const int file{ open(filename.c_str(), O_RDONLY | O_CLOEXEC) };
+	if (file < 0)
+		return false;
+
+	struct stat status{};
+	if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode))
+	{
+		close(file);
+		return false;
+	}
+
+	m_Size = static_cast<size_t>(status.st_size);
+	if (m_Size == 0)
+	{
+		close(file);
+		return true;
+	}
+
+	void* pMapping{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0) };
+	//The mapping keeps its own reference to the file
+	close(file);
+
+	if (pMapping == MAP_FAILED)
+	{
+		m_Size = 0;
+		return false;
+	}
+
+	//The whole file is about to be parsed, start reading it in right away
+	madvise(pMapping, m_Size, MADV_WILLNEED);
+
+	m_pData = static_cast<const char*>(pMapping);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_Size);
+
+	m_pData = nullptr;
+	m_Size = 0;
+}
+
+void MappedFile::AdviseWillNeed(size_t offset, size_t size) const
+{
+	if (!m_pData || offset >= m_Size)
+		return;
+
+	//madvise wants a page aligned start
+	const size_t pageSize{ static_cast<size_t>(sysconf(_SC_PAGESIZE)) };
+	const size_t start{ offset / pageSize * pageSize };
+	madvise(const_cast<char*>(m_pData) + start, std::min(size, m_Size - offset) + offset - start, MADV_WILLNEED);
+}
+
+void MappedFile::AdviseDontNeed(size_t offset, size_t size) const
+{
+	if (!m_pData || offset >= m_Size)
+		return;
+
+	//Only whole pages inside the range, neighbouring data keeps its pages
+	const size_t pageSize{ static_cast<size_t>(sysconf(_SC_PAGESIZE)) };
+	const size_t start{ (offset + pageSize - 1) / pageSize * pageSize };
+	const size_t end{ offset + std::min(size, m_Size - offset) };
+	const size_t alignedEnd{ end == m_Size ? end : end / pageSize * pageSize };
+	if (alignedEnd > start)
+		madvise(const_cast<char*>(m_pData) + start, alignedEnd - start, MADV_DONTNEED);
+}
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	//Read-only view of a whole file, mapped into memory instead of copied
+	//Pages are loaded by the OS on first touch, so several threads can read different parts at full speed
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		//An empty file opens fine, with a null data pointer and a size of 0
+		bool Open(const std::string& filename);
+		void Close();
+
+		//Hints for the OS about a byte range of the mapping, the data stays valid either way
+		//WillNeed starts reading the range in ahead of use, DontNeed lets the OS drop its pages (they reload on the next touch)
+		void AdviseWillNeed(size_t offset, size_t size) const;
+		void AdviseDontNeed(size_t offset, size_t size) const;
+
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{};
+		size_t m_Size{};
+
+#if defined(_WIN32)
+		void* m_File{};
+		void* m_Mapping{};
+#endif
+	};
+}
@@ -25,6 +25,18 @@ namespace dae
 		 * \return color
 		 */
 		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+
+		/**
+		 * \brief Base color of the surface, used by the denoiser to keep shading and texture apart
+		 * \return albedo
+		 */
+		virtual ColorRGB GetAlbedo() const { return colors::White; }
+
+		/**
+		 * \brief Whether Shade depends on the view direction, such shading can not be reused from another viewpoint
+		 * \return true unless the material says otherwise
+		 */
+		virtual bool IsViewDependent() const { return true; }
 	};
 #pragma endregion
 
@@ -43,6 +55,16 @@ namespace dae
 			return m_Color;
 		}
 
+		ColorRGB GetAlbedo() const override
+		{
+			return m_Color;
+		}
+
+		bool IsViewDependent() const override
+		{
+			return false;
+		}
+
 	private:
 		ColorRGB m_Color{ colors::White };
 	};
@@ -62,6 +84,16 @@ namespace dae
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
 		}
 
+		ColorRGB GetAlbedo() const override
+		{
+			return m_DiffuseColor;
+		}
+
+		bool IsViewDependent() const override
+		{
+			return false;
+		}
+
 	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 1.f }; //kd
@@ -87,6 +119,11 @@ namespace dae
 				+ BRDF::Phong(m_SpecularReflectance, m_PhongExponent,l, v, hitRecord.normal);
 		}
 
+		ColorRGB GetAlbedo() const override
+		{
+			return m_DiffuseColor;
+		}
+
 	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 0.5f }; //kd
@@ -131,6 +168,11 @@ namespace dae
 			return diffuse + specular;
 		}
 
+		ColorRGB GetAlbedo() const override
+		{
+			return m_Albedo;
+		}
+
 	private:
 		ColorRGB m_Albedo{ 0.955f, 0.637f, 0.538f }; //Copper
 		float m_Metalness{ 1.0f };
@@ -0,0 +1,334 @@
+#include "MathBenchmark.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace dae;
+
+#if defined(_MSC_VER)
+#define DAE_NOINLINE __declspec(noinline)
+#else
+#define DAE_NOINLINE __attribute__((noinline))
+#endif
+
+namespace
+{
+	constexpr size_t g_NumSpheres{ 16 };
+	constexpr size_t g_NumPlanes{ 4 };
+	constexpr size_t g_NumTriangles{ 64 };
+
+	//The Vector3 and Matrix operations as they were compiled before the math core moved into the headers: every call
+	//crosses a translation unit, so without link-time code generation none of them was inlined
+	namespace Legacy
+	{
+		DAE_NOINLINE Vector3 Add(const Vector3& v1, const Vector3& v2)
+		{
+			return { v1.x + v2.x, v1.y + v2.y, v1.z + v2.z };
+		}
+
+		DAE_NOINLINE Vector3 Subtract(const Vector3& v1, const Vector3& v2)
+		{
+			return { v1.x - v2.x, v1.y - v2.y, v1.z - v2.z };
+		}
+
+		DAE_NOINLINE Vector3 Scale(const Vector3& v, float scale)
+		{
+			return { v.x * scale, v.y * scale, v.z * scale };
+		}
+
+		DAE_NOINLINE Vector3 Divide(const Vector3& v, float scale)
+		{
+			return { v.x / scale, v.y / scale, v.z / scale };
+		}
+
+		DAE_NOINLINE float Dot(const Vector3& v1, const Vector3& v2)
+		{
+			return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+		}
+
+		DAE_NOINLINE Vector3 Cross(const Vector3& v1, const Vector3& v2)
+		{
+			return { v1.y * v2.z - v2.y * v1.z, -(v1.x * v2.z - v2.x * v1.z), v1.x * v2.y - v2.x * v1.y };
+		}
+
+		DAE_NOINLINE Vector3 Normalized(const Vector3& v)
+		{
+			const float m = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+			return { v.x / m, v.y / m, v.z / m };
+		}
+
+		DAE_NOINLINE Vector4 Row(const Matrix& m, int index)
+		{
+			return m[index];
+		}
+
+		DAE_NOINLINE Vector3 TransformVector(const Matrix& m, const Vector3& v)
+		{
+			const Vector4 row0{ Row(m, 0) };
+			const Vector4 row1{ Row(m, 1) };
+			const Vector4 row2{ Row(m, 2) };
+			return {
+				row0.x * v.x + row1.x * v.y + row2.x * v.z,
+				row0.y * v.x + row1.y * v.y + row2.y * v.z,
+				row0.z * v.x + row1.z * v.y + row2.z * v.z
+			};
+		}
+
+		DAE_NOINLINE Vector3 TransformPoint(const Matrix& m, const Vector3& p)
+		{
+			const Vector4 row0{ Row(m, 0) };
+			const Vector4 row1{ Row(m, 1) };
+			const Vector4 row2{ Row(m, 2) };
+			const Vector4 row3{ Row(m, 3) };
+			return {
+				row0.x * p.x + row1.x * p.y + row2.x * p.z + row3.x,
+				row0.y * p.x + row1.y * p.y + row2.y * p.z + row3.y,
+				row0.z * p.x + row1.z * p.y + row2.z * p.z + row3.z
+			};
+		}
+
+		//GeometryUtils::HitTest_Sphere, HitTest_Plane and HitTest_Triangle written against the calls above
+		bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord)
+		{
+			const float a{ Dot(ray.direction, ray.direction) };
+			const Vector3 rayMinusSphere{ Subtract(ray.origin, sphere.origin) };
+			const float b{ Dot(Scale(ray.direction, 2), rayMinusSphere) };
+			const float c{ Dot(rayMinusSphere, rayMinusSphere) - (sphere.radius * sphere.radius) };
+
+			const float D{ (b * b) - (4 * a * c) };
+			if (D < 0)
+			{
+				hitRecord.didHit = false;
+				return false;
+			}
+
+			float t{ (-b - sqrtf(D)) / (2 * a) };
+			if (t > ray.max || t < ray.min)
+			{
+				t = (-b + sqrtf(D)) / (2 * a);
+				if (t > ray.max || t < ray.min)
+				{
+					hitRecord.didHit = false;
+					return false;
+				}
+			}
+
+			hitRecord.origin = Add(ray.origin, Scale(ray.direction, t));
+			hitRecord.materialIndex = sphere.materialIndex;
+			hitRecord.normal = Normalized(Subtract(hitRecord.origin, sphere.origin));
+			hitRecord.didHit = true;
+			hitRecord.t = t;
+			return true;
+		}
+
+		bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord)
+		{
+			const float t{ Dot(Subtract(plane.origin, ray.origin), plane.normal) / Dot(ray.direction, plane.normal) };
+			if (t > ray.min && t < ray.max)
+			{
+				hitRecord.origin = Add(ray.origin, Scale(ray.direction, t));
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = plane.materialIndex;
+				hitRecord.normal = plane.normal;
+				hitRecord.t = t;
+				return true;
+			}
+			hitRecord.didHit = false;
+			return false;
+		}
+
+		bool IsOnSameSide(const Vector3& side, const Vector3& pointToSide, const Triangle& triangle)
+		{
+			return Dot(triangle.normal, Cross(side, pointToSide)) >= 0.f;
+		}
+
+		bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord)
+		{
+			const Vector3 triangleCenter{ Divide(Add(Add(triangle.v0, triangle.v1), triangle.v2), 3.f) };
+
+			if (AreEqual(Dot(triangle.normal, ray.direction), .0f))
+			{
+				hitRecord.didHit = false;
+				return false;
+			}
+
+			const float normalDotDirection{ Dot(triangle.normal, ray.direction) };
+			if (triangle.cullMode == TriangleCullMode::FrontFaceCulling && normalDotDirection < 0.f)
+			{
+				hitRecord.didHit = false;
+				return false;
+			}
+			if (triangle.cullMode == TriangleCullMode::BackFaceCulling && normalDotDirection > 0.f)
+			{
+				hitRecord.didHit = false;
+				return false;
+			}
+
+			const float t{ Dot(Subtract(triangleCenter, ray.origin), triangle.normal) / Dot(ray.direction, triangle.normal) };
+			if (t < ray.min || t > ray.max)
+			{
+				hitRecord.didHit = false;
+				return false;
+			}
+
+			const Vector3 intersection{ Add(ray.origin, Scale(ray.direction, t)) };
+
+			if (!IsOnSameSide(Subtract(triangle.v1, triangle.v0), Subtract(intersection, triangle.v0), triangle))
+				return false;
+
+			if (!IsOnSameSide(Subtract(triangle.v2, triangle.v1), Subtract(intersection, triangle.v1), triangle))
+				return false;
+
+			if (!IsOnSameSide(Subtract(triangle.v0, triangle.v2), Subtract(intersection, triangle.v2), triangle))
+				return false;
+
+			hitRecord.origin = intersection;
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = triangle.materialIndex;
+			hitRecord.normal = triangle.normal;
+			hitRecord.t = t;
+			return true;
+		}
+
+		//The instance step of the mesh tests: the ray into the mesh's object space
+		bool ToObjectSpace(const Matrix& inverseTransform, const Ray& ray, Ray& objectRay)
+		{
+			objectRay.origin = TransformPoint(inverseTransform, ray.origin);
+			objectRay.direction = TransformVector(inverseTransform, ray.direction);
+			return objectRay.direction.x > 0.f;
+		}
+	}
+
+	bool ToObjectSpace(const Matrix& inverseTransform, const Ray& ray, Ray& objectRay)
+	{
+		objectRay.origin = inverseTransform.TransformPoint(ray.origin);
+		objectRay.direction = inverseTransform.TransformVector(ray.direction);
+		return objectRay.direction.x > 0.f;
+	}
+
+	//Hits and the sum of their distances, both versions have to agree on them exactly
+	struct Result
+	{
+		size_t numHits{};
+		double sumT{};
+
+		bool operator==(const Result& other) const
+		{
+			return numHits == other.numHits && sumT == other.sumT;
+		}
+	};
+
+	//Every ray against every primitive, best of a few runs; returns million tests per second
+	template<typename Primitive, typename HitTest>
+	float Measure(const std::vector<Ray>& rays, const std::vector<Primitive>& primitives, HitTest&& hitTest, Result& result)
+	{
+		float bestSeconds{ FLT_MAX };
+		for (int repeat{}; repeat < 5; ++repeat)
+		{
+			result = {};
+			const auto start{ std::chrono::steady_clock::now() };
+			for (const Ray& ray : rays)
+			{
+				for (const Primitive& primitive : primitives)
+				{
+					HitRecord hitRecord{};
+					if (hitTest(primitive, ray, hitRecord))
+					{
+						++result.numHits;
+						result.sumT += hitRecord.t;
+					}
+				}
+			}
+			bestSeconds = std::min(bestSeconds, std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
+		}
+		return rays.size() * primitives.size() / bestSeconds / 1'000'000.f;
+	}
+
+	template<typename Primitive, typename LegacyHitTest, typename HitTest>
+	void Compare(const char* pName, const std::vector<Ray>& rays, const std::vector<Primitive>& primitives,
+		LegacyHitTest&& legacyHitTest, HitTest&& hitTest)
+	{
+		Result legacyResult{};
+		Result result{};
+		const float legacyRate{ Measure(rays, primitives, legacyHitTest, legacyResult) };
+		const float rate{ Measure(rays, primitives, hitTest, result) };
+
+		std::cout << "  " << pName << legacyRate << " -> " << rate << " Mtests/s (" << rate / legacyRate << "x)"
+			<< (legacyResult == result ? "" : ", RESULTS DIFFER") << std::endl;
+	}
+}
+
+void MathBenchmark::Run(size_t numRays)
+{
+	std::mt19937 random{ 42 };
+	std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+	const auto randomVector{ [&]() { return Vector3{ distribution(random), distribution(random), distribution(random) }; } };
+
+	//Rays from around the origin into a box of primitives
+	std::vector<Ray> rays(numRays);
+	for (Ray& ray : rays)
+	{
+		ray.origin = randomVector();
+		ray.direction = Vector3{ randomVector() + Vector3::UnitZ * 2.f }.Normalized();
+	}
+
+	std::vector<Sphere> spheres(g_NumSpheres);
+	for (Sphere& sphere : spheres)
+	{
+		sphere.origin = randomVector() * 5.f + Vector3::UnitZ * 10.f;
+		sphere.radius = 1.f;
+	}
+
+	std::vector<Plane> planes(g_NumPlanes);
+	for (Plane& plane : planes)
+	{
+		plane.origin = randomVector() * 5.f + Vector3::UnitZ * 10.f;
+		plane.normal = randomVector().Normalized();
+	}
+
+	std::vector<Triangle> triangles(g_NumTriangles);
+	for (Triangle& triangle : triangles)
+	{
+		const Vector3 center{ randomVector() * 5.f + Vector3::UnitZ * 10.f };
+		triangle = Triangle{ center + randomVector(), center + randomVector(), center + randomVector() };
+	}
+
+	std::vector<Matrix> inverseTransforms{};
+	for (size_t i{}; i < g_NumTriangles; ++i)
+	{
+		const Matrix transform{ Matrix::CreateRotationY(distribution(random) * PI) * Matrix::CreateTranslation(randomVector()) };
+		inverseTransforms.push_back(Matrix::Inverse(transform));
+	}
+
+	std::cout << "Testing " << numRays << " rays, out-of-line calls -> header-only math core" << std::endl;
+	Compare("Spheres:         ", rays, spheres,
+		[](const Sphere& sphere, const Ray& ray, HitRecord& hitRecord) { return Legacy::HitTest_Sphere(sphere, ray, hitRecord); },
+		[](const Sphere& sphere, const Ray& ray, HitRecord& hitRecord) { return GeometryUtils::HitTest_Sphere(sphere, ray, hitRecord); });
+	Compare("Planes:          ", rays, planes,
+		[](const Plane& plane, const Ray& ray, HitRecord& hitRecord) { return Legacy::HitTest_Plane(plane, ray, hitRecord); },
+		[](const Plane& plane, const Ray& ray, HitRecord& hitRecord) { return GeometryUtils::HitTest_Plane(plane, ray, hitRecord); });
+	Compare("Triangles:       ", rays, triangles,
+		[](const Triangle& triangle, const Ray& ray, HitRecord& hitRecord) { return Legacy::HitTest_Triangle(triangle, ray, hitRecord); },
+		[](const Triangle& triangle, const Ray& ray, HitRecord& hitRecord) { return GeometryUtils::HitTest_Triangle(triangle, ray, hitRecord); });
+	//The object space ray's origin z stands in for a distance, so the results can be compared like the hit tests
+	Compare("To object space: ", rays, inverseTransforms,
+		[](const Matrix& inverseTransform, const Ray& ray, HitRecord& hitRecord)
+		{
+			Ray objectRay{};
+			const bool isHit{ Legacy::ToObjectSpace(inverseTransform, ray, objectRay) };
+			hitRecord.t = objectRay.origin.z;
+			return isHit;
+		},
+		[](const Matrix& inverseTransform, const Ray& ray, HitRecord& hitRecord)
+		{
+			Ray objectRay{};
+			const bool isHit{ ToObjectSpace(inverseTransform, ray, objectRay) };
+			hitRecord.t = objectRay.origin.z;
+			return isHit;
+		});
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+namespace dae
+{
+	//Compares the header-only math core against the out-of-line Vector3/Matrix calls it replaced
+	//The sphere, plane and triangle hit tests and the ray to object space transform run once against copies of the old
+	//calls that the compiler can not inline and once against the current headers, over the same random rays
+	namespace MathBenchmark
+	{
+		//Prints million ray tests per second for both versions of every kernel and checks they found the same hits
+		void Run(size_t numRays);
+	}
+}
@@ -1,54 +1,276 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include <immintrin.h>
+#include <type_traits>
+
+#include "MathHelpers.h"
 #include "Vector3.h"
 #include "Vector4.h"
 
 namespace dae {
+	//Header-only so transforms inline into the intersection and vertex loops
+	//Products and transforms broadcast each coordinate over a whole row and add the rows in the same order as the scalar
+	//dot products, which keeps the results bit-identical to them
 	struct Matrix
 	{
 		Matrix() = default;
-		Matrix(
+		constexpr Matrix(
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
-			const Vector3& t);
+			const Vector3& t) :
+			Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+		{
+		}
 
-		Matrix(
+		constexpr Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
-			const Vector4& t);
-
-		Matrix(const Matrix& m);
-
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
-		const Matrix& Transpose();
-
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
-
-		static Matrix CreateTranslation(float x, float y, float z);
-		static Matrix CreateTranslation(const Vector3& t);
-		static Matrix CreateRotationX(float pitch);
-		static Matrix CreateRotationY(float yaw);
-		static Matrix CreateRotationZ(float roll);
-		static Matrix CreateRotation(float pitch, float yaw, float roll);
-		static Matrix CreateRotation(const Vector3& r);
-		static Matrix CreateScale(float sx, float sy, float sz);
-		static Matrix CreateScale(const Vector3& s);
-		static Matrix Transpose(const Matrix& m);
-
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
+			const Vector4& t) :
+			data{ xAxis, yAxis, zAxis, t }
+		{
+		}
+
+		constexpr Matrix(const Matrix& m) = default;
+		constexpr Matrix& operator=(const Matrix& m) = default;
+
+		constexpr Vector3 TransformVector(const Vector3& v) const
+		{
+			return TransformVector(v[0], v[1], v[2]);
+		}
+
+		constexpr Vector3 TransformVector(float x, float y, float z) const
+		{
+			if (std::is_constant_evaluated())
+			{
+				return Vector3{
+					data[0].x * x + data[1].x * y + data[2].x * z,
+					data[0].y * x + data[1].y * y + data[2].y * z,
+					data[0].z * x + data[1].z * y + data[2].z * z
+				};
+			}
+
+			return Vector4::Store(CombineRows(_mm_set1_ps(x), _mm_set1_ps(y), _mm_set1_ps(z)));
+		}
+
+		constexpr Vector3 TransformPoint(const Vector3& p) const
+		{
+			return TransformPoint(p[0], p[1], p[2]);
+		}
+
+		constexpr Vector3 TransformPoint(float x, float y, float z) const
+		{
+			if (std::is_constant_evaluated())
+			{
+				return Vector3{
+					data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+					data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+					data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+				};
+			}
+
+			return Vector4::Store(_mm_add_ps(CombineRows(_mm_set1_ps(x), _mm_set1_ps(y), _mm_set1_ps(z)), data[3].Load()));
+		}
+
+		const Matrix& Transpose()
+		{
+			__m128 row0{ data[0].Load() };
+			__m128 row1{ data[1].Load() };
+			__m128 row2{ data[2].Load() };
+			__m128 row3{ data[3].Load() };
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+			data[0] = Vector4::Store(row0);
+			data[1] = Vector4::Store(row1);
+			data[2] = Vector4::Store(row2);
+			data[3] = Vector4::Store(row3);
+
+			return *this;
+		}
+
+		//Affine inverse, the last column is assumed to be (0, 0, 0, 1)
+		const Matrix& Inverse()
+		{
+			const Vector3 xAxis{ GetAxisX() };
+			const Vector3 yAxis{ GetAxisY() };
+			const Vector3 zAxis{ GetAxisZ() };
+			const Vector3 translation{ GetTranslation() };
+
+			//Columns of the inverse 3x3 part are the cross products of its rows, divided by the determinant
+			const Vector3 column0{ Vector3::Cross(yAxis, zAxis) };
+			const Vector3 column1{ Vector3::Cross(zAxis, xAxis) };
+			const Vector3 column2{ Vector3::Cross(xAxis, yAxis) };
+			const float determinant{ Vector3::Dot(xAxis, column0) };
+			assert(!AreEqual(determinant, 0.f) && "Matrix can not be inverted");
+			const float inverseDeterminant{ 1.f / determinant };
+
+			data[0] = { column0.x * inverseDeterminant, column1.x * inverseDeterminant, column2.x * inverseDeterminant, 0.f };
+			data[1] = { column0.y * inverseDeterminant, column1.y * inverseDeterminant, column2.y * inverseDeterminant, 0.f };
+			data[2] = { column0.z * inverseDeterminant, column1.z * inverseDeterminant, column2.z * inverseDeterminant, 0.f };
+			const Vector3 inverseTranslation{ -TransformVector(translation) };
+			data[3] = { inverseTranslation, 1.f };
+
+			return *this;
+		}
+
+		constexpr Vector3 GetAxisX() const
+		{
+			return data[0];
+		}
+
+		constexpr Vector3 GetAxisY() const
+		{
+			return data[1];
+		}
+
+		constexpr Vector3 GetAxisZ() const
+		{
+			return data[2];
+		}
+
+		constexpr Vector3 GetTranslation() const
+		{
+			return data[3];
+		}
+
+		static constexpr Matrix CreateTranslation(float x, float y, float z)
+		{
+			const Vector3 v3{ x,y,z };
+			return CreateTranslation(v3);
+		}
+
+		static constexpr Matrix CreateTranslation(const Vector3& t)
+		{
+			return Matrix{ Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ,t };
+		}
+
+		static Matrix CreateRotationX(float pitch)
+		{
+			return Matrix{
+				{1,0,0,0},
+				{0,cosf(pitch), -sinf(pitch),0},
+				{0,sinf(pitch),cosf(pitch),0},
+				{0,0,0,1}
+			};
+		}
+
+		static Matrix CreateRotationY(float yaw)
+		{
+			return {
+			{cosf(yaw),0,-sinf(yaw),0},
+			{0,1,0,0},
+			{static_cast<float>(sin(yaw)),0,static_cast<float>(cos(yaw)),0},
+			{0,0,0,1} };
+		}
+
+		static Matrix CreateRotationZ(float roll)
+		{
+			return {
+			{cosf(roll),sinf(roll),0,0},
+			{-sinf(roll),cosf(roll),0,0},
+			{0,0,1,0},
+				{0,0,0,1}
+			};
+		}
+
+		static Matrix CreateRotation(float pitch, float yaw, float roll)
+		{
+			return CreateRotation({ pitch, yaw, roll });
+		}
+
+		static Matrix CreateRotation(const Vector3& r)
+		{
+			const Matrix xRot{ CreateRotationX(r.x) };
+			const Matrix yRot{ CreateRotationY(r.y) };
+			const Matrix zRot{ CreateRotationZ(r.z) };
+			return Matrix{ xRot * yRot * zRot };
+		}
+
+		static constexpr Matrix CreateScale(float sx, float sy, float sz)
+		{
+			return {
+				{sx,0,0,0},
+				{0,sy,0,0},
+				{0,0,sz,0},
+				{0,0,0,1}
+			};
+		}
+
+		static constexpr Matrix CreateScale(const Vector3& s)
+		{
+			return CreateScale(s[0], s[1], s[2]);
+		}
+
+		static Matrix Transpose(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Transpose();
+
+			return out;
+		}
+
+		static Matrix Inverse(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Inverse();
+
+			return out;
+		}
+
+		constexpr Vector4& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr Vector4 operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr Matrix operator*(const Matrix& m) const
+		{
+			Matrix result{};
+			if (std::is_constant_evaluated())
+			{
+				for (int r{ 0 }; r < 4; ++r)
+				{
+					for (int c{ 0 }; c < 4; ++c)
+					{
+						result[r][c] = data[r].x * m[0][c] + data[r].y * m[1][c] + data[r].z * m[2][c] + data[r].w * m[3][c];
+					}
+				}
+
+				return result;
+			}
+
+			//Row r of the product is the rows of m weighted by the elements of row r
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				const __m128 weighted{ m.CombineRows(_mm_set1_ps(data[r].x), _mm_set1_ps(data[r].y), _mm_set1_ps(data[r].z)) };
+				result.data[r] = Vector4::Store(_mm_add_ps(weighted, _mm_mul_ps(_mm_set1_ps(data[r].w), m.data[3].Load())));
+			}
+
+			return result;
+		}
+
+		constexpr const Matrix& operator*=(const Matrix& m)
+		{
+			*this = *this * m;
+			return *this;
+		}
 
 	private:
 
+		//x * row0 + y * row1 + z * row2
+		__m128 CombineRows(__m128 x, __m128 y, __m128 z) const
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, data[0].Load()), _mm_mul_ps(y, data[1].Load())), _mm_mul_ps(z, data[2].Load()));
+		}
+
 		//Row-Major Matrix
 		Vector4 data[4]
 		{
@@ -63,4 +285,4 @@ namespace dae {
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
 	};
-}
\ No newline at end of file
+}
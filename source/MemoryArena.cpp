@@ -0,0 +1,87 @@
+#include "MemoryArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace dae;
+
+MemoryArena::MemoryArena(size_t blockSize) :
+	m_BlockSize(blockSize)
+{
+}
+
+MemoryArena::~MemoryArena()
+{
+	RunDestructors();
+	FreeBlocks();
+}
+
+void* MemoryArena::Allocate(size_t size, size_t alignment)
+{
+	if (!m_Blocks.empty())
+	{
+		const Block& block{ m_Blocks.back() };
+		const uintptr_t start{ reinterpret_cast<uintptr_t>(block.pData) };
+		const uintptr_t aligned{ (start + m_Offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1) };
+		if (aligned + size <= start + block.size)
+		{
+			m_Offset = aligned + size - start;
+			return reinterpret_cast<void*>(aligned);
+		}
+	}
+
+	//Whatever is left of the current block stays unused
+	m_BytesUsedInFullBlocks += m_Offset;
+	AddBlock(std::max(m_BlockSize, size + alignment));
+	return Allocate(size, alignment);
+}
+
+void MemoryArena::Reset()
+{
+	RunDestructors();
+
+	if (m_Blocks.size() > 1)
+	{
+		const size_t bytesReserved{ GetBytesReserved() };
+		FreeBlocks();
+		AddBlock(bytesReserved);
+	}
+	m_Offset = 0;
+	m_BytesUsedInFullBlocks = 0;
+}
+
+size_t MemoryArena::GetBytesReserved() const
+{
+	size_t bytesReserved{};
+	for (const Block& block : m_Blocks)
+	{
+		bytesReserved += block.size;
+	}
+	return bytesReserved;
+}
+
+void MemoryArena::AddBlock(size_t size)
+{
+	m_Blocks.push_back({ static_cast<std::byte*>(::operator new(size)), size });
+	m_Offset = 0;
+}
+
+void MemoryArena::RunDestructors()
+{
+	for (Destructor* pDestructor{ m_pLastDestructor }; pDestructor; pDestructor = pDestructor->pNext)
+	{
+		pDestructor->pDestroy(pDestructor->pObject);
+	}
+	m_pLastDestructor = nullptr;
+}
+
+void MemoryArena::FreeBlocks()
+{
+	for (const Block& block : m_Blocks)
+	{
+		::operator delete(block.pData);
+	}
+	m_Blocks.clear();
+	m_Offset = 0;
+	m_BytesUsedInFullBlocks = 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dae
+{
+	//Bump allocator: hands out memory from large blocks and takes all of it back at once, in Reset or the destructor
+	//Objects made with Create are destroyed then as well, in reverse order of creation
+	//Not thread safe, an arena is allocated from by one thread at a time
+	class MemoryArena final
+	{
+	public:
+		static constexpr size_t m_DefaultBlockSize{ 64 * 1024 };
+
+		explicit MemoryArena(size_t blockSize = m_DefaultBlockSize);
+		~MemoryArena();
+
+		MemoryArena(const MemoryArena&) = delete;
+		MemoryArena(MemoryArena&&) noexcept = delete;
+		MemoryArena& operator=(const MemoryArena&) = delete;
+		MemoryArena& operator=(MemoryArena&&) noexcept = delete;
+
+		//alignment a power of two
+		void* Allocate(size_t size, size_t alignment);
+
+		template<typename T, typename... Args>
+		T* Create(Args&&... args)
+		{
+			if constexpr (std::is_trivially_destructible_v<T>)
+			{
+				return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+			}
+			else
+			{
+				Destructor* pDestructor{ static_cast<Destructor*>(Allocate(sizeof(Destructor), alignof(Destructor))) };
+				T* pObject{ new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...) };
+				//Only linked once the constructor returned, so a throwing one leaves nothing to destroy
+				*pDestructor = { [](void* pDestroyed) { static_cast<T*>(pDestroyed)->~T(); }, pObject, m_pLastDestructor };
+				m_pLastDestructor = pDestructor;
+				return pObject;
+			}
+		}
+
+		//Uninitialized room for count objects, which are never destroyed
+		template<typename T>
+		T* AllocateArray(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "Arena arrays are not destroyed");
+			return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+		}
+
+		//Destroys everything that was created and makes all memory available again
+		//When that took more than one block they are replaced by a single one that fits all of it, so a workload that
+		//needs about the same every round stops allocating after the first
+		void Reset();
+
+		size_t GetBytesUsed() const { return m_BytesUsedInFullBlocks + m_Offset; }
+		size_t GetBytesReserved() const;
+
+	private:
+		struct Block
+		{
+			std::byte* pData{};
+			size_t size{};
+		};
+
+		struct Destructor
+		{
+			void (*pDestroy)(void*) {};
+			void* pObject{};
+			Destructor* pNext{};
+		};
+
+		size_t m_BlockSize{};
+		std::vector<Block> m_Blocks{};
+		//Into the last block
+		size_t m_Offset{};
+		//Used part of every block before the last
+		size_t m_BytesUsedInFullBlocks{};
+		Destructor* m_pLastDestructor{};
+
+		void AddBlock(size_t size);
+		void RunDestructors();
+		void FreeBlocks();
+	};
+}
@@ -0,0 +1,337 @@
+#include "MeshBVH.h"
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace dae;
+
+namespace
+{
+	constexpr int g_NumBins{ 16 };
+	//Nodes with this many triangles or fewer become leaves when splitting does not pay off
+	constexpr uint32_t g_MaxLeafSize{ 4 };
+	//Relative cost of visiting a node compared to testing one triangle
+	constexpr float g_TraversalCost{ 1.f };
+
+	struct Bounds
+	{
+		float min[3]{ FLT_MAX, FLT_MAX, FLT_MAX };
+		float max[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const float point[3])
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], point[axis]);
+				max[axis] = std::max(max[axis], point[axis]);
+			}
+		}
+
+		void Grow(const Bounds& other)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				min[axis] = std::min(min[axis], other.min[axis]);
+				max[axis] = std::max(max[axis], other.max[axis]);
+			}
+		}
+
+		void Grow(const Vector3& point)
+		{
+			const float coordinates[3]{ point.x, point.y, point.z };
+			Grow(coordinates);
+		}
+
+		float GetHalfArea() const
+		{
+			const float dx{ max[0] - min[0] };
+			const float dy{ max[1] - min[1] };
+			const float dz{ max[2] - min[2] };
+			return dx < 0.f ? 0.f : dx * dy + dy * dz + dz * dx;
+		}
+
+		void Store(BVHNode& node) const
+		{
+			node.minAABB = { min[0], min[1], min[2] };
+			node.maxAABB = { max[0], max[1], max[2] };
+		}
+	};
+
+	struct BuildTriangle
+	{
+		Bounds bounds{};
+		float centroid[3]{};
+	};
+
+	struct Bin
+	{
+		Bounds bounds{};
+		uint32_t numTriangles{};
+	};
+
+	struct Split
+	{
+		int axis{ -1 };
+		float position{};
+		float cost{ FLT_MAX };
+	};
+
+	//Binned SAH over the centroid bounds of the node, testing every bin border on all three axes
+	Split FindBestSplit(const std::vector<BuildTriangle>& triangles, const std::vector<uint32_t>& order, uint32_t first, uint32_t count)
+	{
+		Bounds centroidBounds{};
+		for (uint32_t i{ first }; i < first + count; ++i)
+		{
+			centroidBounds.Grow(triangles[order[i]].centroid);
+		}
+
+		Split best{};
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float axisMin{ centroidBounds.min[axis] };
+			const float axisExtent{ centroidBounds.max[axis] - axisMin };
+			if (axisExtent <= 0.f)
+				continue;
+
+			Bin bins[g_NumBins]{};
+			const float binScale{ g_NumBins / axisExtent };
+			for (uint32_t i{ first }; i < first + count; ++i)
+			{
+				const BuildTriangle& triangle{ triangles[order[i]] };
+				const int binIndex{ std::min(g_NumBins - 1, static_cast<int>((triangle.centroid[axis] - axisMin) * binScale)) };
+				bins[binIndex].bounds.Grow(triangle.bounds);
+				++bins[binIndex].numTriangles;
+			}
+
+			//Sweep from both sides, the cost of a border is known once both sweeps have passed it
+			float leftAreas[g_NumBins - 1]{};
+			uint32_t leftCounts[g_NumBins - 1]{};
+			Bounds leftBounds{};
+			uint32_t leftCount{};
+			for (int i{}; i < g_NumBins - 1; ++i)
+			{
+				leftBounds.Grow(bins[i].bounds);
+				leftCount += bins[i].numTriangles;
+				leftAreas[i] = leftBounds.GetHalfArea();
+				leftCounts[i] = leftCount;
+			}
+
+			Bounds rightBounds{};
+			uint32_t rightCount{};
+			for (int i{ g_NumBins - 1 }; i > 0; --i)
+			{
+				rightBounds.Grow(bins[i].bounds);
+				rightCount += bins[i].numTriangles;
+
+				if (leftCounts[i - 1] == 0 || rightCount == 0)
+					continue;
+
+				const float cost{ leftAreas[i - 1] * leftCounts[i - 1] + rightBounds.GetHalfArea() * rightCount };
+				if (cost < best.cost)
+				{
+					best.axis = axis;
+					best.position = axisMin + i / binScale;
+					best.cost = cost;
+				}
+			}
+		}
+		return best;
+	}
+
+	//Top-down binned SAH build over the bounds of arbitrary items, returns the item order of the leaves
+	std::vector<uint32_t> BuildNodes(const std::vector<BuildTriangle>& triangles, std::vector<BVHNode>& nodes)
+	{
+		const uint32_t numTriangles{ static_cast<uint32_t>(triangles.size()) };
+		std::vector<uint32_t> order(numTriangles);
+		for (uint32_t i{}; i < numTriangles; ++i)
+		{
+			order[i] = i;
+		}
+
+		//A binary tree with one triangle per leaf has 2n - 1 nodes, nothing Build makes is larger
+		nodes.clear();
+		nodes.reserve(numTriangles * 2 - 1);
+		nodes.emplace_back();
+		nodes[0].leftFirst = 0;
+		nodes[0].numTriangles = numTriangles;
+
+		struct PendingNode
+		{
+			uint32_t nodeIndex{};
+			int depth{};
+		};
+		std::vector<PendingNode> pendingNodes{ { 0, 0 } };
+
+		while (!pendingNodes.empty())
+		{
+			const PendingNode pending{ pendingNodes.back() };
+			pendingNodes.pop_back();
+
+			const uint32_t first{ nodes[pending.nodeIndex].leftFirst };
+			const uint32_t count{ nodes[pending.nodeIndex].numTriangles };
+
+			Bounds nodeBounds{};
+			for (uint32_t i{ first }; i < first + count; ++i)
+			{
+				nodeBounds.Grow(triangles[order[i]].bounds);
+			}
+			nodeBounds.Store(nodes[pending.nodeIndex]);
+
+			if (count == 1 || pending.depth + 1 >= MeshBVH::m_MaxDepth)
+				continue;
+
+			const Split split{ FindBestSplit(triangles, order, first, count) };
+			if (split.axis < 0)
+				continue;
+
+			//Leaf cost is count, split cost is the SAH estimate relative to the parent's area
+			const float splitCost{ g_TraversalCost + split.cost / std::max(nodeBounds.GetHalfArea(), FLT_MIN) };
+			if (count <= g_MaxLeafSize && splitCost >= static_cast<float>(count))
+				continue;
+
+			const auto middle{ std::partition(order.begin() + first, order.begin() + first + count,
+				[&](uint32_t triangle) { return triangles[triangle].centroid[split.axis] < split.position; }) };
+			const uint32_t leftCount{ static_cast<uint32_t>(middle - order.begin()) - first };
+			if (leftCount == 0 || leftCount == count)
+				continue;
+
+			const uint32_t leftIndex{ static_cast<uint32_t>(nodes.size()) };
+			nodes.emplace_back();
+			nodes.emplace_back();
+			nodes[leftIndex].leftFirst = first;
+			nodes[leftIndex].numTriangles = leftCount;
+			nodes[leftIndex + 1].leftFirst = first + leftCount;
+			nodes[leftIndex + 1].numTriangles = count - leftCount;
+
+			nodes[pending.nodeIndex].leftFirst = leftIndex;
+			nodes[pending.nodeIndex].numTriangles = 0;
+
+			pendingNodes.push_back({ leftIndex + 1, pending.depth + 1 });
+			pendingNodes.push_back({ leftIndex, pending.depth + 1 });
+		}
+
+		nodes.shrink_to_fit();
+		return order;
+	}
+
+	void SetCentroid(BuildTriangle& triangle)
+	{
+		for (int axis{}; axis < 3; ++axis)
+		{
+			triangle.centroid[axis] = (triangle.bounds.min[axis] + triangle.bounds.max[axis]) * .5f;
+		}
+	}
+}
+
+void MeshBVH::Build(const std::vector<Vector3>& positions, std::vector<int>& indices, std::vector<Vector3>& normals)
+{
+	const uint32_t numTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+	m_NumTriangles = numTriangles;
+	m_Nodes.clear();
+	m_WorldNodes.clear();
+	if (numTriangles == 0)
+		return;
+
+	std::vector<BuildTriangle> triangles(numTriangles);
+	for (uint32_t i{}; i < numTriangles; ++i)
+	{
+		BuildTriangle& triangle{ triangles[i] };
+		for (int corner{}; corner < 3; ++corner)
+		{
+			triangle.bounds.Grow(positions[indices[i * 3 + corner]]);
+		}
+		SetCentroid(triangle);
+	}
+
+	const std::vector<uint32_t> order{ BuildNodes(triangles, m_Nodes) };
+
+	//Put the triangles in leaf order, so a leaf is a plain range of the index and normal buffers
+	std::vector<int> sortedIndices(indices.size());
+	std::vector<Vector3> sortedNormals(normals.size() == numTriangles ? numTriangles : 0);
+	for (uint32_t i{}; i < numTriangles; ++i)
+	{
+		const uint32_t triangle{ order[i] };
+		for (int corner{}; corner < 3; ++corner)
+		{
+			sortedIndices[i * 3 + corner] = indices[triangle * 3 + corner];
+		}
+		if (!sortedNormals.empty())
+			sortedNormals[i] = normals[triangle];
+	}
+	indices = std::move(sortedIndices);
+	if (!sortedNormals.empty())
+		normals = std::move(sortedNormals);
+}
+
+std::vector<uint32_t> MeshBVH::BuildOverBoxes(const std::vector<Vector3>& minBounds, const std::vector<Vector3>& maxBounds)
+{
+	const uint32_t numItems{ static_cast<uint32_t>(minBounds.size()) };
+	m_NumTriangles = numItems;
+	m_Nodes.clear();
+	m_WorldNodes.clear();
+	if (numItems == 0)
+		return {};
+
+	std::vector<BuildTriangle> items(numItems);
+	for (uint32_t i{}; i < numItems; ++i)
+	{
+		items[i].bounds.Grow(minBounds[i]);
+		items[i].bounds.Grow(maxBounds[i]);
+		SetCentroid(items[i]);
+	}
+
+	std::vector<uint32_t> order{ BuildNodes(items, m_Nodes) };
+	//Static boxes, object space is world space
+	m_WorldNodes = m_Nodes;
+	return order;
+}
+
+void MeshBVH::Assign(std::vector<BVHNode>&& nodes, size_t numTriangles)
+{
+	m_Nodes = std::move(nodes);
+	m_WorldNodes.clear();
+	m_NumTriangles = numTriangles;
+}
+
+void MeshBVH::Refit(const std::vector<Vector3>& transformedPositions, const std::vector<int>& indices)
+{
+	m_WorldNodes.resize(m_Nodes.size());
+
+	//Children always come after their parent, so walking backwards visits every child first
+	for (size_t i{ m_Nodes.size() }; i-- > 0;)
+	{
+		const BVHNode& node{ m_Nodes[i] };
+		BVHNode& worldNode{ m_WorldNodes[i] };
+		worldNode.leftFirst = node.leftFirst;
+		worldNode.numTriangles = node.numTriangles;
+
+		Bounds bounds{};
+		if (node.IsLeaf())
+		{
+			const size_t firstIndex{ static_cast<size_t>(node.leftFirst) * 3 };
+			const size_t endIndex{ firstIndex + static_cast<size_t>(node.numTriangles) * 3 };
+			for (size_t index{ firstIndex }; index < endIndex; ++index)
+			{
+				bounds.Grow(transformedPositions[indices[index]]);
+			}
+		}
+		else
+		{
+			for (uint32_t child{ node.leftFirst }; child < node.leftFirst + 2; ++child)
+			{
+				const BVHNode& childNode{ m_WorldNodes[child] };
+				bounds.Grow(childNode.minAABB);
+				bounds.Grow(childNode.maxAABB);
+			}
+		}
+		bounds.Store(worldNode);
+	}
+}
+
+void MeshBVH::RefitInPlace(const std::vector<Vector3>& positions, const std::vector<int>& indices)
+{
+	Refit(positions, indices);
+	m_Nodes.swap(m_WorldNodes);
+	m_WorldNodes.clear();
+	m_WorldNodes.shrink_to_fit();
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//32 bytes, so two nodes share a cache line
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		//Leaf: first triangle of the node, inner node: left child (the right child directly follows it)
+		uint32_t leftFirst{};
+		Vector3 maxAABB{};
+		//0 for inner nodes
+		uint32_t numTriangles{};
+
+		bool IsLeaf() const { return numTriangles > 0; }
+	};
+
+	//Bounding volume hierarchy over the triangles of one mesh
+	//Built once in object space with binned SAH, reordering the triangles so every leaf covers a contiguous range.
+	//Refit copies the hierarchy into world space after the mesh moved, rigid transforms never need a rebuild.
+	class MeshBVH final
+	{
+	public:
+		//Deep enough for any tree Build produces, traversal keeps its node stack on the stack
+		static constexpr int m_MaxDepth{ 48 };
+
+		MeshBVH() = default;
+		~MeshBVH() = default;
+
+		MeshBVH(const MeshBVH&) = default;
+		MeshBVH(MeshBVH&&) noexcept = default;
+		MeshBVH& operator=(const MeshBVH&) = default;
+		MeshBVH& operator=(MeshBVH&&) noexcept = default;
+
+		//Reorders indices (three per triangle) and normals (one per triangle) into leaf order
+		void Build(const std::vector<Vector3>& positions, std::vector<int>& indices, std::vector<Vector3>& normals);
+		//Builds over one box per item instead of triangles, leaves refer to positions in the returned item order
+		//Meant for static boxes, the world nodes are ready right away
+		std::vector<uint32_t> BuildOverBoxes(const std::vector<Vector3>& minBounds, const std::vector<Vector3>& maxBounds);
+		//Takes over a hierarchy that was built earlier, the triangles have to be in its order already
+		void Assign(std::vector<BVHNode>&& nodes, size_t numTriangles);
+		void Refit(const std::vector<Vector3>& transformedPositions, const std::vector<int>& indices);
+		//Refits the object space nodes themselves and drops the world copy, for meshes traced in object space
+		void RefitInPlace(const std::vector<Vector3>& positions, const std::vector<int>& indices);
+		//Takes over the result of a Refit on another copy of this hierarchy
+		void CopyWorldNodes(const MeshBVH& source) { m_WorldNodes = source.m_WorldNodes; }
+
+		bool IsBuiltFor(size_t numTriangles) const { return m_NumTriangles == numTriangles && (numTriangles == 0 || !m_Nodes.empty()); }
+
+		//Object space, as built
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		//World space, as of the last Refit
+		const std::vector<BVHNode>& GetWorldNodes() const { return m_WorldNodes; }
+		size_t GetMemoryFootprint() const { return (m_Nodes.capacity() + m_WorldNodes.capacity()) * sizeof(BVHNode); }
+
+	private:
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<BVHNode> m_WorldNodes{};
+		size_t m_NumTriangles{};
+	};
+}
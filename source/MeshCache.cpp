@@ -0,0 +1,319 @@
+#include "MeshCache.h"
+#include "DataTypes.h"
+#include "MappedFile.h"
+#include "ObjLoader.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+using namespace dae;
+
+namespace
+{
+	//Bump whenever the layout of the header, a section or the BVH builder output changes
+	constexpr uint32_t g_CacheVersion{ 2 };
+	constexpr char g_CacheMagic[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+	//Tells apart caches written on a machine with a different byte order
+	constexpr uint32_t g_ByteOrderMark{ 0x01020304 };
+	constexpr uint64_t g_SectionAlignment{ 64 };
+	//The mesh itself and its LODs; at a quarter of the triangles per level the index limit is reached long before this
+	constexpr uint32_t g_MaxLevels{ 16 };
+
+	static_assert(sizeof(Vector3) == 12, "Cache sections store Vector3 as three packed floats");
+	static_assert(sizeof(BVHNode) == 32, "Cache sections store BVHNode as 32 bytes");
+
+	struct LevelSections
+	{
+		uint64_t numPositions{};
+		uint64_t numTriangles{};
+		uint64_t numNodes{};
+
+		//Byte offsets from the start of the file, all multiples of g_SectionAlignment
+		uint64_t positionsOffset{};
+		uint64_t normalsOffset{};
+		uint64_t indicesOffset{};
+		uint64_t nodesOffset{};
+	};
+
+	struct CacheHeader
+	{
+		char magic[8]{};
+		uint32_t version{};
+		uint32_t byteOrderMark{};
+		uint64_t headerSize{};
+		uint64_t fileSize{};
+
+		uint64_t sourceHash{};
+		uint64_t sourceSize{};
+
+		//Level 0 is the mesh, level n its lods[n - 1]
+		uint64_t numLevels{};
+		LevelSections levels[g_MaxLevels]{};
+	};
+
+	uint64_t AlignSection(uint64_t offset)
+	{
+		return (offset + g_SectionAlignment - 1) / g_SectionAlignment * g_SectionAlignment;
+	}
+
+	uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	bool IsSectionInside(uint64_t offset, uint64_t elementSize, uint64_t count, uint64_t fileSize)
+	{
+		return offset % g_SectionAlignment == 0 && count <= fileSize / elementSize && offset <= fileSize - count * elementSize;
+	}
+
+	//Everything a damaged or foreign file could get wrong that would otherwise crash traversal
+	bool IsLevelValid(const LevelSections& level, const MappedFile& cacheFile)
+	{
+		const uint64_t fileSize{ cacheFile.GetSize() };
+		if (level.numTriangles > INT32_MAX / 3 || level.numPositions > INT32_MAX
+			|| !IsSectionInside(level.positionsOffset, sizeof(Vector3), level.numPositions, fileSize)
+			|| !IsSectionInside(level.normalsOffset, sizeof(Vector3), level.numTriangles, fileSize)
+			|| !IsSectionInside(level.indicesOffset, sizeof(int), level.numTriangles * 3, fileSize)
+			|| !IsSectionInside(level.nodesOffset, sizeof(BVHNode), level.numNodes, fileSize))
+			return false;
+
+		if ((level.numTriangles == 0) != (level.numNodes == 0))
+			return false;
+
+		const int* pIndices{ reinterpret_cast<const int*>(cacheFile.GetData() + level.indicesOffset) };
+		for (uint64_t i{}; i < level.numTriangles * 3; ++i)
+		{
+			if (pIndices[i] < 0 || static_cast<uint64_t>(pIndices[i]) >= level.numPositions)
+				return false;
+		}
+
+		const BVHNode* pNodes{ reinterpret_cast<const BVHNode*>(cacheFile.GetData() + level.nodesOffset) };
+		for (uint64_t i{}; i < level.numNodes; ++i)
+		{
+			const BVHNode& node{ pNodes[i] };
+			const bool isInside{ node.IsLeaf()
+				? static_cast<uint64_t>(node.leftFirst) + node.numTriangles <= level.numTriangles
+				: node.leftFirst > i && static_cast<uint64_t>(node.leftFirst) + 1 < level.numNodes };
+			if (!isInside)
+				return false;
+		}
+		return true;
+	}
+
+	bool IsCacheValid(const CacheHeader& header, const MappedFile& cacheFile, uint64_t sourceHash, uint64_t sourceSize)
+	{
+		if (std::memcmp(header.magic, g_CacheMagic, sizeof(g_CacheMagic)) != 0
+			|| header.version != g_CacheVersion
+			|| header.byteOrderMark != g_ByteOrderMark
+			|| header.headerSize != sizeof(CacheHeader)
+			|| header.fileSize != cacheFile.GetSize()
+			|| header.sourceHash != sourceHash
+			|| header.sourceSize != sourceSize
+			|| header.numLevels == 0 || header.numLevels > g_MaxLevels)
+			return false;
+
+		for (uint64_t i{}; i < header.numLevels; ++i)
+		{
+			if (!IsLevelValid(header.levels[i], cacheFile))
+				return false;
+		}
+		return true;
+	}
+
+	template <typename T>
+	void CopySection(const MappedFile& cacheFile, uint64_t offset, uint64_t count, std::vector<T>& destination)
+	{
+		const T* pSource{ reinterpret_cast<const T*>(cacheFile.GetData() + offset) };
+		destination.assign(pSource, pSource + count);
+	}
+
+	bool ReadCache(const std::string& cacheFilename, uint64_t sourceHash, uint64_t sourceSize, TriangleMesh& mesh)
+	{
+		MappedFile cacheFile{};
+		if (!cacheFile.Open(cacheFilename) || cacheFile.GetSize() < sizeof(CacheHeader))
+			return false;
+
+		CacheHeader header{};
+		std::memcpy(&header, cacheFile.GetData(), sizeof(header));
+		if (!IsCacheValid(header, cacheFile, sourceHash, sourceSize))
+			return false;
+
+		mesh.lods.clear();
+		mesh.lods.resize(header.numLevels - 1);
+		mesh.selectedLod = 0;
+		for (uint64_t i{}; i < header.numLevels; ++i)
+		{
+			const LevelSections& level{ header.levels[i] };
+			TriangleMesh& levelMesh{ i == 0 ? mesh : mesh.lods[i - 1] };
+			CopySection(cacheFile, level.positionsOffset, level.numPositions, levelMesh.positions);
+			CopySection(cacheFile, level.normalsOffset, level.numTriangles, levelMesh.normals);
+			CopySection(cacheFile, level.indicesOffset, level.numTriangles * 3, levelMesh.indices);
+
+			std::vector<BVHNode> nodes{};
+			CopySection(cacheFile, level.nodesOffset, level.numNodes, nodes);
+			levelMesh.bvh.Assign(std::move(nodes), level.numTriangles);
+		}
+		return true;
+	}
+
+	bool WriteSection(std::FILE* pFile, uint64_t& position, uint64_t offset, const void* pData, uint64_t size)
+	{
+		static constexpr char padding[g_SectionAlignment]{};
+		if (fwrite(padding, 1, offset - position, pFile) != offset - position)
+			return false;
+		position = offset + size;
+		return size == 0 || fwrite(pData, 1, size, pFile) == size;
+	}
+
+	bool WriteCache(const std::string& cacheFilename, uint64_t sourceHash, uint64_t sourceSize, const TriangleMesh& mesh)
+	{
+		if (mesh.lods.size() + 1 > g_MaxLevels)
+			return false;
+
+		CacheHeader header{};
+		std::memcpy(header.magic, g_CacheMagic, sizeof(g_CacheMagic));
+		header.version = g_CacheVersion;
+		header.byteOrderMark = g_ByteOrderMark;
+		header.headerSize = sizeof(CacheHeader);
+		header.sourceHash = sourceHash;
+		header.sourceSize = sourceSize;
+		header.numLevels = mesh.lods.size() + 1;
+
+		uint64_t offset{ sizeof(CacheHeader) };
+		for (uint64_t i{}; i < header.numLevels; ++i)
+		{
+			const TriangleMesh& levelMesh{ i == 0 ? mesh : mesh.lods[i - 1] };
+			LevelSections& level{ header.levels[i] };
+			level.numPositions = levelMesh.positions.size();
+			level.numTriangles = levelMesh.indices.size() / 3;
+			level.numNodes = levelMesh.bvh.GetNodes().size();
+			level.positionsOffset = AlignSection(offset);
+			level.normalsOffset = AlignSection(level.positionsOffset + level.numPositions * sizeof(Vector3));
+			level.indicesOffset = AlignSection(level.normalsOffset + level.numTriangles * sizeof(Vector3));
+			level.nodesOffset = AlignSection(level.indicesOffset + level.numTriangles * 3 * sizeof(int));
+			offset = level.nodesOffset + level.numNodes * sizeof(BVHNode);
+		}
+		header.fileSize = offset;
+
+		//Written under a unique name and renamed at the end: other processes (batch workers) loading the same mesh
+		//never see a half-written cache, and a crash leaves the old one in place
+		const std::string temporaryFilename{ cacheFilename + ".tmp" + std::to_string(std::random_device{}()) };
+
+		std::FILE* pFile{};
+#if defined(_WIN32)
+		if (fopen_s(&pFile, temporaryFilename.c_str(), "wb") != 0)
+			pFile = nullptr;
+#else
+		pFile = fopen(temporaryFilename.c_str(), "wb");
+#endif
+		if (!pFile)
+			return false;
+
+		uint64_t position{};
+		bool isWritten{ WriteSection(pFile, position, 0, &header, sizeof(header)) };
+		for (uint64_t i{}; isWritten && i < header.numLevels; ++i)
+		{
+			const TriangleMesh& levelMesh{ i == 0 ? mesh : mesh.lods[i - 1] };
+			const LevelSections& level{ header.levels[i] };
+			isWritten = WriteSection(pFile, position, level.positionsOffset, levelMesh.positions.data(), level.numPositions * sizeof(Vector3))
+				&& WriteSection(pFile, position, level.normalsOffset, levelMesh.normals.data(), level.numTriangles * sizeof(Vector3))
+				&& WriteSection(pFile, position, level.indicesOffset, levelMesh.indices.data(), level.numTriangles * 3 * sizeof(int))
+				&& WriteSection(pFile, position, level.nodesOffset, levelMesh.bvh.GetNodes().data(), level.numNodes * sizeof(BVHNode));
+		}
+
+		if (fclose(pFile) != 0 || !isWritten)
+		{
+			std::remove(temporaryFilename.c_str());
+			return false;
+		}
+
+		//rename does not replace an existing file on Windows
+		std::remove(cacheFilename.c_str());
+		if (std::rename(temporaryFilename.c_str(), cacheFilename.c_str()) != 0)
+		{
+			std::remove(temporaryFilename.c_str());
+			return false;
+		}
+		return true;
+	}
+}
+
+uint64_t MeshCache::HashBytes(const char* pData, size_t size)
+{
+	constexpr uint64_t prime1{ 0x9E3779B185EBCA87ull };
+	constexpr uint64_t prime2{ 0xC2B2AE3D27D4EB4Full };
+
+	uint64_t lanes[4]{ prime1, prime2, prime1 ^ prime2, ~prime1 };
+	size_t offset{};
+	for (; offset + 32 <= size; offset += 32)
+	{
+		for (int lane{}; lane < 4; ++lane)
+		{
+			uint64_t word{};
+			std::memcpy(&word, pData + offset + lane * 8, sizeof(word));
+			lanes[lane] = RotateLeft(lanes[lane] + word * prime2, 31) * prime1;
+		}
+	}
+
+	uint64_t hash{ size * prime1 };
+	for (int lane{}; lane < 4; ++lane)
+	{
+		hash = RotateLeft(hash ^ lanes[lane], 27) * prime1 + prime2;
+	}
+	for (; offset < size; ++offset)
+	{
+		hash = RotateLeft(hash ^ (static_cast<uint8_t>(pData[offset]) * prime2), 23) * prime1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+bool MeshCache::LoadOBJ(const std::string& filename, TriangleMesh& mesh)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+	const std::string cacheFilename{ filename + ".meshcache" };
+
+	uint64_t sourceHash{};
+	uint64_t sourceSize{};
+	{
+		MappedFile sourceFile{};
+		if (!sourceFile.Open(filename))
+		{
+			std::cout << "Could not open " << filename << std::endl;
+			return false;
+		}
+		sourceHash = HashBytes(sourceFile.GetData(), sourceFile.GetSize());
+		sourceSize = sourceFile.GetSize();
+	}
+
+	if (ReadCache(cacheFilename, sourceHash, sourceSize, mesh))
+	{
+		const std::chrono::duration<float, std::milli> duration{ std::chrono::steady_clock::now() - start };
+		std::cout << "Loaded " << filename << " from cache: " << mesh.positions.size() << " vertices, "
+			<< mesh.indices.size() / 3 << " triangles, " << mesh.bvh.GetNodes().size() << " BVH nodes, "
+			<< mesh.lods.size() << " LODs in " << duration.count() << " ms" << std::endl;
+		return true;
+	}
+
+	if (!ObjLoader::Load(filename, mesh.positions, mesh.normals, mesh.indices))
+		return false;
+
+	const auto buildStart{ std::chrono::steady_clock::now() };
+	mesh.bvh.Build(mesh.positions, mesh.indices, mesh.normals);
+	//Builds the BVH of every level as well, so they all go into the cache
+	mesh.GenerateLods();
+	const std::chrono::duration<float, std::milli> buildDuration{ std::chrono::steady_clock::now() - buildStart };
+	std::cout << "Built BVH with " << mesh.bvh.GetNodes().size() << " nodes and " << mesh.lods.size() << " LODs in "
+		<< buildDuration.count() << " ms" << std::endl;
+
+	if (!WriteCache(cacheFilename, sourceHash, sourceSize, mesh))
+		std::cout << "Could not write mesh cache " << cacheFilename << std::endl;
+	return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	struct TriangleMesh;
+
+	//Binary cache next to each OBJ file ("<file>.meshcache") holding positions, normals, indices and the BVH, for the
+	//mesh and each of its LODs
+	//The cache is keyed on a hash of the OBJ contents. Sections are aligned and stored in native layout, so a warm start
+	//maps the file and copies the arrays straight into the mesh without parsing or building anything.
+	//A missing, stale or damaged cache falls back to ObjLoader and a fresh BVH build, and is rewritten afterwards.
+	namespace MeshCache
+	{
+		//Replaces the positions, normals and indices of the mesh and builds or loads its BVH and LOD chain
+		//The mesh transforms still have to be updated afterwards
+		bool LoadOBJ(const std::string& filename, TriangleMesh& mesh);
+
+		//Multiply-rotate hash over 8-byte words in four independent lanes, fast enough to run at memory speed
+		//Not cryptographic, it only has to notice that a source file was edited
+		uint64_t HashBytes(const char* pData, size_t size);
+	}
+}
@@ -0,0 +1,436 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+
+using namespace dae;
+
+namespace
+{
+	//Border planes count this much more than face planes, borders only move when nothing else is left
+	constexpr double g_BorderWeight{ 100.0 };
+	//A collapse may not turn a face by more than this (cosine of the angle between the old and new normal)
+	constexpr double g_MinNormalCosine{ .2 };
+
+	struct Vector3d
+	{
+		double x{};
+		double y{};
+		double z{};
+
+		Vector3d() = default;
+		Vector3d(double _x, double _y, double _z) : x{ _x }, y{ _y }, z{ _z } {}
+		explicit Vector3d(const Vector3& v) : x{ v.x }, y{ v.y }, z{ v.z } {}
+
+		Vector3d operator+(const Vector3d& v) const { return { x + v.x, y + v.y, z + v.z }; }
+		Vector3d operator-(const Vector3d& v) const { return { x - v.x, y - v.y, z - v.z }; }
+		Vector3d operator*(double scale) const { return { x * scale, y * scale, z * scale }; }
+
+		static double Dot(const Vector3d& a, const Vector3d& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		static Vector3d Cross(const Vector3d& a, const Vector3d& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+		double Magnitude() const { return std::sqrt(Dot(*this, *this)); }
+	};
+
+	//Symmetric 4x4 matrix, the upper triangle row by row
+	struct Quadric
+	{
+		double a[10]{};
+
+		void AddPlane(const Vector3d& normal, double distance, double weight)
+		{
+			const double plane[4]{ normal.x, normal.y, normal.z, distance };
+			int index{};
+			for (int row{}; row < 4; ++row)
+			{
+				for (int column{ row }; column < 4; ++column)
+				{
+					a[index++] += plane[row] * plane[column] * weight;
+				}
+			}
+		}
+
+		void Add(const Quadric& other)
+		{
+			for (int i{}; i < 10; ++i)
+			{
+				a[i] += other.a[i];
+			}
+		}
+
+		double Evaluate(const Vector3d& p) const
+		{
+			return a[0] * p.x * p.x + 2.0 * a[1] * p.x * p.y + 2.0 * a[2] * p.x * p.z + 2.0 * a[3] * p.x
+				+ a[4] * p.y * p.y + 2.0 * a[5] * p.y * p.z + 2.0 * a[6] * p.y
+				+ a[7] * p.z * p.z + 2.0 * a[8] * p.z
+				+ a[9];
+		}
+
+		//Point of least error, false when the quadric is (close to) singular
+		bool FindMinimum(Vector3d& minimum) const
+		{
+			const double determinant{ a[0] * (a[4] * a[7] - a[5] * a[5]) - a[1] * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * a[5] - a[4] * a[2]) };
+			if (std::abs(determinant) < 1e-12)
+				return false;
+
+			//Cramer's rule on A x = -b
+			const double bx{ -a[3] };
+			const double by{ -a[6] };
+			const double bz{ -a[8] };
+			minimum.x = (bx * (a[4] * a[7] - a[5] * a[5]) - a[1] * (by * a[7] - a[5] * bz) + a[2] * (by * a[5] - a[4] * bz)) / determinant;
+			minimum.y = (a[0] * (by * a[7] - bz * a[5]) - bx * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * bz - by * a[2])) / determinant;
+			minimum.z = (a[0] * (a[4] * bz - a[5] * by) - a[1] * (a[1] * bz - by * a[2]) + bx * (a[1] * a[5] - a[4] * a[2])) / determinant;
+			return true;
+		}
+	};
+
+	struct Candidate
+	{
+		double cost{};
+		int keptVertex{};
+		int removedVertex{};
+		uint32_t keptStamp{};
+		uint32_t removedStamp{};
+		Vector3d position{};
+
+		bool operator>(const Candidate& other) const { return cost > other.cost; }
+	};
+
+	class Simplifier final
+	{
+	public:
+		Simplifier(const std::vector<Vector3>& positions, const std::vector<int>& indices)
+			: m_Positions(positions.size())
+			, m_Quadrics(positions.size())
+			, m_Stamps(positions.size())
+			, m_IsVertexRemoved(positions.size())
+			, m_VertexTriangles(positions.size())
+		{
+			for (size_t i{}; i < positions.size(); ++i)
+			{
+				m_Positions[i] = Vector3d{ positions[i] };
+			}
+
+			for (size_t i{}; i + 2 < indices.size(); i += 3)
+			{
+				const std::array<int, 3> triangle{ indices[i], indices[i + 1], indices[i + 2] };
+				if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0])
+					continue;
+
+				const int triangleIndex{ static_cast<int>(m_Triangles.size()) };
+				m_Triangles.push_back(triangle);
+				for (int vertex : triangle)
+				{
+					m_VertexTriangles[vertex].push_back(triangleIndex);
+				}
+			}
+			m_IsTriangleRemoved.assign(m_Triangles.size(), false);
+			m_NumTriangles = m_Triangles.size();
+
+			AddFaceQuadrics();
+			AddBorderQuadrics();
+
+			for (const std::array<int, 3>& triangle : m_Triangles)
+			{
+				for (int corner{}; corner < 3; ++corner)
+				{
+					const int from{ triangle[corner] };
+					const int to{ triangle[(corner + 1) % 3] };
+					//Every interior edge shows up twice, once is enough
+					if (from < to || IsBorderEdge(from, to))
+						PushCandidate(from, to);
+				}
+			}
+		}
+
+		void Run(size_t targetTriangles)
+		{
+			while (m_NumTriangles > targetTriangles && !m_Candidates.empty())
+			{
+				const Candidate candidate{ m_Candidates.top() };
+				m_Candidates.pop();
+
+				//Either end changed after this was queued, a fresh candidate for the edge is already in the queue
+				if (m_IsVertexRemoved[candidate.keptVertex] || m_IsVertexRemoved[candidate.removedVertex]
+					|| m_Stamps[candidate.keptVertex] != candidate.keptStamp || m_Stamps[candidate.removedVertex] != candidate.removedStamp)
+					continue;
+
+				if (!CanCollapse(candidate))
+					continue;
+
+				Collapse(candidate);
+			}
+		}
+
+		void Write(std::vector<Vector3>& positions, std::vector<int>& indices) const
+		{
+			std::vector<int> newIndices(m_Positions.size(), -1);
+			positions.clear();
+			indices.clear();
+			indices.reserve(m_NumTriangles * 3);
+
+			for (size_t i{}; i < m_Triangles.size(); ++i)
+			{
+				if (m_IsTriangleRemoved[i])
+					continue;
+
+				for (int vertex : m_Triangles[i])
+				{
+					if (newIndices[vertex] < 0)
+					{
+						newIndices[vertex] = static_cast<int>(positions.size());
+						const Vector3d& position{ m_Positions[vertex] };
+						positions.push_back({ static_cast<float>(position.x), static_cast<float>(position.y), static_cast<float>(position.z) });
+					}
+					indices.push_back(newIndices[vertex]);
+				}
+			}
+		}
+
+	private:
+		std::vector<Vector3d> m_Positions;
+		std::vector<Quadric> m_Quadrics;
+		std::vector<uint32_t> m_Stamps;
+		std::vector<bool> m_IsVertexRemoved;
+		std::vector<std::vector<int>> m_VertexTriangles;
+
+		std::vector<std::array<int, 3>> m_Triangles{};
+		std::vector<bool> m_IsTriangleRemoved{};
+		size_t m_NumTriangles{};
+
+		std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> m_Candidates{};
+
+		Vector3d GetFaceNormal(const std::array<int, 3>& triangle) const
+		{
+			const Vector3d& v0{ m_Positions[triangle[0]] };
+			return Vector3d::Cross(m_Positions[triangle[1]] - v0, m_Positions[triangle[2]] - v0);
+		}
+
+		void AddFaceQuadrics()
+		{
+			for (const std::array<int, 3>& triangle : m_Triangles)
+			{
+				const Vector3d normal{ GetFaceNormal(triangle) };
+				const double doubleArea{ normal.Magnitude() };
+				if (doubleArea <= 0.0)
+					continue;
+
+				//Weighted by area, so a few large faces are not outvoted by many slivers
+				const Vector3d unitNormal{ normal * (1.0 / doubleArea) };
+				const double distance{ -Vector3d::Dot(unitNormal, m_Positions[triangle[0]]) };
+				for (int vertex : triangle)
+				{
+					m_Quadrics[vertex].AddPlane(unitNormal, distance, doubleArea * .5);
+				}
+			}
+		}
+
+		//An edge is on the border when only one face uses it
+		bool IsBorderEdge(int from, int to) const
+		{
+			int numFaces{};
+			for (int triangleIndex : m_VertexTriangles[from])
+			{
+				if (m_IsTriangleRemoved[triangleIndex])
+					continue;
+				const std::array<int, 3>& triangle{ m_Triangles[triangleIndex] };
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+					++numFaces;
+			}
+			return numFaces == 1;
+		}
+
+		void AddBorderQuadrics()
+		{
+			for (const std::array<int, 3>& triangle : m_Triangles)
+			{
+				const Vector3d normal{ GetFaceNormal(triangle) };
+				for (int corner{}; corner < 3; ++corner)
+				{
+					const int from{ triangle[corner] };
+					const int to{ triangle[(corner + 1) % 3] };
+					if (!IsBorderEdge(from, to))
+						continue;
+
+					//Plane through the edge, perpendicular to the face
+					const Vector3d edge{ m_Positions[to] - m_Positions[from] };
+					Vector3d borderNormal{ Vector3d::Cross(edge, normal) };
+					const double length{ borderNormal.Magnitude() };
+					if (length <= 0.0)
+						continue;
+					borderNormal = borderNormal * (1.0 / length);
+
+					const double distance{ -Vector3d::Dot(borderNormal, m_Positions[from]) };
+					const double weight{ g_BorderWeight * Vector3d::Dot(edge, edge) };
+					m_Quadrics[from].AddPlane(borderNormal, distance, weight);
+					m_Quadrics[to].AddPlane(borderNormal, distance, weight);
+				}
+			}
+		}
+
+		void PushCandidate(int first, int second)
+		{
+			Quadric quadric{ m_Quadrics[first] };
+			quadric.Add(m_Quadrics[second]);
+
+			const Vector3d& firstPosition{ m_Positions[first] };
+			const Vector3d& secondPosition{ m_Positions[second] };
+
+			//The ends and the middle are always safe choices, the optimum only when it stays near the edge
+			Vector3d options[4]{ firstPosition, secondPosition, (firstPosition + secondPosition) * .5, {} };
+			int numOptions{ 3 };
+			Vector3d minimum{};
+			if (quadric.FindMinimum(minimum))
+			{
+				const Vector3d edge{ secondPosition - firstPosition };
+				const Vector3d toMinimum{ minimum - options[2] };
+				if (Vector3d::Dot(toMinimum, toMinimum) <= Vector3d::Dot(edge, edge))
+					options[numOptions++] = minimum;
+			}
+
+			Candidate candidate{};
+			candidate.cost = DBL_MAX;
+			for (int i{}; i < numOptions; ++i)
+			{
+				const double cost{ quadric.Evaluate(options[i]) };
+				if (cost < candidate.cost)
+				{
+					candidate.cost = cost;
+					candidate.position = options[i];
+				}
+			}
+
+			//Keep the vertex with more faces, fewer adjacency lists have to be merged
+			const bool isFirstKept{ m_VertexTriangles[first].size() >= m_VertexTriangles[second].size() };
+			candidate.keptVertex = isFirstKept ? first : second;
+			candidate.removedVertex = isFirstKept ? second : first;
+			candidate.keptStamp = m_Stamps[candidate.keptVertex];
+			candidate.removedStamp = m_Stamps[candidate.removedVertex];
+			m_Candidates.push(candidate);
+		}
+
+		void GatherNeighbours(int vertex, std::vector<int>& neighbours) const
+		{
+			neighbours.clear();
+			for (int triangleIndex : m_VertexTriangles[vertex])
+			{
+				if (m_IsTriangleRemoved[triangleIndex])
+					continue;
+				for (int other : m_Triangles[triangleIndex])
+				{
+					if (other != vertex && std::find(neighbours.begin(), neighbours.end(), other) == neighbours.end())
+						neighbours.push_back(other);
+				}
+			}
+		}
+
+		bool CanCollapse(const Candidate& candidate)
+		{
+			//Link condition: an edge shared by two faces has exactly two common neighbours (one on a border),
+			//more means the collapse would glue separate parts of the surface together
+			GatherNeighbours(candidate.keptVertex, m_KeptNeighbours);
+			GatherNeighbours(candidate.removedVertex, m_RemovedNeighbours);
+			int numShared{};
+			for (int neighbour : m_KeptNeighbours)
+			{
+				if (std::find(m_RemovedNeighbours.begin(), m_RemovedNeighbours.end(), neighbour) != m_RemovedNeighbours.end())
+					++numShared;
+			}
+			if (numShared > 2)
+				return false;
+
+			//No face that survives may flip or collapse to a line
+			for (int vertex : { candidate.keptVertex, candidate.removedVertex })
+			{
+				for (int triangleIndex : m_VertexTriangles[vertex])
+				{
+					if (m_IsTriangleRemoved[triangleIndex])
+						continue;
+
+					std::array<int, 3> triangle{ m_Triangles[triangleIndex] };
+					const bool hasKept{ triangle[0] == candidate.keptVertex || triangle[1] == candidate.keptVertex || triangle[2] == candidate.keptVertex };
+					const bool hasRemoved{ triangle[0] == candidate.removedVertex || triangle[1] == candidate.removedVertex || triangle[2] == candidate.removedVertex };
+					if (hasKept && hasRemoved)
+						continue;
+
+					const Vector3d oldNormal{ GetFaceNormal(triangle) };
+					Vector3d moved[3]{ m_Positions[triangle[0]], m_Positions[triangle[1]], m_Positions[triangle[2]] };
+					for (int corner{}; corner < 3; ++corner)
+					{
+						if (triangle[corner] == vertex)
+							moved[corner] = candidate.position;
+					}
+					const Vector3d newNormal{ Vector3d::Cross(moved[1] - moved[0], moved[2] - moved[0]) };
+
+					const double lengths{ oldNormal.Magnitude() * newNormal.Magnitude() };
+					if (lengths <= 0.0 || Vector3d::Dot(oldNormal, newNormal) < g_MinNormalCosine * lengths)
+						return false;
+				}
+			}
+			return true;
+		}
+
+		void Collapse(const Candidate& candidate)
+		{
+			const int kept{ candidate.keptVertex };
+			const int removed{ candidate.removedVertex };
+
+			for (int triangleIndex : m_VertexTriangles[removed])
+			{
+				if (m_IsTriangleRemoved[triangleIndex])
+					continue;
+
+				std::array<int, 3>& triangle{ m_Triangles[triangleIndex] };
+				if (triangle[0] == kept || triangle[1] == kept || triangle[2] == kept)
+				{
+					m_IsTriangleRemoved[triangleIndex] = true;
+					--m_NumTriangles;
+					continue;
+				}
+
+				for (int& vertex : triangle)
+				{
+					if (vertex == removed)
+						vertex = kept;
+				}
+				m_VertexTriangles[kept].push_back(triangleIndex);
+			}
+
+			std::vector<int>& keptTriangles{ m_VertexTriangles[kept] };
+			keptTriangles.erase(std::remove_if(keptTriangles.begin(), keptTriangles.end(),
+				[this](int triangleIndex) { return m_IsTriangleRemoved[triangleIndex]; }), keptTriangles.end());
+			m_VertexTriangles[removed] = {};
+
+			m_Positions[kept] = candidate.position;
+			m_Quadrics[kept].Add(m_Quadrics[removed]);
+			m_IsVertexRemoved[removed] = true;
+			++m_Stamps[kept];
+			++m_Stamps[removed];
+
+			//The new stamp makes every queued candidate around the kept vertex stale, these replace them
+			GatherNeighbours(kept, m_KeptNeighbours);
+			for (int neighbour : m_KeptNeighbours)
+			{
+				PushCandidate(kept, neighbour);
+			}
+		}
+
+		//Scratch space, reused for every candidate
+		std::vector<int> m_KeptNeighbours{};
+		std::vector<int> m_RemovedNeighbours{};
+	};
+}
+
+void MeshSimplifier::Simplify(const std::vector<Vector3>& positions, const std::vector<int>& indices, size_t targetTriangles,
+	std::vector<Vector3>& simplifiedPositions, std::vector<int>& simplifiedIndices)
+{
+	Simplifier simplifier{ positions, indices };
+	simplifier.Run(targetTriangles);
+	simplifier.Write(simplifiedPositions, simplifiedIndices);
+}
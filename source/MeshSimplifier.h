@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Quadric error edge collapse (Garland and Heckbert)
+	//Every vertex carries the sum of the squared distances to the planes of its faces; the edge whose collapse adds the
+	//least error goes first. Open borders get extra perpendicular planes so the outline of the mesh stays in place, and
+	//collapses that would flip a face or pinch the surface are skipped.
+	namespace MeshSimplifier
+	{
+		//Writes at most targetTriangles triangles when the mesh allows it, fewer collapses happen otherwise
+		//Unused vertices are dropped from simplifiedPositions
+		void Simplify(const std::vector<Vector3>& positions, const std::vector<int>& indices, size_t targetTriangles,
+			std::vector<Vector3>& simplifiedPositions, std::vector<int>& simplifiedIndices);
+	}
+}
@@ -0,0 +1,378 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace dae;
+
+namespace
+{
+	//Small files are not worth splitting, every chunk is at least this large
+	constexpr size_t g_MinChunkSize{ 256 * 1024 };
+	constexpr size_t g_TrianglesPerNormalBlock{ 64 * 1024 };
+	//Reader hands the pages it is done with back to the OS every so often, so a pass over a huge file stays small in memory
+	constexpr size_t g_ReaderReleaseSize{ 16 * 1024 * 1024 };
+
+	struct Chunk
+	{
+		const char* pBegin{};
+		const char* pEnd{};
+
+		std::vector<Vector3> positions{};
+		//Zero-based. Negative OBJ indices are still relative to this chunk's first vertex, see relativeIndexSlots
+		std::vector<int> indices{};
+		std::vector<size_t> relativeIndexSlots{};
+		bool isValid{ true };
+	};
+
+	struct FaceCorner
+	{
+		int index{};
+		bool isRelative{};
+	};
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* SkipSpaces(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && IsSpace(*p))
+			++p;
+		return p;
+	}
+
+	const char* SkipLine(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && *p != '\n')
+			++p;
+		return p < pEnd ? p + 1 : pEnd;
+	}
+
+	//Chunks start right after a newline (or at the start of the file), so lines never straddle two chunks
+	const char* FindLineStart(const char* pData, size_t size, size_t offset)
+	{
+		if (offset == 0 || offset >= size)
+			return pData + std::min(offset, size);
+		return SkipLine(pData + offset - 1, pData + size);
+	}
+
+	bool ParseFloat(const char*& p, const char* pEnd, float& value)
+	{
+		p = SkipSpaces(p, pEnd);
+		//from_chars does not accept an explicit plus sign
+		if (p < pEnd && *p == '+')
+			++p;
+		const auto [pNext, error] { std::from_chars(p, pEnd, value) };
+		if (error != std::errc{})
+			return false;
+		p = pNext;
+		return true;
+	}
+
+	bool ParseInt(const char*& p, const char* pEnd, int& value)
+	{
+		const auto [pNext, error] { std::from_chars(p, pEnd, value) };
+		if (error != std::errc{})
+			return false;
+		p = pNext;
+		return true;
+	}
+
+	//One face corner: v, v/vt, v//vn or v/vt/vn. Only the position index is kept
+	bool ParseFaceCorner(const char*& p, const char* pEnd, int numChunkPositions, FaceCorner& corner)
+	{
+		int positionIndex{};
+		if (!ParseInt(p, pEnd, positionIndex) || positionIndex == 0)
+			return false;
+
+		int ignoredIndex{};
+		for (int slash{}; slash < 2 && p < pEnd && *p == '/'; ++slash)
+		{
+			++p;
+			if (p < pEnd && *p != '/' && !IsSpace(*p) && *p != '\n' && !ParseInt(p, pEnd, ignoredIndex))
+				return false;
+		}
+
+		corner.isRelative = positionIndex < 0;
+		corner.index = corner.isRelative ? numChunkPositions + positionIndex : positionIndex - 1;
+		return true;
+	}
+
+	void AddIndex(std::vector<int>& indices, std::vector<size_t>& relativeIndexSlots, const FaceCorner& corner)
+	{
+		if (corner.isRelative)
+			relativeIndexSlots.push_back(indices.size());
+		indices.push_back(corner.index);
+	}
+
+	//Polygons are split into a fan around their first corner, which is exact for the convex faces exporters write
+	//Negative indices count back from numChunkPositions
+	bool ParseFace(const char*& p, const char* pEnd, int numChunkPositions, std::vector<int>& indices, std::vector<size_t>& relativeIndexSlots)
+	{
+		FaceCorner first{};
+		FaceCorner previous{};
+		int numCorners{};
+		while (true)
+		{
+			p = SkipSpaces(p, pEnd);
+			if (p == pEnd || *p == '\n' || *p == '#')
+				break;
+
+			FaceCorner corner{};
+			if (!ParseFaceCorner(p, pEnd, numChunkPositions, corner))
+				return false;
+
+			if (numCorners >= 2)
+			{
+				AddIndex(indices, relativeIndexSlots, first);
+				AddIndex(indices, relativeIndexSlots, previous);
+				AddIndex(indices, relativeIndexSlots, corner);
+			}
+			else if (numCorners == 0)
+			{
+				first = corner;
+			}
+			previous = corner;
+			++numCorners;
+		}
+		return numCorners >= 3;
+	}
+
+	bool ParsePosition(const char*& p, const char* pEnd, Vector3& position)
+	{
+		return ParseFloat(p, pEnd, position.x) && ParseFloat(p, pEnd, position.y) && ParseFloat(p, pEnd, position.z);
+	}
+
+	void ParseChunk(Chunk& chunk)
+	{
+		const char* p{ chunk.pBegin };
+		const char* pEnd{ chunk.pEnd };
+
+		while (p < pEnd)
+		{
+			p = SkipSpaces(p, pEnd);
+			if (pEnd - p >= 2 && IsSpace(p[1]))
+			{
+				if (p[0] == 'v')
+				{
+					p += 2;
+					Vector3 position{};
+					if (!ParsePosition(p, pEnd, position))
+					{
+						chunk.isValid = false;
+						return;
+					}
+					chunk.positions.push_back(position);
+				}
+				else if (p[0] == 'f')
+				{
+					p += 2;
+					if (!ParseFace(p, pEnd, static_cast<int>(chunk.positions.size()), chunk.indices, chunk.relativeIndexSlots))
+					{
+						chunk.isValid = false;
+						return;
+					}
+				}
+			}
+			//Comments, vt, vn, groups, materials, ... and the rest of parsed lines
+			p = SkipLine(p, pEnd);
+		}
+	}
+}
+
+bool ObjLoader::Load(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, Statistics* pStatistics)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	positions.clear();
+	normals.clear();
+	indices.clear();
+
+	MappedFile file{};
+	if (!file.Open(filename))
+	{
+		std::cout << "Could not open " << filename << std::endl;
+		return false;
+	}
+
+	const char* pData{ file.GetData() };
+	const size_t size{ file.GetSize() };
+
+	//A few chunks per core so a chunk full of faces does not hold up the others
+	const size_t numCores{ std::max(std::thread::hardware_concurrency(), 1u) };
+	const size_t chunkSize{ std::max(g_MinChunkSize, size / (numCores * 4) + 1) };
+	const size_t numChunks{ std::max<size_t>((size + chunkSize - 1) / chunkSize, 1) };
+
+	std::vector<Chunk> chunks(numChunks);
+	for (size_t i{}; i < numChunks; ++i)
+	{
+		chunks[i].pBegin = FindLineStart(pData, size, i * chunkSize);
+		chunks[i].pEnd = FindLineStart(pData, size, (i + 1) * chunkSize);
+	}
+
+	ParallelFor(size_t{}, numChunks, [&](size_t i) { ParseChunk(chunks[i]); });
+
+	//Prefix sums give every chunk its place in the merged arrays
+	std::vector<size_t> positionOffsets(numChunks + 1);
+	std::vector<size_t> indexOffsets(numChunks + 1);
+	for (size_t i{}; i < numChunks; ++i)
+	{
+		if (!chunks[i].isValid)
+		{
+			std::cout << "Malformed vertex or face in " << filename << std::endl;
+			return false;
+		}
+		positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+		indexOffsets[i + 1] = indexOffsets[i] + chunks[i].indices.size();
+	}
+
+	const size_t numPositions{ positionOffsets.back() };
+	const size_t numIndices{ indexOffsets.back() };
+	positions.resize(numPositions);
+	indices.resize(numIndices);
+
+	std::atomic<bool> hasInvalidIndex{ false };
+	ParallelFor(size_t{}, numChunks, [&](size_t i)
+		{
+			Chunk& chunk{ chunks[i] };
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionOffsets[i]);
+
+			const int positionOffset{ static_cast<int>(positionOffsets[i]) };
+			for (const size_t slot : chunk.relativeIndexSlots)
+			{
+				chunk.indices[slot] += positionOffset;
+			}
+
+			for (const int index : chunk.indices)
+			{
+				if (index < 0 || static_cast<size_t>(index) >= numPositions)
+				{
+					hasInvalidIndex = true;
+					break;
+				}
+			}
+			std::copy(chunk.indices.begin(), chunk.indices.end(), indices.begin() + indexOffsets[i]);
+
+			//Release the chunk right away, the merged copy is all that is needed from here on
+			chunk = Chunk{};
+		});
+
+	if (hasInvalidIndex)
+	{
+		std::cout << "Face references a missing vertex in " << filename << std::endl;
+		positions.clear();
+		indices.clear();
+		return false;
+	}
+
+	//Precompute normals
+	const size_t numTriangles{ numIndices / 3 };
+	normals.resize(numTriangles);
+	const size_t numNormalBlocks{ (numTriangles + g_TrianglesPerNormalBlock - 1) / g_TrianglesPerNormalBlock };
+	ParallelFor(size_t{}, numNormalBlocks, [&](size_t block)
+		{
+			const size_t end{ std::min((block + 1) * g_TrianglesPerNormalBlock, numTriangles) };
+			for (size_t triangle{ block * g_TrianglesPerNormalBlock }; triangle < end; ++triangle)
+			{
+				const Vector3& v0{ positions[indices[triangle * 3]] };
+				const Vector3 edgeV0V1{ positions[indices[triangle * 3 + 1]] - v0 };
+				const Vector3 edgeV0V2{ positions[indices[triangle * 3 + 2]] - v0 };
+				normals[triangle] = Vector3::Cross(edgeV0V1, edgeV0V2).Normalized();
+			}
+		});
+
+	Statistics statistics{};
+	statistics.numBytes = size;
+	statistics.numPositions = numPositions;
+	statistics.numTriangles = numTriangles;
+	statistics.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Loaded " << filename << ": " << numPositions << " vertices, " << numTriangles << " triangles, "
+		<< size / (1024.f * 1024.f) << " MB in " << statistics.seconds * 1000.f << " ms ("
+		<< statistics.GetMegabytesPerSecond() << " MB/s)" << std::endl;
+
+	if (pStatistics)
+		*pStatistics = statistics;
+	return true;
+}
+
+bool ObjLoader::Reader::Open(const std::string& filename)
+{
+	if (!m_File.Open(filename))
+	{
+		std::cout << "Could not open " << filename << std::endl;
+		return false;
+	}
+	Rewind();
+	return true;
+}
+
+void ObjLoader::Reader::Rewind()
+{
+	m_pCurrent = m_File.GetData();
+	m_ReleasedSize = 0;
+	m_FaceIndices.clear();
+	m_NextFaceIndex = 0;
+	m_NumPositions = 0;
+}
+
+ObjLoader::Reader::Element ObjLoader::Reader::Next(Vector3& position, std::array<int, 3>& triangle)
+{
+	//The rest of a polygon that was split into several triangles comes first
+	if (m_NextFaceIndex < m_FaceIndices.size())
+	{
+		triangle = { m_FaceIndices[m_NextFaceIndex], m_FaceIndices[m_NextFaceIndex + 1], m_FaceIndices[m_NextFaceIndex + 2] };
+		m_NextFaceIndex += 3;
+		return Element::Triangle;
+	}
+
+	const size_t readSize{ static_cast<size_t>(m_pCurrent - m_File.GetData()) };
+	if (readSize - m_ReleasedSize >= g_ReaderReleaseSize)
+	{
+		m_File.AdviseDontNeed(m_ReleasedSize, readSize - m_ReleasedSize);
+		m_ReleasedSize = readSize;
+	}
+
+	const char* p{ m_pCurrent };
+	const char* pEnd{ m_File.GetData() + m_File.GetSize() };
+	while (p < pEnd)
+	{
+		p = SkipSpaces(p, pEnd);
+		if (pEnd - p >= 2 && IsSpace(p[1]))
+		{
+			if (p[0] == 'v')
+			{
+				p += 2;
+				if (!ParsePosition(p, pEnd, position))
+					return Element::Malformed;
+				m_pCurrent = SkipLine(p, pEnd);
+				++m_NumPositions;
+				return Element::Position;
+			}
+			if (p[0] == 'f')
+			{
+				p += 2;
+				//Negative indices are resolved against every position so far, so the relative slots need no fixup
+				m_FaceIndices.clear();
+				m_RelativeIndexSlots.clear();
+				if (!ParseFace(p, pEnd, m_NumPositions, m_FaceIndices, m_RelativeIndexSlots))
+					return Element::Malformed;
+				m_pCurrent = SkipLine(p, pEnd);
+				m_NextFaceIndex = 0;
+				return Next(position, triangle);
+			}
+		}
+		p = SkipLine(p, pEnd);
+	}
+
+	m_pCurrent = pEnd;
+	return Element::End;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+#include "MappedFile.h"
+
+namespace dae
+{
+	//Wavefront OBJ reader for large meshes
+	//The file is memory mapped, split into line-aligned chunks and the chunks are parsed on all cores.
+	//Faces accept every index form (v, v/vt, v//vn, v/vt/vn, negative indices) and polygons are fan triangulated.
+	//Only positions are kept: meshes shade with flat face normals, so vt and vn data is skipped.
+	namespace ObjLoader
+	{
+		struct Statistics
+		{
+			size_t numBytes{};
+			size_t numPositions{};
+			size_t numTriangles{};
+			float seconds{};
+
+			float GetMegabytesPerSecond() const { return seconds > 0.f ? numBytes / (1024.f * 1024.f) / seconds : 0.f; }
+		};
+
+		//Replaces the contents of positions, normals (one per triangle) and indices (three per triangle)
+		//Returns false, and leaves the output empty, when the file cannot be read or a face references a missing vertex
+		bool Load(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, Statistics* pStatistics = nullptr);
+
+		//Walks the file front to back one vertex or triangle at a time and keeps neither, for meshes larger than memory
+		//Single threaded, and triangle indices (zero-based, negative ones resolved) are not range checked
+		class Reader final
+		{
+		public:
+			enum class Element
+			{
+				Position,
+				Triangle,
+				End,
+				Malformed
+			};
+
+			Reader() = default;
+			~Reader() = default;
+
+			Reader(const Reader&) = delete;
+			Reader(Reader&&) noexcept = delete;
+			Reader& operator=(const Reader&) = delete;
+			Reader& operator=(Reader&&) noexcept = delete;
+
+			bool Open(const std::string& filename);
+			//Back to the first line, for another pass
+			void Rewind();
+			//Fills position or triangle, depending on what the next element is
+			Element Next(Vector3& position, std::array<int, 3>& triangle);
+
+		private:
+			MappedFile m_File{};
+			const char* m_pCurrent{};
+			//Everything before this has been handed back to the OS
+			size_t m_ReleasedSize{};
+			int m_NumPositions{};
+
+			//Triangles of the last face that were not handed out yet
+			std::vector<int> m_FaceIndices{};
+			std::vector<size_t> m_RelativeIndexSlots{};
+			size_t m_NextFaceIndex{};
+		};
+	}
+}
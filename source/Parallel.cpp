@@ -0,0 +1,173 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace dae;
+
+Parallel::BackgroundWorker::BackgroundWorker() :
+	m_Thread([this]() { Run(); })
+{
+}
+
+Parallel::BackgroundWorker::~BackgroundWorker()
+{
+	{
+		const std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_StateChanged.notify_all();
+	m_Thread.join();
+}
+
+void Parallel::BackgroundWorker::Start(void (*pTask)(void*), void* pContext)
+{
+	{
+		const std::lock_guard lock{ m_Mutex };
+		m_pTask = pTask;
+		m_pContext = pContext;
+		m_ThreadState = AllocationTracker::GetThreadState();
+		m_IsTaskPending = true;
+	}
+	m_StateChanged.notify_all();
+}
+
+void Parallel::BackgroundWorker::Wait()
+{
+	std::unique_lock lock{ m_Mutex };
+	m_StateChanged.wait(lock, [this]() { return !m_IsTaskPending; });
+}
+
+void Parallel::BackgroundWorker::Run()
+{
+	std::unique_lock lock{ m_Mutex };
+	while (true)
+	{
+		m_StateChanged.wait(lock, [this]() { return m_IsStopping || m_IsTaskPending; });
+		if (m_IsStopping)
+			return;
+
+		void (*pTask)(void*) { m_pTask };
+		void* pContext{ m_pContext };
+		const AllocationTracker::ThreadState threadState{ m_ThreadState };
+
+		lock.unlock();
+		{
+			const AllocationTracker::ThreadStateScope threadStateScope{ threadState };
+			pTask(pContext);
+		}
+		lock.lock();
+
+		m_IsTaskPending = false;
+		m_StateChanged.notify_all();
+	}
+}
+
+#if !defined(_MSC_VER)
+namespace
+{
+	//One thread less than there are cores, the thread that hands out the work does its share
+	class ThreadPool final
+	{
+	public:
+		ThreadPool()
+		{
+			const unsigned int numCores{ std::max(std::thread::hardware_concurrency(), 1u) };
+			m_Threads.reserve(numCores - 1);
+			for (unsigned int threadIndex{ 1 }; threadIndex < numCores; ++threadIndex)
+			{
+				m_Threads.emplace_back([this]() { RunWorker(); });
+			}
+		}
+
+		~ThreadPool()
+		{
+			{
+				const std::lock_guard lock{ m_Mutex };
+				m_IsStopping = true;
+			}
+			m_WorkAvailable.notify_all();
+
+			for (std::thread& thread : m_Threads)
+			{
+				thread.join();
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		bool Run(void (*pTask)(void*), void* pContext)
+		{
+			//Not a mutex, the thread that holds the pool can ask again from inside a task
+			if (m_IsBusy.exchange(true))
+				return false;
+
+			{
+				const std::lock_guard lock{ m_Mutex };
+				m_pTask = pTask;
+				m_pContext = pContext;
+				m_NumPendingThreads = m_Threads.size();
+				++m_Generation;
+			}
+			m_WorkAvailable.notify_all();
+
+			pTask(pContext);
+
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_WorkDone.wait(lock, [this]() { return m_NumPendingThreads == 0; });
+			}
+			m_IsBusy.store(false);
+			return true;
+		}
+
+	private:
+		std::vector<std::thread> m_Threads{};
+		std::atomic<bool> m_IsBusy{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WorkAvailable{};
+		std::condition_variable m_WorkDone{};
+		//Everything below is guarded by m_Mutex
+		void (*m_pTask)(void*) {};
+		void* m_pContext{};
+		size_t m_NumPendingThreads{};
+		//Counts up for every Run, so a worker can tell new work from the work it already did
+		uint64_t m_Generation{};
+		bool m_IsStopping{};
+
+		void RunWorker()
+		{
+			uint64_t doneGeneration{};
+			std::unique_lock lock{ m_Mutex };
+			while (true)
+			{
+				m_WorkAvailable.wait(lock, [&]() { return m_IsStopping || m_Generation != doneGeneration; });
+				if (m_IsStopping)
+					return;
+
+				doneGeneration = m_Generation;
+				void (*pTask)(void*) { m_pTask };
+				void* pContext{ m_pContext };
+
+				lock.unlock();
+				pTask(pContext);
+				lock.lock();
+
+				if (--m_NumPendingThreads == 0)
+					m_WorkDone.notify_one();
+			}
+		}
+	};
+}
+
+bool Parallel::RunOnAllThreads(void (*pTask)(void*), void* pContext)
+{
+	static ThreadPool pool{};
+	return pool.Run(pTask, pContext);
+}
+#endif
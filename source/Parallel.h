@@ -0,0 +1,93 @@
+#pragma once
+#if defined(_MSC_VER)
+#include <ppl.h>
+#else
+#include <atomic>
+#endif
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "AllocationTracker.h"
+
+namespace dae
+{
+	namespace Parallel
+	{
+#if !defined(_MSC_VER)
+		//Threads that are started once and then wait for work, so a ParallelFor does not start threads (or allocate)
+		//Runs pTask(pContext) on every one of them and on the calling thread at the same time and returns when all
+		//are done. Returns false without running anything when another thread or an outer ParallelFor has them.
+		bool RunOnAllThreads(void (*pTask)(void*), void* pContext);
+#endif
+
+		//A thread that is started once and runs one task at a time next to the thread that owns it, for work that
+		//overlaps something else every frame without starting a thread (or allocating) per frame
+		class BackgroundWorker final
+		{
+		public:
+			BackgroundWorker();
+			~BackgroundWorker();
+
+			BackgroundWorker(const BackgroundWorker&) = delete;
+			BackgroundWorker(BackgroundWorker&&) noexcept = delete;
+			BackgroundWorker& operator=(const BackgroundWorker&) = delete;
+			BackgroundWorker& operator=(BackgroundWorker&&) noexcept = delete;
+
+			//Runs pTask(pContext) on the worker with the allocation phase of the caller, Wait for the last task first
+			void Start(void (*pTask)(void*), void* pContext);
+			//Returns once the task of the last Start is done
+			void Wait();
+
+		private:
+			std::mutex m_Mutex{};
+			std::condition_variable m_StateChanged{};
+			//Everything below is guarded by m_Mutex
+			void (*m_pTask)(void*) {};
+			void* m_pContext{};
+			AllocationTracker::ThreadState m_ThreadState{};
+			bool m_IsTaskPending{};
+			bool m_IsStopping{};
+
+			//Declared last so everything it reads exists before it starts
+			std::thread m_Thread{};
+
+			void Run();
+		};
+	}
+
+	//Runs function(i) for every i in [begin, end) across all cores
+	//Uses the Concurrency Runtime on MSVC, a pool of std::thread workers everywhere else
+	template <typename Index, typename Function>
+	void ParallelFor(Index begin, Index end, const Function& function)
+	{
+		//Allocations on the workers are booked like those of the caller
+		const AllocationTracker::ThreadState threadState{ AllocationTracker::GetThreadState() };
+#if defined(_MSC_VER)
+		Concurrency::parallel_for(begin, end, [&](Index i)
+			{
+				const AllocationTracker::ThreadStateScope threadStateScope{ threadState };
+				function(i);
+			});
+#else
+		if (end <= begin)
+			return;
+
+		//Indices are handed out one at a time, so uneven work per index still balances
+		std::atomic<Index> nextIndex{ begin };
+		auto worker = [&]()
+		{
+			const AllocationTracker::ThreadStateScope threadStateScope{ threadState };
+			for (Index i{ nextIndex++ }; i < end; i = nextIndex++)
+			{
+				function(i);
+			}
+		};
+
+		//Busy workers mean the cores are taken already, the calling thread does it alone then
+		const auto runWorker = [](void* pWorker) { (*static_cast<decltype(worker)*>(pWorker))(); };
+		if (end - begin == 1 || !Parallel::RunOnAllThreads(runWorker, &worker))
+			worker();
+#endif
+	}
+}
@@ -0,0 +1,196 @@
+#include "RenderBenchmark.h"
+#include "AllocationTracker.h"
+#include "CameraPath.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace dae;
+
+namespace
+{
+	constexpr const char* g_SceneNames[]{ "W1", "W2", "W3", "W4_TestScene", "W4_ReferenceScene" };
+	constexpr int g_Width{ 640 };
+	constexpr int g_Height{ 480 };
+	constexpr float g_TimeStep{ 1.f / 30.f };
+	constexpr AllocationTracker::Phase g_AllocationPhases[]{ AllocationTracker::Phase::Update, AllocationTracker::Phase::Render, AllocationTracker::Phase::Present };
+	constexpr const char* g_AllocationPhaseNames[]{ "update", "render", "present" };
+
+	struct SceneResult
+	{
+		const char* pName{};
+		//Sorted
+		std::vector<float> frameMilliseconds{};
+		double renderSeconds{};
+		RenderStatistics statistics{};
+		double allocationsPerFrame[std::size(g_AllocationPhases)]{};
+	};
+
+	//Sweeps a third to the right and up while turning, then over to the left and down, and back to the start
+	CameraPath CreateCameraPath(const Camera& camera, float duration)
+	{
+		const auto createKeyframe{ [&camera](float time, const Vector3& offset, float pitch, float yaw)
+			{
+				return CameraPath::Keyframe{ time, camera.origin + offset, camera.totalPitch + pitch, camera.totalYaw + yaw, camera.fovAngle };
+			} };
+
+		CameraPath path{};
+		path.AddKeyframe(createKeyframe(0.f, {}, 0.f, 0.f));
+		path.AddKeyframe(createKeyframe(duration / 3.f, { 3.f, 1.f, 2.f }, .1f, -.3f));
+		path.AddKeyframe(createKeyframe(duration * 2.f / 3.f, { -3.f, -.5f, 1.f }, -.05f, .3f));
+		path.AddKeyframe(createKeyframe(duration, {}, 0.f, 0.f));
+		return path;
+	}
+
+	//Nearest rank, percentile in [0, 100]
+	float GetPercentile(const std::vector<float>& sortedValues, float percentile)
+	{
+		const size_t rank{ static_cast<size_t>(std::ceil(percentile / 100.f * sortedValues.size())) };
+		return sortedValues[std::clamp<size_t>(rank, 1, sortedValues.size()) - 1];
+	}
+
+	bool RunScene(const char* pName, int numFrames, SceneResult& result)
+	{
+		const std::unique_ptr<Scene> pScene{ CreateScene(pName) };
+		if (!pScene)
+		{
+			std::cout << "Could not create scene: " << pName << std::endl;
+			return false;
+		}
+		pScene->Initialize();
+		const CameraPath path{ CreateCameraPath(pScene->GetCamera(), numFrames * g_TimeStep) };
+
+		Renderer renderer{ g_Width, g_Height };
+		Timer timer{};
+		const auto advance{ [&](float timeStep)
+			{
+				const AllocationTracker::PhaseScope phaseScope{ AllocationTracker::Phase::Update };
+				timer.Step(timeStep);
+				path.Apply(timer.GetTotal(), pScene->GetCamera());
+				pScene->Update(&timer);
+				pScene->PublishFrame();
+			} };
+
+		//Untimed, fills the caches and buffers a first frame touches
+		advance(0.f);
+		renderer.Render(pScene.get());
+		renderer.ResetStatistics();
+
+		AllocationTracker::Counters allocationsAtStart[std::size(g_AllocationPhases)]{};
+		for (size_t i{}; i < std::size(g_AllocationPhases); ++i)
+		{
+			allocationsAtStart[i] = AllocationTracker::GetTotalCounters(g_AllocationPhases[i]);
+		}
+
+		result.pName = pName;
+		result.frameMilliseconds.reserve(numFrames);
+		for (int frame{}; frame < numFrames; ++frame)
+		{
+			{
+				//Only the untimed first update may allocate
+				const AllocationTracker::NoAllocationScope noAllocationScope{ "RenderBenchmark scene update" };
+				advance(g_TimeStep);
+			}
+
+			const auto start{ std::chrono::steady_clock::now() };
+			renderer.Render(pScene.get());
+			const std::chrono::duration<double> duration{ std::chrono::steady_clock::now() - start };
+			result.renderSeconds += duration.count();
+			result.frameMilliseconds.push_back(static_cast<float>(duration.count() * 1000.0));
+		}
+
+		std::sort(result.frameMilliseconds.begin(), result.frameMilliseconds.end());
+		result.statistics = renderer.GetStatistics();
+		for (size_t i{}; i < std::size(g_AllocationPhases); ++i)
+		{
+			const uint64_t numAllocations{ AllocationTracker::GetTotalCounters(g_AllocationPhases[i]).allocations - allocationsAtStart[i].allocations };
+			result.allocationsPerFrame[i] = static_cast<double>(numAllocations) / numFrames;
+		}
+		return true;
+	}
+
+	void WriteJson(std::ostream& stream, const std::vector<SceneResult>& results, int numFrames, unsigned int numThreads)
+	{
+		stream << "{\n"
+			<< "  \"threads\": " << numThreads << ",\n"
+			<< "  \"width\": " << g_Width << ",\n"
+			<< "  \"height\": " << g_Height << ",\n"
+			<< "  \"frames\": " << numFrames << ",\n"
+			<< "  \"timeStep\": " << g_TimeStep << ",\n"
+			<< "  \"scenes\": [\n";
+
+		for (size_t sceneIndex{}; sceneIndex < results.size(); ++sceneIndex)
+		{
+			const SceneResult& result{ results[sceneIndex] };
+			const std::vector<float>& frameMilliseconds{ result.frameMilliseconds };
+			double totalMilliseconds{};
+			for (const float milliseconds : frameMilliseconds)
+			{
+				totalMilliseconds += milliseconds;
+			}
+
+			stream << "    {\n"
+				<< "      \"name\": \"" << result.pName << "\",\n"
+				<< "      \"frameTimeMs\": { \"mean\": " << totalMilliseconds / frameMilliseconds.size()
+				<< ", \"min\": " << frameMilliseconds.front()
+				<< ", \"p50\": " << GetPercentile(frameMilliseconds, 50.f)
+				<< ", \"p90\": " << GetPercentile(frameMilliseconds, 90.f)
+				<< ", \"p99\": " << GetPercentile(frameMilliseconds, 99.f)
+				<< ", \"max\": " << frameMilliseconds.back() << " },\n"
+				<< "      \"primaryRaysPerSecond\": " << result.statistics.primaryRays / result.renderSeconds << ",\n"
+				<< "      \"shadowRaysPerSecond\": " << result.statistics.shadowRays / result.renderSeconds << ",\n"
+				<< "      \"heapAllocationsPerFrame\": {";
+			for (size_t i{}; i < std::size(g_AllocationPhases); ++i)
+			{
+				stream << (i == 0 ? " \"" : ", \"") << g_AllocationPhaseNames[i] << "\": " << result.allocationsPerFrame[i];
+			}
+			stream << " }\n"
+				<< "    }" << (sceneIndex + 1 < results.size() ? "," : "") << "\n";
+		}
+		stream << "  ]\n"
+			<< "}" << std::endl;
+	}
+}
+
+bool RenderBenchmark::Run(const std::string& jsonFilename, int numFrames)
+{
+	if (numFrames < 1)
+	{
+		std::cout << "Could not run the benchmark, it needs at least one frame" << std::endl;
+		return false;
+	}
+
+	const unsigned int numThreads{ std::max(std::thread::hardware_concurrency(), 1u) };
+	std::cout << "Rendering " << numFrames << " frames of every scene at " << g_Width << "x" << g_Height << " on " << numThreads << " threads" << std::endl;
+
+	std::vector<SceneResult> results(std::size(g_SceneNames));
+	for (size_t i{}; i < std::size(g_SceneNames); ++i)
+	{
+		if (!RunScene(g_SceneNames[i], numFrames, results[i]))
+			return false;
+
+		const SceneResult& result{ results[i] };
+		std::cout << "  " << result.pName << ": p50 " << GetPercentile(result.frameMilliseconds, 50.f)
+			<< " ms, p99 " << GetPercentile(result.frameMilliseconds, 99.f) << " ms, "
+			<< (result.statistics.primaryRays + result.statistics.shadowRays) / result.renderSeconds / 1'000'000.0 << " Mrays/s" << std::endl;
+	}
+
+	std::ofstream file{ jsonFilename };
+	if (!file)
+	{
+		std::cout << "Could not open " << jsonFilename << std::endl;
+		return false;
+	}
+	WriteJson(file, results, numFrames, numThreads);
+	std::cout << "Wrote " << jsonFilename << std::endl;
+	return true;
+}
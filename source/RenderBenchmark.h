@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	//Repeatable render timings for regression tracking: RayTracer --benchmark-render [json file] [numFrames]
+	//Every built-in scene is rendered without a window along the same scripted camera path, relative to the scene's
+	//own starting camera, with a fixed animation timestep. Only the renders are timed, the scene updates in between.
+	namespace RenderBenchmark
+	{
+		//Prints a line per scene and writes frame time percentiles, rays per second, heap allocations per frame and the
+		//thread count as JSON; returns false when a scene or the file can not be created
+		bool Run(const std::string& jsonFilename, int numFrames);
+	}
+}
@@ -9,12 +9,47 @@
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
+#include "Timer.h"
+#include "CacheMissCounter.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <climits>
+#include <iostream>
 #include <thread>
 #include <future>
-#include <ppl.h>
+#include <type_traits>
+#include "Parallel.h"
 
 using namespace dae;
 
+//Render reads these every frame, a copy would be a heap allocation per frame
+static_assert(std::is_lvalue_reference_v<decltype(std::declval<const Scene&>().GetMaterials())>, "Scene::GetMaterials must not copy");
+static_assert(std::is_lvalue_reference_v<decltype(std::declval<const Scene&>().GetLights())>, "Scene::GetLights must not copy");
+static_assert(std::is_lvalue_reference_v<decltype(std::declval<const Scene&>().GetTriangles())>, "Scene::GetTriangles must not copy");
+
+namespace
+{
+	//PCG hash, cheap decorrelated random bits per pixel, sample and frame
+	uint32_t HashPCG(uint32_t value)
+	{
+		const uint32_t state{ value * 747796405u + 2891336453u };
+		const uint32_t word{ ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u };
+		return (word >> 22u) ^ word;
+	}
+
+	float ToUnitFloat(uint32_t bits)
+	{
+		return static_cast<float>(bits >> 8) * (1.f / 16777216.f);
+	}
+
+	//Dirty region hulls: the 8 corners of a bounding box plus where each lands when pushed away from a light
+	constexpr int g_NumHullPoints{ 16 };
+	constexpr float g_HullNearDepth{ 0.01f };
+	constexpr float g_FootprintMissDistance{ 1000.f };
+}
+
 //#define ASYNC
 #define PARALELL_FOR
 
@@ -24,7 +59,66 @@ Renderer::Renderer(SDL_Window* pWindow) :
 {
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+	Initialize();
+}
+
+Renderer::Renderer(int width, int height) :
+	m_pBuffer(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888)),
+	m_OwnsBuffer(true),
+	m_Width(width),
+	m_Height(height)
+{
+	Initialize();
+}
+
+Renderer::~Renderer()
+{
+	if (m_OwnsBuffer)
+		SDL_FreeSurface(m_pBuffer);
+}
+
+void Renderer::Initialize()
+{
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+
+	m_SurfaceFormat.redShift = m_pBuffer->format->Rshift;
+	m_SurfaceFormat.greenShift = m_pBuffer->format->Gshift;
+	m_SurfaceFormat.blueShift = m_pBuffer->format->Bshift;
+	m_SurfaceFormat.alphaMask = m_pBuffer->format->Amask;
+
+	m_FrameBuffer.resize(static_cast<size_t>(m_Width) * m_Height);
+
+	//Reserve for full resolution once, scaling down only shrinks the used range
+	const size_t maxNumPixels{ static_cast<size_t>(m_Width) * m_Height };
+	m_RenderColors.reserve(maxNumPixels);
+	m_RenderDepths.reserve(maxNumPixels);
+	m_RenderNormals.reserve(maxNumPixels);
+	m_RenderPositions.reserve(maxNumPixels);
+	m_RenderAlbedos.reserve(maxNumPixels);
+	m_DenoisedColors.reserve(maxNumPixels);
+
+	ResizeRenderTarget(1.f);
+
+	//De-interleave the even (x) and odd (y) bits of every Morton code in a tile
+	const auto compactBits = [](uint32_t code)
+	{
+		code &= 0x55555555u;
+		code = (code | (code >> 1)) & 0x33333333u;
+		code = (code | (code >> 2)) & 0x0f0f0f0fu;
+		code = (code | (code >> 4)) & 0x00ff00ffu;
+		return code;
+	};
+
+	m_MortonTileOffsets.resize(m_TileSize * m_TileSize);
+	for (uint32_t code{}; code < m_MortonTileOffsets.size(); ++code)
+	{
+		m_MortonTileOffsets[code] = static_cast<uint16_t>(compactBits(code) | (compactBits(code >> 1) << 8));
+	}
+}
+
+void Renderer::Update(const Timer* pTimer)
+{
+	m_LastFrameTime = pTimer->GetElapsed();
 }
 
 
@@ -41,14 +135,205 @@ void Renderer::CycleLightningMode()
 	}
 
 	m_CurrentLightningMode = static_cast<LightningMode>(index);
+	InvalidateFrame();
+}
+
+void Renderer::ToggleTemporalCache()
+{
+	m_TemporalCacheEnabled = !m_TemporalCacheEnabled;
+	InvalidateFrame();
+}
+
+void Renderer::CycleDirtyRegionMode()
+{
+	switch (m_DirtyRegionMode)
+	{
+	case DirtyRegionMode::Disabled:
+		m_DirtyRegionMode = DirtyRegionMode::Enabled;
+		break;
+	case DirtyRegionMode::Enabled:
+		m_DirtyRegionMode = DirtyRegionMode::EnabledWithOverlay;
+		break;
+	case DirtyRegionMode::EnabledWithOverlay:
+		m_DirtyRegionMode = DirtyRegionMode::Disabled;
+		break;
+	}
+	InvalidateFrame();
+}
+
+void Renderer::ToggleDynamicResolution()
+{
+	m_DynamicResolutionEnabled = !m_DynamicResolutionEnabled;
+	m_ControllerScale = 1.f;
+}
+
+void Renderer::CycleToneMappingMode()
+{
+	switch (m_ToneMappingMode)
+	{
+	case ToneMappingMode::MaxToOne:
+		m_ToneMappingMode = ToneMappingMode::Reinhard;
+		break;
+	case ToneMappingMode::Reinhard:
+		m_ToneMappingMode = ToneMappingMode::ACES;
+		break;
+	case ToneMappingMode::ACES:
+		m_ToneMappingMode = ToneMappingMode::MaxToOne;
+		break;
+	}
+}
+
+void Renderer::TogglePixelTraversalOrder()
+{
+	m_PixelTraversalOrder = m_PixelTraversalOrder == PixelTraversalOrder::Morton ? PixelTraversalOrder::Scanline : PixelTraversalOrder::Morton;
+	std::cout << "Pixel traversal: " << (m_PixelTraversalOrder == PixelTraversalOrder::Morton ? "Morton" : "Scanline") << std::endl;
+}
+
+void Renderer::CycleSoftShadowSamples()
+{
+	m_SoftShadowSamples = m_SoftShadowSamples >= m_MaxSoftShadowSamples ? 0 : std::max(m_SoftShadowSamples * 2, 1);
+	std::cout << "Soft shadow samples: " << m_SoftShadowSamples << std::endl;
+	InvalidateFrame();
 }
 
-void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const
+void Renderer::ToggleDenoiser()
 {
-	const int px = pixelIndex % m_Width;
-	const int py = pixelIndex / m_Width;
-	const float cx{ (((2.f * (px + 0.5f)) / static_cast<float>(m_Width)) - 1.f) * aspectRatio * fov };
-	const float cy{ static_cast<float>(1.f - ((2.f * (py + 0.5f)) / static_cast<float>(m_Height))) * fov };
+	m_DenoiserEnabled = !m_DenoiserEnabled;
+	std::cout << "Denoiser: " << (m_DenoiserEnabled ? "on" : "off") << std::endl;
+}
+
+void Renderer::ProfilePixelTraversalOrders(Scene* pScene)
+{
+	//Renders the full frame once per order on this thread, the counters only see the calling thread
+	CacheMissCounter counter{};
+	if (!counter.IsAvailable())
+	{
+		std::cout << "Cache-miss counters are not available on this platform" << std::endl;
+		return;
+	}
+
+	const Camera& camera = pScene->GetRenderCamera();
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	const float aspectRatio{ static_cast<float>(m_Width) / static_cast<float>(m_Height) };
+	const float fov{ tanf((camera.fovAngle * TO_RADIANS) / 2.f) };
+
+	const PixelTraversalOrder previousOrder{ m_PixelTraversalOrder };
+	const bool wasTemporalCacheEnabled{ m_TemporalCacheEnabled };
+	m_TemporalCacheEnabled = false;
+	m_IsFullFrameDirty = true;
+
+	for (const PixelTraversalOrder order : { PixelTraversalOrder::Scanline, PixelTraversalOrder::Morton })
+	{
+		m_PixelTraversalOrder = order;
+
+		const auto start{ std::chrono::steady_clock::now() };
+		counter.Start();
+		for (uint32_t tileIndex{}; tileIndex < m_DirtyTiles.size(); ++tileIndex)
+		{
+			RenderTile(pScene, tileIndex, fov, aspectRatio, camera, lights, materials);
+		}
+		counter.Stop();
+		const std::chrono::duration<float, std::milli> duration{ std::chrono::steady_clock::now() - start };
+
+		std::cout << (order == PixelTraversalOrder::Morton ? "Morton:   " : "Scanline: ")
+			<< counter.GetCacheMisses() << " cache misses / " << counter.GetCacheReferences() << " references, "
+			<< duration.count() << " ms" << std::endl;
+	}
+
+	m_PixelTraversalOrder = previousOrder;
+	m_TemporalCacheEnabled = wasTemporalCacheEnabled;
+	InvalidateFrame();
+}
+
+void Renderer::InvalidateFrame()
+{
+	m_TemporalCache.Invalidate();
+	m_ForceFullFrame = true;
+}
+
+bool Renderer::HasCameraMoved(const Camera& camera)
+{
+	const bool hasCameraMoved{ (camera.origin - m_LastCameraOrigin).SqrMagnitude() > 0.f
+		|| (camera.forward - m_LastCameraForward).SqrMagnitude() > 0.f
+		|| camera.fovAngle != m_LastCameraFovAngle };
+
+	m_LastCameraOrigin = camera.origin;
+	m_LastCameraForward = camera.forward;
+	m_LastCameraFovAngle = camera.fovAngle;
+
+	return hasCameraMoved;
+}
+
+void Renderer::GetTileBounds(uint32_t tileIndex, int& tileX, int& tileY, int& endX, int& endY) const
+{
+	tileX = static_cast<int>(tileIndex) % m_NumTilesX * m_TileSize;
+	tileY = static_cast<int>(tileIndex) / m_NumTilesX * m_TileSize;
+	endX = std::min(tileX + m_TileSize, m_RenderWidth);
+	endY = std::min(tileY + m_TileSize, m_RenderHeight);
+}
+
+void Renderer::RenderTile(Scene* pScene, uint32_t tileIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials)
+{
+	const bool isTileDirty{ m_DirtyTiles[tileIndex] != 0 };
+	if (!m_IsFullFrameDirty && !isTileDirty)
+		return;
+
+	int tileX{}, tileY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, tileX, tileY, endX, endY);
+
+	//Something moved through this tile, whatever the cache holds here is stale
+	if (isTileDirty && m_TemporalCacheEnabled)
+		m_TemporalCache.Invalidate(tileX, tileY, endX, endY);
+
+	//Counted per tile, one atomic update per tile keeps contention out of the pixel loop
+	RenderStatistics statistics{};
+
+	if (m_PixelTraversalOrder == PixelTraversalOrder::Morton)
+	{
+		for (const uint16_t offset : m_MortonTileOffsets)
+		{
+			const int px{ tileX + (offset & 0xff) };
+			const int py{ tileY + (offset >> 8) };
+
+			//Edge tiles are partially outside the render target
+			if (px < endX && py < endY)
+				RenderPixel(pScene, px + py * m_RenderWidth, fov, aspectRatio, camera, lights, materials, statistics);
+		}
+	}
+	else
+	{
+		for (int py{ tileY }; py < endY; ++py)
+		{
+			for (int px{ tileX }; px < endX; ++px)
+			{
+				RenderPixel(pScene, px + py * m_RenderWidth, fov, aspectRatio, camera, lights, materials, statistics);
+			}
+		}
+	}
+
+	m_PrimaryRayCount += statistics.primaryRays;
+	m_ShadowRayCount += statistics.shadowRays;
+}
+
+void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, RenderStatistics& statistics)
+{
+	const int px = pixelIndex % m_RenderWidth;
+	const int py = pixelIndex / m_RenderWidth;
+
+	if (m_TemporalCacheEnabled && !m_TemporalCache.NeedsTrace(pixelIndex))
+	{
+		m_RenderColors[pixelIndex] = m_TemporalCache.GetColor(pixelIndex);
+		m_RenderDepths[pixelIndex] = m_TemporalCache.GetDepth(pixelIndex);
+		m_RenderNormals[pixelIndex] = m_TemporalCache.GetNormal(pixelIndex);
+		m_RenderPositions[pixelIndex] = m_TemporalCache.GetPosition(pixelIndex);
+		m_RenderAlbedos[pixelIndex] = m_TemporalCache.GetAlbedo(pixelIndex);
+		return;
+	}
+
+	const float cx{ (((2.f * (px + 0.5f)) / static_cast<float>(m_RenderWidth)) - 1.f) * aspectRatio * fov };
+	const float cy{ static_cast<float>(1.f - ((2.f * (py + 0.5f)) / static_cast<float>(m_RenderHeight))) * fov };
 	Vector3 rayDirection{ cx, cy,1.f };
 	rayDirection.Normalize();
 	rayDirection = camera.cameraToWorld.TransformVector(rayDirection);
@@ -64,6 +349,7 @@ void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, f
 	ColorRGB finalColor{};
 
 	pScene->GetClosestHit(viewRay, closestHit);
+	++statistics.primaryRays;
 
 	if (closestHit.didHit)
 	{
@@ -75,10 +361,11 @@ void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, f
 
 			const float lightDirectionMag{ lightDirection.Normalize() };
 
+			float visibility{ 1.f };
 			if (m_ShadowsEnabled)
 			{
-				Ray invDirectionLight{ originOffset, LightUtils::GetDirectionToLight(light, originOffset).Normalized(), 0.0001f, lightDirectionMag };
-				if (pScene->DoesHit(invDirectionLight))
+				visibility = GetLightVisibility(pScene, light, originOffset, lightDirectionMag, pixelIndex, statistics);
+				if (visibility <= 0.f)
 				{
 					continue;
 				}
@@ -90,97 +377,520 @@ void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, f
 				continue;
 
 
+			ColorRGB lightColor{};
 			switch (m_CurrentLightningMode)
 			{
 			case LightningMode::Combined:
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin) * materials[closestHit.materialIndex]
+				lightColor = LightUtils::GetRadiance(light, closestHit.origin) * materials[closestHit.materialIndex]
 					->Shade(closestHit, lightDirection, invRayDirection) * observedArea;
 				break;
 			case LightningMode::BDRF:
-				finalColor += materials[closestHit.materialIndex]->Shade(closestHit, lightDirection, invRayDirection);
+				lightColor = materials[closestHit.materialIndex]->Shade(closestHit, lightDirection, invRayDirection);
 				break;
 			case LightningMode::ObservedArea:
-				finalColor += ColorRGB(observedArea, observedArea, observedArea);
+				lightColor = ColorRGB(observedArea, observedArea, observedArea);
 				break;
 			case LightningMode::Radiance:
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin);
+				lightColor = LightUtils::GetRadiance(light, closestHit.origin);
 				break;
 			}
+			finalColor += lightColor * visibility;
 		}
 	}
 
-	//Update Color in Buffer
-	finalColor.MaxToOne();
+	const ColorRGB albedo{ closestHit.didHit ? materials[closestHit.materialIndex]->GetAlbedo() : ColorRGB{} };
+
+	if (m_TemporalCacheEnabled)
+		m_TemporalCache.Store(pixelIndex, closestHit, finalColor, albedo, closestHit.didHit && materials[closestHit.materialIndex]->IsViewDependent());
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+	m_RenderColors[pixelIndex] = finalColor;
+	m_RenderDepths[pixelIndex] = closestHit.t;
+	m_RenderNormals[pixelIndex] = closestHit.didHit ? closestHit.normal : Vector3{};
+	m_RenderPositions[pixelIndex] = closestHit.origin;
+	m_RenderAlbedos[pixelIndex] = albedo;
 }
 
+float Renderer::GetLightVisibility(Scene* pScene, const Light& light, const Vector3& origin, float lightDistance, uint32_t pixelIndex, RenderStatistics& statistics) const
+{
+	//Hard shadows: a single ray towards the light's center
+	if (m_SoftShadowSamples == 0 || light.type != LightType::Point || light.radius <= 0.f)
+	{
+		const Ray shadowRay{ origin, LightUtils::GetDirectionToLight(light, origin).Normalized(), 0.0001f, lightDistance };
+		++statistics.shadowRays;
+		return pScene->DoesHit(shadowRay) ? 0.f : 1.f;
+	}
+
+	//Soft shadows: jittered rays towards a disk of light.radius facing the shaded point
+	const Vector3 toLight{ (light.origin - origin).Normalized() };
+	const Vector3 tangent{ Vector3::Cross(std::abs(toLight.x) > 0.9f ? Vector3::UnitY : Vector3::UnitX, toLight).Normalized() };
+	const Vector3 bitangent{ Vector3::Cross(toLight, tangent) };
 
-void Renderer::Render(Scene* pScene) const
+	int numVisibleSamples{};
+	for (int sampleIndex{}; sampleIndex < m_SoftShadowSamples; ++sampleIndex)
+	{
+		const uint32_t seed{ HashPCG(pixelIndex * m_MaxSoftShadowSamples + sampleIndex + HashPCG(m_FrameIndex)) };
+		const float sampleRadius{ light.radius * sqrtf(ToUnitFloat(seed)) };
+		const float sampleAngle{ PI_2 * ToUnitFloat(HashPCG(seed)) };
+
+		const Vector3 samplePoint{ light.origin + tangent * (cosf(sampleAngle) * sampleRadius) + bitangent * (sinf(sampleAngle) * sampleRadius) };
+		Vector3 sampleDirection{ samplePoint - origin };
+		const float sampleDistance{ sampleDirection.Normalize() };
+
+		const Ray shadowRay{ origin, sampleDirection, 0.0001f, sampleDistance };
+		++statistics.shadowRays;
+		if (!pScene->DoesHit(shadowRay))
+			++numVisibleSamples;
+	}
+
+	return static_cast<float>(numVisibleSamples) / static_cast<float>(m_SoftShadowSamples);
+}
+
+
+void Renderer::Render(Scene* pScene)
 {
-	Camera& camera = pScene->GetCamera();
+	const AllocationTracker::PhaseScope phaseScope{ AllocationTracker::Phase::Render };
+	const Camera& camera = pScene->GetRenderCamera();
 	auto& materials = pScene->GetMaterials();
 	auto& lights = pScene->GetLights();
 
 	const float aspectRatio{ static_cast<float>(m_Width) / static_cast<float>(m_Height) };
 	const float fov{ tanf((camera.fovAngle * TO_RADIANS) / 2.f) };
 
-	const uint32_t numPixels{ static_cast<uint32_t>(m_Width * m_Height) };
+	const bool hasCameraMoved{ HasCameraMoved(camera) };
+	UpdateResolutionScale(hasCameraMoved);
+	UpdateDirtyTiles(pScene, camera, fov, aspectRatio, hasCameraMoved);
+
+	const uint32_t numTiles{ static_cast<uint32_t>(m_NumTilesX * m_NumTilesY) };
+
+	//With a static camera the cache already matches the screen, only dirty tiles need work
+	if (m_TemporalCacheEnabled && m_IsFullFrameDirty)
+		m_TemporalCache.Reproject(camera, fov, aspectRatio);
+
+	//Tracing and presenting only read the published frame and write buffers that are already sized, a change of
+	//resolution scale above is the only thing that allocates (std::async does as well, so not with ASYNC)
+#if !defined(ASYNC)
+	const AllocationTracker::NoAllocationScope noAllocationScope{ "Renderer::Render" };
+#endif
 
 #if defined(ASYNC)
 	//async
 	const uint32_t numCores = std::thread::hardware_concurrency();
 	std::vector<std::future<void>> async_futures{};
 
-	const uint32_t numPixelPerTask = numPixels / numCores;
-	uint32_t numUnassignedPixels = numPixels % numCores;
-	uint32_t currentPixelIndex = 0;
+	const uint32_t numTilesPerTask = numTiles / numCores;
+	uint32_t numUnassignedTiles = numTiles % numCores;
+	uint32_t currentTileIndex = 0;
 
 	for (uint32_t coreId{ 0 }; coreId < numCores; coreId++)
 	{
-		uint32_t taskSize = numPixelPerTask;
-		if (numUnassignedPixels > 0)
+		uint32_t taskSize = numTilesPerTask;
+		if (numUnassignedTiles > 0)
 		{
 			++taskSize;
-			--numUnassignedPixels;
+			--numUnassignedTiles;
 		}
 
 		async_futures.push_back(
-			std::async(std::launch::async, [=, this]
+			std::async(std::launch::async, [=, this, &lights, &materials]
 				{
-					const uint32_t pixelIndexEnd = currentPixelIndex + taskSize;
-					for (uint32_t pixelIndex{ currentPixelIndex }; pixelIndex < pixelIndexEnd; pixelIndex++)
+					const uint32_t tileIndexEnd = currentTileIndex + taskSize;
+					for (uint32_t tileIndex{ currentTileIndex }; tileIndex < tileIndexEnd; tileIndex++)
 					{
-						RenderPixel(pScene, pixelIndex, fov, aspectRatio, camera, lights, materials);
+						RenderTile(pScene, tileIndex, fov, aspectRatio, camera, lights, materials);
 					}
 				})
 		);
-		currentPixelIndex += taskSize;
+		currentTileIndex += taskSize;
 	}
 #elif defined(PARALELL_FOR)
 	//paralell
 
-	Concurrency::parallel_for(0u, numPixels, [=, this](int i)
+	ParallelFor(0u, numTiles, [=, this, &lights, &materials](int i)
 		{
-			RenderPixel(pScene, i, fov, aspectRatio, camera, lights, materials);
+			RenderTile(pScene, i, fov, aspectRatio, camera, lights, materials);
 		});
 #else
 	//syncronous
-	for (uint32_t i{}; i < numPixels; ++i)
+	for (uint32_t i{}; i < numTiles; ++i)
 	{
-		RenderPixel(pScene, i, fov, aspectRatio, camera, lights, materials);
+		RenderTile(pScene, i, fov, aspectRatio, camera, lights, materials);
 	}
 #endif
 
+	Present();
+	++m_FrameIndex;
+}
+
+void Renderer::Present()
+{
+	const AllocationTracker::PhaseScope phaseScope{ AllocationTracker::Phase::Present };
+	if (m_DenoiserEnabled)
+	{
+		m_Denoiser.Apply(m_RenderColors.data(), m_RenderAlbedos.data(), m_RenderNormals.data(), m_RenderPositions.data(), m_RenderDepths.data(), m_DenoisedColors.data());
+	}
+
+	ResolveToSurface();
+
+	if (m_DirtyRegionMode == DirtyRegionMode::EnabledWithOverlay)
+		DrawDirtyTileOverlay();
+
 	//@END
 	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	if (m_pWindow)
+		SDL_UpdateWindowSurface(m_pWindow);
 }
 
-bool Renderer::SaveBufferToImage() const
+#pragma region Distributed Rendering
+uint32_t Renderer::GetTilePixelCount(uint32_t tileIndex) const
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
-}
\ No newline at end of file
+	int tileX{}, tileY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, tileX, tileY, endX, endY);
+	return static_cast<uint32_t>((endX - tileX) * (endY - tileY));
+}
+
+void Renderer::RenderTileRange(Scene* pScene, uint32_t firstTile, uint32_t endTile)
+{
+	//A worker only sees scattered ranges, so every tile it is handed is traced in full
+	if (m_ResolutionScale != 1.f)
+		ResizeRenderTarget(1.f);
+	m_IsFullFrameDirty = true;
+
+	const AllocationTracker::PhaseScope phaseScope{ AllocationTracker::Phase::Render };
+	const Camera& camera = pScene->GetRenderCamera();
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	const float aspectRatio{ static_cast<float>(m_Width) / static_cast<float>(m_Height) };
+	const float fov{ tanf((camera.fovAngle * TO_RADIANS) / 2.f) };
+
+	ParallelFor(firstTile, std::min(endTile, GetNumTiles()), [=, this, &lights, &materials](uint32_t i)
+		{
+			RenderTile(pScene, i, fov, aspectRatio, camera, lights, materials);
+		});
+}
+
+void Renderer::ReadTile(uint32_t tileIndex, ColorRGB* pColors) const
+{
+	int tileX{}, tileY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, tileX, tileY, endX, endY);
+
+	for (int py{ tileY }; py < endY; ++py)
+	{
+		const auto rowBegin{ m_RenderColors.begin() + (tileX + py * m_RenderWidth) };
+		pColors = std::copy(rowBegin, rowBegin + (endX - tileX), pColors);
+	}
+}
+
+void Renderer::WriteTile(uint32_t tileIndex, const ColorRGB* pColors)
+{
+	int tileX{}, tileY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, tileX, tileY, endX, endY);
+
+	for (int py{ tileY }; py < endY; ++py)
+	{
+		std::copy(pColors, pColors + (endX - tileX), m_RenderColors.begin() + (tileX + py * m_RenderWidth));
+		pColors += endX - tileX;
+	}
+}
+#pragma endregion
+
+#pragma region Dirty Regions
+void Renderer::UpdateDirtyTiles(Scene* pScene, const Camera& camera, float fov, float aspectRatio, bool hasCameraMoved)
+{
+	m_IsFullFrameDirty = m_ForceFullFrame || hasCameraMoved || m_DirtyRegionMode == DirtyRegionMode::Disabled;
+	m_ForceFullFrame = false;
+
+	//Without dirty regions every tile is traced anyway, but the temporal cache still has to drop the pixels a moving
+	//mesh covered or uncovered, so the dirty tiles are found for it as well
+	std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), static_cast<uint8_t>(0));
+	if (m_DirtyRegionMode == DirtyRegionMode::Disabled && !m_TemporalCacheEnabled)
+		return;
+
+	for (const TriangleMesh& mesh : pScene->GetRenderTriangleMeshes())
+	{
+		if (!mesh.hasTransformChanged)
+			continue;
+
+		int minX{ INT_MAX }, minY{ INT_MAX }, maxX{ INT_MIN }, maxY{ INT_MIN };
+
+		//Screen bounds of where the mesh was and where it is now
+		const Vector3 bounds[2][2]{ { mesh.previousMinAABB, mesh.previousMaxAABB }, { mesh.minAABB, mesh.maxAABB } };
+		for (const auto& box : bounds)
+		{
+			std::array<Vector3, g_NumHullPoints> hull{};
+			for (int cornerIndex{}; cornerIndex < 8; ++cornerIndex)
+			{
+				hull[cornerIndex] = Vector3{
+					(cornerIndex & 1) ? box[1].x : box[0].x,
+					(cornerIndex & 2) ? box[1].y : box[0].y,
+					(cornerIndex & 4) ? box[1].z : box[0].z };
+			}
+
+			if (!m_ShadowsEnabled)
+			{
+				MarkDirtyHull(hull.data(), 8, camera, fov, aspectRatio, minX, minY, maxX, maxY);
+				continue;
+			}
+
+			//Shadow footprint: follow each corner away from the light until it lands on a receiver, the box and those
+			//receiver points span everything the light can no longer reach
+			for (const Light& light : pScene->GetLights())
+			{
+				for (int cornerIndex{}; cornerIndex < 8; ++cornerIndex)
+				{
+					const Vector3& corner{ hull[cornerIndex] };
+					const Vector3 awayFromLight{ -LightUtils::GetDirectionToLight(light, corner).Normalized() };
+
+					//Skip past the box itself so the mesh does not catch its own footprint
+					float tExit{ FLT_MAX };
+					for (int axis{}; axis < 3; ++axis)
+					{
+						if (awayFromLight[axis] > 0.f)
+							tExit = std::min(tExit, (box[1][axis] - corner[axis]) / awayFromLight[axis]);
+						else if (awayFromLight[axis] < 0.f)
+							tExit = std::min(tExit, (box[0][axis] - corner[axis]) / awayFromLight[axis]);
+					}
+
+					const Ray footprintRay{ corner, awayFromLight, tExit + 0.0001f };
+					HitRecord receiver{};
+					pScene->GetClosestHit(footprintRay, receiver);
+
+					//A ray that leaves the scene still bounds the receivers next to it, so it ends far away instead
+					hull[8 + cornerIndex] = receiver.didHit ? receiver.origin : corner + awayFromLight * g_FootprintMissDistance;
+				}
+
+				MarkDirtyHull(hull.data(), g_NumHullPoints, camera, fov, aspectRatio, minX, minY, maxX, maxY);
+			}
+		}
+
+		//One pixel of padding for rounding, then clip to the screen
+		minX = std::max(minX - 1, 0);
+		minY = std::max(minY - 1, 0);
+		maxX = std::min(maxX + 1, m_RenderWidth - 1);
+		maxY = std::min(maxY + 1, m_RenderHeight - 1);
+		if (minX > maxX || minY > maxY)
+			continue;
+
+		for (int tileY{ minY / m_TileSize }; tileY <= maxY / m_TileSize; ++tileY)
+		{
+			for (int tileX{ minX / m_TileSize }; tileX <= maxX / m_TileSize; ++tileX)
+			{
+				m_DirtyTiles[tileX + tileY * m_NumTilesX] = 1;
+			}
+		}
+	}
+}
+
+bool Renderer::MarkDirtyPoint(const Vector3& point, const Camera& camera, float fov, float aspectRatio, int& minX, int& minY, int& maxX, int& maxY) const
+{
+	float screenX{}, screenY{};
+	if (!camera.WorldToScreen(point, fov, aspectRatio, m_RenderWidth, m_RenderHeight, screenX, screenY))
+		return false;
+
+	//Keep far off-screen points from overflowing the integer bounds
+	screenX = std::clamp(screenX, -1.f, static_cast<float>(m_RenderWidth));
+	screenY = std::clamp(screenY, -1.f, static_cast<float>(m_RenderHeight));
+
+	minX = std::min(minX, static_cast<int>(floorf(screenX)));
+	minY = std::min(minY, static_cast<int>(floorf(screenY)));
+	maxX = std::max(maxX, static_cast<int>(floorf(screenX)));
+	maxY = std::max(maxY, static_cast<int>(floorf(screenY)));
+	return true;
+}
+
+void Renderer::MarkDirtyHull(const Vector3* pPoints, int numPoints, const Camera& camera, float fov, float aspectRatio, int& minX, int& minY, int& maxX, int& maxY) const
+{
+	//Clip the hull against a plane just in front of the camera: the points in front of it plus every place an edge
+	//crosses it bound the visible part, so geometry behind the camera widens the bounds to the screen edge instead
+	//of dropping the whole frame
+	std::array<float, g_NumHullPoints> depths{};
+	for (int index{}; index < numPoints; ++index)
+	{
+		depths[index] = camera.GetViewDepth(pPoints[index]) - g_HullNearDepth;
+		if (depths[index] >= 0.f)
+			MarkDirtyPoint(pPoints[index], camera, fov, aspectRatio, minX, minY, maxX, maxY);
+	}
+
+	//Without the real edges every pair is clipped, crossings of inner diagonals still lie inside the hull
+	for (int first{}; first < numPoints; ++first)
+	{
+		for (int second{ first + 1 }; second < numPoints; ++second)
+		{
+			if ((depths[first] >= 0.f) == (depths[second] >= 0.f))
+				continue;
+
+			const float t{ depths[first] / (depths[first] - depths[second]) };
+			const Vector3 crossing{ pPoints[first] + (pPoints[second] - pPoints[first]) * t };
+			MarkDirtyPoint(crossing, camera, fov, aspectRatio, minX, minY, maxX, maxY);
+		}
+	}
+}
+
+void Renderer::DrawDirtyTileOverlay()
+{
+	//Drawn straight onto the surface, the next resolve overwrites it again
+	const uint32_t overlayColor{ SDL_MapRGB(m_pBuffer->format, 255, 0, 255) };
+
+	for (int tileY{}; tileY < m_NumTilesY; ++tileY)
+	{
+		for (int tileX{}; tileX < m_NumTilesX; ++tileX)
+		{
+			if (!m_IsFullFrameDirty && !m_DirtyTiles[tileX + tileY * m_NumTilesX])
+				continue;
+
+			//Outline the top and left edge in window space, neighbouring tiles close the grid
+			const int startX{ tileX * m_TileSize * m_Width / m_RenderWidth };
+			const int startY{ tileY * m_TileSize * m_Height / m_RenderHeight };
+			const int endX{ std::min((tileX + 1) * m_TileSize * m_Width / m_RenderWidth, m_Width) };
+			const int endY{ std::min((tileY + 1) * m_TileSize * m_Height / m_RenderHeight, m_Height) };
+
+			for (int px{ startX }; px < endX; ++px)
+			{
+				m_pBufferPixels[px + startY * m_Width] = overlayColor;
+			}
+
+			for (int py{ startY + 1 }; py < endY; ++py)
+			{
+				m_pBufferPixels[startX + py * m_Width] = overlayColor;
+			}
+		}
+	}
+}
+#pragma endregion
+
+#pragma region Dynamic Resolution
+void Renderer::UpdateResolutionScale(bool hasCameraMoved)
+{
+	float resolutionScale{ 1.f };
+
+	if (m_DynamicResolutionEnabled && m_LastFrameTime > 0.f)
+	{
+		//Pixel count scales with the square of the scale, hysteresis keeps it from flip-flopping
+		if (m_LastFrameTime > m_TargetFrameTime * 1.1f)
+			m_ControllerScale = std::max(m_ControllerScale - m_ResolutionScaleStep, m_MinResolutionScale);
+		else if (m_LastFrameTime < m_TargetFrameTime * 0.7f)
+			m_ControllerScale = std::min(m_ControllerScale + m_ResolutionScaleStep, 1.f);
+
+		//Drop immediately while moving, a static camera recovers one step per frame
+		resolutionScale = hasCameraMoved ? std::min(m_ControllerScale, m_MotionResolutionScale) : m_ControllerScale;
+	}
+
+	if (resolutionScale != m_ResolutionScale)
+		ResizeRenderTarget(resolutionScale);
+}
+
+void Renderer::ResizeRenderTarget(float resolutionScale)
+{
+	m_ResolutionScale = resolutionScale;
+	m_RenderWidth = std::max(static_cast<int>(static_cast<float>(m_Width) * resolutionScale), 1);
+	m_RenderHeight = std::max(static_cast<int>(static_cast<float>(m_Height) * resolutionScale), 1);
+
+	const size_t numPixels{ static_cast<size_t>(m_RenderWidth) * m_RenderHeight };
+	m_RenderColors.resize(numPixels);
+	m_RenderDepths.resize(numPixels);
+	m_RenderNormals.resize(numPixels);
+	m_RenderPositions.resize(numPixels);
+	m_RenderAlbedos.resize(numPixels);
+	m_DenoisedColors.resize(numPixels);
+
+	m_TemporalCache.Resize(m_RenderWidth, m_RenderHeight);
+	m_Denoiser.Resize(m_RenderWidth, m_RenderHeight);
+
+	m_NumTilesX = (m_RenderWidth + m_TileSize - 1) / m_TileSize;
+	m_NumTilesY = (m_RenderHeight + m_TileSize - 1) / m_TileSize;
+	m_DirtyTiles.resize(static_cast<size_t>(m_NumTilesX) * m_NumTilesY);
+
+	m_ForceFullFrame = true;
+}
+
+void Renderer::ResolveToSurface()
+{
+	const bool isFullResolution{ m_RenderWidth == m_Width && m_RenderHeight == m_Height };
+	if (!isFullResolution)
+	{
+		ParallelFor(0, m_Height, [this](int py)
+			{
+				UpscaleRow(py);
+			});
+	}
+
+	ParallelFor(0, m_Height, [this](int py)
+		{
+			PackRow(py);
+		});
+}
+
+void Renderer::UpscaleRow(int py)
+{
+	const float scaleX{ static_cast<float>(m_RenderWidth) / static_cast<float>(m_Width) };
+	const float scaleY{ static_cast<float>(m_RenderHeight) / static_cast<float>(m_Height) };
+
+	const float sourceY{ std::max((static_cast<float>(py) + 0.5f) * scaleY - 0.5f, 0.f) };
+	const int y0{ std::min(static_cast<int>(sourceY), m_RenderHeight - 1) };
+	const int y1{ std::min(y0 + 1, m_RenderHeight - 1) };
+	const float fy{ sourceY - static_cast<float>(y0) };
+
+	for (int px{}; px < m_Width; ++px)
+	{
+		//Bilinear taps, down-weighted when their depth differs from the nearest tap so edges stay sharp
+		const float sourceX{ std::max((static_cast<float>(px) + 0.5f) * scaleX - 0.5f, 0.f) };
+		const int x0{ std::min(static_cast<int>(sourceX), m_RenderWidth - 1) };
+		const int x1{ std::min(x0 + 1, m_RenderWidth - 1) };
+		const float fx{ sourceX - static_cast<float>(x0) };
+
+		const int tapIndices[4]{ x0 + y0 * m_RenderWidth, x1 + y0 * m_RenderWidth, x0 + y1 * m_RenderWidth, x1 + y1 * m_RenderWidth };
+		const float tapWeights[4]{ (1.f - fx) * (1.f - fy), fx * (1.f - fy), (1.f - fx) * fy, fx * fy };
+		const int nearestTap{ (fx < 0.5f ? 0 : 1) + (fy < 0.5f ? 0 : 2) };
+		const float nearestDepth{ m_RenderDepths[tapIndices[nearestTap]] };
+
+		ColorRGB finalColor{};
+		float totalWeight{};
+		for (int tap{}; tap < 4; ++tap)
+		{
+			const float tapDepth{ m_RenderDepths[tapIndices[tap]] };
+			const float relativeDepth{ tapDepth == nearestDepth ? 0.f : fabsf(tapDepth - nearestDepth) / std::min(tapDepth, nearestDepth) };
+			const float weight{ tapWeights[tap] / (1.f + 50.f * relativeDepth) };
+
+			finalColor += GetResolveColors()[tapIndices[tap]] * weight;
+			totalWeight += weight;
+		}
+
+		m_FrameBuffer[px + py * m_Width] = finalColor / totalWeight;
+	}
+}
+
+void Renderer::PackRow(int py)
+{
+	//At full resolution the render target already is the frame buffer
+	const bool isFullResolution{ m_RenderWidth == m_Width && m_RenderHeight == m_Height };
+	const ColorRGB* pSource{ (isFullResolution ? GetResolveColors().data() : m_FrameBuffer.data()) + py * m_Width };
+
+	ToneMappingUtils::PackRow(pSource, m_pBufferPixels + py * m_Width, m_Width, m_ToneMappingMode, m_SurfaceFormat);
+}
+#pragma endregion
+
+std::string Renderer::SaveBufferToImage(ImageFormat format)
+{
+	const std::string filename{ m_ImageWriter.GetNextSequenceFilename("RayTracing_Buffer", format) };
+	SaveBufferToImage(filename, format);
+	return filename;
+}
+
+void Renderer::SaveBufferToImage(const std::string& filename, ImageFormat format)
+{
+	if (format == ImageFormat::PFM)
+	{
+		//HDR colors at window resolution, before tonemapping
+		const bool isFullResolution{ m_RenderWidth == m_Width && m_RenderHeight == m_Height };
+		const ColorRGB* pColors{ isFullResolution ? GetResolveColors().data() : m_FrameBuffer.data() };
+		m_ImageWriter.Write(filename, m_Width, m_Height, std::vector<ColorRGB>(pColors, pColors + static_cast<size_t>(m_Width) * m_Height));
+		return;
+	}
+
+	m_ImageWriter.Write(filename, format, m_Width, m_Height, std::vector<uint32_t>(m_pBufferPixels, m_pBufferPixels + static_cast<size_t>(m_Width) * m_Height), m_SurfaceFormat);
+}
+
+void Renderer::SaveBufferToVideo(VideoWriter& writer) const
+{
+	writer.WriteFrame(std::vector<uint32_t>(m_pBufferPixels, m_pBufferPixels + static_cast<size_t>(m_Width) * m_Height), m_SurfaceFormat);
+}
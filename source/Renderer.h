@@ -1,38 +1,176 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <string>
 #include <vector>
 
+#include "Denoiser.h"
+#include "ImageWriter.h"
+#include "TemporalCache.h"
+#include "ToneMapping.h"
+#include "VideoWriter.h"
+
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
 	class Scene;
+	class Timer;
 	struct Camera;
 	struct Light;
 	class Material;
 
+	struct RenderStatistics
+	{
+		uint64_t primaryRays{};
+		uint64_t shadowRays{};
+	};
+
 	class Renderer final
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		//Headless: renders into an off-screen surface, nothing is presented
+		Renderer(int width, int height);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
-		bool SaveBufferToImage() const;
+		void Update(const Timer* pTimer);
+		void Render(Scene* pScene);
+		//Both copy the current frame and return right away, the file is written on the image writer thread
+		std::string SaveBufferToImage(ImageFormat format = ImageFormat::PNG);
+		void SaveBufferToImage(const std::string& filename, ImageFormat format);
+		void FlushImages() { m_ImageWriter.Flush(); }
+		void SaveBufferToVideo(VideoWriter& writer) const;
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+
+		RenderStatistics GetStatistics() const { return { m_PrimaryRayCount.load(), m_ShadowRayCount.load() }; }
+		void ResetStatistics() { m_PrimaryRayCount = 0; m_ShadowRayCount = 0; }
 
 		void CycleLightningMode();
-		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; };
+		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; InvalidateFrame(); };
+		void ToggleTemporalCache();
+		void CycleDirtyRegionMode();
+		void ToggleDynamicResolution();
+		void CycleToneMappingMode();
+		void TogglePixelTraversalOrder();
+		void CycleSoftShadowSamples();
+		void ToggleDenoiser();
+		void SetSoftShadowSamples(int numSamples) { m_SoftShadowSamples = std::clamp(numSamples, 0, m_MaxSoftShadowSamples); InvalidateFrame(); }
+		void SetDenoiserEnabled(bool isEnabled) { m_DenoiserEnabled = isEnabled; }
+		//Batch renders seed the soft shadows with the frame number, so every process picks the same samples for a frame
+		void SetFrameIndex(uint32_t frameIndex) { m_FrameIndex = frameIndex; }
+		void ProfilePixelTraversalOrders(Scene* pScene);
+		void SetTargetFrameTime(float targetFrameTime) { m_TargetFrameTime = targetFrameTime; }
 
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
+		//Distributed rendering: workers trace tile ranges, the coordinator merges their tiles and presents
+		uint32_t GetNumTiles() const { return static_cast<uint32_t>(m_NumTilesX * m_NumTilesY); }
+		uint32_t GetTilePixelCount(uint32_t tileIndex) const;
+		void RenderTileRange(Scene* pScene, uint32_t firstTile, uint32_t endTile);
+		//Tile pixels are copied row by row, GetTilePixelCount(tileIndex) colors per tile
+		void ReadTile(uint32_t tileIndex, ColorRGB* pColors) const;
+		void WriteTile(uint32_t tileIndex, const ColorRGB* pColors);
+		void Present();
+
+		void RenderTile(Scene* pScene, uint32_t tileIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials);
+		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, RenderStatistics& statistics);
+		float GetLightVisibility(Scene* pScene, const Light& light, const Vector3& origin, float lightDistance, uint32_t pixelIndex, RenderStatistics& statistics) const;
 
 	private:
+		void Initialize();
+		void InvalidateFrame();
+		bool HasCameraMoved(const Camera& camera);
+		void GetTileBounds(uint32_t tileIndex, int& tileX, int& tileY, int& endX, int& endY) const;
+
+		//Dynamic resolution
+		void UpdateResolutionScale(bool hasCameraMoved);
+		void ResizeRenderTarget(float resolutionScale);
+		void ResolveToSurface();
+		void UpscaleRow(int py);
+		void PackRow(int py);
+		//What gets upscaled and packed: the denoised colors when the denoiser is on
+		const std::vector<ColorRGB>& GetResolveColors() const { return m_DenoiserEnabled ? m_DenoisedColors : m_RenderColors; }
+
+		//Dirty regions
+		void UpdateDirtyTiles(Scene* pScene, const Camera& camera, float fov, float aspectRatio, bool hasCameraMoved);
+		bool MarkDirtyPoint(const Vector3& point, const Camera& camera, float fov, float aspectRatio, int& minX, int& minY, int& maxX, int& maxY) const;
+		void MarkDirtyHull(const Vector3* pPoints, int numPoints, const Camera& camera, float fov, float aspectRatio, int& minX, int& minY, int& maxX, int& maxY) const;
+		void DrawDirtyTileOverlay();
+
+		enum class DirtyRegionMode
+		{
+			Disabled,
+			Enabled,
+			EnabledWithOverlay
+		};
+
+		enum class PixelTraversalOrder
+		{
+			Scanline,
+			Morton
+		};
+
+		static constexpr int m_TileSize{ 16 };
+		int m_NumTilesX{};
+		int m_NumTilesY{};
+
+		//Pixel offsets inside a tile (x | y << 8), in Z-order so consecutive rays stay close together
+		PixelTraversalOrder m_PixelTraversalOrder{ PixelTraversalOrder::Morton };
+		std::vector<uint16_t> m_MortonTileOffsets{};
+
+		DirtyRegionMode m_DirtyRegionMode{ DirtyRegionMode::Disabled };
+		std::vector<uint8_t> m_DirtyTiles{};
+		bool m_IsFullFrameDirty{ true };
+		bool m_ForceFullFrame{ true };
+
+		Vector3 m_LastCameraOrigin{};
+		Vector3 m_LastCameraForward{};
+		float m_LastCameraFovAngle{};
+
+		//Internal HDR render target, upscaled into m_FrameBuffer when m_ResolutionScale < 1
+		int m_RenderWidth{};
+		int m_RenderHeight{};
+		std::vector<ColorRGB> m_RenderColors{};
+		std::vector<float> m_RenderDepths{};
+
+		//Guide buffers for the denoiser, a zero normal marks a miss
+		std::vector<Vector3> m_RenderNormals{};
+		std::vector<Vector3> m_RenderPositions{};
+		std::vector<ColorRGB> m_RenderAlbedos{};
+		std::vector<ColorRGB> m_DenoisedColors{};
+		Denoiser m_Denoiser{};
+		bool m_DenoiserEnabled{ false };
+
+		//Shadow rays per light per pixel when sampling soft shadows, 0 traces one hard shadow ray to the light's center
+		static constexpr int m_MaxSoftShadowSamples{ 4 };
+		int m_SoftShadowSamples{ 0 };
+		//Seeds the soft shadow jitter so the noise changes every frame, Render advances it after each frame
+		uint32_t m_FrameIndex{};
+
+		//Window sized HDR colors, tonemapped and packed into the surface at the end of the frame
+		std::vector<ColorRGB> m_FrameBuffer{};
+		ToneMappingMode m_ToneMappingMode{ ToneMappingMode::MaxToOne };
+		ToneMappingUtils::SurfaceFormat m_SurfaceFormat{};
+
+		static constexpr float m_MinResolutionScale{ 0.25f };
+		static constexpr float m_MotionResolutionScale{ 0.5f };
+		static constexpr float m_ResolutionScaleStep{ 0.125f };
+
+		bool m_DynamicResolutionEnabled{ false };
+		float m_ResolutionScale{ 1.f };
+		float m_ControllerScale{ 1.f };
+		float m_TargetFrameTime{ 1.f / 30.f };
+		float m_LastFrameTime{};
+
 		enum class LightningMode
 		{
 			ObservedArea,
@@ -46,10 +184,19 @@ namespace dae
 
 		bool m_ShadowsEnabled{ true };
 
+		TemporalCache m_TemporalCache{};
+		bool m_TemporalCacheEnabled{ false };
+
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		bool m_OwnsBuffer{ false };
+
+		ImageWriter m_ImageWriter{};
+
+		std::atomic<uint64_t> m_PrimaryRayCount{};
+		std::atomic<uint64_t> m_ShadowRayCount{};
 
 		int m_Width{};
 		int m_Height{};;
@@ -1,30 +1,27 @@
 #include "Scene.h"
 #include "Utils.h"
+#include "GltfLoader.h"
 #include "Material.h"
+#include "MeshCache.h"
+
+#include <chrono>
+#include <iostream>
 
 namespace dae {
 
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
-	Scene::Scene() :
-		m_Materials({ new Material_SolidColor({1,0,0}) })
+	Scene::Scene()
 	{
+		AddMaterial<Material_SolidColor>(ColorRGB{ 1,0,0 });
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
 		m_TriangleMeshGeometries.reserve(32);
 		m_Lights.reserve(32);
 	}
 
-	Scene::~Scene()
-	{
-		for (auto& pMaterial : m_Materials)
-		{
-			delete pMaterial;
-			pMaterial = nullptr;
-		}
-
-		m_Materials.clear();
-	}
+	//Materials and streamed meshes are destroyed with m_SceneArena
+	Scene::~Scene() = default;
 
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
@@ -50,7 +47,7 @@ namespace dae {
 			}
 		}
 
-		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		for (const TriangleMesh& triangleMesh : m_RenderTriangleMeshes)
 		{
 			HitRecord currentHit{ };
 			GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, currentHit);
@@ -60,6 +57,17 @@ namespace dae {
 				selectedHit = currentHit;
 			}
 		}
+
+		for (const StreamedMesh* pStreamedMesh : m_StreamedMeshes)
+		{
+			HitRecord currentHit{ };
+			pStreamedMesh->HitTest(ray, currentHit);
+
+			if (currentHit.didHit && currentHit.t < selectedHit.t)
+			{
+				selectedHit = currentHit;
+			}
+		}
 		closestHit = selectedHit;
 	}
 
@@ -81,7 +89,7 @@ namespace dae {
 			}
 		}
 
-		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		for (const TriangleMesh& triangleMesh : m_RenderTriangleMeshes)
 		{
 
 			if (GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray))
@@ -90,9 +98,72 @@ namespace dae {
 			}
 		}
 
+		for (const StreamedMesh* pStreamedMesh : m_StreamedMeshes)
+		{
+			HitRecord ignoredHit{ };
+			if (pStreamedMesh->HitTest(ray, ignoredHit, true))
+			{
+				return true;
+			}
+		}
+
 		return false;
 	}
 
+	void Scene::PublishFrame()
+	{
+		//Meshes added since the last snapshot also need their index and BVH buffers copied
+		const bool isFullCopy{ m_IsRenderSnapshotStale || m_RenderTriangleMeshes.size() != m_TriangleMeshGeometries.size() };
+		m_RenderTriangleMeshes.resize(m_TriangleMeshGeometries.size());
+		for (size_t i{}; i < m_TriangleMeshGeometries.size(); ++i)
+		{
+			m_RenderTriangleMeshes[i].CopyRenderState(m_TriangleMeshGeometries[i], isFullCopy);
+		}
+		m_IsRenderSnapshotStale = false;
+
+		m_RenderCamera = m_Camera;
+
+		m_FrameArena.Reset();
+
+		//Eviction frees chunks a render could be reading, so it happens here and not in Update
+		for (StreamedMesh* pStreamedMesh : m_StreamedMeshes)
+		{
+			pStreamedMesh->BeginFrame(m_FrameArena);
+		}
+	}
+
+	void Scene::SelectLods()
+	{
+		const float fov{ tanf((m_Camera.fovAngle * TO_RADIANS) / 2.f) };
+		for (TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			triangleMesh.SelectLod(m_Camera.origin, fov);
+		}
+	}
+
+	void Scene::CompressTriangleMeshes()
+	{
+		for (TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			triangleMesh.Compress();
+		}
+		m_IsRenderSnapshotStale = true;
+	}
+
+	size_t Scene::GetTriangleMeshFootprint() const
+	{
+		size_t footprint{};
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			footprint += triangleMesh.GetMemoryFootprint();
+		}
+		for (const TriangleMesh& triangleMesh : m_RenderTriangleMeshes)
+		{
+			footprint += triangleMesh.GetMemoryFootprint();
+		}
+		return footprint;
+	}
+
 #pragma region Scene Helpers
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
@@ -126,12 +197,40 @@ namespace dae {
 		return &m_TriangleMeshGeometries.back();
 	}
 
-	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
+	size_t Scene::AddTriangleMeshesFromGLB(const std::string& filename, TriangleCullMode cullMode, unsigned char materialIndex)
+	{
+		const size_t firstMesh{ m_TriangleMeshGeometries.size() };
+		if (!GltfLoader::LoadGLB(filename, m_TriangleMeshGeometries))
+			return 0;
+
+		for (size_t i{ firstMesh }; i < m_TriangleMeshGeometries.size(); ++i)
+		{
+			TriangleMesh& mesh{ m_TriangleMeshGeometries[i] };
+			mesh.cullMode = cullMode;
+			mesh.materialIndex = materialIndex;
+			mesh.UpdateTransforms();
+		}
+		return m_TriangleMeshGeometries.size() - firstMesh;
+	}
+
+	StreamedMesh* Scene::AddStreamedMesh(const std::string& objFilename, TriangleCullMode cullMode, unsigned char materialIndex, uint64_t residentBudgetBytes)
+	{
+		//A mesh that fails to open stays in the arena until the scene goes, it holds no more than its file name
+		StreamedMesh* pStreamedMesh{ m_SceneArena.Create<StreamedMesh>(cullMode, materialIndex, residentBudgetBytes) };
+		if (!pStreamedMesh->Open(objFilename))
+			return nullptr;
+
+		m_StreamedMeshes.push_back(pStreamedMesh);
+		return pStreamedMesh;
+	}
+
+	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color, float radius)
 	{
 		Light l;
 		l.origin = origin;
 		l.intensity = intensity;
 		l.color = color;
+		l.radius = radius;
 		l.type = LightType::Point;
 
 		m_Lights.emplace_back(l);
@@ -163,11 +262,11 @@ namespace dae {
 	{
 		//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue = AddMaterial<Material_SolidColor>(colors::Blue);
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow = AddMaterial<Material_SolidColor>(colors::Yellow);
+		const unsigned char matId_Solid_Green = AddMaterial<Material_SolidColor>(colors::Green);
+		const unsigned char matId_Solid_Magenta = AddMaterial<Material_SolidColor>(colors::Magenta);
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -198,10 +297,10 @@ namespace dae {
 
 		//default: Material id0 >> SolidColor Material (RED)
 		constexpr  unsigned char matId_Solid_Red{ 0 };
-		const unsigned char matId_Solid_Blue{ AddMaterial(new Material_SolidColor{colors::Blue}) };
-		const unsigned char matId_Solid_Yellow{ AddMaterial(new Material_SolidColor{colors::Yellow}) };
-		const unsigned char matId_Solid_Green{ AddMaterial(new Material_SolidColor{colors::Green}) };
-		const unsigned char matId_Solid_Magenta{ AddMaterial(new Material_SolidColor{colors::Magenta}) };
+		const unsigned char matId_Solid_Blue{ AddMaterial<Material_SolidColor>(colors::Blue) };
+		const unsigned char matId_Solid_Yellow{ AddMaterial<Material_SolidColor>(colors::Yellow) };
+		const unsigned char matId_Solid_Green{ AddMaterial<Material_SolidColor>(colors::Green) };
+		const unsigned char matId_Solid_Magenta{ AddMaterial<Material_SolidColor>(colors::Magenta) };
 
 		//Plane
 		AddPlane({ -5.f,0.f,0.f }, { 1.f,0.f,0.f }, matId_Solid_Green);
@@ -227,11 +326,11 @@ namespace dae {
 		m_Camera.origin = { 0.f,3.f,-9.f };
 		m_Camera.fovAngle = 45.f;
 
-		//const auto matLambert_Red{ AddMaterial(new Material_Lambert{colors::Red, 1.f}) };
-		//const auto matLambertPhong_Red{ AddMaterial(new Material_LambertPhong{colors::Red, 1.f,1.f,60.f}) };
-		//const auto matLambert_Blue{ AddMaterial(new Material_Lambert{colors::Blue, 1.f}) };
-		//const auto matLambert_Yellow{ AddMaterial(new Material_Lambert{colors::Yellow, 1.f}) };
-		//const auto matLambertPhong_Blue{ AddMaterial(new Material_LambertPhong(colors::Blue,1.f,1.f,6.f)) };
+		//const auto matLambert_Red{ AddMaterial<Material_Lambert>(colors::Red, 1.f) };
+		//const auto matLambertPhong_Red{ AddMaterial<Material_LambertPhong>(colors::Red, 1.f,1.f,60.f) };
+		//const auto matLambert_Blue{ AddMaterial<Material_Lambert>(colors::Blue, 1.f) };
+		//const auto matLambert_Yellow{ AddMaterial<Material_Lambert>(colors::Yellow, 1.f) };
+		//const auto matLambertPhong_Blue{ AddMaterial<Material_LambertPhong>(colors::Blue,1.f,1.f,6.f) };
 
 		////Spheres
 		//AddSphere({ -.75f,1.f,.0f }, 1.f, matLambertPhong_Red);
@@ -245,8 +344,8 @@ namespace dae {
 		//AddPointLight({ 0.f,2.5f,-5.f }, 25.f, colors::White);
 
 		//constexpr unsigned char matId_Solid_Red{ 0 };
-		//const unsigned char matId_Solid_Blue{ AddMaterial(new Material_SolidColor{colors::Blue}) };
-		//const unsigned char matId_Solid_Yellow{ AddMaterial(new Material_SolidColor{colors::Yellow}) };
+		//const unsigned char matId_Solid_Blue{ AddMaterial<Material_SolidColor>(colors::Blue) };
+		//const unsigned char matId_Solid_Yellow{ AddMaterial<Material_SolidColor>(colors::Yellow) };
 
 		////Spheres
 		//AddSphere({ -.75f,1.f,.0f }, 1.f, matId_Solid_Red);
@@ -261,14 +360,14 @@ namespace dae {
 
 
 
-		const auto matCT_GrayRoughMetal{ AddMaterial(new Material_CookTorrence({.972f,.960f,.915f},1.f,1.f)) };
-		const auto matCT_GrayMediumMetal{ AddMaterial(new Material_CookTorrence({.972f,.960f,.915f},1.f,.6f)) };
-		const auto matCT_GraySmoothMetal{ AddMaterial(new Material_CookTorrence({.972f,.960f,.915f},1.f,.1f)) };
-		const auto matCT_GrayRoughPlastic{ AddMaterial(new Material_CookTorrence({.75f,.75f,.75f},.0f,1.f)) };
-		const auto matCT_GrayMediumPlastic{ AddMaterial(new Material_CookTorrence({.75f,.75f,.75f},.0f,.6f)) };
-		const auto matCT_GraySmoothPlastic{ AddMaterial(new Material_CookTorrence({.75f,.75f,.75f},.0f,.1f)) };
+		const auto matCT_GrayRoughMetal{ AddMaterial<Material_CookTorrence>(ColorRGB{ .972f,.960f,.915f },1.f,1.f) };
+		const auto matCT_GrayMediumMetal{ AddMaterial<Material_CookTorrence>(ColorRGB{ .972f,.960f,.915f },1.f,.6f) };
+		const auto matCT_GraySmoothMetal{ AddMaterial<Material_CookTorrence>(ColorRGB{ .972f,.960f,.915f },1.f,.1f) };
+		const auto matCT_GrayRoughPlastic{ AddMaterial<Material_CookTorrence>(ColorRGB{ .75f,.75f,.75f },.0f,1.f) };
+		const auto matCT_GrayMediumPlastic{ AddMaterial<Material_CookTorrence>(ColorRGB{ .75f,.75f,.75f },.0f,.6f) };
+		const auto matCT_GraySmoothPlastic{ AddMaterial<Material_CookTorrence>(ColorRGB{ .75f,.75f,.75f },.0f,.1f) };
 
-		const auto matLambert_GrayBlue{ AddMaterial(new Material_Lambert({.49f,.57f,.57f},1.f)) };
+		const auto matLambert_GrayBlue{ AddMaterial<Material_Lambert>(ColorRGB{ .49f,.57f,.57f },1.f) };
 
 		//Plane
 		AddPlane({ 0.f,0.f,10.f }, { 0.f,0.f,-1.f }, matLambert_GrayBlue);
@@ -303,8 +402,8 @@ namespace dae {
 
 
 		//Materials
-		const auto matLambert_GrayBlue{ AddMaterial(new Material_Lambert({.49f,.57f,.57f},1.f)) };
-		const auto matLambert_White{ AddMaterial(new Material_Lambert(colors::White,1.f)) };
+		const auto matLambert_GrayBlue{ AddMaterial<Material_Lambert>(ColorRGB{ .49f,.57f,.57f },1.f) };
+		const auto matLambert_White{ AddMaterial<Material_Lambert>(colors::White,1.f) };
 
 
 		//Planes
@@ -323,7 +422,7 @@ namespace dae {
 		
 
 		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/lowpoly_bunny.obj", pMesh->positions, pMesh->normals, pMesh->indices);
+		MeshCache::LoadOBJ("Resources/lowpoly_bunny.obj", *pMesh);
 		pMesh->Translate({ 0.f, 0.f, 0.f });
 		pMesh->Scale({ 2.f,2.f,2.f });
 		pMesh->UpdateTransforms();
@@ -348,15 +447,15 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 
-		const auto matCT_GrayRoughMetal{ AddMaterial(new Material_CookTorrence({.972f,.960f,.915f},1.f,1.f)) };
-		const auto matCT_GrayMediumMetal{ AddMaterial(new Material_CookTorrence({.972f,.960f,.915f},1.f,.6f)) };
-		const auto matCT_GraySmoothMetal{ AddMaterial(new Material_CookTorrence({.972f,.960f,.915f},1.f,.1f)) };
-		const auto matCT_GrayRoughPlastic{ AddMaterial(new Material_CookTorrence({.75f,.75f,.75f},.0f,1.f)) };
-		const auto matCT_GrayMediumPlastic{ AddMaterial(new Material_CookTorrence({.75f,.75f,.75f},.0f,.6f)) };
-		const auto matCT_GraySmoothPlastic{ AddMaterial(new Material_CookTorrence({.75f,.75f,.75f},.0f,.1f)) };
+		const auto matCT_GrayRoughMetal{ AddMaterial<Material_CookTorrence>(ColorRGB{ .972f,.960f,.915f },1.f,1.f) };
+		const auto matCT_GrayMediumMetal{ AddMaterial<Material_CookTorrence>(ColorRGB{ .972f,.960f,.915f },1.f,.6f) };
+		const auto matCT_GraySmoothMetal{ AddMaterial<Material_CookTorrence>(ColorRGB{ .972f,.960f,.915f },1.f,.1f) };
+		const auto matCT_GrayRoughPlastic{ AddMaterial<Material_CookTorrence>(ColorRGB{ .75f,.75f,.75f },.0f,1.f) };
+		const auto matCT_GrayMediumPlastic{ AddMaterial<Material_CookTorrence>(ColorRGB{ .75f,.75f,.75f },.0f,.6f) };
+		const auto matCT_GraySmoothPlastic{ AddMaterial<Material_CookTorrence>(ColorRGB{ .75f,.75f,.75f },.0f,.1f) };
 
-		const auto matLambert_GrayBlue{ AddMaterial(new Material_Lambert({.49f,.57f,.57f},1.f)) };
-		const auto matLambert_White{ AddMaterial(new Material_Lambert(colors::White,1.f)) };
+		const auto matLambert_GrayBlue{ AddMaterial<Material_Lambert>(ColorRGB{ .49f,.57f,.57f },1.f) };
+		const auto matLambert_White{ AddMaterial<Material_Lambert>(colors::White,1.f) };
 
 		AddPlane(Vector3{ 0.f,0.f,10.f }, Vector3{ 0.f,0.f,-1.f }, matLambert_GrayBlue);
 		AddPlane(Vector3{ 0.f,0.f,0.f }, Vector3{ 0.f,1.f,0.f }, matLambert_GrayBlue);
@@ -409,4 +508,91 @@ namespace dae {
 	}
 
 #pragma endregion
+
+#pragma region SCENE FILE
+	Scene_File::Scene_File(SceneFile::SceneDescription&& description, const std::string& filename) :
+		m_Description(std::move(description))
+	{
+		sceneName = filename;
+	}
+
+	void Scene_File::Initialize()
+	{
+		const auto start{ std::chrono::steady_clock::now() };
+
+		if (m_Description.hasCamera)
+			m_Camera.SetPose(m_Description.cameraOrigin, m_Description.cameraPitch, m_Description.cameraYaw, m_Description.fovAngle);
+
+		m_Materials.reserve(m_Materials.size() + m_Description.materials.size());
+		for (const SceneFile::MaterialDescription& material : m_Description.materials)
+		{
+			AddMaterial(material.Create(m_SceneArena));
+		}
+
+		//The description already holds the geometry arrays at their final size, they are taken over whole
+		m_PlaneGeometries = std::move(m_Description.planes);
+		m_SphereGeometries = std::move(m_Description.spheres);
+		m_Lights = std::move(m_Description.lights);
+
+		m_TriangleMeshGeometries.reserve(m_Description.meshes.size());
+		for (const SceneFile::MeshDescription& mesh : m_Description.meshes)
+		{
+			switch (mesh.source)
+			{
+			case SceneFile::MeshSource::OBJ:
+			{
+				TriangleMesh* pMesh{ AddTriangleMesh(mesh.cullMode, mesh.materialIndex) };
+				if (!MeshCache::LoadOBJ(mesh.filename, *pMesh))
+				{
+					m_TriangleMeshGeometries.pop_back();
+					break;
+				}
+				pMesh->Translate(mesh.translation);
+				pMesh->Scale(mesh.scale);
+				pMesh->RotateY(mesh.yaw);
+				pMesh->UpdateTransforms();
+				break;
+			}
+			case SceneFile::MeshSource::GLB:
+				AddTriangleMeshesFromGLB(mesh.filename, mesh.cullMode, mesh.materialIndex);
+				break;
+			case SceneFile::MeshSource::Streamed:
+				AddStreamedMesh(mesh.filename, mesh.cullMode, mesh.materialIndex, mesh.residentBudgetBytes);
+				break;
+			}
+		}
+		m_Description = {};
+
+		const std::chrono::duration<float, std::milli> duration{ std::chrono::steady_clock::now() - start };
+		std::cout << "Built scene " << sceneName << " in " << duration.count() << " ms" << std::endl;
+	}
+#pragma endregion
+
+	Scene* CreateScene(const std::string& name)
+	{
+		const auto hasExtension{ [&name](const std::string& extension)
+			{ return name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0; } };
+		if (hasExtension(".scene") || hasExtension(".sceneb"))
+		{
+			SceneFile::SceneDescription description{};
+			if (!SceneFile::Load(name, description))
+				return nullptr;
+			return new Scene_File(std::move(description), name);
+		}
+
+		const std::string sceneName{ name.rfind("Scene_", 0) == 0 ? name.substr(6) : name };
+
+		if (sceneName == "W1")
+			return new Scene_W1();
+		if (sceneName == "W2")
+			return new Scene_W2();
+		if (sceneName == "W3")
+			return new Scene_W3();
+		if (sceneName == "W4_TestScene")
+			return new Scene_W4_TestScene();
+		if (sceneName == "W4_ReferenceScene")
+			return new Scene_W4_ReferenceScene();
+
+		return nullptr;
+	}
 }
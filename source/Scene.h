@@ -5,6 +5,9 @@
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "SceneFile.h"
+#include "StreamedMesh.h"
+#include "MemoryArena.h"
 
 namespace dae
 {
@@ -27,40 +30,91 @@ namespace dae
 		Scene& operator=(const Scene&) = delete;
 		Scene& operator=(Scene&&) noexcept = delete;
 
+		//Update only writes the camera and triangle meshes of the next frame, rendering reads the snapshot
+		//PublishFrame took of them. Between two PublishFrame calls an Update can run while the last snapshot renders.
 		virtual void Initialize() = 0;
 		virtual void Update(dae::Timer* pTimer)
 		{
-			m_Camera.Update(pTimer);
+			for (TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+			{
+				triangleMesh.BeginFrame();
+			}
+
+			m_Camera.Update(pTimer, m_CameraInput);
+			SelectLods();
 		}
+		//Input the next Update moves the camera with, set it while no Update runs. Without it the camera stands still.
+		void SetCameraInput(const CameraInput& input) { m_CameraInput = input; }
+		//Makes the state of the last Update the one rendering sees, call when neither an Update nor a render is running
+		void PublishFrame();
 
+		//The camera Update moves, GetRenderCamera is the one of the published frame
 		Camera& GetCamera() { return m_Camera; }
+		const Camera& GetRenderCamera() const { return m_RenderCamera; }
+		//Both trace the published frame
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
 		bool DoesHit(const Ray& ray) const;
 
+		//Level of detail for every triangle mesh as seen from the camera, Update does this after moving the camera
+		void SelectLods();
+		//Switches every triangle mesh to compressed storage, call after Initialize
+		void CompressTriangleMeshes();
+		//Bytes held by the vertex, normal, index and BVH buffers of all triangle meshes, render snapshot included
+		size_t GetTriangleMeshFootprint() const;
+
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const std::vector<TriangleMesh>& GetTriangleMeshGeometries() const { return m_TriangleMeshGeometries; }
+		const std::vector<TriangleMesh>& GetRenderTriangleMeshes() const { return m_RenderTriangleMeshes; }
+		const std::vector<StreamedMesh*>& GetStreamedMeshes() const { return m_StreamedMeshes; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
-		const std::vector<Triangle> GetTriangles() const { return m_Triangles; }
+		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
+		const std::vector<Triangle>& GetTriangles() const { return m_Triangles; }
+		//Scratch memory that lives from one PublishFrame to the next, for data the published frame needs while it renders
+		MemoryArena& GetFrameArena() { return m_FrameArena; }
 
 	protected:
 		std::string	sceneName;
 
+		//Holds the materials and streamed meshes until the scene is destroyed, declared first so it goes last
+		MemoryArena m_SceneArena{};
+		MemoryArena m_FrameArena{};
+
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
 		std::vector<Light> m_Lights{};
 		std::vector<Triangle> m_Triangles{};
 		std::vector<Material*> m_Materials{};
+		std::vector<StreamedMesh*> m_StreamedMeshes{};
 
 		Camera m_Camera{};
+		CameraInput m_CameraInput{};
+
+		//Snapshot of m_TriangleMeshGeometries and m_Camera taken by PublishFrame
+		std::vector<TriangleMesh> m_RenderTriangleMeshes{};
+		Camera m_RenderCamera{};
+		//Set when mesh buffers were rebuilt, the next PublishFrame copies everything again
+		bool m_IsRenderSnapshotStale{ true };
 
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
-
-		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
+		//Adds one mesh per node instance in a .glb file and returns how many were added
+		//Can move the meshes in memory, so take TriangleMesh pointers after calling this
+		size_t AddTriangleMeshesFromGLB(const std::string& filename, TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		//Static mesh that is paged in from disk while rendering, keeping at most residentBudgetBytes of it in memory
+		//Returns nullptr when the OBJ can not be opened or converted
+		StreamedMesh* AddStreamedMesh(const std::string& objFilename, TriangleCullMode cullMode, unsigned char materialIndex, uint64_t residentBudgetBytes);
+
+		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color, float radius = .5f);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
+		template<typename MaterialT, typename... Args>
+		unsigned char AddMaterial(Args&&... args)
+		{
+			return AddMaterial(m_SceneArena.Create<MaterialT>(std::forward<Args>(args)...));
+		}
+		//pMaterial has to live in m_SceneArena
 		unsigned char AddMaterial(Material* pMaterial);
 	};
 
@@ -147,4 +201,27 @@ namespace dae
 	private:
 		TriangleMesh* m_Meshes[3]{};
 	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Scene loaded from a .scene or .sceneb file, see SceneFile.h
+	class Scene_File final : public Scene
+	{
+	public:
+		Scene_File(SceneFile::SceneDescription&& description, const std::string& filename);
+		~Scene_File() override = default;
+
+		Scene_File(const Scene_File&) = delete;
+		Scene_File(Scene_File&&) noexcept = delete;
+		Scene_File& operator=(const Scene_File&) = delete;
+		Scene_File& operator=(Scene_File&&) noexcept = delete;
+
+		void Initialize() override;
+	private:
+		//Moved into the scene by Initialize
+		SceneFile::SceneDescription m_Description;
+	};
+
+	//Creates one of the scenes above from its class name, with or without the "Scene_" prefix, or loads a scene file
+	//when the name ends in .scene or .sceneb (nullptr if unknown or the file does not load)
+	Scene* CreateScene(const std::string& name);
 }
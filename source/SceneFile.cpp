@@ -0,0 +1,729 @@
+#include "SceneFile.h"
+#include "MappedFile.h"
+#include "Material.h"
+#include "MemoryArena.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+using namespace dae;
+using namespace dae::SceneFile;
+
+namespace
+{
+	//Bump whenever the layout of the header or a record changes
+	constexpr uint32_t g_BinaryVersion{ 1 };
+	constexpr char g_BinaryMagic[8]{ 'D', 'A', 'E', 'S', 'C', 'E', 'N', 'E' };
+	//Tells apart files written on a machine with a different byte order
+	constexpr uint32_t g_ByteOrderMark{ 0x01020304 };
+	//Material indices are unsigned chars and 0 is the scene's default material
+	constexpr size_t g_MaxMaterials{ 255 };
+	constexpr uint64_t g_BytesPerMB{ 1024 * 1024 };
+	//Radius AddPointLight uses when none is given
+	constexpr float g_DefaultLightRadius{ .5f };
+
+	//Binary layout: the header, then every record of each kind in header order, then the mesh filenames
+	struct BinaryHeader
+	{
+		char magic[8]{};
+		uint32_t version{};
+		uint32_t byteOrderMark{};
+		uint64_t headerSize{};
+		uint64_t fileSize{};
+
+		uint64_t numMaterials{};
+		uint64_t numPlanes{};
+		uint64_t numSpheres{};
+		uint64_t numLights{};
+		uint64_t numMeshes{};
+		uint64_t stringsSize{};
+
+		uint32_t hasCamera{};
+		float cameraOrigin[3]{};
+		float cameraPitch{};
+		float cameraYaw{};
+		float fovAngle{};
+		uint32_t reserved{};
+	};
+
+	struct MaterialRecord
+	{
+		uint32_t type{};
+		float color[3]{};
+		float parameters[3]{};
+	};
+
+	struct PlaneRecord
+	{
+		float origin[3]{};
+		float normal[3]{};
+		uint32_t materialIndex{};
+	};
+
+	struct SphereRecord
+	{
+		float origin[3]{};
+		float radius{};
+		uint32_t materialIndex{};
+	};
+
+	struct LightRecord
+	{
+		uint32_t type{};
+		float origin[3]{};
+		float direction[3]{};
+		float color[3]{};
+		float intensity{};
+		float radius{};
+	};
+
+	struct MeshRecord
+	{
+		uint32_t source{};
+		uint32_t cullMode{};
+		uint32_t materialIndex{};
+		float translation[3]{};
+		float scale[3]{};
+		float yaw{};
+		uint64_t residentBudgetBytes{};
+		//Into the strings section
+		uint64_t filenameOffset{};
+		uint64_t filenameSize{};
+	};
+
+	static_assert(sizeof(BinaryHeader) == 112 && sizeof(MaterialRecord) == 28 && sizeof(PlaneRecord) == 28
+		&& sizeof(SphereRecord) == 20 && sizeof(LightRecord) == 48 && sizeof(MeshRecord) == 64,
+		"Scene records are written without padding");
+
+	enum class RecordType
+	{
+		Camera,
+		Material,
+		Plane,
+		Sphere,
+		PointLight,
+		DirectionalLight,
+		Mesh,
+		GLB,
+		Streamed,
+		Unknown
+	};
+
+	RecordType FindRecordType(std::string_view keyword)
+	{
+		if (keyword == "sphere")
+			return RecordType::Sphere;
+		if (keyword == "plane")
+			return RecordType::Plane;
+		if (keyword == "material")
+			return RecordType::Material;
+		if (keyword == "pointlight")
+			return RecordType::PointLight;
+		if (keyword == "directionallight")
+			return RecordType::DirectionalLight;
+		if (keyword == "mesh")
+			return RecordType::Mesh;
+		if (keyword == "glb")
+			return RecordType::GLB;
+		if (keyword == "streamed")
+			return RecordType::Streamed;
+		if (keyword == "camera")
+			return RecordType::Camera;
+		return RecordType::Unknown;
+	}
+
+#pragma region Text
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	//Reads the words of one line, a '#' ends the line early
+	class LineReader final
+	{
+	public:
+		LineReader(const char* pBegin, const char* pEnd) :
+			m_p(pBegin), m_pEnd(pEnd)
+		{
+		}
+
+		bool IsAtEnd()
+		{
+			SkipSpaces();
+			return m_p == m_pEnd || *m_p == '#';
+		}
+
+		bool ReadWord(std::string_view& word)
+		{
+			if (IsAtEnd())
+				return false;
+			const char* pStart{ m_p };
+			while (m_p < m_pEnd && !IsSpace(*m_p) && *m_p != '#')
+				++m_p;
+			word = { pStart, static_cast<size_t>(m_p - pStart) };
+			return true;
+		}
+
+		bool ReadFloat(float& value)
+		{
+			if (IsAtEnd())
+				return false;
+			//from_chars does not accept an explicit plus sign
+			if (*m_p == '+')
+				++m_p;
+			const auto [pNext, error] { std::from_chars(m_p, m_pEnd, value) };
+			m_p = pNext;
+			return error == std::errc{};
+		}
+
+		bool ReadUint(uint64_t& value)
+		{
+			if (IsAtEnd())
+				return false;
+			const auto [pNext, error] { std::from_chars(m_p, m_pEnd, value) };
+			m_p = pNext;
+			return error == std::errc{};
+		}
+
+		bool ReadVector(Vector3& value)
+		{
+			return ReadFloat(value.x) && ReadFloat(value.y) && ReadFloat(value.z);
+		}
+
+		bool ReadColor(ColorRGB& value)
+		{
+			return ReadFloat(value.r) && ReadFloat(value.g) && ReadFloat(value.b);
+		}
+
+		//Range checked once the whole file is read and the number of materials is known
+		bool ReadMaterialIndex(unsigned char& value)
+		{
+			uint64_t index{};
+			if (!ReadUint(index) || index > g_MaxMaterials)
+				return false;
+			value = static_cast<unsigned char>(index);
+			return true;
+		}
+
+		bool ReadCullMode(TriangleCullMode& value)
+		{
+			std::string_view word{};
+			if (!ReadWord(word))
+				return false;
+			if (word == "front")
+				value = TriangleCullMode::FrontFaceCulling;
+			else if (word == "back")
+				value = TriangleCullMode::BackFaceCulling;
+			else if (word == "none")
+				value = TriangleCullMode::NoCulling;
+			else
+				return false;
+			return true;
+		}
+
+	private:
+		const char* m_p{};
+		const char* m_pEnd{};
+
+		void SkipSpaces()
+		{
+			while (m_p < m_pEnd && IsSpace(*m_p))
+				++m_p;
+		}
+	};
+
+	bool ParseMaterial(LineReader& reader, MaterialDescription& material)
+	{
+		std::string_view type{};
+		if (!reader.ReadWord(type) || !reader.ReadColor(material.color))
+			return false;
+
+		int numParameters{};
+		if (type == "solid")
+			material.type = MaterialType::SolidColor;
+		else if (type == "lambert")
+		{
+			material.type = MaterialType::Lambert;
+			numParameters = 1;
+		}
+		else if (type == "phong")
+		{
+			material.type = MaterialType::LambertPhong;
+			numParameters = 3;
+		}
+		else if (type == "cooktorrance")
+		{
+			material.type = MaterialType::CookTorrence;
+			numParameters = 2;
+		}
+		else
+			return false;
+
+		for (int i{}; i < numParameters; ++i)
+		{
+			if (!reader.ReadFloat(material.parameters[i]))
+				return false;
+		}
+		return true;
+	}
+
+	bool ParseMesh(LineReader& reader, RecordType type, MeshDescription& mesh)
+	{
+		std::string_view filename{};
+		if (!reader.ReadWord(filename) || !reader.ReadCullMode(mesh.cullMode) || !reader.ReadMaterialIndex(mesh.materialIndex))
+			return false;
+		mesh.filename = filename;
+
+		if (type == RecordType::GLB)
+		{
+			mesh.source = MeshSource::GLB;
+			return true;
+		}
+
+		if (type == RecordType::Streamed)
+		{
+			mesh.source = MeshSource::Streamed;
+			float budgetMB{};
+			if (!reader.ReadFloat(budgetMB) || budgetMB <= 0.f)
+				return false;
+			mesh.residentBudgetBytes = static_cast<uint64_t>(budgetMB * g_BytesPerMB);
+			return true;
+		}
+
+		//Trailing transform parts are optional, but each one has to be complete
+		mesh.source = MeshSource::OBJ;
+		if (reader.IsAtEnd())
+			return true;
+		if (!reader.ReadVector(mesh.translation))
+			return false;
+		if (reader.IsAtEnd())
+			return true;
+		if (!reader.ReadVector(mesh.scale))
+			return false;
+		if (reader.IsAtEnd())
+			return true;
+		return reader.ReadFloat(mesh.yaw);
+	}
+
+	bool ParseRecord(LineReader& reader, RecordType type, SceneDescription& description)
+	{
+		switch (type)
+		{
+		case RecordType::Camera:
+			description.hasCamera = true;
+			return reader.ReadVector(description.cameraOrigin) && reader.ReadFloat(description.cameraPitch)
+				&& reader.ReadFloat(description.cameraYaw) && reader.ReadFloat(description.fovAngle);
+		case RecordType::Material:
+			return ParseMaterial(reader, description.materials.emplace_back());
+		case RecordType::Plane:
+		{
+			Plane& plane{ description.planes.emplace_back() };
+			if (!reader.ReadVector(plane.origin) || !reader.ReadVector(plane.normal) || !reader.ReadMaterialIndex(plane.materialIndex))
+				return false;
+			return plane.normal.Normalize() > 0.f;
+		}
+		case RecordType::Sphere:
+		{
+			Sphere& sphere{ description.spheres.emplace_back() };
+			return reader.ReadVector(sphere.origin) && reader.ReadFloat(sphere.radius) && reader.ReadMaterialIndex(sphere.materialIndex);
+		}
+		case RecordType::PointLight:
+		{
+			Light& light{ description.lights.emplace_back() };
+			light.type = LightType::Point;
+			light.radius = g_DefaultLightRadius;
+			if (!reader.ReadVector(light.origin) || !reader.ReadFloat(light.intensity) || !reader.ReadColor(light.color))
+				return false;
+			return reader.IsAtEnd() || reader.ReadFloat(light.radius);
+		}
+		case RecordType::DirectionalLight:
+		{
+			Light& light{ description.lights.emplace_back() };
+			light.type = LightType::Directional;
+			if (!reader.ReadVector(light.direction) || !reader.ReadFloat(light.intensity) || !reader.ReadColor(light.color))
+				return false;
+			return light.direction.Normalize() > 0.f;
+		}
+		case RecordType::Mesh:
+		case RecordType::GLB:
+		case RecordType::Streamed:
+			return ParseMesh(reader, type, description.meshes.emplace_back());
+		default:
+			return false;
+		}
+	}
+
+	bool LoadText(const std::string& filename, const char* pData, size_t size, SceneDescription& description)
+	{
+		const char* pEnd{ pData + size };
+
+		//First pass only looks at the keyword of each line, so every container is allocated exactly once
+		size_t counts[static_cast<int>(RecordType::Unknown) + 1]{};
+		for (const char* p{ pData }; p < pEnd;)
+		{
+			const char* pLineEnd{ static_cast<const char*>(std::memchr(p, '\n', pEnd - p)) };
+			if (!pLineEnd)
+				pLineEnd = pEnd;
+
+			LineReader reader{ p, pLineEnd };
+			std::string_view keyword{};
+			if (reader.ReadWord(keyword))
+				++counts[static_cast<int>(FindRecordType(keyword))];
+			p = pLineEnd + 1;
+		}
+
+		description.materials.reserve(counts[static_cast<int>(RecordType::Material)]);
+		description.planes.reserve(counts[static_cast<int>(RecordType::Plane)]);
+		description.spheres.reserve(counts[static_cast<int>(RecordType::Sphere)]);
+		description.lights.reserve(counts[static_cast<int>(RecordType::PointLight)] + counts[static_cast<int>(RecordType::DirectionalLight)]);
+		description.meshes.reserve(counts[static_cast<int>(RecordType::Mesh)] + counts[static_cast<int>(RecordType::GLB)]
+			+ counts[static_cast<int>(RecordType::Streamed)]);
+
+		int lineNumber{};
+		for (const char* p{ pData }; p < pEnd;)
+		{
+			const char* pLineEnd{ static_cast<const char*>(std::memchr(p, '\n', pEnd - p)) };
+			if (!pLineEnd)
+				pLineEnd = pEnd;
+			++lineNumber;
+
+			LineReader reader{ p, pLineEnd };
+			std::string_view keyword{};
+			if (reader.ReadWord(keyword) && !(ParseRecord(reader, FindRecordType(keyword), description) && reader.IsAtEnd()))
+			{
+				std::cout << "Could not parse " << filename << " line " << lineNumber << std::endl;
+				return false;
+			}
+			p = pLineEnd + 1;
+		}
+		return true;
+	}
+#pragma endregion
+
+#pragma region Binary
+	bool IsSectionInside(uint64_t& offset, uint64_t elementSize, uint64_t count, uint64_t fileSize)
+	{
+		if (count > fileSize / elementSize || offset > fileSize - count * elementSize)
+			return false;
+		offset += count * elementSize;
+		return true;
+	}
+
+	template <typename Record>
+	const char* ReadRecord(const char* pData, Record& record)
+	{
+		//Records are only 4-byte aligned in the file
+		std::memcpy(&record, pData, sizeof(Record));
+		return pData + sizeof(Record);
+	}
+
+	bool LoadBinary(const char* pData, size_t size, SceneDescription& description)
+	{
+		BinaryHeader header{};
+		if (size < sizeof(header))
+			return false;
+		std::memcpy(&header, pData, sizeof(header));
+
+		uint64_t offset{ sizeof(header) };
+		if (header.version != g_BinaryVersion || header.byteOrderMark != g_ByteOrderMark || header.headerSize != sizeof(header)
+			|| header.fileSize != size || header.numMaterials > g_MaxMaterials
+			|| !IsSectionInside(offset, sizeof(MaterialRecord), header.numMaterials, size)
+			|| !IsSectionInside(offset, sizeof(PlaneRecord), header.numPlanes, size)
+			|| !IsSectionInside(offset, sizeof(SphereRecord), header.numSpheres, size)
+			|| !IsSectionInside(offset, sizeof(LightRecord), header.numLights, size)
+			|| !IsSectionInside(offset, sizeof(MeshRecord), header.numMeshes, size)
+			|| !IsSectionInside(offset, 1, header.stringsSize, size))
+			return false;
+
+		description.hasCamera = header.hasCamera != 0;
+		description.cameraOrigin = { header.cameraOrigin[0], header.cameraOrigin[1], header.cameraOrigin[2] };
+		description.cameraPitch = header.cameraPitch;
+		description.cameraYaw = header.cameraYaw;
+		description.fovAngle = header.fovAngle;
+
+		//Every array is sized once and filled in place
+		const char* p{ pData + sizeof(header) };
+		description.materials.resize(header.numMaterials);
+		for (MaterialDescription& material : description.materials)
+		{
+			MaterialRecord record{};
+			p = ReadRecord(p, record);
+			material.type = static_cast<MaterialType>(record.type);
+			material.color = { record.color[0], record.color[1], record.color[2] };
+			std::memcpy(material.parameters, record.parameters, sizeof(record.parameters));
+			if (record.type > static_cast<uint32_t>(MaterialType::CookTorrence))
+				return false;
+		}
+
+		//Checked on the stored 32 bits, narrowed to unsigned char an index of 256 would turn into the default material
+		//Index 0 is that default, so the last valid index is numMaterials
+		const auto isMaterialIndexValid{ [&header](uint32_t materialIndex) { return materialIndex <= header.numMaterials; } };
+
+		description.planes.resize(header.numPlanes);
+		for (Plane& plane : description.planes)
+		{
+			PlaneRecord record{};
+			p = ReadRecord(p, record);
+			if (!isMaterialIndexValid(record.materialIndex))
+				return false;
+			plane.origin = { record.origin[0], record.origin[1], record.origin[2] };
+			plane.normal = { record.normal[0], record.normal[1], record.normal[2] };
+			plane.materialIndex = static_cast<unsigned char>(record.materialIndex);
+		}
+
+		description.spheres.resize(header.numSpheres);
+		for (Sphere& sphere : description.spheres)
+		{
+			SphereRecord record{};
+			p = ReadRecord(p, record);
+			if (!isMaterialIndexValid(record.materialIndex))
+				return false;
+			sphere.origin = { record.origin[0], record.origin[1], record.origin[2] };
+			sphere.radius = record.radius;
+			sphere.materialIndex = static_cast<unsigned char>(record.materialIndex);
+		}
+
+		description.lights.resize(header.numLights);
+		for (Light& light : description.lights)
+		{
+			LightRecord record{};
+			p = ReadRecord(p, record);
+			light.type = record.type == 0 ? LightType::Point : LightType::Directional;
+			light.origin = { record.origin[0], record.origin[1], record.origin[2] };
+			light.direction = { record.direction[0], record.direction[1], record.direction[2] };
+			light.color = { record.color[0], record.color[1], record.color[2] };
+			light.intensity = record.intensity;
+			light.radius = record.radius;
+		}
+
+		const char* pStrings{ p + header.numMeshes * sizeof(MeshRecord) };
+		description.meshes.resize(header.numMeshes);
+		for (MeshDescription& mesh : description.meshes)
+		{
+			MeshRecord record{};
+			p = ReadRecord(p, record);
+			if (record.source > static_cast<uint32_t>(MeshSource::Streamed) || record.cullMode > static_cast<uint32_t>(TriangleCullMode::NoCulling)
+				|| record.filenameOffset > header.stringsSize || record.filenameSize > header.stringsSize - record.filenameOffset
+				|| !isMaterialIndexValid(record.materialIndex))
+				return false;
+
+			mesh.source = static_cast<MeshSource>(record.source);
+			mesh.filename.assign(pStrings + record.filenameOffset, record.filenameSize);
+			mesh.cullMode = static_cast<TriangleCullMode>(record.cullMode);
+			mesh.materialIndex = static_cast<unsigned char>(record.materialIndex);
+			mesh.translation = { record.translation[0], record.translation[1], record.translation[2] };
+			mesh.scale = { record.scale[0], record.scale[1], record.scale[2] };
+			mesh.yaw = record.yaw;
+			mesh.residentBudgetBytes = record.residentBudgetBytes;
+		}
+		return true;
+	}
+#pragma endregion
+
+	//Material indices are only known to be in range once all materials are read
+	bool AreMaterialIndicesValid(const SceneDescription& description)
+	{
+		const size_t numMaterials{ description.materials.size() + 1 };
+		for (const Plane& plane : description.planes)
+		{
+			if (plane.materialIndex >= numMaterials)
+				return false;
+		}
+		for (const Sphere& sphere : description.spheres)
+		{
+			if (sphere.materialIndex >= numMaterials)
+				return false;
+		}
+		for (const MeshDescription& mesh : description.meshes)
+		{
+			if (mesh.materialIndex >= numMaterials)
+				return false;
+		}
+		return description.materials.size() <= g_MaxMaterials;
+	}
+
+	void CopyVector(const Vector3& vector, float (&destination)[3])
+	{
+		destination[0] = vector.x;
+		destination[1] = vector.y;
+		destination[2] = vector.z;
+	}
+
+	void CopyColor(const ColorRGB& color, float (&destination)[3])
+	{
+		destination[0] = color.r;
+		destination[1] = color.g;
+		destination[2] = color.b;
+	}
+
+	template <typename Record>
+	bool WriteRecords(std::FILE* pFile, const std::vector<Record>& records)
+	{
+		return records.empty() || fwrite(records.data(), sizeof(Record), records.size(), pFile) == records.size();
+	}
+}
+
+Material* MaterialDescription::Create(MemoryArena& arena) const
+{
+	switch (type)
+	{
+	case MaterialType::Lambert:
+		return arena.Create<Material_Lambert>(color, parameters[0]);
+	case MaterialType::LambertPhong:
+		return arena.Create<Material_LambertPhong>(color, parameters[0], parameters[1], parameters[2]);
+	case MaterialType::CookTorrence:
+		return arena.Create<Material_CookTorrence>(color, parameters[0], parameters[1]);
+	default:
+		return arena.Create<Material_SolidColor>(color);
+	}
+}
+
+bool SceneFile::Load(const std::string& filename, SceneDescription& description)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	MappedFile file{};
+	if (!file.Open(filename))
+	{
+		std::cout << "Could not open " << filename << std::endl;
+		return false;
+	}
+
+	description = {};
+	const bool isBinary{ file.GetSize() >= sizeof(g_BinaryMagic) && std::memcmp(file.GetData(), g_BinaryMagic, sizeof(g_BinaryMagic)) == 0 };
+	if (isBinary && !LoadBinary(file.GetData(), file.GetSize(), description))
+	{
+		std::cout << "Could not read " << filename << ": not a valid binary scene for this version" << std::endl;
+		return false;
+	}
+	if (!isBinary && !LoadText(filename, file.GetData(), file.GetSize(), description))
+		return false;
+
+	if (!AreMaterialIndicesValid(description))
+	{
+		std::cout << "Could not load " << filename << ": a material index is out of range" << std::endl;
+		return false;
+	}
+
+	const std::chrono::duration<float, std::milli> duration{ std::chrono::steady_clock::now() - start };
+	std::cout << "Loaded " << (isBinary ? "binary" : "text") << " scene " << filename << ": " << description.materials.size() << " materials, "
+		<< description.planes.size() << " planes, " << description.spheres.size() << " spheres, " << description.lights.size() << " lights, "
+		<< description.meshes.size() << " meshes in " << duration.count() << " ms ("
+		<< file.GetSize() / (duration.count() * 1000.f) << " MB/s)" << std::endl;
+	return true;
+}
+
+bool SceneFile::WriteBinary(const std::string& filename, const SceneDescription& description)
+{
+	BinaryHeader header{};
+	std::memcpy(header.magic, g_BinaryMagic, sizeof(g_BinaryMagic));
+	header.version = g_BinaryVersion;
+	header.byteOrderMark = g_ByteOrderMark;
+	header.headerSize = sizeof(BinaryHeader);
+	header.numMaterials = description.materials.size();
+	header.numPlanes = description.planes.size();
+	header.numSpheres = description.spheres.size();
+	header.numLights = description.lights.size();
+	header.numMeshes = description.meshes.size();
+	header.hasCamera = description.hasCamera ? 1 : 0;
+	CopyVector(description.cameraOrigin, header.cameraOrigin);
+	header.cameraPitch = description.cameraPitch;
+	header.cameraYaw = description.cameraYaw;
+	header.fovAngle = description.fovAngle;
+
+	std::vector<MaterialRecord> materials(description.materials.size());
+	for (size_t i{}; i < materials.size(); ++i)
+	{
+		const MaterialDescription& material{ description.materials[i] };
+		materials[i].type = static_cast<uint32_t>(material.type);
+		CopyColor(material.color, materials[i].color);
+		std::memcpy(materials[i].parameters, material.parameters, sizeof(material.parameters));
+	}
+
+	std::vector<PlaneRecord> planes(description.planes.size());
+	for (size_t i{}; i < planes.size(); ++i)
+	{
+		CopyVector(description.planes[i].origin, planes[i].origin);
+		CopyVector(description.planes[i].normal, planes[i].normal);
+		planes[i].materialIndex = description.planes[i].materialIndex;
+	}
+
+	std::vector<SphereRecord> spheres(description.spheres.size());
+	for (size_t i{}; i < spheres.size(); ++i)
+	{
+		CopyVector(description.spheres[i].origin, spheres[i].origin);
+		spheres[i].radius = description.spheres[i].radius;
+		spheres[i].materialIndex = description.spheres[i].materialIndex;
+	}
+
+	std::vector<LightRecord> lights(description.lights.size());
+	for (size_t i{}; i < lights.size(); ++i)
+	{
+		const Light& light{ description.lights[i] };
+		lights[i].type = light.type == LightType::Point ? 0 : 1;
+		CopyVector(light.origin, lights[i].origin);
+		CopyVector(light.direction, lights[i].direction);
+		CopyColor(light.color, lights[i].color);
+		lights[i].intensity = light.intensity;
+		lights[i].radius = light.radius;
+	}
+
+	std::string strings{};
+	std::vector<MeshRecord> meshes(description.meshes.size());
+	for (size_t i{}; i < meshes.size(); ++i)
+	{
+		const MeshDescription& mesh{ description.meshes[i] };
+		meshes[i].source = static_cast<uint32_t>(mesh.source);
+		meshes[i].cullMode = static_cast<uint32_t>(mesh.cullMode);
+		meshes[i].materialIndex = mesh.materialIndex;
+		CopyVector(mesh.translation, meshes[i].translation);
+		CopyVector(mesh.scale, meshes[i].scale);
+		meshes[i].yaw = mesh.yaw;
+		meshes[i].residentBudgetBytes = mesh.residentBudgetBytes;
+		meshes[i].filenameOffset = strings.size();
+		meshes[i].filenameSize = mesh.filename.size();
+		strings += mesh.filename;
+	}
+	header.stringsSize = strings.size();
+	header.fileSize = sizeof(BinaryHeader) + materials.size() * sizeof(MaterialRecord) + planes.size() * sizeof(PlaneRecord)
+		+ spheres.size() * sizeof(SphereRecord) + lights.size() * sizeof(LightRecord) + meshes.size() * sizeof(MeshRecord) + strings.size();
+
+	std::FILE* pFile{};
+#if defined(_WIN32)
+	if (fopen_s(&pFile, filename.c_str(), "wb") != 0)
+		pFile = nullptr;
+#else
+	pFile = fopen(filename.c_str(), "wb");
+#endif
+	if (!pFile)
+	{
+		std::cout << "Could not open " << filename << " for writing" << std::endl;
+		return false;
+	}
+
+	const bool isWritten{ fwrite(&header, sizeof(header), 1, pFile) == 1
+		&& WriteRecords(pFile, materials) && WriteRecords(pFile, planes) && WriteRecords(pFile, spheres)
+		&& WriteRecords(pFile, lights) && WriteRecords(pFile, meshes)
+		&& (strings.empty() || fwrite(strings.data(), 1, strings.size(), pFile) == strings.size()) };
+	if (fclose(pFile) != 0 || !isWritten)
+	{
+		std::cout << "Could not write " << filename << std::endl;
+		std::remove(filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool SceneFile::Convert(const std::string& sourceFilename, const std::string& binaryFilename)
+{
+	SceneDescription description{};
+	if (!Load(sourceFilename, description) || !WriteBinary(binaryFilename, description))
+		return false;
+
+	std::cout << "Wrote " << binaryFilename << std::endl;
+	return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Material;
+	class MemoryArena;
+
+	//Scene description files, loaded by Scene_File
+	//Text (".scene"), one record per line, '#' starts a comment:
+	//  camera x y z pitch yaw fov                 pitch and yaw in radians, fov in degrees
+	//  material solid r g b
+	//  material lambert r g b reflectance
+	//  material phong r g b kd ks exponent
+	//  material cooktorrance r g b metalness roughness
+	//  plane x y z nx ny nz material
+	//  sphere x y z radius material
+	//  pointlight x y z intensity r g b [radius]
+	//  directionallight x y z intensity r g b
+	//  mesh file.obj cull material [tx ty tz [sx sy sz [yaw]]]
+	//  glb file.glb cull material
+	//  streamed file.obj cull material budgetMB
+	//Materials are numbered in file order starting at 1, 0 is the scene's default red. cull is front, back or none.
+	//Mesh paths are relative to the working directory, like the ones in the built-in scenes, and can not contain spaces.
+	//Binary (".sceneb", written by Convert): the same records in fixed-size native layout, read without any parsing.
+	namespace SceneFile
+	{
+		enum class MaterialType : uint32_t
+		{
+			SolidColor,
+			Lambert,
+			LambertPhong,
+			CookTorrence
+		};
+
+		enum class MeshSource : uint32_t
+		{
+			OBJ,
+			GLB,
+			Streamed
+		};
+
+		struct MaterialDescription
+		{
+			MaterialType type{};
+			ColorRGB color{};
+			//Reflectance; kd, ks, exponent; or metalness, roughness
+			float parameters[3]{};
+
+			//The material lives as long as the arena
+			Material* Create(MemoryArena& arena) const;
+		};
+
+		struct MeshDescription
+		{
+			MeshSource source{};
+			std::string filename{};
+			TriangleCullMode cullMode{};
+			unsigned char materialIndex{};
+			//OBJ meshes only
+			Vector3 translation{};
+			Vector3 scale{ 1.f, 1.f, 1.f };
+			float yaw{};
+			//Streamed meshes only
+			uint64_t residentBudgetBytes{};
+		};
+
+		struct SceneDescription
+		{
+			bool hasCamera{};
+			Vector3 cameraOrigin{};
+			float cameraPitch{};
+			float cameraYaw{};
+			float fovAngle{ 45.f };
+
+			std::vector<MaterialDescription> materials{};
+			std::vector<Plane> planes{};
+			std::vector<Sphere> spheres{};
+			std::vector<Light> lights{};
+			std::vector<MeshDescription> meshes{};
+		};
+
+		//Text or binary, told apart by the first bytes of the file
+		//Every container is sized once up front, the text parser counts the records before filling them
+		bool Load(const std::string& filename, SceneDescription& description);
+		bool WriteBinary(const std::string& filename, const SceneDescription& description);
+		//Loads any scene file and writes it as binary
+		bool Convert(const std::string& sourceFilename, const std::string& binaryFilename);
+	}
+}
@@ -0,0 +1,842 @@
+#include "StreamedMesh.h"
+#include "ObjLoader.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+
+using namespace dae;
+
+namespace
+{
+	//Bump whenever the layout of the header, the chunk table or a chunk changes
+	constexpr uint32_t g_ChunkFileVersion{ 2 };
+	constexpr char g_ChunkFileMagic[8]{ 'D', 'A', 'E', 'C', 'H', 'N', 'K', '\0' };
+	constexpr uint32_t g_ByteOrderMark{ 0x01020304 };
+	//Chunks start on 64KB boundaries: whole pages everywhere, and the allocation granularity on Windows
+	constexpr uint64_t g_ChunkAlignment{ 65536 };
+	constexpr uint64_t g_SectionAlignment{ 64 };
+	//A few MB per chunk: one read brings in a useful amount, and a frame only needs a fraction of a large mesh
+	constexpr uint32_t g_TargetChunkTriangles{ 1 << 16 };
+
+	static_assert(sizeof(Vector3) == 12, "Chunks store Vector3 as three packed floats");
+	static_assert(sizeof(BVHNode) == 32, "Chunks store BVHNode as 32 bytes");
+
+	struct ChunkFileHeader
+	{
+		char magic[8]{};
+		uint32_t version{};
+		uint32_t byteOrderMark{};
+		uint64_t headerSize{};
+		uint64_t fileSize{};
+
+		//Size and last write time of the OBJ: checking them costs nothing, hashing a mesh larger than RAM costs a full read
+		uint64_t sourceSize{};
+		int64_t sourceWriteTime{};
+
+		uint64_t numTriangles{};
+		uint64_t numChunks{};
+		uint64_t chunkTableOffset{};
+	};
+
+	struct ChunkEntry
+	{
+		Vector3 minAABB{};
+		uint32_t numPositions{};
+		Vector3 maxAABB{};
+		uint32_t numTriangles{};
+		uint32_t numNodes{};
+		uint32_t padding{};
+		//From the start of the file, a multiple of g_ChunkAlignment
+		uint64_t offset{};
+	};
+
+	//Sections of one chunk, as byte offsets from the start of the chunk
+	struct ChunkLayout
+	{
+		uint64_t nodesOffset{};
+		uint64_t positionsOffset{};
+		uint64_t normalsOffset{};
+		uint64_t indicesOffset{};
+		uint64_t size{};
+	};
+
+	uint64_t Align(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	ChunkLayout GetChunkLayout(const ChunkEntry& entry)
+	{
+		ChunkLayout layout{};
+		layout.positionsOffset = Align(layout.nodesOffset + entry.numNodes * sizeof(BVHNode), g_SectionAlignment);
+		layout.normalsOffset = Align(layout.positionsOffset + entry.numPositions * sizeof(Vector3), g_SectionAlignment);
+		layout.indicesOffset = Align(layout.normalsOffset + entry.numTriangles * sizeof(Vector3), g_SectionAlignment);
+		layout.size = layout.indicesOffset + static_cast<uint64_t>(entry.numTriangles) * 3 * sizeof(int);
+		return layout;
+	}
+
+	uint64_t GetChunkTableOffset()
+	{
+		return Align(sizeof(ChunkFileHeader), g_SectionAlignment);
+	}
+
+	//Conversion counts the triangles by centroid in a grid of 64^3 cells (2MB of counters) and splits that grid at the
+	//median until every part holds about g_TargetChunkTriangles triangles, so every chunk is a compact box of the mesh
+	constexpr uint32_t g_ConversionGridSize{ 64 };
+	//Chunks are built in batches of about this many triangles, which bounds the memory conversion needs whatever the mesh size
+	//A single grid cell is never split, so a very dense cell makes a larger chunk and batch
+	constexpr uint64_t g_ConversionBatchTriangles{ 1 << 22 };
+
+	//One triangle as conversion passes it between its passes
+	struct TriangleRecord
+	{
+		std::array<int, 3> indices{};
+		uint32_t cell{};
+	};
+
+	//Everything one chunk stores, with indices and node ranges local to the chunk
+	struct ChunkData
+	{
+		std::vector<BVHNode> nodes{};
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<int> indices{};
+	};
+
+	std::FILE* OpenForWriting(const std::string& filename)
+	{
+		std::FILE* pFile{};
+#if defined(_WIN32)
+		if (fopen_s(&pFile, filename.c_str(), "wb") != 0)
+			pFile = nullptr;
+#else
+		pFile = fopen(filename.c_str(), "wb");
+#endif
+		return pFile;
+	}
+
+	bool WritePadding(std::FILE* pFile, uint64_t& position, uint64_t offset)
+	{
+		static constexpr char padding[4096]{};
+		while (position < offset)
+		{
+			const size_t size{ static_cast<size_t>(std::min<uint64_t>(offset - position, sizeof(padding))) };
+			if (fwrite(padding, 1, size, pFile) != size)
+				return false;
+			position += size;
+		}
+		return true;
+	}
+
+	bool WriteSection(std::FILE* pFile, uint64_t& position, uint64_t offset, const void* pData, uint64_t size)
+	{
+		if (!WritePadding(pFile, position, offset))
+			return false;
+		position = offset + size;
+		return size == 0 || fwrite(pData, 1, size, pFile) == size;
+	}
+
+	//Grid cells are numbered x first, then y, then z
+	struct GridRegion
+	{
+		std::array<uint32_t, 3> min{};
+		//Exclusive
+		std::array<uint32_t, 3> max{};
+	};
+
+	uint32_t GetGridCell(const std::array<uint32_t, 3>& coordinates)
+	{
+		return coordinates[0] + g_ConversionGridSize * (coordinates[1] + g_ConversionGridSize * coordinates[2]);
+	}
+
+	//Points outside the bounds go to the nearest cell
+	uint32_t GetGridCell(const Vector3& point, const Vector3& minBounds, const Vector3& cellScale)
+	{
+		std::array<uint32_t, 3> coordinates{};
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float scaled{ (point[axis] - minBounds[axis]) * cellScale[axis] };
+			//Written so NaN ends up in the first cell as well
+			coordinates[axis] = scaled > 0.f ? static_cast<uint32_t>(std::min(scaled, static_cast<float>(g_ConversionGridSize - 1))) : 0;
+		}
+		return GetGridCell(coordinates);
+	}
+
+	//Calls function for every cell of the region with its coordinates and cell index
+	template <typename CellFunction>
+	void ForEachCell(const GridRegion& region, const CellFunction& function)
+	{
+		std::array<uint32_t, 3> coordinates{};
+		for (coordinates[2] = region.min[2]; coordinates[2] < region.max[2]; ++coordinates[2])
+		{
+			for (coordinates[1] = region.min[1]; coordinates[1] < region.max[1]; ++coordinates[1])
+			{
+				for (coordinates[0] = region.min[0]; coordinates[0] < region.max[0]; ++coordinates[0])
+				{
+					function(coordinates, GetGridCell(coordinates));
+				}
+			}
+		}
+	}
+
+	//First pass: positions go to a temporary file as packed Vector3, their bounds are the extent of the grid
+	bool WritePositions(ObjLoader::Reader& reader, const std::string& positionsFilename, uint64_t& numPositions, Vector3& minBounds, Vector3& maxBounds)
+	{
+		std::FILE* pFile{ OpenForWriting(positionsFilename) };
+		if (!pFile)
+			return false;
+
+		numPositions = 0;
+		minBounds = Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
+		maxBounds = Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		Vector3 position{};
+		std::array<int, 3> triangle{};
+		ObjLoader::Reader::Element element{};
+		bool isWritten{ true };
+		while (isWritten && (element = reader.Next(position, triangle)) != ObjLoader::Reader::Element::End)
+		{
+			if (element == ObjLoader::Reader::Element::Malformed)
+			{
+				isWritten = false;
+				break;
+			}
+			if (element != ObjLoader::Reader::Element::Position)
+				continue;
+
+			isWritten = fwrite(&position, sizeof(Vector3), 1, pFile) == 1;
+			for (int axis{}; axis < 3; ++axis)
+			{
+				minBounds[axis] = std::min(minBounds[axis], position[axis]);
+				maxBounds[axis] = std::max(maxBounds[axis], position[axis]);
+			}
+			++numPositions;
+		}
+		return fclose(pFile) == 0 && isWritten;
+	}
+
+	//Second pass: every triangle goes to a temporary file together with its grid cell, and the cells are counted
+	bool WriteTriangles(ObjLoader::Reader& reader, const std::string& trianglesFilename, const MappedFile& positions,
+		const Vector3& minBounds, const Vector3& cellScale, std::vector<uint64_t>& cellCounts, bool& hasInvalidIndex)
+	{
+		std::FILE* pFile{ OpenForWriting(trianglesFilename) };
+		if (!pFile)
+			return false;
+
+		const Vector3* pPositions{ reinterpret_cast<const Vector3*>(positions.GetData()) };
+		const uint64_t numPositions{ positions.GetSize() / sizeof(Vector3) };
+		cellCounts.assign(static_cast<size_t>(g_ConversionGridSize) * g_ConversionGridSize * g_ConversionGridSize, 0);
+		hasInvalidIndex = false;
+
+		Vector3 position{};
+		TriangleRecord record{};
+		ObjLoader::Reader::Element element{};
+		bool isWritten{ true };
+		while (isWritten && (element = reader.Next(position, record.indices)) != ObjLoader::Reader::Element::End)
+		{
+			if (element == ObjLoader::Reader::Element::Malformed)
+			{
+				isWritten = false;
+				break;
+			}
+			if (element != ObjLoader::Reader::Element::Triangle)
+				continue;
+
+			for (const int index : record.indices)
+			{
+				if (index < 0 || static_cast<uint64_t>(index) >= numPositions)
+					hasInvalidIndex = true;
+			}
+			if (hasInvalidIndex)
+			{
+				isWritten = false;
+				break;
+			}
+
+			const Vector3 centroid{ (pPositions[record.indices[0]] + pPositions[record.indices[1]] + pPositions[record.indices[2]]) / 3.f };
+			record.cell = GetGridCell(centroid, minBounds, cellScale);
+			++cellCounts[record.cell];
+			isWritten = fwrite(&record, sizeof(TriangleRecord), 1, pFile) == 1;
+		}
+		return fclose(pFile) == 0 && isWritten;
+	}
+
+	//Splits the grid at the median of its longest side until every region holds at most g_TargetChunkTriangles triangles
+	//(or is a single cell). Returns the chunk of every cell, chunkSizes gets the number of triangles in each chunk
+	std::vector<uint32_t> AssignChunks(const std::vector<uint64_t>& cellCounts, const Vector3& cellSize, std::vector<uint64_t>& chunkSizes)
+	{
+		std::vector<uint32_t> cellChunks(cellCounts.size());
+		chunkSizes.clear();
+
+		std::vector<GridRegion> pendingRegions{ { {}, { g_ConversionGridSize, g_ConversionGridSize, g_ConversionGridSize } } };
+		std::vector<uint64_t> sliceCounts(g_ConversionGridSize);
+		while (!pendingRegions.empty())
+		{
+			GridRegion region{ pendingRegions.back() };
+			pendingRegions.pop_back();
+
+			//Shrink to the cells that hold triangles, so the longest side is measured on the mesh and not on empty space
+			GridRegion tightRegion{ region.max, region.min };
+			uint64_t numTriangles{};
+			ForEachCell(region, [&](const std::array<uint32_t, 3>& coordinates, uint32_t cell)
+				{
+					if (cellCounts[cell] == 0)
+						return;
+					numTriangles += cellCounts[cell];
+					for (int axis{}; axis < 3; ++axis)
+					{
+						tightRegion.min[axis] = std::min(tightRegion.min[axis], coordinates[axis]);
+						tightRegion.max[axis] = std::max(tightRegion.max[axis], coordinates[axis] + 1);
+					}
+				});
+			if (numTriangles == 0)
+				continue;
+			region = tightRegion;
+
+			int splitAxis{ -1 };
+			float longestSide{ -1.f };
+			for (int axis{}; axis < 3; ++axis)
+			{
+				const float side{ (region.max[axis] - region.min[axis]) * cellSize[axis] };
+				if (region.max[axis] - region.min[axis] > 1 && side > longestSide)
+				{
+					splitAxis = axis;
+					longestSide = side;
+				}
+			}
+
+			if (numTriangles <= g_TargetChunkTriangles || splitAxis < 0)
+			{
+				ForEachCell(region, [&](const std::array<uint32_t, 3>&, uint32_t cell) { cellChunks[cell] = static_cast<uint32_t>(chunkSizes.size()); });
+				chunkSizes.push_back(numTriangles);
+				continue;
+			}
+
+			//First slice where half of the triangles are behind, both sides keep at least one slice
+			std::fill(sliceCounts.begin(), sliceCounts.end(), 0);
+			ForEachCell(region, [&](const std::array<uint32_t, 3>& coordinates, uint32_t cell) { sliceCounts[coordinates[splitAxis]] += cellCounts[cell]; });
+			uint32_t split{ region.min[splitAxis] + 1 };
+			for (uint64_t before{ sliceCounts[region.min[splitAxis]] }; split < region.max[splitAxis] - 1 && before * 2 < numTriangles; ++split)
+			{
+				before += sliceCounts[split];
+			}
+
+			GridRegion upper{ region };
+			region.max[splitAxis] = split;
+			upper.min[splitAxis] = split;
+			pendingRegions.push_back(upper);
+			pendingRegions.push_back(region);
+		}
+		return cellChunks;
+	}
+
+	//Gives a chunk its own copy of the positions it uses and its own BVH, pIndices refer to the whole mesh
+	void BuildChunk(const Vector3* pPositions, const int* pIndices, uint64_t numTriangles, ChunkData& chunk, std::vector<int>& usedIndices)
+	{
+		const size_t numIndices{ static_cast<size_t>(numTriangles) * 3 };
+		usedIndices.assign(pIndices, pIndices + numIndices);
+		std::sort(usedIndices.begin(), usedIndices.end());
+		usedIndices.erase(std::unique(usedIndices.begin(), usedIndices.end()), usedIndices.end());
+
+		chunk.positions.resize(usedIndices.size());
+		for (size_t i{}; i < usedIndices.size(); ++i)
+		{
+			chunk.positions[i] = pPositions[usedIndices[i]];
+		}
+
+		chunk.indices.resize(numIndices);
+		for (size_t i{}; i < numIndices; ++i)
+		{
+			chunk.indices[i] = static_cast<int>(std::lower_bound(usedIndices.begin(), usedIndices.end(), pIndices[i]) - usedIndices.begin());
+		}
+
+		//Flat face normals, the same way ObjLoader computes them
+		chunk.normals.resize(static_cast<size_t>(numTriangles));
+		for (size_t triangle{}; triangle < chunk.normals.size(); ++triangle)
+		{
+			const Vector3& v0{ chunk.positions[chunk.indices[triangle * 3]] };
+			const Vector3 edgeV0V1{ chunk.positions[chunk.indices[triangle * 3 + 1]] - v0 };
+			const Vector3 edgeV0V2{ chunk.positions[chunk.indices[triangle * 3 + 2]] - v0 };
+			chunk.normals[triangle] = Vector3::Cross(edgeV0V1, edgeV0V2).Normalized();
+		}
+
+		MeshBVH bvh{};
+		bvh.Build(chunk.positions, chunk.indices, chunk.normals);
+		chunk.nodes = bvh.GetNodes();
+	}
+
+	//Last passes: the triangles of a batch of chunks are gathered from the triangle file, then every chunk is built and
+	//appended; the header and chunk table go in last, once every offset is known
+	bool WriteChunks(const std::string& temporaryFilename, const MappedFile& positions, const MappedFile& triangles,
+		const std::vector<uint32_t>& cellChunks, const std::vector<uint64_t>& chunkSizes, uint64_t sourceSize, int64_t sourceWriteTime)
+	{
+		std::FILE* pFile{ OpenForWriting(temporaryFilename) };
+		if (!pFile)
+			return false;
+
+		const Vector3* pPositions{ reinterpret_cast<const Vector3*>(positions.GetData()) };
+		const TriangleRecord* pRecords{ reinterpret_cast<const TriangleRecord*>(triangles.GetData()) };
+		const uint64_t numRecords{ triangles.GetSize() / sizeof(TriangleRecord) };
+
+		ChunkFileHeader header{};
+		std::memcpy(header.magic, g_ChunkFileMagic, sizeof(g_ChunkFileMagic));
+		header.version = g_ChunkFileVersion;
+		header.byteOrderMark = g_ByteOrderMark;
+		header.headerSize = sizeof(ChunkFileHeader);
+		header.sourceSize = sourceSize;
+		header.sourceWriteTime = sourceWriteTime;
+		header.numTriangles = numRecords;
+		header.numChunks = chunkSizes.size();
+		header.chunkTableOffset = GetChunkTableOffset();
+
+		//Placeholders first, so the chunks land behind them
+		std::vector<ChunkEntry> entries(chunkSizes.size());
+		uint64_t position{};
+		bool isWritten{ WriteSection(pFile, position, 0, &header, sizeof(header))
+			&& WriteSection(pFile, position, header.chunkTableOffset, entries.data(), entries.size() * sizeof(ChunkEntry)) };
+
+		std::vector<int> batchIndices{};
+		std::vector<uint64_t> batchOffsets{};
+		std::vector<int> usedIndices{};
+		ChunkData chunk{};
+		for (size_t firstChunk{}; firstChunk < chunkSizes.size() && isWritten;)
+		{
+			size_t endChunk{ firstChunk };
+			uint64_t numBatchTriangles{};
+			batchOffsets.assign(1, 0);
+			while (endChunk < chunkSizes.size() && (endChunk == firstChunk || numBatchTriangles + chunkSizes[endChunk] <= g_ConversionBatchTriangles))
+			{
+				numBatchTriangles += chunkSizes[endChunk++];
+				batchOffsets.push_back(numBatchTriangles);
+			}
+
+			//Only this batch of the mesh is ever on the heap
+			batchIndices.resize(static_cast<size_t>(numBatchTriangles) * 3);
+			std::vector<uint64_t> cursors(batchOffsets.begin(), batchOffsets.end() - 1);
+			for (uint64_t i{}; i < numRecords; ++i)
+			{
+				const uint32_t chunkIndex{ cellChunks[pRecords[i].cell] };
+				if (chunkIndex < firstChunk || chunkIndex >= endChunk)
+					continue;
+				const uint64_t triangle{ cursors[chunkIndex - firstChunk]++ };
+				std::copy(pRecords[i].indices.begin(), pRecords[i].indices.end(), batchIndices.begin() + triangle * 3);
+			}
+			triangles.AdviseDontNeed(0, triangles.GetSize());
+
+			for (size_t chunkIndex{ firstChunk }; chunkIndex < endChunk && isWritten; ++chunkIndex)
+			{
+				const uint64_t firstTriangle{ batchOffsets[chunkIndex - firstChunk] };
+				BuildChunk(pPositions, batchIndices.data() + firstTriangle * 3, chunkSizes[chunkIndex], chunk, usedIndices);
+
+				ChunkEntry& entry{ entries[chunkIndex] };
+				entry.minAABB = chunk.nodes[0].minAABB;
+				entry.maxAABB = chunk.nodes[0].maxAABB;
+				entry.numPositions = static_cast<uint32_t>(chunk.positions.size());
+				entry.numTriangles = static_cast<uint32_t>(chunkSizes[chunkIndex]);
+				entry.numNodes = static_cast<uint32_t>(chunk.nodes.size());
+				entry.offset = Align(position, g_ChunkAlignment);
+
+				const ChunkLayout layout{ GetChunkLayout(entry) };
+				isWritten = WriteSection(pFile, position, entry.offset + layout.nodesOffset, chunk.nodes.data(), chunk.nodes.size() * sizeof(BVHNode))
+					&& WriteSection(pFile, position, entry.offset + layout.positionsOffset, chunk.positions.data(), chunk.positions.size() * sizeof(Vector3))
+					&& WriteSection(pFile, position, entry.offset + layout.normalsOffset, chunk.normals.data(), chunk.normals.size() * sizeof(Vector3))
+					&& WriteSection(pFile, position, entry.offset + layout.indicesOffset, chunk.indices.data(), chunk.indices.size() * sizeof(int));
+			}
+			positions.AdviseDontNeed(0, positions.GetSize());
+			firstChunk = endChunk;
+		}
+
+		header.fileSize = position;
+		if (isWritten)
+		{
+			position = 0;
+			isWritten = fseek(pFile, 0, SEEK_SET) == 0
+				&& WriteSection(pFile, position, 0, &header, sizeof(header))
+				&& WriteSection(pFile, position, header.chunkTableOffset, entries.data(), entries.size() * sizeof(ChunkEntry));
+		}
+		return fclose(pFile) == 0 && isWritten;
+	}
+
+	//Converts without ever holding the whole mesh: positions and triangles go through temporary files that are mapped
+	//again, so the OS pages them like the chunk file, and only the grid counts and one batch of chunks live on the heap
+	bool WriteChunkFile(const std::string& objFilename, const std::string& chunkFilename, uint64_t sourceSize, int64_t sourceWriteTime)
+	{
+		const auto start{ std::chrono::steady_clock::now() };
+
+		ObjLoader::Reader reader{};
+		if (!reader.Open(objFilename))
+			return false;
+
+		//Unique names and a rename at the end, same as the mesh cache
+		const std::string suffix{ ".tmp" + std::to_string(std::random_device{}()) };
+		const std::string positionsFilename{ chunkFilename + ".positions" + suffix };
+		const std::string trianglesFilename{ chunkFilename + ".triangles" + suffix };
+		const std::string temporaryFilename{ chunkFilename + suffix };
+
+		uint64_t numPositions{};
+		Vector3 minBounds{};
+		Vector3 maxBounds{};
+		bool isWritten{ WritePositions(reader, positionsFilename, numPositions, minBounds, maxBounds) };
+
+		MappedFile positions{};
+		MappedFile triangles{};
+		uint64_t numTriangles{};
+		std::vector<uint64_t> chunkSizes{};
+		bool hasInvalidIndex{};
+		if (isWritten)
+		{
+			const Vector3 extent{ maxBounds - minBounds };
+			const Vector3 cellSize{ extent / static_cast<float>(g_ConversionGridSize) };
+			Vector3 cellScale{};
+			for (int axis{}; axis < 3; ++axis)
+			{
+				cellScale[axis] = extent[axis] > 0.f ? 1.f / cellSize[axis] : 0.f;
+			}
+
+			std::vector<uint64_t> cellCounts{};
+			reader.Rewind();
+			isWritten = positions.Open(positionsFilename)
+				&& WriteTriangles(reader, trianglesFilename, positions, minBounds, cellScale, cellCounts, hasInvalidIndex)
+				&& triangles.Open(trianglesFilename);
+
+			if (isWritten)
+			{
+				numTriangles = triangles.GetSize() / sizeof(TriangleRecord);
+				const std::vector<uint32_t> cellChunks{ AssignChunks(cellCounts, cellSize, chunkSizes) };
+				isWritten = WriteChunks(temporaryFilename, positions, triangles, cellChunks, chunkSizes, sourceSize, sourceWriteTime);
+			}
+		}
+
+		positions.Close();
+		triangles.Close();
+		std::remove(positionsFilename.c_str());
+		std::remove(trianglesFilename.c_str());
+
+		if (hasInvalidIndex)
+			std::cout << "Face references a missing vertex in " << objFilename << std::endl;
+		else if (!isWritten)
+			std::cout << "Malformed vertex or face in " << objFilename << ", or the disk is full" << std::endl;
+
+		if (!isWritten)
+		{
+			std::remove(temporaryFilename.c_str());
+			return false;
+		}
+
+		std::remove(chunkFilename.c_str());
+		if (std::rename(temporaryFilename.c_str(), chunkFilename.c_str()) != 0)
+		{
+			std::remove(temporaryFilename.c_str());
+			return false;
+		}
+
+		const std::chrono::duration<float, std::milli> duration{ std::chrono::steady_clock::now() - start };
+		std::cout << "Converted " << objFilename << ": " << numPositions << " vertices, " << numTriangles
+			<< " triangles into " << chunkSizes.size() << " chunks in " << duration.count() << " ms" << std::endl;
+		return true;
+	}
+
+	//Checks one chunk the way traversal will read it, anything else could crash a render thread
+	bool IsChunkValid(const BVHNode* pNodes, uint32_t numNodes, const int* pIndices, uint32_t numTriangles, uint32_t numPositions)
+	{
+		for (uint32_t i{}; i < numNodes; ++i)
+		{
+			const BVHNode& node{ pNodes[i] };
+			const bool isInside{ node.IsLeaf()
+				? static_cast<uint64_t>(node.leftFirst) + node.numTriangles <= numTriangles
+				: node.leftFirst > i && static_cast<uint64_t>(node.leftFirst) + 1 < numNodes };
+			if (!isInside)
+				return false;
+		}
+
+		for (uint64_t i{}; i < static_cast<uint64_t>(numTriangles) * 3; ++i)
+		{
+			if (pIndices[i] < 0 || static_cast<uint32_t>(pIndices[i]) >= numPositions)
+				return false;
+		}
+		return true;
+	}
+
+	//Size and last write time of a file, false when it does not exist
+	bool GetFileStamp(const std::string& filename, uint64_t& size, int64_t& writeTime)
+	{
+		std::error_code error{};
+		size = std::filesystem::file_size(filename, error);
+		if (error)
+			return false;
+		writeTime = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+		return !error;
+	}
+}
+
+StreamedMesh::StreamedMesh(TriangleCullMode cullMode, unsigned char materialIndex, uint64_t residentBudgetBytes)
+	: m_CullMode{ cullMode }
+	, m_MaterialIndex{ materialIndex }
+	, m_ResidentBudgetBytes{ residentBudgetBytes }
+{
+}
+
+bool StreamedMesh::Open(const std::string& objFilename)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+	const std::string chunkFilename{ objFilename + ".chunks" };
+
+	uint64_t sourceSize{};
+	int64_t sourceWriteTime{};
+	if (!GetFileStamp(objFilename, sourceSize, sourceWriteTime))
+	{
+		std::cout << "Could not open " << objFilename << std::endl;
+		return false;
+	}
+
+	for (int attempt{}; attempt < 2; ++attempt)
+	{
+		if (attempt > 0)
+		{
+			//Missing or stale, convert from the OBJ; Windows cannot replace the chunk file while it is still mapped
+			m_File.Close();
+			if (!WriteChunkFile(objFilename, chunkFilename, sourceSize, sourceWriteTime))
+			{
+				std::cout << "Could not write chunk file " << chunkFilename << std::endl;
+				return false;
+			}
+		}
+
+		if (!m_File.Open(chunkFilename) || m_File.GetSize() < sizeof(ChunkFileHeader))
+			continue;
+
+		ChunkFileHeader header{};
+		std::memcpy(&header, m_File.GetData(), sizeof(header));
+		const uint64_t fileSize{ m_File.GetSize() };
+		if (std::memcmp(header.magic, g_ChunkFileMagic, sizeof(g_ChunkFileMagic)) != 0
+			|| header.version != g_ChunkFileVersion
+			|| header.byteOrderMark != g_ByteOrderMark
+			|| header.headerSize != sizeof(ChunkFileHeader)
+			|| header.fileSize != fileSize
+			|| header.sourceSize != sourceSize
+			|| header.sourceWriteTime != sourceWriteTime
+			|| header.chunkTableOffset != GetChunkTableOffset()
+			|| header.numChunks > (fileSize - header.chunkTableOffset) / sizeof(ChunkEntry))
+			continue;
+
+		const ChunkEntry* pEntries{ reinterpret_cast<const ChunkEntry*>(m_File.GetData() + header.chunkTableOffset) };
+		const uint64_t tableEnd{ header.chunkTableOffset + header.numChunks * sizeof(ChunkEntry) };
+
+		//Only the chunk table is checked here, the contents of a chunk are checked when it is first paged in
+		bool isValid{ true };
+		uint64_t numTriangles{};
+		for (uint64_t i{}; i < header.numChunks && isValid; ++i)
+		{
+			const ChunkEntry& entry{ pEntries[i] };
+			const uint64_t size{ GetChunkLayout(entry).size };
+			isValid = entry.offset % g_ChunkAlignment == 0 && entry.offset >= tableEnd
+				&& entry.offset <= fileSize && size <= fileSize - entry.offset
+				&& (entry.numTriangles == 0) == (entry.numNodes == 0);
+			numTriangles += entry.numTriangles;
+		}
+		if (!isValid || numTriangles != header.numTriangles)
+			continue;
+
+		m_Chunks = std::vector<Chunk>(header.numChunks);
+		std::vector<Vector3> minBounds(header.numChunks);
+		std::vector<Vector3> maxBounds(header.numChunks);
+		for (uint64_t i{}; i < header.numChunks; ++i)
+		{
+			const ChunkEntry& entry{ pEntries[i] };
+			const ChunkLayout layout{ GetChunkLayout(entry) };
+			const char* pChunk{ m_File.GetData() + entry.offset };
+
+			Chunk& chunk{ m_Chunks[i] };
+			chunk.minAABB = entry.minAABB;
+			chunk.maxAABB = entry.maxAABB;
+			chunk.pNodes = reinterpret_cast<const BVHNode*>(pChunk + layout.nodesOffset);
+			chunk.pPositions = reinterpret_cast<const Vector3*>(pChunk + layout.positionsOffset);
+			chunk.pNormals = reinterpret_cast<const Vector3*>(pChunk + layout.normalsOffset);
+			chunk.pIndices = reinterpret_cast<const int*>(pChunk + layout.indicesOffset);
+			chunk.numNodes = entry.numNodes;
+			chunk.numTriangles = entry.numTriangles;
+			chunk.numPositions = entry.numPositions;
+			chunk.offset = entry.offset;
+			chunk.size = layout.size;
+
+			minBounds[i] = entry.minAABB;
+			maxBounds[i] = entry.maxAABB;
+		}
+		m_ChunkOrder = m_ChunkBVH.BuildOverBoxes(minBounds, maxBounds);
+		m_NumTriangles = header.numTriangles;
+
+		const std::chrono::duration<float, std::milli> duration{ std::chrono::steady_clock::now() - start };
+		std::cout << "Streaming " << objFilename << ": " << m_NumTriangles << " triangles in " << m_Chunks.size() << " chunks ("
+			<< fileSize / (1024.f * 1024.f) << " MB, budget " << m_ResidentBudgetBytes / (1024.f * 1024.f) << " MB), opened in "
+			<< duration.count() << " ms" << std::endl;
+		return true;
+	}
+
+	m_File.Close();
+	std::cout << "Could not open chunk file " << chunkFilename << std::endl;
+	return false;
+}
+
+void StreamedMesh::BeginFrame(MemoryArena& frameArena)
+{
+	m_FrameStatistics.pageIns = m_PageIns.exchange(0);
+	m_FrameStatistics.bytesPagedIn = m_BytesPagedIn.exchange(0);
+	m_FrameStatistics.residentBytes = m_ResidentBytes.load();
+	m_FrameStatistics.residentChunks = m_ResidentChunks.load();
+
+	//Least recently used first, chunks the last frame needed go only when older ones do not free enough
+	if (m_FrameStatistics.residentBytes > m_ResidentBudgetBytes)
+	{
+		Chunk** pResidentChunks{ frameArena.AllocateArray<Chunk*>(m_Chunks.size()) };
+		size_t numResidentChunks{};
+		for (Chunk& chunk : m_Chunks)
+		{
+			if (chunk.isResident.load())
+				pResidentChunks[numResidentChunks++] = &chunk;
+		}
+		std::sort(pResidentChunks, pResidentChunks + numResidentChunks, [](const Chunk* pLeft, const Chunk* pRight)
+			{
+				return pLeft->lastUsedFrame.load() < pRight->lastUsedFrame.load();
+			});
+
+		for (size_t i{}; i < numResidentChunks; ++i)
+		{
+			Chunk* pChunk{ pResidentChunks[i] };
+			if (m_ResidentBytes.load() <= m_ResidentBudgetBytes)
+				break;
+			Evict(*pChunk);
+		}
+	}
+	m_FrameStatistics.evictions = m_Evictions;
+	m_Evictions = 0;
+
+	m_TotalStatistics.pageIns += m_FrameStatistics.pageIns;
+	m_TotalStatistics.bytesPagedIn += m_FrameStatistics.bytesPagedIn;
+	m_TotalStatistics.evictions += m_FrameStatistics.evictions;
+	m_TotalStatistics.residentBytes = std::max(m_TotalStatistics.residentBytes, m_FrameStatistics.residentBytes);
+	m_TotalStatistics.residentChunks = std::max(m_TotalStatistics.residentChunks, m_FrameStatistics.residentChunks);
+
+	++m_FrameIndex;
+}
+
+StreamedMesh::Statistics StreamedMesh::GetTotalStatistics() const
+{
+	Statistics statistics{ m_TotalStatistics };
+	statistics.pageIns += m_PageIns.load();
+	statistics.bytesPagedIn += m_BytesPagedIn.load();
+	statistics.residentBytes = std::max(statistics.residentBytes, m_ResidentBytes.load());
+	statistics.residentChunks = std::max(statistics.residentChunks, m_ResidentChunks.load());
+	return statistics;
+}
+
+bool StreamedMesh::HitTest(const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord) const
+{
+	const std::vector<BVHNode>& chunkNodes{ m_ChunkBVH.GetWorldNodes() };
+	const Vector3 inverseDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+	Ray closestRay{ ray };
+	bool isHit{ false };
+
+	GeometryUtils::TraverseBVH(chunkNodes.data(), chunkNodes.size(), closestRay, inverseDirection, [&](const BVHNode& chunkLeaf)
+		{
+			for (uint32_t i{ chunkLeaf.leftFirst }; i < chunkLeaf.leftFirst + chunkLeaf.numTriangles; ++i)
+			{
+				const Chunk& chunk{ m_Chunks[m_ChunkOrder[i]] };
+				//The bounds are in the chunk table, a ray that misses them never pages the chunk in
+				if (GeometryUtils::HitTest_AABB(chunk.minAABB, chunk.maxAABB, closestRay, inverseDirection) == FLT_MAX)
+					continue;
+				if (!Touch(chunk))
+					continue;
+
+				GeometryUtils::TraverseBVH(chunk.pNodes, chunk.numNodes, closestRay, inverseDirection, [&](const BVHNode& leaf)
+					{
+						for (uint32_t j{ leaf.leftFirst }; j < leaf.leftFirst + leaf.numTriangles; ++j)
+						{
+							Triangle triangle{ chunk.pPositions[chunk.pIndices[j * 3]],chunk.pPositions[chunk.pIndices[j * 3 + 1]],chunk.pPositions[chunk.pIndices[j * 3 + 2]] };
+							triangle.normal = chunk.pNormals[j];
+							triangle.cullMode = m_CullMode;
+							triangle.materialIndex = m_MaterialIndex;
+							HitRecord newHit{};
+
+							if (GeometryUtils::HitTest_Triangle(triangle, closestRay, newHit, ignoreHitRecord))
+							{
+								isHit = true;
+								if (ignoreHitRecord)
+									return true;
+
+								hitRecord = newHit;
+								closestRay.max = newHit.t;
+							}
+						}
+						return false;
+					});
+
+				if (isHit && ignoreHitRecord)
+					return true;
+			}
+			return false;
+		});
+	return isHit;
+}
+
+bool StreamedMesh::Touch(const Chunk& chunk) const
+{
+	//Plain loads first, most visits change nothing and should not fight over the cache line
+	if (chunk.lastUsedFrame.load(std::memory_order_relaxed) != m_FrameIndex)
+		chunk.lastUsedFrame.store(m_FrameIndex, std::memory_order_relaxed);
+
+	if (!chunk.isResident.load(std::memory_order_relaxed) && !chunk.isResident.exchange(true))
+	{
+		//Counted once per residency, the OS still faults the pages in lazily; the hint makes that one read instead of a fault per page
+		++m_PageIns;
+		m_BytesPagedIn += chunk.size;
+		m_ResidentBytes += chunk.size;
+		++m_ResidentChunks;
+		m_File.AdviseWillNeed(chunk.offset, chunk.size);
+	}
+
+	return Validate(chunk);
+}
+
+bool StreamedMesh::Validate(const Chunk& chunk) const
+{
+	ChunkState state{ chunk.state.load(std::memory_order_acquire) };
+	if (state == ChunkState::Unchecked && chunk.state.compare_exchange_strong(state, ChunkState::Checking, std::memory_order_acquire))
+	{
+		//The first visit checks the chunk while it pages in anyway, the others wait for the verdict
+		state = IsChunkValid(chunk.pNodes, chunk.numNodes, chunk.pIndices, chunk.numTriangles, chunk.numPositions)
+			? ChunkState::Valid : ChunkState::Invalid;
+		if (state == ChunkState::Invalid)
+			std::cout << "Skipping corrupt chunk at offset " << chunk.offset << ", delete the chunk file to convert it again" << std::endl;
+
+		chunk.state.store(state, std::memory_order_release);
+		chunk.state.notify_all();
+	}
+
+	while (state == ChunkState::Checking)
+	{
+		chunk.state.wait(ChunkState::Checking, std::memory_order_acquire);
+		state = chunk.state.load(std::memory_order_acquire);
+	}
+	return state == ChunkState::Valid;
+}
+
+void StreamedMesh::Evict(Chunk& chunk)
+{
+	if (!chunk.isResident.exchange(false))
+		return;
+
+	m_ResidentBytes -= chunk.size;
+	--m_ResidentChunks;
+	++m_Evictions;
+	//Read-only file pages: dropping them is always safe, a late reader just faults them back in
+	m_File.AdviseDontNeed(chunk.offset, chunk.size);
+}
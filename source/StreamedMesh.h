@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+#include "MappedFile.h"
+#include "MeshBVH.h"
+#include "MemoryArena.h"
+
+namespace dae
+{
+	//Static triangle mesh that is never held in memory as a whole
+	//The OBJ is converted once into "<file>.chunks": spatially coherent chunks of triangles, each with its own bounds,
+	//positions, normals, indices and BVH. At runtime the chunk file is memory mapped and only a small top-level BVH
+	//over the chunk bounds lives on the heap. Chunks are paged in by the OS when traversal first reaches them, and the
+	//least recently used ones are handed back once the resident set grows over the budget, so a mesh larger than RAM
+	//renders slower instead of running out of memory.
+	//The geometry is used in the coordinates of the OBJ file, there is no transform.
+	class StreamedMesh final
+	{
+	public:
+		//Counters for one frame (or summed over frames), resident sizes are as of the end of the frame, before eviction
+		struct Statistics
+		{
+			uint64_t pageIns{};
+			uint64_t bytesPagedIn{};
+			uint64_t evictions{};
+			uint64_t residentBytes{};
+			uint64_t residentChunks{};
+
+			void Add(const Statistics& other)
+			{
+				pageIns += other.pageIns;
+				bytesPagedIn += other.bytesPagedIn;
+				evictions += other.evictions;
+				residentBytes += other.residentBytes;
+				residentChunks += other.residentChunks;
+			}
+		};
+
+		StreamedMesh(TriangleCullMode cullMode, unsigned char materialIndex, uint64_t residentBudgetBytes);
+		~StreamedMesh() = default;
+
+		StreamedMesh(const StreamedMesh&) = delete;
+		StreamedMesh(StreamedMesh&&) noexcept = delete;
+		StreamedMesh& operator=(const StreamedMesh&) = delete;
+		StreamedMesh& operator=(StreamedMesh&&) noexcept = delete;
+
+		//Maps the chunk file of an OBJ, converting the OBJ first when the chunk file is missing or stale
+		//Stale means the size or last write time of the OBJ changed, the OBJ itself is not read to find out
+		//Conversion never loads the whole mesh either: it streams the OBJ through ObjLoader::Reader and builds the chunks
+		//a few million triangles at a time
+		bool Open(const std::string& objFilename);
+
+		//Called once per frame before rendering: closes the statistics of the last frame and evicts chunks over budget
+		//frameArena is scratch memory for the eviction order
+		void BeginFrame(MemoryArena& frameArena);
+
+		//Thread safe, any number of render threads can test rays while nothing calls BeginFrame
+		bool HitTest(const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false) const;
+
+		const Statistics& GetFrameStatistics() const { return m_FrameStatistics; }
+		//Page-ins, bytes and evictions summed over all frames including the current one, resident sizes are the peak of any frame
+		Statistics GetTotalStatistics() const;
+
+		uint64_t GetNumTriangles() const { return m_NumTriangles; }
+		size_t GetNumChunks() const { return m_Chunks.size(); }
+
+	private:
+		//Chunk contents are checked on first use instead of when opening, which would read the whole file
+		enum class ChunkState : uint8_t
+		{
+			Unchecked,
+			Checking,
+			Valid,
+			Invalid
+		};
+
+		struct Chunk
+		{
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+			const BVHNode* pNodes{};
+			const Vector3* pPositions{};
+			const Vector3* pNormals{};
+			const int* pIndices{};
+			uint32_t numNodes{};
+			uint32_t numTriangles{};
+			uint32_t numPositions{};
+
+			uint64_t offset{};
+			uint64_t size{};
+
+			//Written by render threads on every visit
+			mutable std::atomic<uint64_t> lastUsedFrame{};
+			mutable std::atomic<bool> isResident{};
+			mutable std::atomic<ChunkState> state{};
+		};
+
+		TriangleCullMode m_CullMode{};
+		unsigned char m_MaterialIndex{};
+		uint64_t m_ResidentBudgetBytes{};
+
+		MappedFile m_File{};
+		//Static, built over the chunk bounds; leaves index m_ChunkOrder
+		MeshBVH m_ChunkBVH{};
+		std::vector<uint32_t> m_ChunkOrder{};
+		std::vector<Chunk> m_Chunks{};
+		uint64_t m_NumTriangles{};
+
+		uint64_t m_FrameIndex{ 1 };
+		mutable std::atomic<uint64_t> m_PageIns{};
+		mutable std::atomic<uint64_t> m_BytesPagedIn{};
+		mutable std::atomic<uint64_t> m_ResidentBytes{};
+		mutable std::atomic<uint64_t> m_ResidentChunks{};
+		uint64_t m_Evictions{};
+
+		Statistics m_FrameStatistics{};
+		Statistics m_TotalStatistics{};
+
+		//False when the chunk is corrupt, traversal then skips it
+		bool Touch(const Chunk& chunk) const;
+		bool Validate(const Chunk& chunk) const;
+		void Evict(Chunk& chunk);
+	};
+}
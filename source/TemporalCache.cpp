@@ -0,0 +1,104 @@
+#include "TemporalCache.h"
+#include "Camera.h"
+
+using namespace dae;
+
+void TemporalCache::Resize(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+
+	const size_t numPixels{ static_cast<size_t>(width) * static_cast<size_t>(height) };
+	m_Previous.assign(numPixels, {});
+	m_Current.assign(numPixels, {});
+}
+
+void TemporalCache::Invalidate()
+{
+	for (CachedSample& sample : m_Current)
+	{
+		sample.isValid = false;
+	}
+}
+
+void TemporalCache::Invalidate(int minX, int minY, int maxX, int maxY)
+{
+	for (int py{ minY }; py < maxY; ++py)
+	{
+		for (int px{ minX }; px < maxX; ++px)
+		{
+			m_Current[px + py * m_Width].isValid = false;
+		}
+	}
+}
+
+void TemporalCache::Reproject(const Camera& camera, float fov, float aspectRatio)
+{
+	m_Previous.swap(m_Current);
+	for (CachedSample& sample : m_Current)
+	{
+		sample.isValid = false;
+		sample.depth = FLT_MAX;
+	}
+
+	//Scatter last frame's hits into the new camera, keeping the closest one per pixel
+	const Vector3 cameraOrigin{ camera.cameraToWorld.GetTranslation() };
+	const bool hasViewpointMoved{ (cameraOrigin - m_CameraOrigin).SqrMagnitude() > 0.f };
+	m_CameraOrigin = cameraOrigin;
+
+	for (const CachedSample& sample : m_Previous)
+	{
+		if (!sample.isValid)
+			continue;
+
+		//Highlights slide over the surface as the viewpoint moves, only the diffuse part would still be right
+		if (hasViewpointMoved && sample.isViewDependent)
+			continue;
+
+		const Vector3 toSample{ sample.position - cameraOrigin };
+
+		//Surfaces turned away from the new viewpoint are occluded by something we did not see
+		if (Vector3::Dot(toSample, sample.normal) >= 0.f)
+			continue;
+
+		float screenX{}, screenY{};
+		if (!camera.WorldToScreen(sample.position, fov, aspectRatio, m_Width, m_Height, screenX, screenY))
+			continue;
+
+		if (screenX < 0.f || screenY < 0.f || screenX >= static_cast<float>(m_Width) || screenY >= static_cast<float>(m_Height))
+			continue;
+
+		const uint32_t targetIndex{ static_cast<uint32_t>(screenX) + static_cast<uint32_t>(screenY) * m_Width };
+		const float depth{ toSample.Magnitude() };
+
+		CachedSample& target{ m_Current[targetIndex] };
+		if (depth < target.depth)
+		{
+			target = sample;
+			target.depth = depth;
+		}
+	}
+
+	//Refresh budget: a diagonal pattern of pixels is retraced every frame to bound staleness
+	++m_FrameIndex;
+	for (int py{}; py < m_Height; ++py)
+	{
+		for (int px{}; px < m_Width; ++px)
+		{
+			if ((static_cast<uint32_t>(px + py * 5) + m_FrameIndex) % m_RefreshPeriod == 0)
+				m_Current[px + py * m_Width].isValid = false;
+		}
+	}
+}
+
+void TemporalCache::Store(uint32_t pixelIndex, const HitRecord& hitRecord, const ColorRGB& color, const ColorRGB& albedo, bool isViewDependent)
+{
+	CachedSample& sample{ m_Current[pixelIndex] };
+	sample.position = hitRecord.origin;
+	sample.normal = hitRecord.normal;
+	sample.color = color;
+	sample.albedo = albedo;
+	sample.depth = hitRecord.t;
+	sample.isValid = hitRecord.didHit;
+	sample.isViewDependent = isViewDependent;
+}
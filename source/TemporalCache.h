@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	struct Camera;
+
+	//Keeps last frame's primary hits so they can be reprojected into the current camera
+	//Only disoccluded pixels, view-dependent hits once the camera moved and a rotating fraction of the frame (the
+	//refresh budget) are retraced
+	class TemporalCache final
+	{
+	public:
+		TemporalCache() = default;
+		~TemporalCache() = default;
+
+		TemporalCache(const TemporalCache&) = delete;
+		TemporalCache(TemporalCache&&) noexcept = delete;
+		TemporalCache& operator=(const TemporalCache&) = delete;
+		TemporalCache& operator=(TemporalCache&&) noexcept = delete;
+
+		void Resize(int width, int height);
+		void Invalidate();
+		void Invalidate(int minX, int minY, int maxX, int maxY);
+		void Reproject(const Camera& camera, float fov, float aspectRatio);
+
+		bool NeedsTrace(uint32_t pixelIndex) const { return !m_Current[pixelIndex].isValid; }
+		const ColorRGB& GetColor(uint32_t pixelIndex) const { return m_Current[pixelIndex].color; }
+		float GetDepth(uint32_t pixelIndex) const { return m_Current[pixelIndex].depth; }
+		const Vector3& GetPosition(uint32_t pixelIndex) const { return m_Current[pixelIndex].position; }
+		const Vector3& GetNormal(uint32_t pixelIndex) const { return m_Current[pixelIndex].normal; }
+		const ColorRGB& GetAlbedo(uint32_t pixelIndex) const { return m_Current[pixelIndex].albedo; }
+		void Store(uint32_t pixelIndex, const HitRecord& hitRecord, const ColorRGB& color, const ColorRGB& albedo, bool isViewDependent);
+
+		//Every pixel is retraced at least once every refreshPeriod frames
+		void SetRefreshPeriod(uint32_t refreshPeriod) { m_RefreshPeriod = refreshPeriod > 0 ? refreshPeriod : 1; }
+
+	private:
+		struct CachedSample
+		{
+			Vector3 position{};
+			Vector3 normal{};
+			ColorRGB color{};
+			ColorRGB albedo{};
+			float depth{ FLT_MAX };
+			bool isValid{ false };
+			//Specular shading, only valid for the viewpoint it was traced from
+			bool isViewDependent{ false };
+		};
+
+		std::vector<CachedSample> m_Previous{};
+		std::vector<CachedSample> m_Current{};
+
+		int m_Width{};
+		int m_Height{};
+
+		//Viewpoint of the last reprojection, a turn alone keeps every view direction the same
+		Vector3 m_CameraOrigin{};
+
+		uint32_t m_RefreshPeriod{ 16 };
+		uint32_t m_FrameIndex{};
+	};
+}
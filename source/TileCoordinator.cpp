@@ -0,0 +1,155 @@
+#include "TileCoordinator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "Scene.h"
+
+using namespace dae;
+
+TileCoordinator::TileCoordinator(int numWorkers, const std::vector<std::string>& workerArguments, int timeoutMilliseconds)
+	: m_TimeoutMilliseconds{ timeoutMilliseconds }
+{
+	std::vector<std::string> arguments{ workerArguments };
+	arguments.push_back("--worker-index");
+	arguments.push_back({});
+
+	for (int workerIndex{}; workerIndex < numWorkers; ++workerIndex)
+	{
+		arguments.back() = std::to_string(workerIndex);
+		auto pWorker{ std::make_unique<WorkerProcess>() };
+		if (!pWorker->Launch(arguments))
+		{
+			std::cout << "Could not launch worker " << workerIndex << std::endl;
+			continue;
+		}
+		m_Workers.push_back(std::move(pWorker));
+	}
+}
+
+TileCoordinator::~TileCoordinator()
+{
+	//All are told to quit first, so they wind down at the same time
+	const TileRequest quitRequest{ WorkerCommand::Quit };
+	for (const auto& pWorker : m_Workers)
+	{
+		if (pWorker->IsRunning())
+			pWorker->Write(&quitRequest, sizeof(quitRequest));
+	}
+
+	const auto deadline{ std::chrono::steady_clock::now() + std::chrono::milliseconds(m_ShutdownTimeoutMilliseconds) };
+	for (const auto& pWorker : m_Workers)
+	{
+		const auto remaining{ std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()) };
+		pWorker->Terminate(static_cast<int>(std::max<int64_t>(remaining.count(), 0)));
+	}
+}
+
+int TileCoordinator::GetNumRunningWorkers() const
+{
+	return static_cast<int>(std::count_if(m_Workers.begin(), m_Workers.end(), [](const auto& pWorker) { return pWorker->IsRunning(); }));
+}
+
+void TileCoordinator::RenderFrame(Scene* pScene, Renderer& renderer, int frame)
+{
+	const uint32_t numTiles{ renderer.GetNumTiles() };
+	const uint32_t numRanges{ std::max(static_cast<uint32_t>(m_Workers.size()) * m_RangesPerWorker, 1u) };
+	const uint32_t rangeSize{ std::max((numTiles + numRanges - 1) / numRanges, 1u) };
+
+	for (uint32_t firstTile{}; firstTile < numTiles; firstTile += rangeSize)
+	{
+		m_PendingRanges.push_back({ firstTile, std::min(firstTile + rangeSize, numTiles) });
+	}
+
+	//A worker dying late can requeue ranges after the others ran dry, so go again until it is all done
+	while (!m_PendingRanges.empty() && GetNumRunningWorkers() > 0)
+	{
+		std::vector<std::thread> threads{};
+		for (int workerIndex{}; workerIndex < static_cast<int>(m_Workers.size()); ++workerIndex)
+		{
+			if (m_Workers[workerIndex]->IsRunning())
+				threads.emplace_back(&TileCoordinator::RunWorker, this, workerIndex, std::ref(renderer), frame);
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	//No workers left, finish the frame locally
+	renderer.SetFrameIndex(static_cast<uint32_t>(frame));
+	for (const TileRange& range : m_PendingRanges)
+	{
+		renderer.RenderTileRange(pScene, range.firstTile, range.endTile);
+	}
+	m_PendingRanges.clear();
+
+	renderer.Present();
+}
+
+void TileCoordinator::RunWorker(int workerIndex, Renderer& renderer, int frame)
+{
+	WorkerProcess& worker{ *m_Workers[workerIndex] };
+	std::vector<ColorRGB> colors{};
+
+	TileRange range{};
+	while (PopRange(range))
+	{
+		if (RenderRange(worker, renderer, frame, range, colors))
+			continue;
+
+		worker.Terminate();
+
+		const std::lock_guard lock{ m_Mutex };
+		std::cout << "Worker " << workerIndex << " failed or timed out, reassigning tiles " << range.firstTile << "-" << range.endTile - 1 << std::endl;
+		m_PendingRanges.push_back(range);
+		return;
+	}
+}
+
+bool TileCoordinator::RenderRange(WorkerProcess& worker, Renderer& renderer, int frame, const TileRange& range, std::vector<ColorRGB>& colors)
+{
+	const TileRequest request{ WorkerCommand::RenderTiles, static_cast<uint32_t>(frame), range.firstTile, range.endTile };
+	if (!worker.Write(&request, sizeof(request)))
+		return false;
+
+	TileResponse response{};
+	if (!worker.Read(&response, sizeof(response), m_TimeoutMilliseconds) || response.firstTile != range.firstTile || response.endTile != range.endTile)
+		return false;
+
+	uint32_t numPixels{};
+	for (uint32_t tileIndex{ range.firstTile }; tileIndex < range.endTile; ++tileIndex)
+	{
+		numPixels += renderer.GetTilePixelCount(tileIndex);
+	}
+
+	colors.resize(numPixels);
+	if (!worker.Read(colors.data(), colors.size() * sizeof(ColorRGB), m_TimeoutMilliseconds))
+		return false;
+
+	//Ranges never overlap, so workers can write their tiles without holding the lock
+	const ColorRGB* pColors{ colors.data() };
+	for (uint32_t tileIndex{ range.firstTile }; tileIndex < range.endTile; ++tileIndex)
+	{
+		renderer.WriteTile(tileIndex, pColors);
+		pColors += renderer.GetTilePixelCount(tileIndex);
+	}
+
+	m_PrimaryRayCount += response.primaryRays;
+	m_ShadowRayCount += response.shadowRays;
+	return true;
+}
+
+bool TileCoordinator::PopRange(TileRange& range)
+{
+	const std::lock_guard lock{ m_Mutex };
+	if (m_PendingRanges.empty())
+		return false;
+
+	range = m_PendingRanges.front();
+	m_PendingRanges.pop_front();
+	return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Renderer.h"
+#include "WorkerProcess.h"
+
+namespace dae
+{
+	class Scene;
+
+	//Pipe protocol between the coordinator and its "--worker" processes, both ends run the same binary
+	enum class WorkerCommand : uint32_t
+	{
+		RenderTiles,
+		Quit
+	};
+
+	struct TileRequest
+	{
+		WorkerCommand command{ WorkerCommand::RenderTiles };
+		uint32_t frame{};
+		uint32_t firstTile{};
+		uint32_t endTile{};
+	};
+
+	//Followed by the HDR colors of every tile in [firstTile, endTile), see Renderer::ReadTile
+	struct TileResponse
+	{
+		uint32_t firstTile{};
+		uint32_t endTile{};
+		uint64_t primaryRays{};
+		uint64_t shadowRays{};
+	};
+
+	//Splits each frame into tile ranges and hands them to local worker processes
+	//Ranges of a worker that dies or does not answer within the timeout are queued again, whatever no worker is left
+	//for is traced here
+	class TileCoordinator final
+	{
+	public:
+		//Every worker also gets "--worker-index <i>"; the timeout covers a whole answer, so also the scene setup before
+		//a worker's first one
+		TileCoordinator(int numWorkers, const std::vector<std::string>& workerArguments, int timeoutMilliseconds);
+		~TileCoordinator();
+
+		TileCoordinator(const TileCoordinator&) = delete;
+		TileCoordinator(TileCoordinator&&) noexcept = delete;
+		TileCoordinator& operator=(const TileCoordinator&) = delete;
+		TileCoordinator& operator=(TileCoordinator&&) noexcept = delete;
+
+		int GetNumRunningWorkers() const;
+		RenderStatistics GetStatistics() const { return { m_PrimaryRayCount.load(), m_ShadowRayCount.load() }; }
+
+		//pScene must already be advanced to frame, it is only traced when every worker failed
+		void RenderFrame(Scene* pScene, Renderer& renderer, int frame);
+
+	private:
+		struct TileRange
+		{
+			uint32_t firstTile{};
+			uint32_t endTile{};
+		};
+
+		void RunWorker(int workerIndex, Renderer& renderer, int frame);
+		bool RenderRange(WorkerProcess& worker, Renderer& renderer, int frame, const TileRange& range, std::vector<ColorRGB>& colors);
+		bool PopRange(TileRange& range);
+
+		//A few ranges per worker, so a slow or lost worker only holds back a small part of the frame
+		static constexpr uint32_t m_RangesPerWorker{ 4 };
+		//How long workers get to exit after Quit before they are killed
+		static constexpr int m_ShutdownTimeoutMilliseconds{ 2000 };
+
+		int m_TimeoutMilliseconds{};
+
+		std::vector<std::unique_ptr<WorkerProcess>> m_Workers{};
+
+		std::mutex m_Mutex{};
+		std::deque<TileRange> m_PendingRanges{};
+
+		std::atomic<uint64_t> m_PrimaryRayCount{};
+		std::atomic<uint64_t> m_ShadowRayCount{};
+	};
+}
@@ -82,3 +82,11 @@ void Timer::Stop()
 		m_IsStopped = true;
 	}
 }
+
+
+void Timer::Step(float elapsedTime)
+{
+	m_ElapsedTime = elapsedTime;
+	m_TotalTime += elapsedTime;
+	++m_FPSCount;
+}
\ No newline at end of file
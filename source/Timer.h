@@ -21,6 +21,9 @@ namespace dae
 		void Update();
 		void Stop();
 
+		//Advances by a fixed amount instead of wall-clock time, for deterministic offline rendering
+		void Step(float elapsedTime);
+
 		uint32_t GetFPS() const { return m_FPS; };
 		float GetdFPS() const { return m_dFPS; };
 		float GetElapsed() const { return m_ElapsedTime; };
@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <immintrin.h>
+
+#include "Math.h"
+
+namespace dae
+{
+	enum class ToneMappingMode
+	{
+		MaxToOne,
+		Reinhard,
+		ACES
+	};
+
+	namespace ToneMappingUtils
+	{
+		//Bit layout of a 32 bit surface with 8 bits per channel
+		struct SurfaceFormat
+		{
+			uint32_t redShift{ 16 };
+			uint32_t greenShift{ 8 };
+			uint32_t blueShift{ 0 };
+			uint32_t alphaMask{};
+		};
+
+		constexpr int SRGBTableSize{ 4096 };
+
+		//Linear [0, 1] quantized to 12 bits >> 8 bit sRGB
+		inline const std::array<uint8_t, SRGBTableSize>& GetSRGBTable()
+		{
+			static const std::array<uint8_t, SRGBTableSize> table{ []
+				{
+					std::array<uint8_t, SRGBTableSize> result{};
+					for (int i{}; i < SRGBTableSize; ++i)
+					{
+						const float linear{ static_cast<float>(i) / static_cast<float>(SRGBTableSize - 1) };
+						const float srgb{ linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.f / 2.4f) - 0.055f };
+						result[i] = static_cast<uint8_t>(srgb * 255.f + 0.5f);
+					}
+					return result;
+				}() };
+			return table;
+		}
+
+		//Four pixels at a time, one channel per register
+		inline void ToneMap(ToneMappingMode mode, __m128& r, __m128& g, __m128& b)
+		{
+			const __m128 one{ _mm_set1_ps(1.f) };
+			const __m128 zero{ _mm_setzero_ps() };
+
+			switch (mode)
+			{
+			case ToneMappingMode::MaxToOne:
+			{
+				//Same as ColorRGB::MaxToOne, divides every channel like it does so both round the same
+				const __m128 maxValue{ _mm_max_ps(r, _mm_max_ps(g, b)) };
+				const __m128 divisor{ _mm_max_ps(maxValue, one) };
+				r = _mm_div_ps(r, divisor);
+				g = _mm_div_ps(g, divisor);
+				b = _mm_div_ps(b, divisor);
+				break;
+			}
+			case ToneMappingMode::Reinhard:
+				r = _mm_div_ps(r, _mm_add_ps(one, r));
+				g = _mm_div_ps(g, _mm_add_ps(one, g));
+				b = _mm_div_ps(b, _mm_add_ps(one, b));
+				break;
+			case ToneMappingMode::ACES:
+			{
+				//Narkowicz fit: (x * (2.51x + 0.03)) / (x * (2.43x + 0.59) + 0.14)
+				const auto aces = [&](__m128 x)
+				{
+					const __m128 numerator{ _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f))) };
+					const __m128 denominator{ _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f)) };
+					return _mm_div_ps(numerator, denominator);
+				};
+				r = aces(r);
+				g = aces(g);
+				b = aces(b);
+				break;
+			}
+			}
+
+			r = _mm_min_ps(_mm_max_ps(r, zero), one);
+			g = _mm_min_ps(_mm_max_ps(g, zero), one);
+			b = _mm_min_ps(_mm_max_ps(b, zero), one);
+		}
+
+		//MaxToOne keeps the original linear output, the HDR operators are encoded to sRGB
+		inline __m128i EncodeChannel(ToneMappingMode mode, __m128 channel)
+		{
+			if (mode == ToneMappingMode::MaxToOne)
+				return _mm_cvttps_epi32(_mm_mul_ps(channel, _mm_set1_ps(255.f)));
+
+			alignas(16) int32_t indices[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvtps_epi32(_mm_mul_ps(channel, _mm_set1_ps(SRGBTableSize - 1.f))));
+
+			const auto& table{ GetSRGBTable() };
+			return _mm_setr_epi32(table[indices[0]], table[indices[1]], table[indices[2]], table[indices[3]]);
+		}
+
+		inline __m128i Pack(const SurfaceFormat& format, __m128i r, __m128i g, __m128i b)
+		{
+			__m128i pixels{ _mm_set1_epi32(static_cast<int>(format.alphaMask)) };
+			pixels = _mm_or_si128(pixels, _mm_sll_epi32(r, _mm_cvtsi32_si128(static_cast<int>(format.redShift))));
+			pixels = _mm_or_si128(pixels, _mm_sll_epi32(g, _mm_cvtsi32_si128(static_cast<int>(format.greenShift))));
+			pixels = _mm_or_si128(pixels, _mm_sll_epi32(b, _mm_cvtsi32_si128(static_cast<int>(format.blueShift))));
+			return pixels;
+		}
+
+		//Tonemaps and packs one row of HDR colors into 32 bit surface pixels
+		inline void PackRow(const ColorRGB* pSource, uint32_t* pDestination, int count, ToneMappingMode mode, const SurfaceFormat& format)
+		{
+			static_assert(sizeof(ColorRGB) == 3 * sizeof(float), "ColorRGB is expected to be tightly packed");
+
+			int i{};
+			for (; i + 4 <= count; i += 4)
+			{
+				//r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3 >> rrrr gggg bbbb
+				const float* pFloats{ &pSource[i].r };
+				const __m128 a{ _mm_loadu_ps(pFloats) };
+				const __m128 b{ _mm_loadu_ps(pFloats + 4) };
+				const __m128 c{ _mm_loadu_ps(pFloats + 8) };
+
+				__m128 red{ _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0)) };
+				__m128 green{ _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)) };
+				__m128 blue{ _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)) };
+
+				ToneMap(mode, red, green, blue);
+
+				const __m128i pixels{ Pack(format, EncodeChannel(mode, red), EncodeChannel(mode, green), EncodeChannel(mode, blue)) };
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pDestination + i), pixels);
+			}
+
+			for (; i < count; ++i)
+			{
+				__m128 red{ _mm_set1_ps(pSource[i].r) };
+				__m128 green{ _mm_set1_ps(pSource[i].g) };
+				__m128 blue{ _mm_set1_ps(pSource[i].b) };
+
+				ToneMap(mode, red, green, blue);
+
+				const __m128i pixels{ Pack(format, EncodeChannel(mode, red), EncodeChannel(mode, green), EncodeChannel(mode, blue)) };
+				pDestination[i] = static_cast<uint32_t>(_mm_cvtsi128_si32(pixels));
+			}
+		}
+	}
+}
@@ -1,8 +1,9 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
-#include <fstream>
 #include "Math.h"
 #include "DataTypes.h"
+#include "ObjLoader.h"
 
 namespace dae
 {
@@ -98,22 +99,17 @@ namespace dae
 				return false;
 			}
 
-			if (triangle.cullMode == TriangleCullMode::FrontFaceCulling)
+			//Shadow rays (ignoreHitRecord) leave from the other side of the surface, so they cull the opposite face
+			const float normalDotDirection{ Vector3::Dot(triangle.normal, ray.direction) };
+			if (triangle.cullMode == TriangleCullMode::FrontFaceCulling && (ignoreHitRecord ? normalDotDirection > 0.f : normalDotDirection < 0.f))
 			{
-				if (Vector3::Dot(triangle.normal, ray.direction) > 0.f)
-				{
-					if (Vector3::Dot(triangle.normal, ray.direction) < 0.f)
-					{
-						return false;
-					}
-				}
-				if (triangle.cullMode == TriangleCullMode::BackFaceCulling)
-				{
-					if (Vector3::Dot(triangle.normal, ray.direction) > 0.f)
-					{
-						return false;
-					}
-				}
+				hitRecord.didHit = false;
+				return false;
+			}
+			if (triangle.cullMode == TriangleCullMode::BackFaceCulling && (ignoreHitRecord ? normalDotDirection < 0.f : normalDotDirection > 0.f))
+			{
+				hitRecord.didHit = false;
+				return false;
 			}
 
 			auto t{ Vector3::Dot(triangleCenter - ray.origin, triangle.normal) / Vector3::Dot(ray.direction, triangle.normal) };
@@ -126,13 +122,13 @@ namespace dae
 
 			Vector3 intersection{ ray.origin + t * ray.direction };
 
-			if (!isOnSameSide(intersection - triangle.v0, triangle.v1 - triangle.v0, triangle))
+			if (!isOnSameSide(triangle.v1 - triangle.v0, intersection - triangle.v0, triangle))
 				return false;
 
-			if (!isOnSameSide(intersection - triangle.v1, triangle.v2 - triangle.v1, triangle))
+			if (!isOnSameSide(triangle.v2 - triangle.v1, intersection - triangle.v1, triangle))
 				return false;
 
-			if (!isOnSameSide(intersection - triangle.v2, triangle.v0 - triangle.v2, triangle))
+			if (!isOnSameSide(triangle.v0 - triangle.v2, intersection - triangle.v2, triangle))
 				return false;
 
 			hitRecord.origin = intersection;
@@ -151,29 +147,156 @@ namespace dae
 		}
 #pragma endregion
 #pragma region TriangeMesh HitTest
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		//Entry distance of the ray into the box, FLT_MAX on a miss
+		inline float HitTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray, const Vector3& inverseDirection)
 		{
-			hitRecord.t = FLT_MAX;
-			for (size_t i{}; i < mesh.indices.size(); i += 3)
+			const float tx1{ (minAABB.x - ray.origin.x) * inverseDirection.x };
+			const float tx2{ (maxAABB.x - ray.origin.x) * inverseDirection.x };
+			const float ty1{ (minAABB.y - ray.origin.y) * inverseDirection.y };
+			const float ty2{ (maxAABB.y - ray.origin.y) * inverseDirection.y };
+			const float tz1{ (minAABB.z - ray.origin.z) * inverseDirection.z };
+			const float tz2{ (maxAABB.z - ray.origin.z) * inverseDirection.z };
+
+			const float tMin{ std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), ray.min)) };
+			const float tMax{ std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), ray.max)) };
+			return tMin <= tMax ? tMin : FLT_MAX;
+		}
+
+		//Nearest-first walk over a BVH, hitLeaf(leaf) tests the items of a leaf and shrinks closestRay.max on a hit
+		//hitLeaf returns true to end the walk early, shadow rays stop at the first hit
+		template <typename LeafFunction>
+		inline void TraverseBVH(const BVHNode* pNodes, size_t numNodes, Ray& closestRay, const Vector3& inverseDirection, LeafFunction&& hitLeaf)
+		{
+			if (numNodes == 0 || HitTest_AABB(pNodes[0].minAABB, pNodes[0].maxAABB, closestRay, inverseDirection) == FLT_MAX)
+				return;
+
+			uint32_t stack[MeshBVH::m_MaxDepth]{};
+			int stackSize{};
+			uint32_t nodeIndex{};
+			while (true)
 			{
-				Triangle triangle{ mesh.transformedPositions[mesh.indices[i]],mesh.transformedPositions[mesh.indices[i + 1]],mesh.transformedPositions[mesh.indices[i + 2]] };
-				triangle.normal = mesh.normals[i];
-				triangle.cullMode = mesh.cullMode;
-				triangle.materialIndex = mesh.materialIndex;
-				HitRecord newHit{};
-        
-				if (GeometryUtils::HitTest_Triangle(triangle, ray, newHit))
+				const BVHNode& node{ pNodes[nodeIndex] };
+				if (node.IsLeaf())
 				{
-					if (hitRecord.t > newHit.t && !ignoreHitRecord)
+					if (hitLeaf(node))
+						return;
+
+					if (stackSize == 0)
+						return;
+					nodeIndex = stack[--stackSize];
+					continue;
+				}
+
+				const uint32_t leftIndex{ node.leftFirst };
+				const float leftDistance{ HitTest_AABB(pNodes[leftIndex].minAABB, pNodes[leftIndex].maxAABB, closestRay, inverseDirection) };
+				const float rightDistance{ HitTest_AABB(pNodes[leftIndex + 1].minAABB, pNodes[leftIndex + 1].maxAABB, closestRay, inverseDirection) };
+
+				const bool isLeftNearer{ leftDistance <= rightDistance };
+				const float nearDistance{ isLeftNearer ? leftDistance : rightDistance };
+				const float farDistance{ isLeftNearer ? rightDistance : leftDistance };
+				const uint32_t nearIndex{ isLeftNearer ? leftIndex : leftIndex + 1 };
+				const uint32_t farIndex{ isLeftNearer ? leftIndex + 1 : leftIndex };
+
+				if (nearDistance == FLT_MAX)
+				{
+					if (stackSize == 0)
+						return;
+					nodeIndex = stack[--stackSize];
+					continue;
+				}
+
+				if (farDistance != FLT_MAX)
+					stack[stackSize++] = farIndex;
+				nodeIndex = nearIndex;
+			}
+		}
+
+		//Compressed meshes are traced in object space: the ray is moved instead of every vertex
+		//The direction is not renormalized, so t means the same in both spaces
+		inline bool HitTest_CompressedTriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord)
+		{
+			const std::vector<BVHNode>& nodes{ mesh.bvh.GetNodes() };
+
+			Ray closestRay{ ray };
+			closestRay.origin = mesh.inverseTransform.TransformPoint(ray.origin);
+			closestRay.direction = mesh.inverseTransform.TransformVector(ray.direction);
+			const Vector3 inverseDirection{ 1.f / closestRay.direction.x, 1.f / closestRay.direction.y, 1.f / closestRay.direction.z };
+			bool isHit{ false };
+
+			TraverseBVH(nodes.data(), nodes.size(), closestRay, inverseDirection, [&](const BVHNode& leaf)
+				{
+					for (uint32_t i{ leaf.leftFirst }; i < leaf.leftFirst + leaf.numTriangles; ++i)
 					{
-						hitRecord = newHit;
+						Triangle triangle{};
+						mesh.compressed.DecodeTriangle(i, triangle.v0, triangle.v1, triangle.v2);
+						triangle.normal = mesh.compressed.DecodeNormal(i);
+						triangle.cullMode = mesh.cullMode;
+						triangle.materialIndex = mesh.materialIndex;
+						HitRecord newHit{};
+
+						if (GeometryUtils::HitTest_Triangle(triangle, closestRay, newHit, ignoreHitRecord))
+						{
+							isHit = true;
+							if (ignoreHitRecord)
+								return true;
+
+							hitRecord = newHit;
+							closestRay.max = newHit.t;
+						}
 					}
-					isHit = true;
-				}
+					return false;
+				});
+
+			if (isHit && !ignoreHitRecord)
+			{
+				hitRecord.origin = ray.origin + hitRecord.t * ray.direction;
+				hitRecord.normal = mesh.normalTransform.TransformVector(hitRecord.normal).Normalized();
 			}
 			return isHit;
 		}
 
+		//Walks the mesh BVH nearest child first; a shadow query (ignoreHitRecord) stops at the first hit
+		//Shadow rays use the same level as camera rays, a coarser occluder would shadow the surface it leaves from
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			if (mesh.selectedLod > 0)
+				return HitTest_TriangleMesh(mesh.GetSelectedLod(), ray, hitRecord, ignoreHitRecord);
+
+			if (mesh.compressed.IsEncoded())
+				return HitTest_CompressedTriangleMesh(mesh, ray, hitRecord, ignoreHitRecord);
+
+			const std::vector<BVHNode>& nodes{ mesh.bvh.GetWorldNodes() };
+			const Vector3 inverseDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+			//Shrinks to the closest hit so far, so farther nodes and triangles get culled
+			Ray closestRay{ ray };
+			bool isHit{ false };
+
+			TraverseBVH(nodes.data(), nodes.size(), closestRay, inverseDirection, [&](const BVHNode& leaf)
+				{
+					for (uint32_t i{ leaf.leftFirst }; i < leaf.leftFirst + leaf.numTriangles; ++i)
+					{
+						Triangle triangle{ mesh.transformedPositions[mesh.indices[i * 3]],mesh.transformedPositions[mesh.indices[i * 3 + 1]],mesh.transformedPositions[mesh.indices[i * 3 + 2]] };
+						triangle.normal = mesh.transformedNormals[i];
+						triangle.cullMode = mesh.cullMode;
+						triangle.materialIndex = mesh.materialIndex;
+						HitRecord newHit{};
+
+						if (GeometryUtils::HitTest_Triangle(triangle, closestRay, newHit, ignoreHitRecord))
+						{
+							isHit = true;
+							if (ignoreHitRecord)
+								return true;
+
+							hitRecord = newHit;
+							closestRay.max = newHit.t;
+						}
+					}
+					return false;
+				});
+			return isHit;
+		}
+
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
 		{
 			HitRecord temp{};
@@ -209,76 +332,10 @@ namespace dae
 
 	namespace Utils
 	{
-		//Just parses vertices and indices
-#pragma warning(push)
-#pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+		//Just parses vertices and indices, see ObjLoader for the supported syntax
+		inline bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
 		{
-			std::ifstream file(filename);
-			if (!file)
-				return false;
-
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof())
-					break;
-			}
-
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
-			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.push_back(normal);
-			}
-
-			return true;
+			return ObjLoader::Load(filename, positions, normals, indices);
 		}
-#pragma warning(pop)
 	}
 }
\ No newline at end of file
@@ -1,9 +1,16 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include <immintrin.h>
+#include <type_traits>
+
+#include "Vector3.h"
 
 namespace dae
 {
-	struct Vector3;
-	struct Vector4
+	//16-byte aligned so a Vector4 is one SSE load; the element-wise operators run in a register at runtime and fall back
+	//to the scalar code in constant expressions
+	struct alignas(16) Vector4
 	{
 		float x;
 		float y;
@@ -11,22 +18,117 @@ namespace dae
 		float w;
 
 		Vector4() = default;
-		Vector4(float _x, float _y, float _z, float _w);
-		Vector4(const Vector3& v, float _w);
+		constexpr Vector4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+		constexpr Vector4(const Vector3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+
+		float Magnitude() const
+		{
+			return sqrtf(x * x + y * y + z * z + w * w);
+		}
+
+		constexpr float SqrMagnitude() const
+		{
+			return x * x + y * y + z * z + w * w;
+		}
+
+		float Normalize()
+		{
+			const float m = Magnitude();
+			x /= m;
+			y /= m;
+			z /= m;
+			w /= m;
+
+			return m;
+		}
+
+		Vector4 Normalized() const
+		{
+			const float m = Magnitude();
+			return { x / m, y / m, z / m, w / m };
+		}
 
-		float Magnitude() const;
-		float SqrMagnitude() const;
-		float Normalize();
-		Vector4 Normalized() const;
+		//Summed left to right like the scalar version, a horizontal add would change the rounding of every matrix product
+		static constexpr float Dot(const Vector4& v1, const Vector4& v2)
+		{
+			return { v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w };
+		}
 
-		static float Dot(const Vector4& v1, const Vector4& v2);
+		__m128 Load() const
+		{
+			return _mm_load_ps(&x);
+		}
+
+		static Vector4 Store(__m128 value)
+		{
+			Vector4 result;
+			_mm_store_ps(&result.x, value);
+			return result;
+		}
 
 		// operator overloading
-		Vector4 operator*(float scale) const;
-		Vector4 operator+(const Vector4& v) const;
-		Vector4 operator-(const Vector4& v) const;
-		Vector4& operator+=(const Vector4& v);
-		float& operator[](int index);
-		float operator[](int index) const;
+		constexpr Vector4 operator*(float scale) const
+		{
+			if (std::is_constant_evaluated())
+				return { x * scale, y * scale, z * scale, w * scale };
+
+			return Store(_mm_mul_ps(Load(), _mm_set1_ps(scale)));
+		}
+
+		constexpr Vector4 operator+(const Vector4& v) const
+		{
+			if (std::is_constant_evaluated())
+				return { x + v.x, y + v.y, z + v.z, w + v.w };
+
+			return Store(_mm_add_ps(Load(), v.Load()));
+		}
+
+		constexpr Vector4 operator-(const Vector4& v) const
+		{
+			if (std::is_constant_evaluated())
+				return { x - v.x, y - v.y, z - v.z, w - v.w };
+
+			return Store(_mm_sub_ps(Load(), v.Load()));
+		}
+
+		constexpr Vector4& operator+=(const Vector4& v)
+		{
+			*this = *this + v;
+			return *this;
+		}
+
+		constexpr float& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
+
+		constexpr float operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
 	};
+
+	static_assert(sizeof(Vector4) == 16 && alignof(Vector4) == 16);
+
+	constexpr Vector3::Vector3(const Vector4& v) : x(v.x), y(v.y), z(v.z) {}
+
+	constexpr Vector4 Vector3::ToPoint4() const
+	{
+		return { x, y, z, 1 };
+	}
+
+	constexpr Vector4 Vector3::ToVector4() const
+	{
+		return { x, y, z, 0 };
+	}
 }
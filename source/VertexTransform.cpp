@@ -0,0 +1,293 @@
+#include "VertexTransform.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <immintrin.h>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace dae;
+
+namespace
+{
+	//Arrays below this are done on the calling thread, starting workers costs more than it saves
+	constexpr size_t g_MinParallelCount{ 64 * 1024 };
+	//A multiple of 4, so only the last block has a scalar tail
+	constexpr size_t g_VerticesPerBlock{ 16 * 1024 };
+	//Larger arrays get larger blocks, so the per-block bounds fit on the stack
+	constexpr size_t g_MaxBlocks{ 256 };
+
+	static_assert(sizeof(Vector3) == 12, "The kernels load Vector3 arrays as packed floats");
+
+	//x, y and z of four consecutive Vector3s
+	struct Vector3x4
+	{
+		__m128 x{};
+		__m128 y{};
+		__m128 z{};
+	};
+
+	//The matrix elements the kernels use, each broadcast over a register
+	struct MatrixSplat
+	{
+		__m128 m[4][3]{};
+
+		explicit MatrixSplat(const Matrix& matrix)
+		{
+			for (int r{}; r < 4; ++r)
+			{
+				const Vector4 row{ matrix[r] };
+				m[r][0] = _mm_set1_ps(row.x);
+				m[r][1] = _mm_set1_ps(row.y);
+				m[r][2] = _mm_set1_ps(row.z);
+			}
+		}
+	};
+
+	Vector3x4 Load(const Vector3* pSource)
+	{
+		const float* pFloats{ &pSource->x };
+		//a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+		const __m128 a{ _mm_loadu_ps(pFloats) };
+		const __m128 b{ _mm_loadu_ps(pFloats + 4) };
+		const __m128 c{ _mm_loadu_ps(pFloats + 8) };
+
+		const __m128 xBC{ _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)) };
+		const __m128 yAB{ _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)) };
+		const __m128 yBC{ _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)) };
+		const __m128 zAB{ _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)) };
+		return Vector3x4{
+			_mm_shuffle_ps(a, xBC, _MM_SHUFFLE(2, 0, 3, 0)),
+			_mm_shuffle_ps(yAB, yBC, _MM_SHUFFLE(2, 0, 2, 0)),
+			_mm_shuffle_ps(zAB, c, _MM_SHUFFLE(3, 0, 2, 0)) };
+	}
+
+	void Store(const Vector3x4& vectors, Vector3* pDestination)
+	{
+		const __m128 xy0{ _mm_shuffle_ps(vectors.x, vectors.y, _MM_SHUFFLE(0, 0, 0, 0)) };
+		const __m128 zx01{ _mm_shuffle_ps(vectors.z, vectors.x, _MM_SHUFFLE(1, 1, 0, 0)) };
+		const __m128 yz1{ _mm_shuffle_ps(vectors.y, vectors.z, _MM_SHUFFLE(1, 1, 1, 1)) };
+		const __m128 xy2{ _mm_shuffle_ps(vectors.x, vectors.y, _MM_SHUFFLE(2, 2, 2, 2)) };
+		const __m128 zx23{ _mm_shuffle_ps(vectors.z, vectors.x, _MM_SHUFFLE(3, 3, 2, 2)) };
+		const __m128 yz3{ _mm_shuffle_ps(vectors.y, vectors.z, _MM_SHUFFLE(3, 3, 3, 3)) };
+
+		float* pFloats{ &pDestination->x };
+		_mm_storeu_ps(pFloats, _mm_shuffle_ps(xy0, zx01, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(pFloats + 4, _mm_shuffle_ps(yz1, xy2, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(pFloats + 8, _mm_shuffle_ps(zx23, yz3, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+
+	//Row vector times the upper 3x3, the same as Matrix::TransformVector
+	Vector3x4 Multiply(const MatrixSplat& matrix, const Vector3x4& v)
+	{
+		Vector3x4 result{};
+		__m128* pResult[3]{ &result.x, &result.y, &result.z };
+		for (int axis{}; axis < 3; ++axis)
+		{
+			*pResult[axis] = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(v.x, matrix.m[0][axis]),
+				_mm_mul_ps(v.y, matrix.m[1][axis])),
+				_mm_mul_ps(v.z, matrix.m[2][axis]));
+		}
+		return result;
+	}
+
+	void TransformPointBlock(const MatrixSplat& matrix, const Matrix& transform, const Vector3* pSource, Vector3* pDestination, size_t count,
+		Vector3& minBounds, Vector3& maxBounds)
+	{
+		__m128 minX{ _mm_set1_ps(FLT_MAX) }, minY{ minX }, minZ{ minX };
+		__m128 maxX{ _mm_set1_ps(-FLT_MAX) }, maxY{ maxX }, maxZ{ maxX };
+
+		size_t i{};
+		for (; i + 4 <= count; i += 4)
+		{
+			Vector3x4 points{ Multiply(matrix, Load(pSource + i)) };
+			points.x = _mm_add_ps(points.x, matrix.m[3][0]);
+			points.y = _mm_add_ps(points.y, matrix.m[3][1]);
+			points.z = _mm_add_ps(points.z, matrix.m[3][2]);
+			Store(points, pDestination + i);
+
+			minX = _mm_min_ps(minX, points.x);
+			minY = _mm_min_ps(minY, points.y);
+			minZ = _mm_min_ps(minZ, points.z);
+			maxX = _mm_max_ps(maxX, points.x);
+			maxY = _mm_max_ps(maxY, points.y);
+			maxZ = _mm_max_ps(maxZ, points.z);
+		}
+
+		alignas(16) float lanes[6][4]{};
+		_mm_store_ps(lanes[0], minX);
+		_mm_store_ps(lanes[1], minY);
+		_mm_store_ps(lanes[2], minZ);
+		_mm_store_ps(lanes[3], maxX);
+		_mm_store_ps(lanes[4], maxY);
+		_mm_store_ps(lanes[5], maxZ);
+		minBounds = { std::min({ lanes[0][0], lanes[0][1], lanes[0][2], lanes[0][3] }),
+			std::min({ lanes[1][0], lanes[1][1], lanes[1][2], lanes[1][3] }),
+			std::min({ lanes[2][0], lanes[2][1], lanes[2][2], lanes[2][3] }) };
+		maxBounds = { std::max({ lanes[3][0], lanes[3][1], lanes[3][2], lanes[3][3] }),
+			std::max({ lanes[4][0], lanes[4][1], lanes[4][2], lanes[4][3] }),
+			std::max({ lanes[5][0], lanes[5][1], lanes[5][2], lanes[5][3] }) };
+
+		for (; i < count; ++i)
+		{
+			const Vector3 point{ transform.TransformPoint(pSource[i]) };
+			pDestination[i] = point;
+			minBounds = { std::min(minBounds.x, point.x), std::min(minBounds.y, point.y), std::min(minBounds.z, point.z) };
+			maxBounds = { std::max(maxBounds.x, point.x), std::max(maxBounds.y, point.y), std::max(maxBounds.z, point.z) };
+		}
+	}
+
+	void TransformNormalBlock(const MatrixSplat& matrix, const Matrix& normalTransform, const Vector3* pSource, Vector3* pDestination, size_t count)
+	{
+		size_t i{};
+		for (; i + 4 <= count; i += 4)
+		{
+			Vector3x4 normals{ Multiply(matrix, Load(pSource + i)) };
+			const __m128 length{ _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(normals.x, normals.x), _mm_mul_ps(normals.y, normals.y)), _mm_mul_ps(normals.z, normals.z))) };
+			normals.x = _mm_div_ps(normals.x, length);
+			normals.y = _mm_div_ps(normals.y, length);
+			normals.z = _mm_div_ps(normals.z, length);
+			Store(normals, pDestination + i);
+		}
+
+		for (; i < count; ++i)
+		{
+			pDestination[i] = normalTransform.TransformVector(pSource[i]).Normalized();
+		}
+	}
+
+	size_t GetVerticesPerBlock(size_t count)
+	{
+		const size_t minVerticesPerBlock{ ((count + g_MaxBlocks - 1) / g_MaxBlocks + 3) / 4 * 4 };
+		return std::max(g_VerticesPerBlock, minVerticesPerBlock);
+	}
+
+	size_t GetNumBlocks(size_t count)
+	{
+		const size_t verticesPerBlock{ GetVerticesPerBlock(count) };
+		return (count + verticesPerBlock - 1) / verticesPerBlock;
+	}
+
+	//Runs blockFunction(first, count) over the array, in parallel when it is large enough
+	template <typename BlockFunction>
+	void ForEachBlock(size_t count, const BlockFunction& blockFunction)
+	{
+		if (count < g_MinParallelCount)
+		{
+			blockFunction(size_t{}, count, size_t{});
+			return;
+		}
+
+		const size_t verticesPerBlock{ GetVerticesPerBlock(count) };
+		ParallelFor(size_t{}, GetNumBlocks(count), [&](size_t block)
+			{
+				const size_t first{ block * verticesPerBlock };
+				blockFunction(first, std::min(verticesPerBlock, count - first), block);
+			});
+	}
+}
+
+void VertexTransform::TransformPoints(const Matrix& transform, const Vector3* pSource, Vector3* pDestination, size_t count,
+	Vector3& minBounds, Vector3& maxBounds)
+{
+	if (count == 0)
+	{
+		minBounds = {};
+		maxBounds = {};
+		return;
+	}
+
+	const MatrixSplat matrix{ transform };
+	//One bounds pair per block, merged once all blocks are done; on the stack, this runs for every moving mesh every frame
+	const size_t numBlocks{ count < g_MinParallelCount ? 1 : GetNumBlocks(count) };
+	Vector3 blockMinBounds[g_MaxBlocks]{};
+	Vector3 blockMaxBounds[g_MaxBlocks]{};
+	ForEachBlock(count, [&](size_t first, size_t blockCount, size_t block)
+		{
+			TransformPointBlock(matrix, transform, pSource + first, pDestination + first, blockCount, blockMinBounds[block], blockMaxBounds[block]);
+		});
+
+	minBounds = blockMinBounds[0];
+	maxBounds = blockMaxBounds[0];
+	for (size_t i{ 1 }; i < numBlocks; ++i)
+	{
+		minBounds = { std::min(minBounds.x, blockMinBounds[i].x), std::min(minBounds.y, blockMinBounds[i].y), std::min(minBounds.z, blockMinBounds[i].z) };
+		maxBounds = { std::max(maxBounds.x, blockMaxBounds[i].x), std::max(maxBounds.y, blockMaxBounds[i].y), std::max(maxBounds.z, blockMaxBounds[i].z) };
+	}
+}
+
+void VertexTransform::TransformNormals(const Matrix& normalTransform, const Vector3* pSource, Vector3* pDestination, size_t count)
+{
+	const MatrixSplat matrix{ normalTransform };
+	ForEachBlock(count, [&](size_t first, size_t blockCount, size_t)
+		{
+			TransformNormalBlock(matrix, normalTransform, pSource + first, pDestination + first, blockCount);
+		});
+}
+
+void VertexTransform::RunBenchmark(size_t numVertices)
+{
+	std::mt19937 random{ 42 };
+	std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+	std::vector<Vector3> source(numVertices);
+	for (Vector3& vertex : source)
+	{
+		vertex = { distribution(random), distribution(random), distribution(random) };
+	}
+	std::vector<Vector3> destination(numVertices);
+
+	const Matrix transform{ Matrix::CreateScale(2.f, 1.f, .5f) * Matrix::CreateRotationY(.7f) * Matrix::CreateTranslation(1.f, 2.f, 3.f) };
+	const Matrix normalTransform{ Matrix::Transpose(Matrix::Inverse(transform)) };
+
+	//Best of a few runs, the first one also pays for page faults on the destination
+	const auto measure{ [numVertices](const char* pName, const auto& run)
+		{
+			float bestSeconds{ FLT_MAX };
+			for (int repeat{}; repeat < 5; ++repeat)
+			{
+				const auto start{ std::chrono::steady_clock::now() };
+				run();
+				bestSeconds = std::min(bestSeconds, std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
+			}
+			std::cout << "  " << pName << numVertices / bestSeconds / 1'000'000.f << " Mvertices/s" << std::endl;
+		} };
+
+	std::cout << "Transforming " << numVertices << " vertices (points with bounds, then normals)" << std::endl;
+	Vector3 minBounds{};
+	Vector3 maxBounds{};
+	measure("Points,  Matrix per vertex: ", [&]()
+		{
+			for (size_t i{}; i < numVertices; ++i)
+			{
+				destination[i] = transform.TransformPoint(source[i]);
+			}
+		});
+	measure("Points,  SSE, one core:     ", [&]()
+		{
+			TransformPointBlock(MatrixSplat{ transform }, transform, source.data(), destination.data(), numVertices, minBounds, maxBounds);
+		});
+	measure("Points,  SSE, all cores:    ", [&]()
+		{
+			TransformPoints(transform, source.data(), destination.data(), numVertices, minBounds, maxBounds);
+		});
+	measure("Normals, Matrix per vertex: ", [&]()
+		{
+			for (size_t i{}; i < numVertices; ++i)
+			{
+				destination[i] = normalTransform.TransformVector(source[i]).Normalized();
+			}
+		});
+	measure("Normals, SSE, one core:     ", [&]()
+		{
+			TransformNormalBlock(MatrixSplat{ normalTransform }, normalTransform, source.data(), destination.data(), numVertices);
+		});
+	measure("Normals, SSE, all cores:    ", [&]()
+		{
+			TransformNormals(normalTransform, source.data(), destination.data(), numVertices);
+		});
+}
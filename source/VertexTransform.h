@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Batched transforms of vertex arrays into storage the caller already sized
+	//Four vertices at a time with SSE: three loads of packed Vector3s are shuffled into x, y and z registers, transformed
+	//and shuffled back. Large arrays are split in blocks over all cores.
+	namespace VertexTransform
+	{
+		//Also returns the bounds of the transformed points, the zero vector for an empty array
+		void TransformPoints(const Matrix& transform, const Vector3* pSource, Vector3* pDestination, size_t count,
+			Vector3& minBounds, Vector3& maxBounds);
+		//normalTransform is the inverse transpose of the point transform; results are normalized
+		void TransformNormals(const Matrix& normalTransform, const Vector3* pSource, Vector3* pDestination, size_t count);
+
+		//Prints vertices per second for the per-vertex Matrix calls, the SSE kernel on one core and on all cores
+		void RunBenchmark(size_t numVertices);
+	}
+}
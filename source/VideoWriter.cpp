@@ -0,0 +1,178 @@
+#include "VideoWriter.h"
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace dae;
+
+namespace
+{
+	//Hands the real stdout to the video stream and points fd 1 at stderr, so log output cannot end up in the video
+	std::FILE* TakeStandardOutput()
+	{
+		fflush(stdout);
+#if defined(_WIN32)
+		const int videoHandle{ _dup(_fileno(stdout)) };
+		_dup2(_fileno(stderr), _fileno(stdout));
+		_setmode(videoHandle, _O_BINARY);
+		return _fdopen(videoHandle, "wb");
+#else
+		const int videoHandle{ dup(STDOUT_FILENO) };
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+		return fdopen(videoHandle, "wb");
+#endif
+	}
+}
+
+VideoWriter::VideoWriter(const std::string& filename, VideoFormat format, int width, int height, float framesPerSecond, size_t maxQueuedFrames) :
+	m_Format{ format },
+	m_Width{ width },
+	m_Height{ height },
+	m_MaxQueuedFrames{ std::max<size_t>(maxQueuedFrames, 1) }
+{
+#if !defined(_WIN32)
+	//An encoder that exits early must fail the write, not kill the renderer
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	m_IsStandardOutput = filename == "-";
+#if defined(_WIN32)
+	if (m_IsStandardOutput)
+		m_pFile = TakeStandardOutput();
+	else if (fopen_s(&m_pFile, filename.c_str(), "wb") != 0)
+		m_pFile = nullptr;
+#else
+	m_pFile = m_IsStandardOutput ? TakeStandardOutput() : fopen(filename.c_str(), "wb");
+#endif
+
+	if (!m_pFile)
+		return;
+
+	if (m_Format == VideoFormat::Y4M)
+	{
+		//Frame rate as a rational with millihertz precision
+		const long long rateNumerator{ std::llround(framesPerSecond * 1000.0) };
+		fprintf(m_pFile, "YUV4MPEG2 W%d H%d F%lld:1000 Ip A1:1 C444\n", m_Width, m_Height, rateNumerator);
+	}
+
+	m_Thread = std::thread{ &VideoWriter::Run, this };
+}
+
+VideoWriter::~VideoWriter()
+{
+	if (!m_pFile)
+		return;
+
+	{
+		const std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_FrameAdded.notify_one();
+	m_Thread.join();
+
+	fclose(m_pFile);
+}
+
+bool VideoWriter::ParseFormat(const std::string& name, VideoFormat& format)
+{
+	if (name == "y4m")
+		format = VideoFormat::Y4M;
+	else if (name == "rgb")
+		format = VideoFormat::RGB;
+	else
+		return false;
+	return true;
+}
+
+void VideoWriter::WriteFrame(std::vector<uint32_t>&& pixels, const ToneMappingUtils::SurfaceFormat& surfaceFormat)
+{
+	if (!m_pFile)
+		return;
+
+	{
+		//Backpressure: a slow encoder holds up the render loop instead of piling up frames
+		std::unique_lock lock{ m_Mutex };
+		m_FrameTaken.wait(lock, [this] { return m_Frames.size() < m_MaxQueuedFrames; });
+		m_Frames.push_back({ std::move(pixels), surfaceFormat });
+	}
+	m_FrameAdded.notify_one();
+}
+
+void VideoWriter::Run()
+{
+	std::unique_lock lock{ m_Mutex };
+	while (true)
+	{
+		m_FrameAdded.wait(lock, [this] { return !m_Frames.empty() || m_IsStopping; });
+		if (m_Frames.empty())
+			return;
+
+		const Frame frame{ std::move(m_Frames.front()) };
+		m_Frames.pop_front();
+
+		lock.unlock();
+		m_FrameTaken.notify_one();
+
+		//After the first failure (usually the reading end went away) frames are dropped quietly
+		if (!m_HasFailed && !Encode(frame))
+		{
+			m_HasFailed = true;
+			std::cerr << "Video stream write failed, dropping remaining frames" << std::endl;
+		}
+
+		lock.lock();
+	}
+}
+
+bool VideoWriter::Encode(const Frame& frame)
+{
+	const size_t numPixels{ static_cast<size_t>(m_Width) * m_Height };
+	const ToneMappingUtils::SurfaceFormat& format{ frame.surfaceFormat };
+
+	if (m_Format == VideoFormat::RGB)
+	{
+		m_EncodedFrame.resize(numPixels * 3);
+		for (size_t i{}; i < numPixels; ++i)
+		{
+			m_EncodedFrame[i * 3] = static_cast<uint8_t>(frame.pixels[i] >> format.redShift);
+			m_EncodedFrame[i * 3 + 1] = static_cast<uint8_t>(frame.pixels[i] >> format.greenShift);
+			m_EncodedFrame[i * 3 + 2] = static_cast<uint8_t>(frame.pixels[i] >> format.blueShift);
+		}
+	}
+	else
+	{
+		//"FRAME\n" followed by full Y, U and V planes, BT.601 studio range in 8.8 fixed point
+		static constexpr char frameHeader[]{ "FRAME\n" };
+		constexpr size_t headerSize{ sizeof(frameHeader) - 1 };
+
+		m_EncodedFrame.resize(headerSize + numPixels * 3);
+		std::copy(frameHeader, frameHeader + headerSize, m_EncodedFrame.begin());
+
+		uint8_t* pY{ m_EncodedFrame.data() + headerSize };
+		uint8_t* pU{ pY + numPixels };
+		uint8_t* pV{ pU + numPixels };
+
+		for (size_t i{}; i < numPixels; ++i)
+		{
+			const int r{ static_cast<uint8_t>(frame.pixels[i] >> format.redShift) };
+			const int g{ static_cast<uint8_t>(frame.pixels[i] >> format.greenShift) };
+			const int b{ static_cast<uint8_t>(frame.pixels[i] >> format.blueShift) };
+
+			pY[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			pU[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			pV[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+
+	return fwrite(m_EncodedFrame.data(), 1, m_EncodedFrame.size(), m_pFile) == m_EncodedFrame.size()
+		&& fflush(m_pFile) == 0;
+}
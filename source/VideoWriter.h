@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ToneMapping.h"
+
+namespace dae
+{
+	enum class VideoFormat
+	{
+		//YUV4MPEG2, 4:4:4 BT.601, readable by ffmpeg/x264 without further arguments
+		Y4M,
+		//Headerless rgb24, the size and rate have to be passed to the encoder
+		RGB
+	};
+
+	//Streams frames into one file or into stdout ("-") so they can be piped straight into an encoder
+	//Conversion and writing happen on a background thread, at most maxQueuedFrames wait in between
+	class VideoWriter final
+	{
+	public:
+		VideoWriter(const std::string& filename, VideoFormat format, int width, int height, float framesPerSecond, size_t maxQueuedFrames = 3);
+		~VideoWriter();
+
+		VideoWriter(const VideoWriter&) = delete;
+		VideoWriter(VideoWriter&&) noexcept = delete;
+		VideoWriter& operator=(const VideoWriter&) = delete;
+		VideoWriter& operator=(VideoWriter&&) noexcept = delete;
+
+		static bool ParseFormat(const std::string& name, VideoFormat& format);
+
+		bool IsOpen() const { return m_pFile != nullptr; }
+		bool HasFailed() const { return m_HasFailed; }
+
+		void WriteFrame(std::vector<uint32_t>&& pixels, const ToneMappingUtils::SurfaceFormat& surfaceFormat);
+
+	private:
+		struct Frame
+		{
+			std::vector<uint32_t> pixels{};
+			ToneMappingUtils::SurfaceFormat surfaceFormat{};
+		};
+
+		void Run();
+		bool Encode(const Frame& frame);
+
+		const VideoFormat m_Format{};
+		const int m_Width{};
+		const int m_Height{};
+		const size_t m_MaxQueuedFrames{};
+
+		std::FILE* m_pFile{};
+		bool m_IsStandardOutput{ false };
+		std::atomic<bool> m_HasFailed{ false };
+
+		//Reused between frames, only touched by the writer thread
+		std::vector<uint8_t> m_EncodedFrame{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_FrameAdded{};
+		std::condition_variable m_FrameTaken{};
+		std::deque<Frame> m_Frames{};
+		bool m_IsStopping{ false };
+
+		std::thread m_Thread{};
+	};
+}
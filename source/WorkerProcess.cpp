@@ -0,0 +1,377 @@
+#include "WorkerProcess.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <thread>
+
+using namespace dae;
+
+WorkerProcess::~WorkerProcess()
+{
+	Terminate();
+}
+
+#if defined(_WIN32)
+namespace
+{
+	HANDLE ToHandle(intptr_t handle)
+	{
+		return reinterpret_cast<HANDLE>(handle);
+	}
+
+	void AppendQuoted(std::string& commandLine, const std::string& argument)
+	{
+		if (!commandLine.empty())
+			commandLine += ' ';
+		commandLine += '"';
+		commandLine += argument;
+		commandLine += '"';
+	}
+}
+
+bool WorkerProcess::Launch(const std::vector<std::string>& arguments)
+{
+	char executablePath[MAX_PATH]{};
+	if (GetModuleFileNameA(nullptr, executablePath, MAX_PATH) == 0)
+		return false;
+
+	std::string commandLine{};
+	AppendQuoted(commandLine, executablePath);
+	for (const std::string& argument : arguments)
+	{
+		AppendQuoted(commandLine, argument);
+	}
+
+	//Only the child's ends of the pipes are inherited
+	SECURITY_ATTRIBUTES security{ sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+	HANDLE childInputRead{}, childInputWrite{}, childOutputRead{}, childOutputWrite{};
+	if (!CreatePipe(&childInputRead, &childInputWrite, &security, 0))
+		return false;
+	if (!CreatePipe(&childOutputRead, &childOutputWrite, &security, 0))
+	{
+		CloseHandle(childInputRead);
+		CloseHandle(childInputWrite);
+		return false;
+	}
+	SetHandleInformation(childInputWrite, HANDLE_FLAG_INHERIT, 0);
+	SetHandleInformation(childOutputRead, HANDLE_FLAG_INHERIT, 0);
+
+	STARTUPINFOA startupInfo{};
+	startupInfo.cb = sizeof(startupInfo);
+	startupInfo.dwFlags = STARTF_USESTDHANDLES;
+	startupInfo.hStdInput = childInputRead;
+	startupInfo.hStdOutput = childOutputWrite;
+	startupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+	PROCESS_INFORMATION processInfo{};
+	const BOOL isCreated{ CreateProcessA(executablePath, commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startupInfo, &processInfo) };
+
+	CloseHandle(childInputRead);
+	CloseHandle(childOutputWrite);
+
+	if (!isCreated)
+	{
+		CloseHandle(childInputWrite);
+		CloseHandle(childOutputRead);
+		return false;
+	}
+
+	CloseHandle(processInfo.hThread);
+	m_Process = reinterpret_cast<intptr_t>(processInfo.hProcess);
+	m_Input = reinterpret_cast<intptr_t>(childInputWrite);
+	m_Output = reinterpret_cast<intptr_t>(childOutputRead);
+	return true;
+}
+
+void WorkerProcess::Terminate(int gracePeriodMilliseconds)
+{
+	if (m_Input != m_InvalidHandle)
+		CloseHandle(ToHandle(m_Input));
+	if (m_Output != m_InvalidHandle)
+		CloseHandle(ToHandle(m_Output));
+	m_Input = m_InvalidHandle;
+	m_Output = m_InvalidHandle;
+
+	if (m_Process != m_InvalidHandle)
+	{
+		if (WaitForSingleObject(ToHandle(m_Process), static_cast<DWORD>(gracePeriodMilliseconds)) != WAIT_OBJECT_0)
+		{
+			TerminateProcess(ToHandle(m_Process), 1);
+			WaitForSingleObject(ToHandle(m_Process), INFINITE);
+		}
+		CloseHandle(ToHandle(m_Process));
+		m_Process = m_InvalidHandle;
+	}
+}
+
+bool WorkerProcess::Write(const void* pData, size_t size)
+{
+	const char* pBytes{ static_cast<const char*>(pData) };
+	while (size > 0)
+	{
+		DWORD numWritten{};
+		const DWORD chunkSize{ static_cast<DWORD>(std::min<size_t>(size, MAXDWORD)) };
+		if (!WriteFile(ToHandle(m_Input), pBytes, chunkSize, &numWritten, nullptr))
+			return false;
+		pBytes += numWritten;
+		size -= numWritten;
+	}
+	return true;
+}
+
+bool WorkerProcess::Read(void* pData, size_t size, int timeoutMilliseconds)
+{
+	const auto deadline{ std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds) };
+	char* pBytes{ static_cast<char*>(pData) };
+	while (size > 0)
+	{
+		//Anonymous pipes can not be read overlapped, so wait for data by peeking; fails once the child is gone
+		DWORD numAvailable{};
+		if (!PeekNamedPipe(ToHandle(m_Output), nullptr, 0, nullptr, &numAvailable, nullptr))
+			return false;
+		if (numAvailable == 0)
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+				return false;
+			Sleep(1);
+			continue;
+		}
+
+		DWORD numRead{};
+		const DWORD chunkSize{ static_cast<DWORD>(std::min<size_t>(size, numAvailable)) };
+		if (!ReadFile(ToHandle(m_Output), pBytes, chunkSize, &numRead, nullptr) || numRead == 0)
+			return false;
+		pBytes += numRead;
+		size -= numRead;
+	}
+	return true;
+}
+
+WorkerChannel::WorkerChannel()
+{
+	fflush(stdout);
+	m_Input = _fileno(stdin);
+	m_Output = _dup(_fileno(stdout));
+	_dup2(_fileno(stderr), _fileno(stdout));
+
+	_setmode(m_Input, _O_BINARY);
+	_setmode(m_Output, _O_BINARY);
+}
+
+bool WorkerChannel::Write(const void* pData, size_t size)
+{
+	const char* pBytes{ static_cast<const char*>(pData) };
+	while (size > 0)
+	{
+		const int numWritten{ _write(m_Output, pBytes, static_cast<unsigned int>(std::min<size_t>(size, INT_MAX))) };
+		if (numWritten <= 0)
+			return false;
+		pBytes += numWritten;
+		size -= numWritten;
+	}
+	return true;
+}
+
+bool WorkerChannel::Read(void* pData, size_t size)
+{
+	char* pBytes{ static_cast<char*>(pData) };
+	while (size > 0)
+	{
+		const int numRead{ _read(m_Input, pBytes, static_cast<unsigned int>(std::min<size_t>(size, INT_MAX))) };
+		if (numRead <= 0)
+			return false;
+		pBytes += numRead;
+		size -= numRead;
+	}
+	return true;
+}
+#else
+namespace
+{
+	bool WriteAll(int handle, const void* pData, size_t size)
+	{
+		const char* pBytes{ static_cast<const char*>(pData) };
+		while (size > 0)
+		{
+			const ssize_t numWritten{ write(handle, pBytes, size) };
+			if (numWritten < 0 && errno == EINTR)
+				continue;
+			if (numWritten <= 0)
+				return false;
+			pBytes += numWritten;
+			size -= static_cast<size_t>(numWritten);
+		}
+		return true;
+	}
+
+	bool ReadAll(int handle, void* pData, size_t size)
+	{
+		char* pBytes{ static_cast<char*>(pData) };
+		while (size > 0)
+		{
+			const ssize_t numRead{ read(handle, pBytes, size) };
+			if (numRead < 0 && errno == EINTR)
+				continue;
+			if (numRead <= 0)
+				return false;
+			pBytes += numRead;
+			size -= static_cast<size_t>(numRead);
+		}
+		return true;
+	}
+}
+
+bool WorkerProcess::Launch(const std::vector<std::string>& arguments)
+{
+	//Writing to a dead worker must fail the write, not kill the coordinator
+	signal(SIGPIPE, SIG_IGN);
+
+	static const char* executablePath{ "/proc/self/exe" };
+
+	//argv is built before forking, the child only execs
+	std::vector<char*> argv{};
+	argv.push_back(const_cast<char*>(executablePath));
+	for (const std::string& argument : arguments)
+	{
+		argv.push_back(const_cast<char*>(argument.c_str()));
+	}
+	argv.push_back(nullptr);
+
+	int childInput[2]{};
+	int childOutput[2]{};
+	if (pipe(childInput) != 0)
+		return false;
+	if (pipe(childOutput) != 0)
+	{
+		close(childInput[0]);
+		close(childInput[1]);
+		return false;
+	}
+
+	//Later workers must not inherit this worker's pipes, or it would never see end of input
+	fcntl(childInput[1], F_SETFD, FD_CLOEXEC);
+	fcntl(childOutput[0], F_SETFD, FD_CLOEXEC);
+
+	const pid_t processId{ fork() };
+	if (processId == 0)
+	{
+		dup2(childInput[0], STDIN_FILENO);
+		dup2(childOutput[1], STDOUT_FILENO);
+		close(childInput[0]);
+		close(childInput[1]);
+		close(childOutput[0]);
+		close(childOutput[1]);
+
+		execv(executablePath, argv.data());
+		_exit(127);
+	}
+
+	close(childInput[0]);
+	close(childOutput[1]);
+
+	if (processId < 0)
+	{
+		close(childInput[1]);
+		close(childOutput[0]);
+		return false;
+	}
+
+	m_Process = processId;
+	m_Input = childInput[1];
+	m_Output = childOutput[0];
+	return true;
+}
+
+void WorkerProcess::Terminate(int gracePeriodMilliseconds)
+{
+	if (m_Input != m_InvalidHandle)
+		close(static_cast<int>(m_Input));
+	if (m_Output != m_InvalidHandle)
+		close(static_cast<int>(m_Output));
+	m_Input = m_InvalidHandle;
+	m_Output = m_InvalidHandle;
+
+	if (m_Process != m_InvalidHandle)
+	{
+		const pid_t processId{ static_cast<pid_t>(m_Process) };
+		const auto deadline{ std::chrono::steady_clock::now() + std::chrono::milliseconds(gracePeriodMilliseconds) };
+		while (waitpid(processId, nullptr, WNOHANG) == 0)
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				kill(processId, SIGKILL);
+				waitpid(processId, nullptr, 0);
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		m_Process = m_InvalidHandle;
+	}
+}
+
+bool WorkerProcess::Write(const void* pData, size_t size)
+{
+	return WriteAll(static_cast<int>(m_Input), pData, size);
+}
+
+bool WorkerProcess::Read(void* pData, size_t size, int timeoutMilliseconds)
+{
+	const int handle{ static_cast<int>(m_Output) };
+	const auto deadline{ std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds) };
+	char* pBytes{ static_cast<char*>(pData) };
+	while (size > 0)
+	{
+		const auto remaining{ std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()) };
+		pollfd pollHandle{ handle, POLLIN, 0 };
+		const int numReady{ poll(&pollHandle, 1, static_cast<int>(std::max<int64_t>(remaining.count(), 0))) };
+		if (numReady < 0 && errno == EINTR)
+			continue;
+		if (numReady <= 0)
+			return false;
+
+		const ssize_t numRead{ read(handle, pBytes, size) };
+		if (numRead < 0 && errno == EINTR)
+			continue;
+		if (numRead <= 0)
+			return false;
+		pBytes += numRead;
+		size -= static_cast<size_t>(numRead);
+	}
+	return true;
+}
+
+WorkerChannel::WorkerChannel()
+{
+	fflush(stdout);
+	m_Input = STDIN_FILENO;
+	m_Output = dup(STDOUT_FILENO);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+}
+
+bool WorkerChannel::Write(const void* pData, size_t size)
+{
+	return WriteAll(m_Output, pData, size);
+}
+
+bool WorkerChannel::Read(void* pData, size_t size)
+{
+	return ReadAll(m_Input, pData, size);
+}
+#endif
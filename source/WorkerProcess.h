@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	//A second instance of this executable, talked to over its stdin/stdout pipes
+	//A crashed or killed child makes Read/Write return false instead of raising a signal, a hung one makes Read time out
+	class WorkerProcess final
+	{
+	public:
+		WorkerProcess() = default;
+		~WorkerProcess();
+
+		WorkerProcess(const WorkerProcess&) = delete;
+		WorkerProcess(WorkerProcess&&) noexcept = delete;
+		WorkerProcess& operator=(const WorkerProcess&) = delete;
+		WorkerProcess& operator=(WorkerProcess&&) noexcept = delete;
+
+		bool Launch(const std::vector<std::string>& arguments);
+		//Closes the pipes and gives the child up to gracePeriodMilliseconds to exit before it is killed
+		void Terminate(int gracePeriodMilliseconds = 0);
+
+		bool IsRunning() const { return m_Process != m_InvalidHandle; }
+
+		bool Write(const void* pData, size_t size);
+		//Fails when all size bytes did not arrive within timeoutMilliseconds
+		bool Read(void* pData, size_t size, int timeoutMilliseconds);
+
+	private:
+		//Process id / file descriptors on POSIX, HANDLEs on Windows
+		static constexpr intptr_t m_InvalidHandle{ -1 };
+		intptr_t m_Process{ m_InvalidHandle };
+		intptr_t m_Input{ m_InvalidHandle };
+		intptr_t m_Output{ m_InvalidHandle };
+	};
+
+	//The child side of a WorkerProcess: the protocol owns the original stdin/stdout,
+	//stdout itself is pointed at stderr so stray prints cannot corrupt the stream
+	class WorkerChannel final
+	{
+	public:
+		WorkerChannel();
+		~WorkerChannel() = default;
+
+		WorkerChannel(const WorkerChannel&) = delete;
+		WorkerChannel(WorkerChannel&&) noexcept = delete;
+		WorkerChannel& operator=(const WorkerChannel&) = delete;
+		WorkerChannel& operator=(WorkerChannel&&) noexcept = delete;
+
+		bool Write(const void* pData, size_t size);
+		bool Read(void* pData, size_t size);
+
+	private:
+		int m_Input{ -1 };
+		int m_Output{ -1 };
+	};
+}
@@ -1,16 +1,27 @@
 //External includes
+#if defined(_WIN32)
 #include "vld.h"
+#endif
 #include "SDL.h"
 #include "SDL_surface.h"
 #undef main
 
 //Standard includes
 #include <iostream>
+#include <string>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "BatchRenderer.h"
+#include "SceneFile.h"
+#include "VertexTransform.h"
+#include "MathBenchmark.h"
+#include "AllocationTracker.h"
+#include "RenderBenchmark.h"
+#include "KernelBenchmark.h"
+#include "Parallel.h"
 
 using namespace dae;
 
@@ -22,9 +33,76 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Offline rendering without a window
+	if (argc > 1 && std::string(args[1]) == "--batch")
+	{
+		BatchRenderSettings settings{};
+		if (!ParseBatchRenderArguments(argc, args, settings))
+			return 1;
+
+		return RunBatchRender(settings);
+	}
+
+	//Spawned by a batch render with --workers, renders the tile ranges it is sent
+	if (argc > 1 && std::string(args[1]) == "--worker")
+	{
+		BatchRenderSettings settings{};
+		if (!ParseBatchRenderArguments(argc, args, settings))
+			return 1;
+
+		return RunRenderWorker(settings);
+	}
+
+	//Single-process against multi-worker frames, also with a worker that exits or hangs: RayTracer --validate-workers [batch options]
+	if (argc > 1 && std::string(args[1]) == "--validate-workers")
+	{
+		BatchRenderSettings settings{};
+		if (!ParseBatchRenderArguments(argc, args, settings))
+			return 1;
+
+		return ValidateWorkers(settings) ? 0 : 1;
+	}
+
+	//Text scene file to binary: RayTracer --convert-scene <in.scene> <out.sceneb>
+	if (argc == 4 && std::string(args[1]) == "--convert-scene")
+		return SceneFile::Convert(args[2], args[3]) ? 0 : 1;
+
+	//Vertices per second of the mesh transform kernels: RayTracer --benchmark-transforms [numVertices]
+	if (argc > 1 && std::string(args[1]) == "--benchmark-transforms")
+	{
+		VertexTransform::RunBenchmark(argc > 2 ? std::stoul(args[2]) : 1'000'000);
+		return 0;
+	}
+
+	//Old and new math core on the intersection kernels: RayTracer --benchmark-math [numRays]
+	if (argc > 1 && std::string(args[1]) == "--benchmark-math")
+	{
+		MathBenchmark::Run(argc > 2 ? std::stoul(args[2]) : 100'000);
+		return 0;
+	}
+
+	//Time per call of the hit tests, BRDFs and materials: RayTracer --benchmark-kernels [numSamples] [filter]
+	if (argc > 1 && std::string(args[1]) == "--benchmark-kernels")
+	{
+		KernelBenchmark::Run(argc > 2 ? std::stoul(args[2]) : 100'000, argc > 3 ? args[3] : "");
+		return 0;
+	}
+
+	//Every built-in scene along a scripted camera path, results as JSON: RayTracer --benchmark-render [json file] [numFrames]
+	if (argc > 1 && std::string(args[1]) == "--benchmark-render")
+		return RenderBenchmark::Run(argc > 2 ? args[2] : "benchmark.json", argc > 3 ? std::stoi(args[3]) : 60) ? 0 : 1;
+
+	//Any other argument names the scene to show, built-in or a scene file
+	Scene* pSceneFromArguments{};
+	if (argc > 1)
+	{
+		pSceneFromArguments = CreateScene(args[1]);
+		if (!pSceneFromArguments)
+		{
+			std::cout << "Could not create scene: " << args[1] << std::endl;
+			return 1;
+		}
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -44,13 +122,24 @@ int main(int argc, char* args[])
 	//Initialize "framework"
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
+	pRenderer->SetTargetFrameTime(1.f / 30.f);
 
 	//const auto pScene = new Scene_W1();
 	//const auto pScene = new Scene_W2();
 	//const auto pScene = new Scene_W3();
-	const auto pScene = new Scene_W4_ReferenceScene();
+	const auto pScene = pSceneFromArguments ? pSceneFromArguments : new Scene_W4_ReferenceScene();
 	//const auto pScene = new Scene_W4_TestScene();
 	pScene->Initialize();
+	pScene->PublishFrame();
+
+	//Updates the next frame while the current one renders, started once so a frame does not start a thread
+	struct UpdateContext
+	{
+		Scene* pScene;
+		Timer* pTimer;
+	};
+	UpdateContext updateContext{ pScene, pTimer };
+	Parallel::BackgroundWorker updateWorker{};
 
 	//Start loop
 	pTimer->Start();
@@ -59,6 +148,8 @@ int main(int argc, char* args[])
 	bool takeScreenshot = false;
 	while (isLooping)
 	{
+		AllocationTracker::BeginFrame();
+
 		//--------- Get input events ---------
 		SDL_Event e;
 		while (SDL_PollEvent(&e))
@@ -75,18 +166,49 @@ int main(int argc, char* args[])
 					pRenderer->ToggleShadows();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 					pRenderer->CycleLightningMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					pRenderer->ToggleTemporalCache();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					pRenderer->CycleDirtyRegionMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
+					pRenderer->ToggleDynamicResolution();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					pRenderer->CycleToneMappingMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderer->TogglePixelTraversalOrder();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderer->ProfilePixelTraversalOrders(pScene);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					pRenderer->CycleSoftShadowSamples();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					pRenderer->ToggleDenoiser();
 				break;
 			}
 		}
 
-		//--------- Update ---------
-		pScene->Update(pTimer);
+		//--------- Update (next frame) ---------
+		//SDL input is read here on the main thread, the update only sees this copy
+		CameraInput cameraInput{};
+		cameraInput.Sample();
+		pScene->SetCameraInput(cameraInput);
+
+		//Runs alongside the render below, which reads the snapshot the last PublishFrame took
+		updateWorker.Start([](void* pContext)
+			{
+				const UpdateContext& context{ *static_cast<UpdateContext*>(pContext) };
+				const AllocationTracker::PhaseScope phaseScope{ AllocationTracker::Phase::Update };
+				context.pScene->Update(context.pTimer);
+			}, &updateContext);
 
 		//--------- Render ---------
 		pRenderer->Render(pScene);
 
+		updateWorker.Wait();
+		pScene->PublishFrame();
+
 		//--------- Timer ---------
 		pTimer->Update();
+		pRenderer->Update(pTimer);
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
@@ -97,14 +219,14 @@ int main(int argc, char* args[])
 		//Save screenshot after full render
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+			std::cout << "Saving screenshot " << pRenderer->SaveBufferToImage() << std::endl;
 			takeScreenshot = false;
 		}
+
+		AllocationTracker::EndFrame();
 	}
 	pTimer->Stop();
+	AllocationTracker::PrintReport();
 
 	//Shutdown "framework"
 	delete pScene;